@@ -357,6 +357,61 @@ TChain* CommonFunc::MakeChain(const char* _treename_, TString _listname_, TStrin
   return fchain;
 }
 
+// Set up the TTreeCache of a tree or chain. The current file must be loaded
+// (e.g. with LoadTree()) so that the branches can be added to the cache. A
+// TChain keeps the cache and its branches when it moves to the next file.
+void CommonFunc::SetReadProfile(TTree *tree, ReadProfile profile){
+  if(profile.cacheSize<=0) return;
+  if(profile.asyncPrefetch && gEnv->GetValue("TFile.AsyncPrefetching",0)==0){
+    gEnv->SetValue("TFile.AsyncPrefetching",1);
+  }
+  TTreeCache::SetLearnEntries(profile.learnEntries>0 ? profile.learnEntries : 1);
+  tree->SetCacheSize(profile.cacheSize);
+  for(int i=0;i<(int)profile.branches.size();i++){
+    tree->AddBranchToCache(profile.branches[i],kTRUE);
+  }
+  // Known branches need no learning phase:
+  if(profile.branches.size()>0 && profile.learnEntries<=0){
+    tree->StopCacheLearningPhase();
+  }
+  cout<<"SetReadProfile: cache of "<<profile.cacheSize/1048576.<<" MB for "
+      <<profile.branches.size()<<" branches, learning "<<profile.learnEntries
+      <<" entries, async prefetch "<<(profile.asyncPrefetch?"on":"off")<<endl;
+}
+
+// Add the efficiency of the cache of a tree, weighted by the entries read. A
+// TChain keeps its cache object (and its read counters) when it moves to the
+// next file, so this is called once at the end of the loop over all files.
+void CommonFunc::AddCacheStats(TTree *tree, Long64_t entries, CacheStats &stats){
+  if(!tree->GetCurrentFile()) return;
+  TTreeCache *cache=tree->GetReadCache(tree->GetCurrentFile());
+  if(!cache) return;
+  stats.hits+=cache->GetEfficiency()*entries;
+  stats.entries+=entries;
+}
+
+// Fraction of the reads that were served by the caches, over all trees added.
+double CommonFunc::CacheHitRate(const CacheStats &stats){
+  if(stats.entries<=0) return 0;
+  return stats.hits/stats.entries;
+}
+
+// Reset the bytes and read calls counted for all files.
+void CommonFunc::ResetReadStats(){
+  TFile::SetFileBytesRead(0);
+  TFile::SetFileReadCalls(0);
+}
+
+// Print the bytes and read calls for all files since ResetReadStats().
+void CommonFunc::PrintReadStats(TString tag, double hitRate){
+  Long64_t bytes=TFile::GetFileBytesRead();
+  Int_t calls=TFile::GetFileReadCalls();
+  cout<<tag<<": read "<<bytes/1048576.<<" MB in "<<calls<<" calls";
+  if(calls>0) cout<<" ("<<bytes/1024./calls<<" kB/call)";
+  if(hitRate>=0) cout<<", cache hit rate "<<100.*hitRate<<" %";
+  cout<<endl;
+}
+
 bool CommonFunc::descending_on_Pt(TLorentzVector a, TLorentzVector b){
   return a.Pt()>b.Pt();
 }
@@ -8,6 +8,18 @@ using namespace RooFit;
 const double epsilon=1e-6;
 
 namespace CommonFunc{
+  // Read settings for a chain, applied with SetReadProfile():
+  struct ReadProfile{
+    Long64_t cacheSize;             // TTreeCache size in bytes (0 = no cache)
+    std::vector<TString> branches;  // Branches to cache (empty = learn them)
+    Long64_t learnEntries;          // Entries in the cache learning phase
+    bool asyncPrefetch;             // Read ahead in a separate thread
+  };
+  // Cache efficiency of trees, weighted by their entries with AddCacheStats():
+  struct CacheStats{
+    double hits;                    // Entries times the cache efficiency
+    double entries;                 // Entries read through the caches
+  };
   TH1F* CreateHist(TString title="hist",TString tag="",TString axisx="",
 		   TString axisy="",int nbin=100,double xmin=0,double xmax=100,
 		   double min=0);
@@ -50,6 +62,11 @@ namespace CommonFunc{
   double DiffPhi(double);
   void Report(const char* ,const char*);
   TChain* MakeChain(const char*, TString, TString, bool isroot=false);
+  void SetReadProfile(TTree*, ReadProfile);
+  void AddCacheStats(TTree*, Long64_t, CacheStats&);
+  double CacheHitRate(const CacheStats&);
+  void ResetReadStats();
+  void PrintReadStats(TString, double hitRate=-1);
   bool descending_on_Pt(TLorentzVector, TLorentzVector);
   int FindBin(TH1 *h, double lowedge);
   TH1F* TH1DtoTH1F(TH1D *hd);
@@ -47,6 +47,8 @@
 #include <TH1F.h>
 #include <TH2F.h>
 #include <TTree.h>
+#include <TTreeCache.h>
+#include <TEnv.h>
 #include <TString.h>
 #include <TH2.h>
 #include <THStack.h>
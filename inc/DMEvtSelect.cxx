@@ -9,15 +9,26 @@
 //  This class is used to implement the cuts for the H->gg + DM analysis. In  //
 //  addition to testing each cut, it has a built-in event counter.            //
 //                                                                            //
-//  To add a new cut, two modifications must be made at the locations labeled //
-//  with the tag "ADD CUT HERE":                                              //
-//    - add to the list of cutList in DMEvtSelect()                          //
+//  The cut list, thresholds and categorization are resolved once in the      //
+//  constructor into a selection plan of typed cuts with integer IDs, so the  //
+//  event loop never reads the config file or compares strings. The methods   //
+//  taking cut names remain as thin wrappers around the integer ones.         //
+//                                                                            //
+//  Systematic variations of the selection can be evaluated together with     //
+//  evaluateSysVariations(), which applies the plan to all variations in one  //
+//  pass over structure-of-arrays buffers and keeps dense counters for each.  //
+//                                                                            //
+//  To add a new cut, three modifications must be made at the locations       //
+//  labeled with the tag "ADD CUT HERE":                                      //
+//    - add a new type to the CutType enum in DMEvtSelect.h                   //
+//    - add to the list of cutList and cutTypes in compilePlan()              //
 //    - add to the implementation of cuts in passesCut()                      //
 //                                                                            //
 //  Similarly, you will need to update category definitions in the locations  //
 //  identified with the tag "ADD CATE HERE":                                  //
-//    - add to the list of cateSchemes in DMEvtSelect()                       //
-//    - add to the implementation of categories in getCategory()              //
+//    - add a new type to the CateType enum in DMEvtSelect.h                  //
+//    - add to the list of cateSchemes in compilePlan()                       //
+//    - add to the implementation of categories in getCategoryNumber()        //
 //                                                                            //
 //  Note: the counter is a bit finnicky. Either check each step of the        //
 //  individually OR use passesCut("all"), but don't use both. Otherwise, you  //
@@ -30,45 +41,111 @@
 
 /**
    -----------------------------------------------------------------------------
-   Initializes the tool and loads XS, BR values from files. 
+   Initializes the tool and compiles the selection plan from the config file.
    @param newTree - The TTree which contains the sample.
+   @param newConfigFile - The analysis configuration file.
 */
 DMEvtSelect::DMEvtSelect(DMTree* newTree, TString newConfigFile) {
   std::cout << "DMEvtSelect: Initializing DMEvtSelect" << std::endl;
   
   // Load the config file:
   m_config = new Config(newConfigFile);
-  
+  compilePlan(newTree);
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Initializes the tool from settings that are already loaded. This allows the
+   cut values to be changed (with Config::setValue()) without a new file.
+   @param newTree - The TTree which contains the sample.
+   @param newConfig - The analysis settings, owned by the caller.
+*/
+DMEvtSelect::DMEvtSelect(DMTree* newTree, Config *newConfig) {
+  std::cout << "DMEvtSelect: Initializing DMEvtSelect" << std::endl;
+  m_config = newConfig;
+  compilePlan(newTree);
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Compile the selection plan and categorization from the settings.
+   @param newTree - The TTree which contains the sample.
+*/
+void DMEvtSelect::compilePlan(DMTree *newTree) {
   // Store the general and analysis specific cuts:
   m_cutList.clear();
+  m_cutTypes.clear();
+  m_cutMxAODIndex.clear();
   
   // Get the MxAOD cuts:
   std::vector<TString> cutFlowMxAODs = m_config->getStrV("MxAODCutList");
   for (int i_c = 0; i_c < (int)cutFlowMxAODs.size(); i_c++) {
     m_cutList.push_back(cutFlowMxAODs[i_c]);
+    m_cutTypes.push_back(kMxAODCut);
+    m_cutMxAODIndex.push_back(i_c);
   }
   
+  // ADD CUT HERE:
   // Then add analysis-specific cuts:
+  m_cutDiphotonPT = 0.0;
+  m_cutETMiss = 0.0;
   if (m_config->getBool("LeptonVeto")) {
     m_cutList.push_back("LeptonVeto");
+    m_cutTypes.push_back(kLeptonVeto);
+    m_cutMxAODIndex.push_back(-1);
   }
   if (m_config->isDefined("AnaCutDiphotonPT")) {
     m_cutList.push_back("DiphotonPT");
+    m_cutTypes.push_back(kDiphotonPT);
+    m_cutMxAODIndex.push_back(-1);
+    m_cutDiphotonPT = m_config->getNum("AnaCutDiphotonPT");
   }
   if (m_config->isDefined("AnaCutETMiss")) {
     m_cutList.push_back("DiphotonETMiss");
+    m_cutTypes.push_back(kDiphotonETMiss);
+    m_cutMxAODIndex.push_back(-1);
+    m_cutETMiss = m_config->getNum("AnaCutETMiss");
   }
   m_cutList.push_back("AllCuts");
+  m_cutTypes.push_back(kAllCuts);
+  m_cutMxAODIndex.push_back(-1);
   
-  // Load the category information:
-  m_cateSchemesAndSizes.clear();
-  m_cateSchemesAndSizes[m_config->getStr("cateScheme")]
-    = m_config->getInt("nCategories");
+  // ADD CATE HERE:
+  // Load the category information and the thresholds it uses:
+  m_cateScheme = m_config->getStr("cateScheme");
+  m_nCategories = m_config->getInt("nCategories");
+  m_ratioCut1 = 0.0; m_ratioCut2 = 0.0;
+  m_etMissCut1 = 0.0; m_etMissCut2 = 0.0;
+  m_diphotonPTCut1 = 0.0; m_diphotonPTCut2 = 0.0;
+  m_pTHardCut = 0.0;
+  if (m_cateScheme.EqualTo("inclusive")) m_cateType = kInclusive;
+  else if (m_cateScheme.EqualTo("splitETMiss")) m_cateType = kSplitETMiss;
+  else if (m_cateScheme.EqualTo("RatioEtmPt")) {
+    m_cateType = kRatioEtmPt;
+    m_ratioCut1 = m_config->getNum("RatioCut1");
+    m_ratioCut2 = m_config->getNum("RatioCut2");
+  }
+  else if (m_cateScheme.EqualTo("combined")) {
+    m_cateType = kCombined;
+    m_etMissCut1 = m_config->getNum("ETMissCut1");
+    m_etMissCut2 = m_config->getNum("ETMissCut2");
+    m_diphotonPTCut1 = m_config->getNum("DiphotonPTCut1");
+    m_diphotonPTCut2 = m_config->getNum("DiphotonPTCut2");
+    m_pTHardCut = m_config->getNum("PTHardCut");
+  }
+  else m_cateType = kUnknownCate;
   
+  // The tree only reads the object branches that the plan needs:
   m_evtTree = newTree;
+  if (m_evtTree) m_evtTree->requireObjects(requiredObjects());
   
   // Set the systematic variation ("Nominal" by default):
   m_sysVariation = "Nominal";
+  m_sysIndex = 0;
+  
+  // No systematic variations are evaluated together by default:
+  m_nSysSlots = 0;
+  m_sysIndices.clear();
   
   // Create a temporary cutflow histogram, to be replaced:
   m_cutFlowHist_weighted = new TH1F("cutflow_weighted", "cutflow_weighted",
@@ -84,24 +161,153 @@ DMEvtSelect::DMEvtSelect(DMTree* newTree, TString newConfigFile) {
   std::cout << "DMEvtSelect: Successfully initialized!" << std::endl;
 }
 
-/** 
+/**
+   -----------------------------------------------------------------------------
+   Add the event counters and cutflow histograms of another selector to this
+   one. Used to merge selectors that ran over different parts of a sample.
+   @param selector - The selector whose counters will be added to this one.
+*/
+void DMEvtSelect::addCounters(DMEvtSelect *selector) {
+  for (int i_c = 0; i_c < (int)m_cutList.size(); i_c++) {
+    m_evtCountPass[i_c] += selector->getPassingEvents(m_cutList[i_c]);
+    m_evtCountPassWt[i_c] += selector->getPassingEventsWt(m_cutList[i_c]);
+    m_evtCountTot[i_c] += selector->getTotalEvents(m_cutList[i_c]);
+    m_evtCountTotWt[i_c] += selector->getTotalEventsWt(m_cutList[i_c]);
+  }
+  for (int i_c = 0; i_c < m_nCategories; i_c++) {
+    m_cateCount[i_c] += selector->getEventsPerCate(m_cateScheme, i_c);
+    m_cateCountWt[i_c] += selector->getEventsPerCateWt(m_cateScheme, i_c);
+  }
+  // Counters of the systematic variations (same variation list assumed):
+  if (selector->m_nSysSlots != m_nSysSlots) {
+    std::cout << "DMEvtSelect: Error! Cannot add counters for different "
+	      << "systematic variation lists." << std::endl;
+    exit(0);
+  }
+  for (int i_i = 0; i_i < (int)m_sysCountPass.size(); i_i++) {
+    m_sysCountPass[i_i] += selector->m_sysCountPass[i_i];
+    m_sysCountPassWt[i_i] += selector->m_sysCountPassWt[i_i];
+    m_sysCountTot[i_i] += selector->m_sysCountTot[i_i];
+    m_sysCountTotWt[i_i] += selector->m_sysCountTotWt[i_i];
+  }
+  for (int i_i = 0; i_i < (int)m_sysCateCount.size(); i_i++) {
+    m_sysCateCount[i_i] += selector->m_sysCateCount[i_i];
+    m_sysCateCountWt[i_i] += selector->m_sysCateCountWt[i_i];
+  }
+  m_cutFlowHist_weighted->Add(selector->retrieveCutflowHist(true));
+  m_cutFlowHist_unweighted->Add(selector->retrieveCutflowHist(false));
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Add a set of counter values from getCounterValues() to the counters of this
+   selector. Used to merge selectors that were saved to file.
+   @param values - The counter values of another selector with the same cuts,
+   categories and systematic variations.
+*/
+void DMEvtSelect::addCounterValues(std::vector<double> values) {
+  if (values.size() != getCounterValues().size()) {
+    std::cout << "DMEvtSelect: Error! Cannot add counter values of size "
+	      << values.size() << std::endl;
+    exit(0);
+  }
+  int index = 0;
+  for (int i_c = 0; i_c < (int)m_cutList.size(); i_c++) {
+    m_evtCountPass[i_c] += (int)values[index++];
+    m_evtCountPassWt[i_c] += values[index++];
+    m_evtCountTot[i_c] += (int)values[index++];
+    m_evtCountTotWt[i_c] += values[index++];
+  }
+  for (int i_c = 0; i_c < m_nCategories; i_c++) {
+    m_cateCount[i_c] += (int)values[index++];
+    m_cateCountWt[i_c] += values[index++];
+  }
+  for (int i_i = 0; i_i < (int)m_sysCountPass.size(); i_i++) {
+    m_sysCountPass[i_i] += (int)values[index++];
+    m_sysCountPassWt[i_i] += values[index++];
+    m_sysCountTot[i_i] += (int)values[index++];
+    m_sysCountTotWt[i_i] += values[index++];
+  }
+  for (int i_i = 0; i_i < (int)m_sysCateCount.size(); i_i++) {
+    m_sysCateCount[i_i] += (int)values[index++];
+    m_sysCateCountWt[i_i] += values[index++];
+  }
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Find the category of the current event for one systematic variation, using
+   the compiled categorization and the derived quantities of the DMTree. Does
+   not update any counters.
+   @param sysIndex - The DMTree index of the systematic variation.
+   @return - The category number, or -1 if the event cannot be categorized.
+*/
+int DMEvtSelect::categorize(int sysIndex) {
+  float etMiss = m_evtTree->HGamEventInfoAuxDyn_TST_met[sysIndex];
+  float pTyy = m_evtTree->HGamEventInfoAuxDyn_pT_yy[sysIndex];
+  
+  // ADD CATE HERE:
+  int currCate = -1;
+  
+  // Inclusive categorization - only 1 category.
+  if (m_cateType == kInclusive) {
+    currCate = 0;
+  }
+  // Split MET - low and high MET categories.
+  else if (m_cateType == kSplitETMiss) {
+    if (etMiss > 140000.0) currCate = 1;
+    else currCate = 0;
+  }
+  // Ratio ETMiss/pT categorization:
+  else if (m_cateType == kRatioEtmPt) {
+    double currRatio = m_evtTree->ratioETMisspTyy(sysIndex);
+    if (currRatio < m_ratioCut1) currCate = 0;
+    else if (currRatio >= m_ratioCut1 && currRatio < m_ratioCut2) currCate = 1;
+    else if (currRatio >= m_ratioCut2) currCate = 2;
+  }
+  else if (m_cateType == kCombined) {
+    
+    // High-MET region (ETMiss > 100 GeV):
+    if (etMiss > m_etMissCut2) {
+      // Combine with high-PT to get mono-H category:
+      if (pTyy > m_diphotonPTCut2) currCate = 4;
+      else currCate = 3;
+    }
+    
+    // Intermediate ETMiss and pTHard region:
+    else if (etMiss > m_etMissCut1 && m_evtTree->pTHard() > m_pTHardCut) {
+      currCate = 2;
+    }
+    
+    // Rest category (everything else with pTyy > 15 GeV).
+    else if (pTyy > m_diphotonPTCut1) {
+      currCate = 1;
+    }
+    
+    // Need to have a category for all other events.
+    else {
+      currCate = 0;
+    }
+  }
+  return currCate;
+}
+
+/**
    -----------------------------------------------------------------------------
     Check whether the specified category has been defined.
     @param cateScheme - The name of the categorization.
-    @return - True iff the categorization has been defined. 
+    @return - True iff the categorization has been defined.
 */
 bool DMEvtSelect::cateExists(TString cateScheme) {
-  // Checks if there is a key corresponding to cateScheme in the map: 
-  bool nonExistent = (m_cateCount.find(Form("%s_0",cateScheme.Data()))
-		      == m_cateCount.end());
+  bool nonExistent = !cateScheme.EqualTo(m_cateScheme);
   if (nonExistent) {
     std::cout << "DMEvtSelect: Category " << cateScheme << " not defined!"
 	      << std::endl;
     std::cout << "DMEvtSelect: Printing m_cateCount and contents for reference."
 	      << std::endl;
-    for (std::map<TString,int>::iterator it = m_cateCount.begin(); 
-	 it != m_cateCount.end(); it++) {
-      std::cout << "\t" << it->first << "\t" << it->second << std::endl;
+    for (int i_c = 0; i_c < m_nCategories; i_c++) {
+      std::cout << "\t" << m_cateScheme << "_" << i_c << "\t"
+		<< m_cateCount[i_c] << std::endl;
     }
   }
   return !nonExistent;
@@ -112,28 +318,21 @@ bool DMEvtSelect::cateExists(TString cateScheme) {
    Clear the event counters.
 */
 void DMEvtSelect::clearCounters() {
-  // Clear the maps:
-  m_evtCountPass.clear();
-  m_evtCountPassWt.clear();
-  m_evtCountTot.clear();
-  m_evtCountTotWt.clear();
-  m_cateCount.clear();
-  m_cateCountWt.clear();
-  // Then initialize all cut counters to zero:
-  for (int i = 0; i < (int)m_cutList.size(); i++) {
-    m_evtCountPass[m_cutList[i]] = 0;
-    m_evtCountPassWt[m_cutList[i]] = 0.0;
-    m_evtCountTot[m_cutList[i]] = 0;
-    m_evtCountTotWt[m_cutList[i]] = 0.0;
-  }
+  // Initialize all cut counters to zero:
+  m_evtCountPass.assign(m_cutList.size(), 0);
+  m_evtCountPassWt.assign(m_cutList.size(), 0.0);
+  m_evtCountTot.assign(m_cutList.size(), 0);
+  m_evtCountTotWt.assign(m_cutList.size(), 0.0);
   // Then initialize all category counters to zero:
-  for (std::map<TString,int>::iterator it = m_cateSchemesAndSizes.begin(); 
-       it != m_cateSchemesAndSizes.end(); it++) {
-    for (int j = 0; j < it->second; j++) {
-      m_cateCount[Form("%s_%d", (it->first).Data(), j)] = 0;
-      m_cateCountWt[Form("%s_%d", (it->first).Data(), j)] = 0.0;
-    }
-  }
+  m_cateCount.assign(m_nCategories, 0);
+  m_cateCountWt.assign(m_nCategories, 0.0);
+  // And the counters of the systematic variations evaluated together:
+  m_sysCountPass.assign(m_sysCountPass.size(), 0);
+  m_sysCountPassWt.assign(m_sysCountPassWt.size(), 0.0);
+  m_sysCountTot.assign(m_sysCountTot.size(), 0);
+  m_sysCountTotWt.assign(m_sysCountTotWt.size(), 0.0);
+  m_sysCateCount.assign(m_sysCateCount.size(), 0);
+  m_sysCateCountWt.assign(m_sysCateCountWt.size(), 0.0);
   // Also empty the histograms:
   for (int i_b = 0; i_b <= m_cutFlowHist_weighted->GetNbinsX()+1; i_b++) {
     m_cutFlowHist_weighted->SetBinContent(i_b, 0.0);
@@ -142,24 +341,24 @@ void DMEvtSelect::clearCounters() {
   
 }
 
-/** 
+/**
    -----------------------------------------------------------------------------
    Check whether the specified cut has been defined.
    @param cutName - The name of the cut whose existence shall be questioned.
    @return - True iff the cut exists.
 */
 bool DMEvtSelect::cutExists(TString cutName) {
-  // Checks if there is a key corresponding to cutName in the map: 
-  bool nonExistent = (m_evtCountTot.find(cutName) == m_evtCountTot.end());
-  if (nonExistent) {
-    std::cout << "DMEvtSelect: Cut " << cutName << " not defined!" << std::endl;
+  for (int i_c = 0; i_c < (int)m_cutList.size(); i_c++) {
+    if (cutName.EqualTo(m_cutList[i_c])) return true;
   }
-  return !nonExistent;
+  std::cout << "DMEvtSelect: Cut " << cutName << " not defined!" << std::endl;
+  return false;
 }
 
 /**
    -----------------------------------------------------------------------------
-   Get the index of a particular cut.
+   Get the index of a particular cut. This is the integer cut ID that can be
+   given to passesCut() in the event loop.
    @param cutName - The name of the cut.
    @return - The index of the cut (the order in the cutflow).
 */
@@ -173,7 +372,130 @@ int DMEvtSelect::cutIndex(TString cutName) {
 
 /**
    -----------------------------------------------------------------------------
-   Find the category in which this event belongs. 
+   Apply the full selection and categorization to all of the systematic 
+   variations set with setSysVariationList() in a single pass. The inputs of
+   each variation are gathered into contiguous arrays and the cuts are applied
+   one at a time to all variations, counting the consecutive cuts that each 
+   variation passes. The counters are identical to calling passesCut("AllCuts")
+   and getCategoryNumber() with one selector per variation.
+   @param weight - The event weight.
+*/
+void DMEvtSelect::evaluateSysVariations(double weight) {
+  if (m_nSysSlots == 0) return;
+  
+  // The "AllCuts" cut is always the last one in the plan:
+  int nCuts = (int)m_cutList.size();
+  int nBasicCuts = nCuts - 1;
+  
+  // Gather the inputs of each variation:
+  for (int i_s = 0; i_s < m_nSysSlots; i_s++) {
+    int currIndex = m_sysIndices[i_s];
+    m_sysCutFlow[i_s] = m_evtTree->HGamEventInfoAuxDyn_cutFlow[currIndex];
+    m_sysPTyy[i_s] = m_evtTree->HGamEventInfoAuxDyn_pT_yy[currIndex];
+    m_sysETMiss[i_s] = m_evtTree->HGamEventInfoAuxDyn_TST_met[currIndex];
+    m_sysNPassed[i_s] = 0;
+  }
+  
+  // ADD CUT HERE:
+  // A variation passes cut i_c only if it has passed all of the previous cuts:
+  int *nPassed = &m_sysNPassed[0];
+  for (int i_c = 0; i_c < nBasicCuts; i_c++) {
+    switch (m_cutTypes[i_c]) {
+    case kMxAODCut: {
+      const int *cutFlow = &m_sysCutFlow[0];
+      int mxAODIndex = m_cutMxAODIndex[i_c];
+      for (int i_s = 0; i_s < m_nSysSlots; i_s++) {
+	nPassed[i_s] += (nPassed[i_s] == i_c && cutFlow[i_s] > mxAODIndex);
+      }
+      break;
+    }
+    case kLeptonVeto: {
+      // The lepton veto does not depend on the variation, and the lepton
+      // branches are only bound if the veto is in the plan:
+      bool passesLeptonVeto = (m_evtTree->nLeptons() == 0);
+      for (int i_s = 0; i_s < m_nSysSlots; i_s++) {
+	nPassed[i_s] += (nPassed[i_s] == i_c && passesLeptonVeto);
+      }
+      break;
+    }
+    case kDiphotonPT: {
+      const float *pTyy = &m_sysPTyy[0];
+      for (int i_s = 0; i_s < m_nSysSlots; i_s++) {
+	nPassed[i_s] += (nPassed[i_s] == i_c && pTyy[i_s] > m_cutDiphotonPT);
+      }
+      break;
+    }
+    case kDiphotonETMiss: {
+      const float *etMiss = &m_sysETMiss[0];
+      for (int i_s = 0; i_s < m_nSysSlots; i_s++) {
+	nPassed[i_s] += (nPassed[i_s] == i_c && etMiss[i_s] > m_cutETMiss);
+      }
+      break;
+    }
+    }
+  }
+  
+  // Update the counters. A variation has been tested at every cut up to and
+  // including the first one it fails:
+  for (int i_s = 0; i_s < m_nSysSlots; i_s++) {
+    int offset = i_s * nCuts;
+    int nTested = (nPassed[i_s] < nBasicCuts) ? nPassed[i_s]+1 : nBasicCuts;
+    for (int i_c = 0; i_c < nTested; i_c++) {
+      m_sysCountTot[offset+i_c]++;
+      m_sysCountTotWt[offset+i_c] += weight;
+    }
+    for (int i_c = 0; i_c < nPassed[i_s]; i_c++) {
+      m_sysCountPass[offset+i_c]++;
+      m_sysCountPassWt[offset+i_c] += weight;
+    }
+    m_sysCountTot[offset+nBasicCuts]++;
+    m_sysCountTotWt[offset+nBasicCuts] += weight;
+    if (nPassed[i_s] == nBasicCuts) {
+      m_sysCountPass[offset+nBasicCuts]++;
+      m_sysCountPassWt[offset+nBasicCuts] += weight;
+    }
+  }
+  
+  // Categorize the variations passing all cuts (the DMTree computes pTHard
+  // at most once per event):
+  for (int i_s = 0; i_s < m_nSysSlots; i_s++) {
+    if (nPassed[i_s] != nBasicCuts) continue;
+    int currCate = categorize(m_sysIndices[i_s]);
+    if (currCate == -1) {
+      std::cout << "DMEvtSelect: Categorization error for " << m_cateScheme
+		<< std::endl;
+      exit(0);
+    }
+    m_sysCateCount[i_s*m_nCategories + currCate]++;
+    m_sysCateCountWt[i_s*m_nCategories + currCate] += weight;
+  }
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Find the category in which this weighted event belongs, using the
+   categorization scheme from the config file.
+   @param weight - The event weight.
+   @return - The category number for the event.
+*/
+int DMEvtSelect::getCategoryNumber(double weight) {
+  
+  int currCate = categorize(m_sysIndex);
+  if (currCate == -1) {
+    std::cout << "DMEvtSelect: Categorization error for " << m_cateScheme
+	      << std::endl;
+    exit(0);
+  }
+  
+  // Add to category counters:
+  m_cateCount[currCate]++;
+  m_cateCountWt[currCate] += weight;
+  return currCate;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Find the category in which this event belongs.
    @param cateScheme - The name of the categorization.
    @return - The category number for the event.
 */
@@ -183,118 +505,62 @@ int DMEvtSelect::getCategoryNumber(TString cateScheme) {
 
 /**
    -----------------------------------------------------------------------------
-   Find the category in which this weighted event belongs. 
+   Find the category in which this weighted event belongs.
    @param cateScheme - the name of the categorization.
    @param weight - The event weight.
    @return - The category number for the event.
 */
 int DMEvtSelect::getCategoryNumber(TString cateScheme, double weight) {
-  
-  // check that the category is defined first. 
+  // check that the category is defined first.
   if (!cateExists(cateScheme)) {
-    std::cout << "DMEvtSelect: Categorization not defined: " << cateScheme 
+    std::cout << "DMEvtSelect: Categorization not defined: " << cateScheme
 	      << " " << weight << std::endl;
     exit(0);
   }
-  
-  // ADD CATE HERE:
-  int currCate = -1;
-  // Inclusive categorization - only 1 category.
-  if (cateScheme.EqualTo("inclusive")) {
-    currCate = 0;
+  return getCategoryNumber(weight);
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Get all of the event counters as a flat list of numbers, e.g. to save them
+   to file. The cutflow histograms are not included.
+   @return - The counter values, to be used with addCounterValues().
+*/
+std::vector<double> DMEvtSelect::getCounterValues() {
+  std::vector<double> values; values.clear();
+  for (int i_c = 0; i_c < (int)m_cutList.size(); i_c++) {
+    values.push_back(m_evtCountPass[i_c]);
+    values.push_back(m_evtCountPassWt[i_c]);
+    values.push_back(m_evtCountTot[i_c]);
+    values.push_back(m_evtCountTotWt[i_c]);
   }
-  // Split MET - low and high MET categories.
-  else if (cateScheme.EqualTo("splitETMiss")) {
-    if (m_evtTree->HGamEventInfoAuxDyn_TST_met[m_sysVariation] > 140000.0) {
-      currCate = 1;
-    }
-    else currCate = 0;
+  for (int i_c = 0; i_c < m_nCategories; i_c++) {
+    values.push_back(m_cateCount[i_c]);
+    values.push_back(m_cateCountWt[i_c]);
   }
-  // Ratio ETMiss/pT categorization:
-  else if (cateScheme.EqualTo("RatioEtmPt")) {
-    double ratioCut1 = m_config->getNum("RatioCut1");
-    double ratioCut2 = m_config->getNum("RatioCut2");
-    double currRatio = (m_evtTree->HGamEventInfoAuxDyn_TST_met[m_sysVariation] /
-			m_evtTree->HGamEventInfoAuxDyn_pT_yy[m_sysVariation]);
-    if (currRatio < ratioCut1) currCate = 0;
-    else if (currRatio >= ratioCut1 && currRatio < ratioCut2) currCate = 1; 
-    else if (currRatio >= ratioCut2) currCate = 2;
-  }
-  else if (cateScheme.EqualTo("combined")) {
-    
-    // Calculate pTHard:
-    TLorentzVector sumParticles;
-    for (int i_p = 0; i_p < (int)(m_evtTree->HGamPhotonsAuxDyn_pt)->size(); 
-	 i_p++) {
-      TLorentzVector photon((*m_evtTree->HGamPhotonsAuxDyn_pt)[i_p],
-			    (*m_evtTree->HGamPhotonsAuxDyn_eta)[i_p],
-			    (*m_evtTree->HGamPhotonsAuxDyn_phi)[i_p],
-			    (*m_evtTree->HGamPhotonsAuxDyn_m)[i_p]);
-      sumParticles += photon;
-    }
-    for (int i_j = 0; i_j < 
-	   (int)(m_evtTree->HGamAntiKt4EMTopoJetsAuxDyn_pt)->size(); i_j++) {
-      TLorentzVector jet((*m_evtTree->HGamAntiKt4EMTopoJetsAuxDyn_pt)[i_j],
-			 (*m_evtTree->HGamAntiKt4EMTopoJetsAuxDyn_eta)[i_j],
-			 (*m_evtTree->HGamAntiKt4EMTopoJetsAuxDyn_phi)[i_j],
-			 (*m_evtTree->HGamAntiKt4EMTopoJetsAuxDyn_m)[i_j]);
-      sumParticles += jet;
-    }
-    double pTHard = sumParticles.Pt();
-    
-    // High-MET region (ETMiss > 100 GeV):
-    if (m_evtTree->HGamEventInfoAuxDyn_TST_met[m_sysVariation] >
-	m_config->getNum("ETMissCut2")) {
-      // Combine with high-PT to get mono-H category:
-      if (m_evtTree->HGamEventInfoAuxDyn_pT_yy[m_sysVariation] > 
-	  m_config->getNum("DiphotonPTCut2")) {
-	currCate = 4;
-      }
-      else {
-	currCate = 3;
-      }
-    }
-    
-    // Intermediate ETMiss and pTHard region (DEFINE pTHard!!):
-    else if (m_evtTree->HGamEventInfoAuxDyn_TST_met[m_sysVariation] >
-	     m_config->getNum("ETMissCut1") &&
-	     pTHard > m_config->getNum("PTHardCut")) {
-      currCate = 2;
-    }
-    
-    // Rest category (everything else with pTyy > 15 GeV).
-    else if (m_evtTree->HGamEventInfoAuxDyn_pT_yy[m_sysVariation] > 
-	     m_config->getNum("DiphotonPTCut1")) {
-      currCate = 1;
-    }
-    
-    // Need to have a category for all other events.
-    else {
-      currCate = 0;
-    }
+  for (int i_i = 0; i_i < (int)m_sysCountPass.size(); i_i++) {
+    values.push_back(m_sysCountPass[i_i]);
+    values.push_back(m_sysCountPassWt[i_i]);
+    values.push_back(m_sysCountTot[i_i]);
+    values.push_back(m_sysCountTotWt[i_i]);
   }
-  if (currCate == -1) {
-    std::cout << "DMEvtSelect: Categorization error for " << cateScheme
-	      << std::endl;
-    exit(0);
+  for (int i_i = 0; i_i < (int)m_sysCateCount.size(); i_i++) {
+    values.push_back(m_sysCateCount[i_i]);
+    values.push_back(m_sysCateCountWt[i_i]);
   }
-  
-  // Add to category counters:
-  m_cateCount[Form("%s_%d",cateScheme.Data(),currCate)]++;
-  m_cateCountWt[Form("%s_%d",cateScheme.Data(),currCate)] += weight;
-  return currCate;
+  return values;
 }
 
 /**
    -----------------------------------------------------------------------------
    Get the (integer) number of events in the specified category.
    @param cateScheme - The name of the categorization.
-   @param cate - The category number. 
+   @param cate - The category number.
    @return - The weighted or unweighted number of events in specified category.
 */
 int DMEvtSelect::getEventsPerCate(TString cateScheme, int cate) {
   if (cateExists(cateScheme)) {
-    return m_cateCount[Form("%s_%d",cateScheme.Data(),cate)];
+    return m_cateCount[cate];
   }
   else {
     std::cout << "DMEvtSelect: ERROR! cannot retrieve events per category."
@@ -312,7 +578,7 @@ int DMEvtSelect::getEventsPerCate(TString cateScheme, int cate) {
 */
 double DMEvtSelect::getEventsPerCateWt(TString cateScheme, int cate) {
   if (cateExists(cateScheme)) {
-    return m_cateCountWt[Form("%s_%d",cateScheme.Data(),cate)];
+    return m_cateCountWt[cate];
   }
   else {
     std::cout << "DMEvtSelect: ERROR! cannot retrieve events per category."
@@ -328,7 +594,7 @@ double DMEvtSelect::getEventsPerCateWt(TString cateScheme, int cate) {
    @return - The integer number of events passing the cut.
 */
 int DMEvtSelect::getPassingEvents(TString cutName) {
-  if (cutExists(cutName)) return m_evtCountPass[cutName];
+  if (cutExists(cutName)) return m_evtCountPass[cutIndex(cutName)];
   else return -1;
 }
 
@@ -339,7 +605,7 @@ int DMEvtSelect::getPassingEvents(TString cutName) {
    @return - The weighted number of events passing the cut.
 */
 double DMEvtSelect::getPassingEventsWt(TString cutName) {
-  if (cutExists(cutName)) return m_evtCountPassWt[cutName];
+  if (cutExists(cutName)) return m_evtCountPassWt[cutIndex(cutName)];
   else return -1;
 }
 
@@ -350,7 +616,7 @@ double DMEvtSelect::getPassingEventsWt(TString cutName) {
    @return - The integer number of events tested at the cut.
 */
 int DMEvtSelect::getTotalEvents(TString cutName) {
-  if (cutExists(cutName)) return m_evtCountTot[cutName];
+  if (cutExists(cutName)) return m_evtCountTot[cutIndex(cutName)];
   else return -1;
 }
 
@@ -361,7 +627,7 @@ int DMEvtSelect::getTotalEvents(TString cutName) {
    @return - The weighted number of events tested at the cut.
 */
 double DMEvtSelect::getTotalEventsWt(TString cutName) {
-  if (cutExists(cutName)) return m_evtCountTotWt[cutName];
+  if (cutExists(cutName)) return m_evtCountTotWt[cutIndex(cutName)];
   else return -1;
 }
 
@@ -375,91 +641,103 @@ int DMEvtSelect::nCuts() {
 
 /**
    -----------------------------------------------------------------------------
-   Check whether an event passes the specified cut.
-   @param cutName - The name of the cut.
-   @return - True iff the event passes the cut.
+   @return - The number of systematic variations evaluated together.
 */
-bool DMEvtSelect::passesCut(TString cutName) {
-  return passesCut(cutName, 1.0);
+int DMEvtSelect::nSysVariations() {
+  return m_nSysSlots;
 }
 
 /**
    -----------------------------------------------------------------------------
-   Check whether a weighted event passes the specified cut. Adds to the 
+   Check whether a weighted event passes the cut with the given ID. Adds to the
    selection counters automatically. WARNING! Calling "AllCuts" in conjunction
    with the other counters will lead to duplication.
-   @param cutName - The name of the cut.
+   @param cutID - The index of the cut, from cutIndex().
    @param weight - The event weight.
    @return - True iff the event passes the cut.
 */
-bool DMEvtSelect::passesCut(TString cutName, double weight) {
-  
-  // check that map exists first.
-  if (!cutExists(cutName)) return false;
+bool DMEvtSelect::passesCut(int cutID, double weight) {
   
+  // ADD CUT HERE:
   bool passes = true;
+  switch (m_cutTypes[cutID]) {
   
-  // The mass parameter:
-  double invariantMass = m_evtTree->HGamEventInfoAuxDyn_m_yy[m_sysVariation];
+    // MxAOD cuts:
+  case kMxAODCut:
+    passes = (m_evtTree->HGamEventInfoAuxDyn_cutFlow[m_sysIndex] >
+	      m_cutMxAODIndex[cutID]);
+    break;
   
-  bool isMxAODCut = false;
-  int currCutIndex = 0;
-  std::vector<TString> cutFlowMxAODs = m_config->getStrV("MxAODCutList");
-  for (currCutIndex = 0; currCutIndex < (int)cutFlowMxAODs.size(); 
-       currCutIndex++) {
-    if (cutName.EqualTo(cutFlowMxAODs[currCutIndex])) {
-      isMxAODCut = true;
-      break;
-    }
-  }
+    // Lepton Veto Cut:
+  case kLeptonVeto:
+    passes = (m_evtTree->nLeptons() == 0);
+    break;
+  
+    // Cut on the diphoton transverse momentum:
+  case kDiphotonPT:
+    passes = (m_evtTree->HGamEventInfoAuxDyn_pT_yy[m_sysIndex] >
+	      m_cutDiphotonPT);
+    break;
   
-  // MxAOD cuts:
-  if (isMxAODCut) {
-    passes = (m_evtTree->HGamEventInfoAuxDyn_cutFlow[m_sysVariation] >
-	      currCutIndex);
-  }
-  // Lepton Veto Cut:
-  else if (cutName.EqualTo("LeptonVeto") && m_config->getBool("LeptonVeto")) {
-    passes = ((m_evtTree->HGamElectronsAuxDyn_pt)->size() == 0 &&
-	      (m_evtTree->HGamMuonsAuxDyn_pt)->size() == 0);
-  }
-  // Cut on the diphoton transverse momentum:
-  else if (cutName.EqualTo("DiphotonPT")) {
-    passes = (m_evtTree->HGamEventInfoAuxDyn_pT_yy[m_sysVariation] >
-	      m_config->getNum("AnaCutDiphotonPT"));
-  }
-  // Cut on the event missing transverse energy:
-  else if (cutName.EqualTo("DiphotonETMiss")) {
-    passes = (m_evtTree->HGamEventInfoAuxDyn_TST_met[m_sysVariation] > 
-	      m_config->getNum("AnaCutETMiss"));
-  }
-  // Check whether event passes all of the cuts above:
-  else if (cutName.EqualTo("AllCuts")) {
-    for (int i = 0; i < (int)m_cutList.size(); i++) {
-      if (m_cutList[i].EqualTo("AllCuts")) {
+    // Cut on the event missing transverse energy:
+  case kDiphotonETMiss:
+    passes = (m_evtTree->HGamEventInfoAuxDyn_TST_met[m_sysIndex] >
+	      m_cutETMiss);
+    break;
+  
+    // Check whether event passes all of the cuts above:
+  case kAllCuts:
+    for (int i_c = 0; i_c < (int)m_cutList.size(); i_c++) {
+      if (m_cutTypes[i_c] == kAllCuts) {
 	continue;
       }
-      else if (!passesCut(m_cutList[i], weight)) {
+      else if (!passesCut(i_c, weight)) {
 	passes = false;
 	break;
       }
     }
+    break;
   }
   
   // Add to total counters:
-  m_evtCountTot[cutName]++;
-  m_evtCountTotWt[cutName] += weight;
+  m_evtCountTot[cutID]++;
+  m_evtCountTotWt[cutID] += weight;
   
   // Add to passing counters:
   if (passes) {
-    m_evtCountPass[cutName]++;
-    m_evtCountPassWt[cutName] += weight;
-    m_cutFlowHist_weighted->Fill(cutIndex(cutName), weight);
-    m_cutFlowHist_unweighted->Fill(cutIndex(cutName), 1.0);
+    m_evtCountPass[cutID]++;
+    m_evtCountPassWt[cutID] += weight;
+    m_cutFlowHist_weighted->Fill(cutID, weight);
+    m_cutFlowHist_unweighted->Fill(cutID, 1.0);
   }
   return passes;
 }
 
+/**
+   -----------------------------------------------------------------------------
+   Check whether an event passes the specified cut.
+   @param cutName - The name of the cut.
+   @return - True iff the event passes the cut.
+*/
+bool DMEvtSelect::passesCut(TString cutName) {
+  return passesCut(cutName, 1.0);
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Check whether a weighted event passes the specified cut. Adds to the
+   selection counters automatically. WARNING! Calling "AllCuts" in conjunction
+   with the other counters will lead to duplication.
+   @param cutName - The name of the cut.
+   @param weight - The event weight.
+   @return - True iff the event passes the cut.
+*/
+bool DMEvtSelect::passesCut(TString cutName, double weight) {
+  // check that the cut exists first.
+  if (!cutExists(cutName)) return false;
+  return passesCut(cutIndex(cutName), weight);
+}
+
 /**
    -----------------------------------------------------------------------------
    Print the categories.
@@ -467,20 +745,12 @@ bool DMEvtSelect::passesCut(TString cutName, double weight) {
 */
 void DMEvtSelect::printCategorization(bool weighted) {
   std::cout << "Printing Categories: " << std::endl;
-  // iterate over category names:
-  for (std::map<TString,int>::iterator it = m_cateSchemesAndSizes.begin(); 
-       it != m_cateSchemesAndSizes.end(); it++){
-    std::cout << "\t" << it->first << " ";
-    for (int j = 0; j < it->second; j++) {
-      if (weighted) {
-	std::cout << m_cateCountWt[Form("%s_%d",(it->first).Data(), j)] << " ";
-      }
-      else {
-	std::cout << m_cateCount[Form("%s_%d",(it->first).Data(), j)] << " ";
-      }
-    }
-    std::cout << std::endl;
+  std::cout << "\t" << m_cateScheme << " ";
+  for (int j = 0; j < m_nCategories; j++) {
+    if (weighted) std::cout << m_cateCountWt[j] << " ";
+    else std::cout << m_cateCount[j] << " ";
   }
+  std::cout << std::endl;
 }
 
 /**
@@ -494,14 +764,13 @@ void DMEvtSelect::printCutflow(bool weighted) {
   for (int i = 0; i < (int)m_cutList.size(); i++) {
     // Print the weighted cutflow (for MC):
     if (weighted) {
-      std::cout << "\t" << m_cutList[i] << "\t" 
-		<< m_evtCountPassWt[m_cutList[i]] << " / " 
-		<< m_evtCountTotWt[m_cutList[i]] << std::endl;
+      std::cout << "\t" << m_cutList[i] << "\t" << m_evtCountPassWt[i]
+		<< " / " << m_evtCountTotWt[i] << std::endl;
     }
     // Print the unweighted cutflow (for data):
     else {
-      std::cout << "\t" << m_cutList[i] << "\t" << m_evtCountPass[m_cutList[i]]
-		<< " / " << m_evtCountTot[m_cutList[i]] << std::endl;
+      std::cout << "\t" << m_cutList[i] << "\t" << m_evtCountPass[i]
+		<< " / " << m_evtCountTot[i] << std::endl;
     }
   }
 }
@@ -524,22 +793,7 @@ TH1F* DMEvtSelect::retrieveCutflowHist(bool weighted) {
    @param weighted - True iff the event counts should be weighted.
 */
 void DMEvtSelect::saveCategorization(TString fileName, bool weighted) {
-  ofstream outFile(fileName);
-  // iterate over category names:
-  for (std::map<TString,int>::iterator it = m_cateSchemesAndSizes.begin();
-       it != m_cateSchemesAndSizes.end(); it++){
-    outFile << it->first << " ";
-    for (int j = 0; j < it->second; j++) {
-      if (weighted) {
-	outFile << m_cateCountWt[Form("%s_%d",(it->first).Data(), j)] << " ";
-      }
-      else {
-	outFile << m_cateCount[Form("%s_%d",(it->first).Data(), j)] << " ";
-      }
-    }
-    outFile << std::endl;
-  }
-  outFile.close();
+  writeCategorization(fileName, weighted, &m_cateCount[0], &m_cateCountWt[0]);
 }
 
 /**
@@ -549,31 +803,113 @@ void DMEvtSelect::saveCategorization(TString fileName, bool weighted) {
    @param weighted - True iff the event counts should be weighted.
 */
 void DMEvtSelect::saveCutflow(TString fileName, bool weighted) {
-  ofstream outFile(fileName);
-  // Loop over the cuts and print the name as well as the pass ratio:
-  for (int i = 0; i < (int)m_cutList.size(); i++) {
-    // Print the weighted cutflow (for MC):
-    if (weighted) {
-      outFile << "\t" << m_cutList[i] << "\t" << m_evtCountPassWt[m_cutList[i]]
-	      << " / " << m_evtCountTotWt[m_cutList[i]] << std::endl;
-    }
-    // Print the unweighted cutflow (for data):
-    else {
-      outFile << "\t" << m_cutList[i] << "\t" << m_evtCountPass[m_cutList[i]]
-	      << " / " << m_evtCountTot[m_cutList[i]] << std::endl;
-    }
-  }
-  outFile.close();
+  writeCutflow(fileName, weighted, &m_evtCountPass[0], &m_evtCountPassWt[0],
+	       &m_evtCountTot[0], &m_evtCountTotWt[0]);
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Save the categories of one of the systematic variations evaluated together.
+   @param sysSlot - The position of the variation in setSysVariationList().
+   @param fileName - The output filename for the category yields.
+   @param weighted - True iff the event counts should be weighted.
+*/
+void DMEvtSelect::saveSysCategorization(int sysSlot, TString fileName,
+					bool weighted) {
+  int offset = sysSlot * m_nCategories;
+  writeCategorization(fileName, weighted, &m_sysCateCount[offset],
+		      &m_sysCateCountWt[offset]);
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Save the cutflow of one of the systematic variations evaluated together.
+   @param sysSlot - The position of the variation in setSysVariationList().
+   @param fileName - The output filename for the cutflow.
+   @param weighted - True iff the event counts should be weighted.
+*/
+void DMEvtSelect::saveSysCutflow(int sysSlot, TString fileName, bool weighted) {
+  int offset = sysSlot * (int)m_cutList.size();
+  writeCutflow(fileName, weighted, &m_sysCountPass[offset],
+	       &m_sysCountPassWt[offset], &m_sysCountTot[offset],
+	       &m_sysCountTotWt[offset]);
 }
 
 /**
    -----------------------------------------------------------------------------
-   Set which systematic uncertainty variation to use with the TTree. 
-   @param sysVariation - The name of the systematic variation to use for the 
+   Set which systematic uncertainty variation to use with the TTree.
+   @param sysVariation - The name of the systematic variation to use for the
    selection ("Nominal" by default).
 */
 void DMEvtSelect::setSysVariation(TString sysVariation) {
-  m_sysVariation = sysVariation;
+  int sysIndex = m_evtTree->sysIndex(sysVariation);
+  if (sysIndex < 0) {
+    std::cout << "DMEvtSelect: Error! Systematic variation " << sysVariation
+	      << " not loaded in DMTree." << std::endl;
+    exit(0);
+  }
+  setSysVariation(sysIndex);
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Set which systematic uncertainty variation to use with the TTree, using the
+   integer id assigned by DMTree. This avoids string lookups in the event loop.
+   @param sysIndex - The DMTree index of the systematic variation (0=Nominal).
+*/
+void DMEvtSelect::setSysVariation(int sysIndex) {
+  m_sysIndex = sysIndex;
+  m_sysVariation = m_evtTree->m_sysNames[sysIndex];
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Set the list of systematic variations to be evaluated together by 
+   evaluateSysVariations(). Each variation gets a slot with its own counters,
+   in the order of the list. This clears the counters of the variations.
+   @param sysList - The names of the systematic variations.
+*/
+void DMEvtSelect::setSysVariationList(std::vector<TString> sysList) {
+  m_nSysSlots = (int)sysList.size();
+  m_sysIndices.clear();
+  for (int i_s = 0; i_s < m_nSysSlots; i_s++) {
+    int sysIndex = m_evtTree->sysIndex(sysList[i_s]);
+    if (sysIndex < 0) {
+      std::cout << "DMEvtSelect: Error! Systematic variation " << sysList[i_s]
+		<< " not loaded in DMTree." << std::endl;
+      exit(0);
+    }
+    m_sysIndices.push_back(sysIndex);
+  }
+  
+  // Size the buffers and counters:
+  m_sysCutFlow.assign(m_nSysSlots, 0);
+  m_sysPTyy.assign(m_nSysSlots, 0.0);
+  m_sysETMiss.assign(m_nSysSlots, 0.0);
+  m_sysNPassed.assign(m_nSysSlots, 0);
+  m_sysCountPass.assign(m_nSysSlots * m_cutList.size(), 0);
+  m_sysCountPassWt.assign(m_nSysSlots * m_cutList.size(), 0.0);
+  m_sysCountTot.assign(m_nSysSlots * m_cutList.size(), 0);
+  m_sysCountTotWt.assign(m_nSysSlots * m_cutList.size(), 0.0);
+  m_sysCateCount.assign(m_nSysSlots * m_nCategories, 0);
+  m_sysCateCountWt.assign(m_nSysSlots * m_nCategories, 0.0);
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Get the object branches of the DMTree that the compiled selection plan and
+   categorization read, so that the others are never read from file.
+   @return - The DMTree::ObjectBranches flags needed by the plan.
+*/
+int DMEvtSelect::requiredObjects() {
+  int objectBranches = 0;
+  for (int i_c = 0; i_c < (int)m_cutTypes.size(); i_c++) {
+    if (m_cutTypes[i_c] == kLeptonVeto) {
+      objectBranches |= DMTree::kLeptonBranches;
+    }
+  }
+  if (m_cateType == kCombined) objectBranches |= DMTree::kPhotonJetBranches;
+  return objectBranches;
 }
 
 /**
@@ -583,5 +919,57 @@ void DMEvtSelect::setSysVariation(TString sysVariation) {
 */
 void DMEvtSelect::setTree(DMTree *newTree) {
   m_evtTree = newTree;
+  if (!m_evtTree) return;
+  m_evtTree->requireObjects(requiredObjects());
   std::cout << "DMEvtSelect: A new TTree has been linked." << std::endl;
 }
+
+/**
+   -----------------------------------------------------------------------------
+   Write a set of category yields to file.
+   @param fileName - The output filename for the category yields.
+   @param weighted - True iff the event counts should be weighted.
+   @param count - The unweighted yield in each category.
+   @param countWt - The weighted yield in each category.
+*/
+void DMEvtSelect::writeCategorization(TString fileName, bool weighted,
+				      const int *count, const double *countWt){
+  ofstream outFile(fileName);
+  outFile << m_cateScheme << " ";
+  for (int j = 0; j < m_nCategories; j++) {
+    if (weighted) outFile << countWt[j] << " ";
+    else outFile << count[j] << " ";
+  }
+  outFile << std::endl;
+  outFile.close();
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Write a set of cutflow counters to file.
+   @param fileName - The output filename for the cutflow.
+   @param weighted - True iff the event counts should be weighted.
+   @param pass - The unweighted number of events passing each cut.
+   @param passWt - The weighted number of events passing each cut.
+   @param tot - The unweighted number of events tested at each cut.
+   @param totWt - The weighted number of events tested at each cut.
+*/
+void DMEvtSelect::writeCutflow(TString fileName, bool weighted, const int *pass,
+			       const double *passWt, const int *tot,
+			       const double *totWt) {
+  ofstream outFile(fileName);
+  // Loop over the cuts and print the name as well as the pass ratio:
+  for (int i = 0; i < (int)m_cutList.size(); i++) {
+    // Print the weighted cutflow (for MC):
+    if (weighted) {
+      outFile << "\t" << m_cutList[i] << "\t" << passWt[i]
+	      << " / " << totWt[i] << std::endl;
+    }
+    // Print the unweighted cutflow (for data):
+    else {
+      outFile << "\t" << m_cutList[i] << "\t" << pass[i]
+	      << " / " << tot[i] << std::endl;
+    }
+  }
+  outFile.close();
+}
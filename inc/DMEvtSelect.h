@@ -24,7 +24,6 @@
 // ROOT includes:
 #include "TString.h"
 #include "TH1F.h"
-#include "TLorentzVector.h"
 
 // Package includes:
 #include "Config.h"
@@ -37,12 +36,22 @@ class DMEvtSelect
   
  public:
   
+  // Types of cut in the compiled selection plan:
+  enum CutType { kMxAODCut, kLeptonVeto, kDiphotonPT, kDiphotonETMiss,
+		 kAllCuts };
+  
+  // Categorization schemes in the compiled selection plan:
+  enum CateType { kUnknownCate, kInclusive, kSplitETMiss, kRatioEtmPt,
+		  kCombined };
+  
   //DMEvtSelect();
   DMEvtSelect(DMTree *newTree, TString newConfigFile);
+  DMEvtSelect(DMTree *newTree, Config *newConfig);
   virtual ~DMEvtSelect() {};
   
   // Public Accessors:
   int cutIndex(TString cutName);
+  std::vector<double> getCounterValues();
   int getEventsPerCate(TString cateScheme, int cate);
   double getEventsPerCateWt(TString cateScheme, int cate);
   int getPassingEvents(TString cutName);
@@ -51,44 +60,98 @@ class DMEvtSelect
   double getTotalEventsWt(TString cutName);
   int nCuts();
   void printCutflow(bool weighted);
+  int nSysVariations();
   void printCategorization(bool weighted);
+  int requiredObjects();
   TH1F* retrieveCutflowHist(bool weighted);
   void saveCutflow(TString filename, bool weighted);
   void saveCategorization(TString filename, bool weighted);
+  void saveSysCutflow(int sysSlot, TString fileName, bool weighted);
+  void saveSysCategorization(int sysSlot, TString fileName, bool weighted);
 
   // Public Mutators
+  void addCounters(DMEvtSelect *selector);
+  void addCounterValues(std::vector<double> values);
   void clearCounters();
+  void evaluateSysVariations(double weight);
+  int getCategoryNumber(double weight);
   int getCategoryNumber(TString cateScheme);
   int getCategoryNumber(TString cateScheme, double weight);
+  bool passesCut(int cutID, double weight);
   bool passesCut(TString cutName);
   bool passesCut(TString cutName, double weight);
   void setTree(DMTree *newTree);
   void setSysVariation(TString sysVariation);
+  void setSysVariation(int sysIndex);
+  void setSysVariationList(std::vector<TString> sysList);
+  
  private:
   
   // Member methods:
+  int categorize(int sysIndex);
+  void compilePlan(DMTree *newTree);
   bool cutExists(TString cutName);
   bool cateExists(TString cateScheme);
+  void writeCategorization(TString fileName, bool weighted, const int *count,
+			   const double *countWt);
+  void writeCutflow(TString fileName, bool weighted, const int *pass,
+		    const double *passWt, const int *tot, const double *totWt);
   
   // Member objects:
   Config *m_config;
   DMTree *m_evtTree;
   std::vector<TString> m_cutList;
   
-  std::map<TString,int> m_evtCountPass;
-  std::map<TString,double> m_evtCountPassWt;
-  std::map<TString,int> m_evtCountTot;
-  std::map<TString,double> m_evtCountTotWt;
+  // The compiled selection plan (indexed by cut ID):
+  std::vector<int> m_cutTypes;
+  std::vector<int> m_cutMxAODIndex;
+  double m_cutDiphotonPT;
+  double m_cutETMiss;
   
-  std::map<TString,int> m_cateSchemesAndSizes;
-  std::map<TString,int> m_cateCount;
-  std::map<TString,double> m_cateCountWt;
+  // The compiled categorization:
+  TString m_cateScheme;
+  int m_cateType;
+  int m_nCategories;
+  double m_ratioCut1;
+  double m_ratioCut2;
+  double m_etMissCut1;
+  double m_etMissCut2;
+  double m_diphotonPTCut1;
+  double m_diphotonPTCut2;
+  double m_pTHardCut;
+  
+  // Event counters (indexed by cut ID or category number):
+  std::vector<int> m_evtCountPass;
+  std::vector<double> m_evtCountPassWt;
+  std::vector<int> m_evtCountTot;
+  std::vector<double> m_evtCountTotWt;
+  std::vector<int> m_cateCount;
+  std::vector<double> m_cateCountWt;
   
   // Cutflow histogram:
   TH1F *m_cutFlowHist_weighted;
   TH1F *m_cutFlowHist_unweighted;
   
   TString m_sysVariation;
+  int m_sysIndex;
+  
+  // Systematic variations evaluated together by evaluateSysVariations(). The
+  // counters are dense, indexed by [slot*nCuts + cut ID] for the cutflow and
+  // [slot*nCategories + category] for the categorization:
+  int m_nSysSlots;
+  std::vector<int> m_sysIndices;
+  std::vector<int> m_sysCountPass;
+  std::vector<double> m_sysCountPassWt;
+  std::vector<int> m_sysCountTot;
+  std::vector<double> m_sysCountTotWt;
+  std::vector<int> m_sysCateCount;
+  std::vector<double> m_sysCateCountWt;
+  
+  // Per-event structure-of-arrays buffers (indexed by slot):
+  std::vector<int> m_sysCutFlow;
+  std::vector<float> m_sysPTyy;
+  std::vector<float> m_sysETMiss;
+  std::vector<int> m_sysNPassed;
 };
 
 #endif
@@ -11,14 +11,23 @@
 #include <TROOT.h>
 #include <TChain.h>
 #include <TFile.h>
+#include <TNamed.h>
+#include <TObjArray.h>
+#include <TObjString.h>
 
 // Header file for the classes stored in the TTree if any.
 #include <vector>
+#include <string>
 
 using namespace std;
 using std::vector;
 
 // Fixed size dimensions of array or collections stored in the TTree if any.
+// The parameter names are stored once per file, and the values of each toy as
+// float arrays in the same order (see DMPseudoExp.cxx).
+const Int_t kMaxToyParams = 500;
+// The NLL of importance-sampled toys at each mu in "toyWeightMuValues".
+const Int_t kMaxWeightMus = 20;
 
 class DMToyTree {
 public :
@@ -38,15 +47,16 @@ public :
    Double_t        llrL1L0;
    Double_t        llrL0Lfree;
    Double_t        llrL1Lfree;
-   vector<double>  *numEventsPerCate;
-   vector<string>  *namesNP;
-   vector<double>  *valuesNPMu0;
-   vector<double>  *valuesNPMu1;
-   vector<double>  *valuesNPMuFree;
-   vector<string>  *namesGlobs;
-   vector<double>  *valuesGlobsMu1;
-   vector<double>  *valuesGlobsMu0;
-   vector<double>  *valuesGlobsMuFree;
+   vector<string>  namesNP;
+   Float_t         valuesNPMu0[kMaxToyParams];
+   Float_t         valuesNPMu1[kMaxToyParams];
+   Float_t         valuesNPMuFree[kMaxToyParams];
+   vector<string>  namesGlobs;
+   Float_t         valuesGlobsMu1[kMaxToyParams];
+   Float_t         valuesGlobsMu0[kMaxToyParams];
+   Float_t         valuesGlobsMuFree[kMaxToyParams];
+   vector<double>  weightMuValues;
+   Double_t        nllGen[kMaxWeightMus];
 
    // List of branches
    TBranch        *b_seed;   //!
@@ -61,23 +71,22 @@ public :
    TBranch        *b_llrL1L0;   //!
    TBranch        *b_llrL0Lfree;   //!
    TBranch        *b_llrL1Lfree;   //!
-   TBranch        *b_numEventsPerCate;   //!
-   TBranch        *b_namesNP;   //!
    TBranch        *b_valuesNPMu0;   //!
    TBranch        *b_valuesNPMu1;   //!
    TBranch        *b_valuesNPMuFree;   //!
-   TBranch        *b_namesGlobs;   //!
    TBranch        *b_valuesGlobsMu1;   //!
    TBranch        *b_valuesGlobsMu0;   //!
    TBranch        *b_valuesGlobsMuFree;   //!
+   TBranch        *b_nllGen;   //!
 
-   DMToyTree(TTree *tree=0);
+   DMToyTree(TTree *tree);
    virtual ~DMToyTree();
    virtual Int_t    Cut(Long64_t entry);
    virtual Int_t    GetEntry(Long64_t entry);
    virtual Long64_t LoadTree(Long64_t entry);
    virtual void     Init(TTree *tree);
    virtual void     Loop();
+   virtual void     LoadNames();
    virtual Bool_t   Notify();
    virtual void     Show(Long64_t entry = -1);
 };
@@ -87,16 +96,8 @@ public :
 #ifdef DMToyTree_cxx
 DMToyTree::DMToyTree(TTree *tree) : fChain(0) 
 {
-// if parameter tree is not specified (or zero), connect the file
-// used to generate this class and read the Tree.
-   if (tree == 0) {
-      TFile *f = (TFile*)gROOT->GetListOfFiles()->FindObject("toy_mu0_1987.root");
-      if (!f || !f->IsOpen()) {
-         f = new TFile("toy_mu0_1987.root");
-      }
-      f->GetObject("toy",tree);
-
-   }
+// The toy files are named by each job (see DMPseudoExp.cxx), so the tree
+// must be given by the caller.
    Init(tree);
 }
 
@@ -136,15 +137,9 @@ void DMToyTree::Init(TTree *tree)
    // (once per file to be processed).
 
    // Set object pointer
-   numEventsPerCate = 0;
-   namesNP = 0;
-   valuesNPMu0 = 0;
-   valuesNPMu1 = 0;
-   valuesNPMuFree = 0;
-   namesGlobs = 0;
-   valuesGlobsMu1 = 0;
-   valuesGlobsMu0 = 0;
-   valuesGlobsMuFree = 0;
+   namesNP.clear();
+   namesGlobs.clear();
+   weightMuValues.clear();
    // Set branch addresses and branch pointers
    if (!tree) return;
    fChain = tree;
@@ -163,18 +158,51 @@ void DMToyTree::Init(TTree *tree)
    fChain->SetBranchAddress("llrL1L0", &llrL1L0, &b_llrL1L0);
    fChain->SetBranchAddress("llrL0Lfree", &llrL0Lfree, &b_llrL0Lfree);
    fChain->SetBranchAddress("llrL1Lfree", &llrL1Lfree, &b_llrL1Lfree);
-   fChain->SetBranchAddress("numEventsPerCate", &numEventsPerCate, &b_numEventsPerCate);
-   fChain->SetBranchAddress("namesNP", &namesNP, &b_namesNP);
-   fChain->SetBranchAddress("valuesNPMu0", &valuesNPMu0, &b_valuesNPMu0);
-   fChain->SetBranchAddress("valuesNPMu1", &valuesNPMu1, &b_valuesNPMu1);
-   fChain->SetBranchAddress("valuesNPMuFree", &valuesNPMuFree, &b_valuesNPMuFree);
-   fChain->SetBranchAddress("namesGlobs", &namesGlobs, &b_namesGlobs);
-   fChain->SetBranchAddress("valuesGlobsMu1", &valuesGlobsMu1, &b_valuesGlobsMu1);
-   fChain->SetBranchAddress("valuesGlobsMu0", &valuesGlobsMu0, &b_valuesGlobsMu0);
-   fChain->SetBranchAddress("valuesGlobsMuFree", &valuesGlobsMuFree, &b_valuesGlobsMuFree);
+   fChain->SetBranchAddress("valuesNPMu0", valuesNPMu0, &b_valuesNPMu0);
+   fChain->SetBranchAddress("valuesNPMu1", valuesNPMu1, &b_valuesNPMu1);
+   fChain->SetBranchAddress("valuesNPMuFree", valuesNPMuFree, &b_valuesNPMuFree);
+   fChain->SetBranchAddress("valuesGlobsMu1", valuesGlobsMu1, &b_valuesGlobsMu1);
+   fChain->SetBranchAddress("valuesGlobsMu0", valuesGlobsMu0, &b_valuesGlobsMu0);
+   fChain->SetBranchAddress("valuesGlobsMuFree", valuesGlobsMuFree, &b_valuesGlobsMuFree);
+   // Only toys made with the "Importance" option have this branch
+   if (fChain->GetBranch("nllGen")) {
+      fChain->SetBranchAddress("nllGen", nllGen, &b_nllGen);
+   }
+   // Open the first file of a chain, which has the parameter names
+   if (fChain->GetEntries() > 0) fChain->LoadTree(0);
    Notify();
 }
 
+void DMToyTree::LoadNames()
+{
+   // Read the names of the parameters and the signal strengths of the
+   // importance weights, which are stored once per file and are the same in
+   // all of the files of a chain.
+   TFile *f = fChain ? fChain->GetCurrentFile() : 0;
+   if (!f) return;
+   TNamed *names[2] = {(TNamed*)f->Get("toyNamesNP"),
+                       (TNamed*)f->Get("toyNamesGlobs")};
+   vector<string> *lists[2] = {&namesNP, &namesGlobs};
+   for (Int_t i = 0; i < 2; i++) {
+      lists[i]->clear();
+      if (!names[i]) continue;
+      TObjArray *tokens = TString(names[i]->GetTitle()).Tokenize(" ");
+      for (Int_t j = 0; j < tokens->GetEntries() && j < kMaxToyParams; j++) {
+         lists[i]->push_back(((TObjString*)tokens->At(j))->GetString().Data());
+      }
+      delete tokens;
+   }
+   weightMuValues.clear();
+   TNamed *weightMus = (TNamed*)f->Get("toyWeightMuValues");
+   if (!weightMus) return;
+   TObjArray *tokens = TString(weightMus->GetTitle()).Tokenize(" ");
+   for (Int_t j = 0; j < tokens->GetEntries() && j < kMaxWeightMus; j++) {
+      TString value = ((TObjString*)tokens->At(j))->GetString();
+      weightMuValues.push_back(value.Atof());
+   }
+   delete tokens;
+}
+
 Bool_t DMToyTree::Notify()
 {
    // The Notify() function is called when a new file is opened. This
@@ -183,6 +211,7 @@ Bool_t DMToyTree::Notify()
    // to the generated code, but the routine can be extended by the
    // user if needed. The return value is currently not used.
 
+   LoadNames();
    return kTRUE;
 }
 
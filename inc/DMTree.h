@@ -11,6 +11,7 @@
 #include <TROOT.h>
 #include <TChain.h>
 #include <TFile.h>
+#include <TMath.h>
 #include <vector>
 #include <iostream>
 
@@ -24,58 +25,55 @@ class DMTree {
   TTree *fChain;  //!pointer to the analyzed TTree or TChain
   Int_t fCurrent; //!current Tree number in a TChain
   
-  bool m_useSys;
+  // Systematic variations, indexed by an integer id (0 is always Nominal):
+  int m_nSys;
   std::vector<TString> m_sysNames;
   
-  // Declaration of nominal and systematics leaf types:
-  std::map<TString, Float_t> HGamEventInfoAuxDyn_m_yy;
-  std::map<TString, Float_t> HGamEventInfoAuxDyn_pT_yy;
-  std::map<TString, Float_t> HGamEventInfoAuxDyn_cosTS_yy;
-  std::map<TString, Float_t> HGamEventInfoAuxDyn_Njets;
-  std::map<TString, Int_t>   HGamEventInfoAuxDyn_cutFlow;
-  std::map<TString, Float_t> HGamEventInfoAuxDyn_weightInitial;
-  std::map<TString, Float_t> HGamEventInfoAuxDyn_weight;
-  std::map<TString, Float_t> HGamEventInfoAuxDyn_TST_met;
-  std::map<TString, Float_t> HGamEventInfoAuxDyn_crossSectionBRfilterEff;
+  // Names of all branches that have been bound and activated for reading:
+  std::vector<TString> m_activeBranches;
+  
+  // The object branches are only bound when the selection needs them:
+  enum ObjectBranches { kLeptonBranches = 1, kPhotonJetBranches = 2 };
+  int m_objectBranches;
+  
+  // Declaration of leaf types with systematic variations (index = sys id):
+  std::vector<Float_t> HGamEventInfoAuxDyn_m_yy;
+  std::vector<Float_t> HGamEventInfoAuxDyn_pT_yy;
+  std::vector<Float_t> HGamEventInfoAuxDyn_TST_met;
+  std::vector<Int_t>   HGamEventInfoAuxDyn_cutFlow;
+  
+  // Declaration of leaf types that are only read for the nominal selection:
+  Float_t HGamEventInfoAuxDyn_Njets;
+  Float_t HGamEventInfoAuxDyn_weight;
+  Float_t HGamEventInfoAuxDyn_crossSectionBRfilterEff;
   
   std::vector<float> *HGamElectronsAuxDyn_pt;
   std::vector<float> *HGamMuonsAuxDyn_pt;
-  std::vector<float> *HGamTruthHiggsBosonsAuxDyn_m;
   
   std::vector<float> *HGamPhotonsAuxDyn_pt;
   std::vector<float> *HGamPhotonsAuxDyn_eta;
-  std::vector<float> *HGamPhotonsAuxDyn_phi;
-  std::vector<float> *HGamPhotonsAuxDyn_m;
   
   std::vector<float> *HGamAntiKt4EMTopoJetsAuxDyn_pt;
   std::vector<float> *HGamAntiKt4EMTopoJetsAuxDyn_eta;
-  std::vector<float> *HGamAntiKt4EMTopoJetsAuxDyn_phi;
-  std::vector<float> *HGamAntiKt4EMTopoJetsAuxDyn_m;
   
   // List of branches
-  std::map<TString, TBranch*> b_HGamEventInfoAuxDyn_m_yy;
-  std::map<TString, TBranch*> b_HGamEventInfoAuxDyn_pT_yy;
-  std::map<TString, TBranch*> b_HGamEventInfoAuxDyn_cosTS_yy;
-  std::map<TString, TBranch*> b_HGamEventInfoAuxDyn_Njets;
-  std::map<TString, TBranch*> b_HGamEventInfoAuxDyn_cutFlow;
-  std::map<TString, TBranch*> b_HGamEventInfoAuxDyn_weightInitial;
-  std::map<TString, TBranch*> b_HGamEventInfoAuxDyn_weight;
-  std::map<TString, TBranch*> b_HGamEventInfoAuxDyn_TST_met;
-  std::map<TString, TBranch*> b_HGamEventInfoAuxDyn_crossSectionBRfilterEff;
+  std::vector<TBranch*> b_HGamEventInfoAuxDyn_m_yy;
+  std::vector<TBranch*> b_HGamEventInfoAuxDyn_pT_yy;
+  std::vector<TBranch*> b_HGamEventInfoAuxDyn_TST_met;
+  std::vector<TBranch*> b_HGamEventInfoAuxDyn_cutFlow;
+  
+  TBranch *b_HGamEventInfoAuxDyn_Njets;
+  TBranch *b_HGamEventInfoAuxDyn_weight;
+  TBranch *b_HGamEventInfoAuxDyn_crossSectionBRfilterEff;
   
   TBranch *b_HGamElectronsAuxDyn_pt;
   TBranch *b_HGamMuonsAuxDyn_pt;
-  TBranch *b_HGamTruthHiggsBosonsAuxDyn_m;
   
   TBranch *b_HGamPhotonsAuxDyn_pt;
   TBranch *b_HGamPhotonsAuxDyn_eta;
-  TBranch *b_HGamPhotonsAuxDyn_phi;
-  TBranch *b_HGamPhotonsAuxDyn_m;
   
   TBranch *b_HGamAntiKt4EMTopoJetsAuxDyn_pt;
   TBranch *b_HGamAntiKt4EMTopoJetsAuxDyn_eta;
-  TBranch *b_HGamAntiKt4EMTopoJetsAuxDyn_phi;
-  TBranch *b_HGamAntiKt4EMTopoJetsAuxDyn_m;
   
   // Methods:
   DMTree(TTree *tree, std::vector<TString> sysNames);
@@ -88,8 +86,34 @@ class DMTree {
   virtual Bool_t Notify();
   virtual void Show(Long64_t entry = -1);
   
-  void DefineSystematics(std::vector<TString> sysNames);
-
+  void requireObjects(int objectBranches);
+  int sysIndex(TString sysName);
+  
+  // Derived quantities of the entry that was read last. Each is computed at
+  // most once per entry (and per variation), and shared by all users:
+  double aTanRatio(int sysIndex);
+  int nLeptons();
+  double pTHard();
+  double ratioETMisspTyy(int sysIndex);
+  double sumSqrtETMisspTyy(int sysIndex);
+  
+ private:
+  
+  void bindBranch(TString branchName, void *address, TBranch **branch);
+  void bindObjects(int objectBranches);
+  void checkObjects(int objectBranches);
+  void computeKinematics(int sysIndex);
+  
+  // Cache of the derived quantities, with the entry they were computed for:
+  Long64_t m_pTHardEntry;
+  Long64_t m_nLeptonsEntry;
+  std::vector<Long64_t> m_kinematicsEntry;
+  double m_pTHard;
+  int m_nLeptons;
+  std::vector<double> m_ratioETMisspTyy;
+  std::vector<double> m_aTanRatio;
+  std::vector<double> m_sumSqrtETMisspTyy;
+  
 };
 
 #endif
@@ -97,11 +121,37 @@ class DMTree {
 #ifdef DMTree_cxx
 DMTree::DMTree(TTree *tree, std::vector<TString> sysNames) : fChain(0) {
   
+  // Nominal always gets id 0, and each variation is only stored once:
   m_sysNames.clear();
   m_sysNames.push_back("Nominal");
   for (int i_s = 0; i_s < (int) sysNames.size(); i_s++) {
-    m_sysNames.push_back(sysNames[i_s]);
+    if (sysIndex(sysNames[i_s]) < 0) m_sysNames.push_back(sysNames[i_s]);
   }
+  m_nSys = (int)m_sysNames.size();
+  
+  // Size the leaf arrays once, so that the branch addresses remain valid:
+  HGamEventInfoAuxDyn_m_yy.assign(m_nSys, 0.0);
+  HGamEventInfoAuxDyn_pT_yy.assign(m_nSys, 0.0);
+  HGamEventInfoAuxDyn_TST_met.assign(m_nSys, 0.0);
+  HGamEventInfoAuxDyn_cutFlow.assign(m_nSys, 0);
+  b_HGamEventInfoAuxDyn_m_yy.assign(m_nSys, NULL);
+  b_HGamEventInfoAuxDyn_pT_yy.assign(m_nSys, NULL);
+  b_HGamEventInfoAuxDyn_TST_met.assign(m_nSys, NULL);
+  b_HGamEventInfoAuxDyn_cutFlow.assign(m_nSys, NULL);
+  
+  // No derived quantities have been computed yet:
+  m_pTHardEntry = -1;
+  m_nLeptonsEntry = -1;
+  m_kinematicsEntry.assign(m_nSys, -1);
+  m_pTHard = 0.0;
+  m_nLeptons = 0;
+  m_ratioETMisspTyy.assign(m_nSys, 0.0);
+  m_aTanRatio.assign(m_nSys, 0.0);
+  m_sumSqrtETMisspTyy.assign(m_nSys, 0.0);
+  
+  // No object branches until requireObjects():
+  m_objectBranches = 0;
+  
   Init(tree);
 }
 
@@ -142,100 +192,56 @@ void DMTree::Init(TTree *tree) {
   fChain = tree;
   fCurrent = -1;
   fChain->SetMakeClass(1);
-    
+  
+  // Only the branches bound below are read from the file:
+  m_activeBranches.clear();
+  fChain->SetBranchStatus("*", 0);
+  
   // Set object pointer
   HGamElectronsAuxDyn_pt = 0;
   HGamMuonsAuxDyn_pt = 0;
-  HGamTruthHiggsBosonsAuxDyn_m = 0;
+  HGamPhotonsAuxDyn_pt = 0;
+  HGamPhotonsAuxDyn_eta = 0;
+  HGamAntiKt4EMTopoJetsAuxDyn_pt = 0;
+  HGamAntiKt4EMTopoJetsAuxDyn_eta = 0;
   
   // Loop over systematics:
-  for (int i_s = 0; i_s < (int)m_sysNames.size(); i_s++) {
+  for (int i_s = 0; i_s < m_nSys; i_s++) {
+    
+    // Create a data tag (name for MxAOD branches).
+    TString dTag = (i_s == 0) ? "" : Form("_%s", m_sysNames[i_s].Data());
     
-    // Create a map tag (key for maps) and data tag (name for MxAOD branches).
-    TString mTag = m_sysNames[i_s];
-    TString dTag = (mTag.EqualTo("Nominal")) ?
-      "" : Form("_%s", m_sysNames[i_s].Data());
-  
     // Someone carelessly put a space in the branch name:
     if (dTag.Contains("FT_EFF_extrapolation_from_charm")) {
       dTag.ReplaceAll("FT_EFF_extrapolation_from_charm",
 		      "FT_EFF_extrapolation from charm");
     }
-
-    b_HGamEventInfoAuxDyn_m_yy[mTag] = NULL;
-    b_HGamEventInfoAuxDyn_pT_yy[mTag] = NULL;
-    b_HGamEventInfoAuxDyn_cosTS_yy[mTag] = NULL;
-    b_HGamEventInfoAuxDyn_Njets[mTag] = NULL;
-    b_HGamEventInfoAuxDyn_cutFlow[mTag] = NULL;
-    b_HGamEventInfoAuxDyn_weightInitial[mTag] = NULL;
-    b_HGamEventInfoAuxDyn_weight[mTag] = NULL;
-    b_HGamEventInfoAuxDyn_TST_met[mTag] = NULL;
-    b_HGamEventInfoAuxDyn_crossSectionBRfilterEff[mTag] = NULL;
-        
-    fChain->SetBranchAddress(Form("HGamEventInfo%sAuxDyn.m_yy",dTag.Data()),
-			     &HGamEventInfoAuxDyn_m_yy[mTag],
-			     &b_HGamEventInfoAuxDyn_m_yy[mTag]);
-    fChain->SetBranchAddress(Form("HGamEventInfo%sAuxDyn.pT_yy",dTag.Data()),
-			     &HGamEventInfoAuxDyn_pT_yy[mTag],
-			     &b_HGamEventInfoAuxDyn_pT_yy[mTag]);
-    fChain->SetBranchAddress(Form("HGamEventInfo%sAuxDyn.cosTS_yy",dTag.Data()),
-			     &HGamEventInfoAuxDyn_cosTS_yy[mTag],
-			     &b_HGamEventInfoAuxDyn_cosTS_yy[mTag]);
-    fChain->SetBranchAddress(Form("HGamEventInfo%sAuxDyn.Njets",dTag.Data()),
-			     &HGamEventInfoAuxDyn_Njets[mTag],
-			     &b_HGamEventInfoAuxDyn_Njets[mTag]);
-    fChain->SetBranchAddress(Form("HGamEventInfo%sAuxDyn.cutFlow",dTag.Data()), 
-			     &HGamEventInfoAuxDyn_cutFlow[mTag],
-			     &b_HGamEventInfoAuxDyn_cutFlow[mTag]);
-    fChain->SetBranchAddress(Form("HGamEventInfo%sAuxDyn.weightInitial",
-				  dTag.Data()),
-			     &HGamEventInfoAuxDyn_weightInitial[mTag], 
-			     &b_HGamEventInfoAuxDyn_weightInitial[mTag]);
-    fChain->SetBranchAddress(Form("HGamEventInfo%sAuxDyn.weight",dTag.Data()),
-			     &HGamEventInfoAuxDyn_weight[mTag],
-			     &b_HGamEventInfoAuxDyn_weight[mTag]);
-    fChain->SetBranchAddress(Form("HGamEventInfo%sAuxDyn.TST_met",dTag.Data()),
-			     &HGamEventInfoAuxDyn_TST_met[mTag],
-			     &b_HGamEventInfoAuxDyn_TST_met[mTag]);
-    fChain
-      ->SetBranchAddress(Form("HGamEventInfo%sAuxDyn.crossSectionBRfilterEff",
-			      dTag.Data()),
-			 &HGamEventInfoAuxDyn_crossSectionBRfilterEff[mTag],
-			 &b_HGamEventInfoAuxDyn_crossSectionBRfilterEff[mTag]);
+    
+    bindBranch(Form("HGamEventInfo%sAuxDyn.m_yy", dTag.Data()),
+	       &HGamEventInfoAuxDyn_m_yy[i_s],
+	       &b_HGamEventInfoAuxDyn_m_yy[i_s]);
+    bindBranch(Form("HGamEventInfo%sAuxDyn.pT_yy", dTag.Data()),
+	       &HGamEventInfoAuxDyn_pT_yy[i_s],
+	       &b_HGamEventInfoAuxDyn_pT_yy[i_s]);
+    bindBranch(Form("HGamEventInfo%sAuxDyn.TST_met", dTag.Data()),
+	       &HGamEventInfoAuxDyn_TST_met[i_s],
+	       &b_HGamEventInfoAuxDyn_TST_met[i_s]);
+    bindBranch(Form("HGamEventInfo%sAuxDyn.cutFlow", dTag.Data()), 
+	       &HGamEventInfoAuxDyn_cutFlow[i_s],
+	       &b_HGamEventInfoAuxDyn_cutFlow[i_s]);
   }
   
-  // The branches that don't have systematic variations:
-  fChain->SetBranchAddress("HGamElectronsAuxDyn.pt",
-			   &HGamElectronsAuxDyn_pt,
-			   &b_HGamElectronsAuxDyn_pt);
-  fChain->SetBranchAddress("HGamMuonsAuxDyn.pt",
-			   &HGamMuonsAuxDyn_pt,
-			   &b_HGamMuonsAuxDyn_pt);
-  fChain->SetBranchAddress("HGamTruthHiggsBosonsAuxDyn.m",
-			   &HGamTruthHiggsBosonsAuxDyn_m,
-			   &b_HGamTruthHiggsBosonsAuxDyn_m);
-  
-  fChain->SetBranchAddress("HGamPhotonsAuxDyn_pt", &HGamPhotonsAuxDyn_pt, 
-			   &b_HGamPhotonsAuxDyn_pt);
-  fChain->SetBranchAddress("HGamPhotonsAuxDyn_eta", &HGamPhotonsAuxDyn_eta,
-			   &b_HGamPhotonsAuxDyn_eta);
-  fChain->SetBranchAddress("HGamPhotonsAuxDyn_phi", &HGamPhotonsAuxDyn_phi,
-			   &b_HGamPhotonsAuxDyn_phi);
-  fChain->SetBranchAddress("HGamPhotonsAuxDyn_m", &HGamPhotonsAuxDyn_m,
-			   &b_HGamPhotonsAuxDyn_m);
-  
-  fChain->SetBranchAddress("HGamAntiKt4EMTopoJetsAuxDyn_pt", 
-			   &HGamAntiKt4EMTopoJetsAuxDyn_pt,
-			   &b_HGamAntiKt4EMTopoJetsAuxDyn_pt);
-  fChain->SetBranchAddress("HGamAntiKt4EMTopoJetsAuxDyn_eta",
-			   &HGamAntiKt4EMTopoJetsAuxDyn_eta,
-			   &b_HGamAntiKt4EMTopoJetsAuxDyn_eta);
-  fChain->SetBranchAddress("HGamAntiKt4EMTopoJetsAuxDyn_phi",
-			   &HGamAntiKt4EMTopoJetsAuxDyn_phi,
-			   &b_HGamAntiKt4EMTopoJetsAuxDyn_phi);
-  fChain->SetBranchAddress("HGamAntiKt4EMTopoJetsAuxDyn_m",
-			   &HGamAntiKt4EMTopoJetsAuxDyn_m,
-			   &b_HGamAntiKt4EMTopoJetsAuxDyn_m);
+  // The branches that are only used for the nominal selection and weights:
+  bindBranch("HGamEventInfoAuxDyn.Njets", &HGamEventInfoAuxDyn_Njets,
+	     &b_HGamEventInfoAuxDyn_Njets);
+  bindBranch("HGamEventInfoAuxDyn.weight", &HGamEventInfoAuxDyn_weight,
+	     &b_HGamEventInfoAuxDyn_weight);
+  bindBranch("HGamEventInfoAuxDyn.crossSectionBRfilterEff",
+	     &HGamEventInfoAuxDyn_crossSectionBRfilterEff,
+	     &b_HGamEventInfoAuxDyn_crossSectionBRfilterEff);
+  
+  // The object branches that were required before:
+  bindObjects(m_objectBranches);
   
   Notify();
 }
@@ -263,4 +269,124 @@ Int_t DMTree::Cut(Long64_t entry) {
    return 1;
 }
 
+void DMTree::requireObjects(int objectBranches) {
+  // Bind the object branches needed by a selection, if not bound already.
+  // Must be called before the read cache is set up from m_activeBranches.
+  int newBranches = objectBranches & ~m_objectBranches;
+  m_objectBranches |= objectBranches;
+  bindObjects(newBranches);
+}
+
+int DMTree::sysIndex(TString sysName) {
+  // Returns the integer id of a systematic variation, or -1 if not stored.
+  for (int i_s = 0; i_s < (int)m_sysNames.size(); i_s++) {
+    if (sysName.EqualTo(m_sysNames[i_s])) return i_s;
+  }
+  return -1;
+}
+
+void DMTree::bindBranch(TString branchName, void *address, TBranch **branch) {
+  // Activate a single branch and set its address. All other branches stay off.
+  fChain->SetBranchStatus(branchName, 1);
+  fChain->SetBranchAddress(branchName, address, branch);
+  m_activeBranches.push_back(branchName);
+}
+
+void DMTree::bindObjects(int objectBranches) {
+  // Bind the object branches (which don't have systematic variations). Only
+  // the pt and eta of photons and jets enter pTHard(), so phi and m are off.
+  if (!fChain) return;
+  if (objectBranches & kLeptonBranches) {
+    bindBranch("HGamElectronsAuxDyn.pt", &HGamElectronsAuxDyn_pt,
+	       &b_HGamElectronsAuxDyn_pt);
+    bindBranch("HGamMuonsAuxDyn.pt", &HGamMuonsAuxDyn_pt,
+	       &b_HGamMuonsAuxDyn_pt);
+  }
+  if (objectBranches & kPhotonJetBranches) {
+    bindBranch("HGamPhotonsAuxDyn_pt", &HGamPhotonsAuxDyn_pt, 
+	       &b_HGamPhotonsAuxDyn_pt);
+    bindBranch("HGamPhotonsAuxDyn_eta", &HGamPhotonsAuxDyn_eta,
+	       &b_HGamPhotonsAuxDyn_eta);
+  
+    bindBranch("HGamAntiKt4EMTopoJetsAuxDyn_pt", 
+	       &HGamAntiKt4EMTopoJetsAuxDyn_pt,
+	       &b_HGamAntiKt4EMTopoJetsAuxDyn_pt);
+    bindBranch("HGamAntiKt4EMTopoJetsAuxDyn_eta",
+	       &HGamAntiKt4EMTopoJetsAuxDyn_eta,
+	       &b_HGamAntiKt4EMTopoJetsAuxDyn_eta);
+  }
+}
+
+void DMTree::checkObjects(int objectBranches) {
+  // Stop if a derived quantity needs object branches that were not required.
+  if ((m_objectBranches & objectBranches) == objectBranches) return;
+  std::cout << "DMTree: Error! Object branches " << objectBranches
+	    << " are used without requireObjects()." << std::endl;
+  exit(0);
+}
+
+double DMTree::aTanRatio(int sysIndex) {
+  // Returns atan(ETMiss/pTyy) of a variation.
+  computeKinematics(sysIndex);
+  return m_aTanRatio[sysIndex];
+}
+
+void DMTree::computeKinematics(int sysIndex) {
+  // Computes the ETMiss and pTyy combinations of a variation, once per entry.
+  if (m_kinematicsEntry[sysIndex] == fChain->GetReadEntry()) return;
+  m_kinematicsEntry[sysIndex] = fChain->GetReadEntry();
+  float etMiss = HGamEventInfoAuxDyn_TST_met[sysIndex];
+  float pTyy = HGamEventInfoAuxDyn_pT_yy[sysIndex];
+  m_ratioETMisspTyy[sysIndex] = etMiss / pTyy;
+  m_aTanRatio[sysIndex] = TMath::ATan(m_ratioETMisspTyy[sysIndex]);
+  m_sumSqrtETMisspTyy[sysIndex] = sqrt((double)etMiss * etMiss +
+				       (double)pTyy * pTyy);
+}
+
+int DMTree::nLeptons() {
+  // Returns the number of electrons and muons.
+  checkObjects(kLeptonBranches);
+  if (m_nLeptonsEntry != fChain->GetReadEntry()) {
+    m_nLeptonsEntry = fChain->GetReadEntry();
+    m_nLeptons = (int)(HGamElectronsAuxDyn_pt->size() +
+		       HGamMuonsAuxDyn_pt->size());
+  }
+  return m_nLeptons;
+}
+
+double DMTree::pTHard() {
+  // Returns pTHard from the (nominal) photons and jets. The sums reproduce
+  // the former TLorentzVector(pt, eta, phi, m) sums, which were filled as
+  // (px, py, pz, E), so that the categories do not change.
+  checkObjects(kPhotonJetBranches);
+  if (m_pTHardEntry != fChain->GetReadEntry()) {
+    m_pTHardEntry = fChain->GetReadEntry();
+    float sumX = 0.0;
+    float sumY = 0.0;
+    for (int i_p = 0; i_p < (int)HGamPhotonsAuxDyn_pt->size(); i_p++) {
+      sumX += (*HGamPhotonsAuxDyn_pt)[i_p];
+      sumY += (*HGamPhotonsAuxDyn_eta)[i_p];
+    }
+    for (int i_j = 0; i_j < (int)HGamAntiKt4EMTopoJetsAuxDyn_pt->size();
+	 i_j++) {
+      sumX += (*HGamAntiKt4EMTopoJetsAuxDyn_pt)[i_j];
+      sumY += (*HGamAntiKt4EMTopoJetsAuxDyn_eta)[i_j];
+    }
+    m_pTHard = sqrtf(sumX * sumX + sumY * sumY);
+  }
+  return m_pTHard;
+}
+
+double DMTree::ratioETMisspTyy(int sysIndex) {
+  // Returns ETMiss/pTyy of a variation.
+  computeKinematics(sysIndex);
+  return m_ratioETMisspTyy[sysIndex];
+}
+
+double DMTree::sumSqrtETMisspTyy(int sysIndex) {
+  // Returns the quadrature sum of ETMiss and pTyy of a variation (in MeV).
+  computeKinematics(sysIndex);
+  return m_sumSqrtETMisspTyy[sysIndex];
+}
+
 #endif // #ifdef DMTree_cxx
@@ -34,6 +34,7 @@
 #include "RooStats/ProfileLikelihoodCalculator.h"
 #include "RooStats/ProfileLikelihoodTestStat.h"
 #include "RooStats/RatioOfProfiledLikelihoodsTestStat.h"
+#include "RooStats/RooStatsUtils.h"
 #include "RooStats/SamplingDistribution.h"
 #include "RooStats/SimpleLikelihoodRatioTestStat.h"
 #include "RooStats/SPlot.h"
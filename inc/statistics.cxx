@@ -209,9 +209,84 @@ RooDataSet* statistics::histToDataSet(TH1* h, RooRealVar* x, RooRealVar* w, RooC
   return histData;
 }
 
-void statistics::randomizeSet(RooAbsPdf* pdf, RooArgSet* globs, int seed){
+// Find the constraint term of a global observable, as built by
+// DMWorkspace::makeNP: RooGaussian(glob,nuis,1), RooBifurGauss(glob,nuis,1,a)
+// or RooPoisson(glob,mean). The servers are in the order of the constructor.
+static statistics::GlobSampler findGlobSampler(RooAbsPdf* pdf, RooRealVar* glob){
+  statistics::GlobSampler sampler={0,glob,NULL,NULL,NULL};
+  RooArgSet *components=pdf->getComponents();
+  TIterator *iterComp=components->createIterator();
+  RooAbsArg *comp=NULL;
+  while((comp=(RooAbsArg*)iterComp->Next())){
+    if(!comp->dependsOn(*glob)) continue;
+    bool isGauss=(dynamic_cast<RooGaussian*>(comp)!=NULL);
+    bool isBifur=(dynamic_cast<RooBifurGauss*>(comp)!=NULL);
+    bool isPoisson=(dynamic_cast<RooPoisson*>(comp)!=NULL);
+    if(!isGauss&&!isBifur&&!isPoisson) continue;
+    vector<RooAbsReal*> servers;
+    TIterator *iterServ=comp->serverIterator();
+    RooAbsArg *serv=NULL;
+    while((serv=(RooAbsArg*)iterServ->Next())) servers.push_back(dynamic_cast<RooAbsReal*>(serv));
+    SafeDelete(iterServ);
+    unsigned nServers=isBifur?4:(isGauss?3:2);
+    if(servers.size()!=nServers||find(servers.begin(),servers.end(),(RooAbsReal*)NULL)!=servers.end()) break;
+    // x and mean are interchangeable in the symmetric Gaussian only
+    if(servers[0]==glob) sampler.mean=servers[1];
+    else if(servers[1]==glob&&isGauss) sampler.mean=servers[0];
+    else break;
+    sampler.sigmaLow=isPoisson?NULL:servers[2];
+    sampler.sigmaHigh=isBifur?servers[3]:sampler.sigmaLow;
+    sampler.type=isGauss?1:(isBifur?2:3);
+    break;
+  }
+  SafeDelete(iterComp);
+  delete components;
+  if(sampler.type==0) cout<<"statistics::randomizeSet: generic sampling of "<<glob->GetName()<<endl;
+  return sampler;
+}
+
+// Draw one value of a global observable, within its range
+static double drawGlob(const statistics::GlobSampler &sampler){
+  TRandom *random=RooRandom::randomGenerator();
+  double mean=sampler.mean->getVal();
+  double value=mean;
+  for(int i_try=0; i_try<100; i_try++){
+    if(sampler.type==3) value=random->Poisson(mean);
+    else{
+      double sigmaLow=sampler.sigmaLow->getVal();
+      double sigmaHigh=sampler.sigmaHigh->getVal();
+      double r=fabs(random->Gaus(0,1));
+      // each side of the bifurcated Gaussian has probability ~ its width
+      if(random->Uniform(sigmaLow+sigmaHigh)<sigmaLow) value=mean-sigmaLow*r;
+      else value=mean+sigmaHigh*r;
+    }
+    if(sampler.glob->inRange(value,0)) return value;
+  }
+  return TMath::Min(TMath::Max(value,sampler.glob->getMin()),sampler.glob->getMax());
+}
+
+// Randomize the global observables. Those constrained by Gaussian, bifurcated
+// Gaussian or Poisson terms are drawn directly, the others with pdf->generate.
+// The samplers point into the model, so a cache must not outlive it: it is
+// owned by the caller (e.g. DMTestStat, one per workspace), or local if NULL.
+void statistics::randomizeSet(RooAbsPdf* pdf, RooArgSet* globs, int seed, GlobSamplerMap* samplers){
   if(seed>=0) RooRandom::randomGenerator() -> SetSeed(seed) ; // This step is necessary
-  RooDataSet *one=pdf->generate(*globs, 1);
+  GlobSamplerMap localSamplers;
+  if(!samplers) samplers=&localSamplers;
+  RooArgSet genericGlobs;
+  TIterator *iter=globs->createIterator();
+  RooRealVar *glob=NULL;
+  while((glob=(RooRealVar*)iter->Next())){
+    TString key=glob->GetName();
+    if(samplers->find(key)==samplers->end()) (*samplers)[key]=findGlobSampler(pdf,glob);
+    const GlobSampler &sampler=(*samplers)[key];
+    if(sampler.type==0) genericGlobs.add(*glob);
+    else glob->setVal(drawGlob(sampler));
+  }
+  SafeDelete(iter);
+  if(genericGlobs.getSize()==0) return;
+  
+  RooDataSet *one=pdf->generate(genericGlobs, 1);
   const RooArgSet *values=one->get(0);
   RooArgSet *allVars=pdf->getVariables();
   *allVars=*values;
@@ -219,6 +294,48 @@ void statistics::randomizeSet(RooAbsPdf* pdf, RooArgSet* globs, int seed){
   delete allVars;
 }
 
+// Philox4x32-10 counter-based generator (Salmon et al., SC11): the output is a
+// pure function of the counter and the key, so random streams can be split
+// and regenerated independently of the order in which they are used.
+void statistics::philox4x32(const UInt_t counter[4], const UInt_t key[2], UInt_t result[4]){
+  UInt_t ctr[4]={counter[0],counter[1],counter[2],counter[3]};
+  UInt_t k[2]={key[0],key[1]};
+  for(int round=0; round<10; round++){
+    ULong64_t prod0=(ULong64_t)0xD2511F53*ctr[0];
+    ULong64_t prod1=(ULong64_t)0xCD9E8D57*ctr[2];
+    UInt_t hi0=(UInt_t)(prod0>>32), lo0=(UInt_t)prod0;
+    UInt_t hi1=(UInt_t)(prod1>>32), lo1=(UInt_t)prod1;
+    ctr[0]=hi1^ctr[1]^k[0];
+    ctr[1]=lo1;
+    ctr[2]=hi0^ctr[3]^k[1];
+    ctr[3]=lo0;
+    k[0]+=0x9E3779B9;
+    k[1]+=0xBB67AE85;
+  }
+  for(int i=0; i<4; i++) result[i]=ctr[i];
+}
+
+// Seed of one random stream of a pseudo-experiment, keyed by the signal, the
+// injected mu_DM, the toy index and the stream (kToyGlobs, or kToyEvents plus
+// the category index). TRandom3 is seeded with 32 bits, so for N streams of
+// one kind (e.g. the events of one category) about N^2/2^33 pairs share their
+// seed: ~0.05 for 20000 toys. Two such toys share one stream, but the other
+// streams differ, so toys are not duplicated unless all of their streams
+// collide (probability ~(N^2/2^33)^(1+categories)).
+UInt_t statistics::toySeed(TString signal, int muDM, int toyIndex, int stream){
+  UInt_t hash=2166136261u; // FNV-1a, stable across ROOT versions
+  for(int i=0; i<signal.Length(); i++){
+    hash^=(UChar_t)signal[i];
+    hash*=16777619u;
+  }
+  UInt_t key[2]={hash,(UInt_t)muDM};
+  UInt_t counter[4]={(UInt_t)toyIndex,(UInt_t)stream,0,0};
+  UInt_t result[4];
+  philox4x32(counter,key,result);
+  UInt_t seed=result[0];
+  return (seed==0) ? 1 : seed; // seed 0 would be taken from the clock
+}
+
 double statistics::pvalueError(double pvalue, int ntoy){
   return sqrt(pvalue*(1-pvalue)/double(ntoy));
 }
@@ -238,6 +355,42 @@ double statistics::pvalueFromToy(vector<double> teststat, double threshold){
   return pvalue;
 }
 
+double statistics::importanceWeight(vector<double> nll, int target, vector<double> fraction){
+  // Weight of a toy drawn from a mixture of hypotheses (fraction[k] of the toys
+  // from hypothesis k), to estimate expectations under the target hypothesis:
+  // w = L_target / sum_k fraction[k]*L_k, with nll[k] = -log(L_k) for the toy.
+  // Summed in log space, since the likelihood ratios can be huge.
+  double maxterm=-1e300;
+  for(int i=0;i<(int)nll.size();i++){
+    if(fraction[i]<=0) continue;
+    maxterm=TMath::Max(maxterm,nll[target]-nll[i]+log(fraction[i]));
+  }
+  if(maxterm<=-1e300) return 0;
+  double sum=0;
+  for(int i=0;i<(int)nll.size();i++){
+    if(fraction[i]<=0) continue;
+    sum+=exp(nll[target]-nll[i]+log(fraction[i])-maxterm);
+  }
+  return exp(-maxterm-log(sum));
+}
+
+double statistics::pvalueFromWeightedToy(vector<double> teststat, vector<double> weight, double threshold, double &error){
+  // Tail probability P(q >= threshold) from weighted toys, with the standard
+  // error of the weighted mean
+  int ntoy=teststat.size();
+  error=0;
+  if(ntoy==0) return 0;
+  double sum=0, sum2=0;
+  for(int itoy=0;itoy<ntoy;itoy++){
+    if(teststat[itoy]<threshold) continue;
+    sum+=weight[itoy];
+    sum2+=weight[itoy]*weight[itoy];
+  }
+  double pvalue=sum/double(ntoy);
+  error=sqrt(TMath::Max(sum2/double(ntoy)-pvalue*pvalue,0.)/double(ntoy));
+  return pvalue;
+}
+
 map<string,double> statistics::expFromToy(vector<double> teststat){
   double median=0;
   double mean=0;
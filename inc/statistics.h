@@ -42,6 +42,17 @@ public:
   bool extrapolateSigma;
   int maxRetries;
   TRandom3 *fRandom;
+  // random streams of a pseudo-experiment (events: one stream per category)
+  enum ToyStream { kToyGlobs = 0, kToyEvents = 1 };
+  // direct sampler of one global observable from its constraint term
+  struct GlobSampler{
+    int type; // 0: generic (RooFit), 1: Gaussian, 2: bifurcated Gaussian, 3: Poisson
+    RooRealVar *glob;
+    RooAbsReal *mean;
+    RooAbsReal *sigmaLow;
+    RooAbsReal *sigmaHigh;
+  };
+  typedef map<TString,GlobSampler> GlobSamplerMap;
 public:
   statistics();
   ~statistics();
@@ -55,10 +66,14 @@ public:
   static void recoverSet(RooArgSet* set, RooArgSet* snapshot);
   static void retrieveSet(RooWorkspace* w, RooArgSet* set, RooArgSet* snapshot);
   void randomizeSet(RooArgSet* set, int seed, bool protection=false);
-  static void randomizeSet(RooAbsPdf* pdf, RooArgSet* globs, int seed);
+  static void randomizeSet(RooAbsPdf* pdf, RooArgSet* globs, int seed, GlobSamplerMap* samplers=NULL);
+  static void philox4x32(const UInt_t counter[4], const UInt_t key[2], UInt_t result[4]);
+  static UInt_t toySeed(TString signal, int muDM, int toyIndex, int stream);
   static RooDataSet* histToDataSet(TH1*, RooRealVar*, RooRealVar*, RooCategory*c=NULL);
   static double pvalueError(double pvalue, int ntoy);
   static double pvalueFromToy(vector<double> teststat, double thresold);
+  static double importanceWeight(vector<double> nll, int target, vector<double> fraction);
+  static double pvalueFromWeightedToy(vector<double> teststat, vector<double> weight, double threshold, double &error);
   static map<string,double> expFromToy(vector<double> teststat);
   ClassDef(statistics,1);
 };
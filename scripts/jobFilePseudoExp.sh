@@ -1,7 +1,7 @@
 #!/bin/bash
 
 if [[ $# -lt 8 ]]; then
-    echo "USAGE: jobFilePseudoExp.sh <jobname> <configfile> <input_file> <exe_name> <signal> <option> <seed> <toysperjob>"
+    echo "USAGE: jobFilePseudoExp.sh <jobname> <configfile> <input_file> <exe_name> <signal> <option> <seed> <toysperjob> [extra mu values]"
     
 else
     jobname=$1
@@ -18,7 +18,7 @@ else
     
     echo $jobname $configfile $input_file $exe_name $signal $option $seed $toysperjob
     
-    out="${jobname}_${seed}"
+    out="${jobname}_${signal}_${seed}"
     output_dir="/afs/cern.ch/user/a/ahard/work_directory/files_HggDM/FullAnalysis/${jobname}/DMPseudoExp"
     
     # setup ROOT:
@@ -50,6 +50,11 @@ else
     ./bin/${exe_name} ${configfile} ${signal} ${option} ${seed} ${toysperjob} 0 1> ${out}_mu0.log 2>${out}_mu0.err;
     ./bin/${exe_name} ${configfile} ${signal} ${option} ${seed} ${toysperjob} 1 1> ${out}_mu1.log 2>${out}_mu1.err;
     
+    # Extra signal strengths for importance-sampled toys:
+    for mu in "${@:9}"; do
+	./bin/${exe_name} ${configfile} ${signal} ${option} ${seed} ${toysperjob} ${mu} 1> ${out}_mu${mu}.log 2>${out}_mu${mu}.err;
+    done
+    
     mv *.log ${output_dir}/log/
     mv *.err ${output_dir}/err/
     rm * -rf
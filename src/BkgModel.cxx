@@ -2,7 +2,7 @@
 //                                                                            //
 //  Name: BkgModel.cxx                                                        //
 //                                                                            //
-//  Created: Andrew Hard                                                      //
+//  Created: agent                                                            //
 //  Email: ahard@cern.ch                                                      //
 //  Date: 25/06/2015                                                          //
 //                                                                            //
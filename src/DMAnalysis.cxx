@@ -198,6 +198,40 @@ int DMAnalysis::getDarkMatterMass(Config *config, TString modeName) {
   exit(0);
 }
 
+/**
+   -----------------------------------------------------------------------------
+   Get the extra values of the DM signal strength at which to generate toys for
+   importance sampling, besides mu = 0 and 1. The values must be distinct
+   integers, since DMPseudoExp and the toy file names only take integers.
+   This is shared by DMMaster and DMPipeline, so that both make the same toys.
+   @param config - The config file for the analysis settings.
+   @param toyOptions - The options of the pseudo-experiment jobs.
+   @returns - the extra values of mu_DM (integers, as for DMPseudoExp).
+*/
+std::vector<int> DMAnalysis::getExtraToyMuValues(Config *config,
+						 TString toyOptions) {
+  std::vector<int> result; result.clear();
+  if (!toyOptions.Contains("Importance")) return result;
+  std::vector<double> muValues = config->getNumV("ImportanceMuDM");
+  for (int i_m = 0; i_m < (int)muValues.size(); i_m++) {
+    int currMu = TMath::Nint(muValues[i_m]);
+    if (fabs(muValues[i_m] - currMu) > 1e-6) {
+      std::cout << "Analysis Error: ImportanceMuDM value " << muValues[i_m]
+		<< " is not an integer." << std::endl;
+      exit(0);
+    }
+    for (int i_p = 0; i_p < i_m; i_p++) {
+      if (TMath::Nint(muValues[i_p]) == currMu) {
+	std::cout << "Analysis Error: ImportanceMuDM value " << currMu
+		  << " is repeated." << std::endl;
+	exit(0);
+      }
+    }
+    if (currMu != 0 && currMu != 1) result.push_back(currMu);
+  }
+  return result;
+}
+
 /**
    -----------------------------------------------------------------------------
    Check if the sample is among those listed as a background sample.
@@ -366,3 +400,39 @@ TString DMAnalysis::nameToFileList(Config *config, TString name, bool useSys) {
   newFileList.close();
   return newListName;
 }
+
+/**
+   -----------------------------------------------------------------------------
+   Check whether a skim written by DMMassPoints can replace its input in a
+   job. Skims store the systematic variations and the object branches (as
+   DMTree::ObjectBranches flags) that were bound when they were written.
+   @param skimName - The name of the skim file.
+   @param systList - The systematic variations evaluated by the job.
+   @param objectBranches - The object branches read by the job.
+   @returns - True iff the skim exists and holds the variations and objects.
+*/
+bool DMAnalysis::skimHasBranches(TString skimName,
+				 std::vector<TString> systList,
+				 int objectBranches) {
+  if (gSystem->AccessPathName(skimName)) return false;
+  TFile skimFile(skimName, "READ");
+  if (skimFile.IsZombie()) return false;
+  TNamed *skimSystematics = (TNamed*)skimFile.Get("skimSystematics");
+  TNamed *skimObjects = (TNamed*)skimFile.Get("skimObjects");
+  std::vector<TString> skimList; skimList.clear();
+  if (skimSystematics) {
+    skimList = CommonFunc::SplitString(skimSystematics->GetTitle(), ' ');
+  }
+  int skimObjectBranches = skimObjects ? atoi(skimObjects->GetTitle()) : 0;
+  skimFile.Close();
+  
+  if ((skimObjectBranches & objectBranches) != objectBranches) return false;
+  for (int i_s = 0; i_s < (int)systList.size(); i_s++) {
+    bool hasVariation = false;
+    for (int i_k = 0; i_k < (int)skimList.size(); i_k++) {
+      if (systList[i_s].EqualTo(skimList[i_k])) hasVariation = true;
+    }
+    if (!hasVariation) return false;
+  }
+  return true;
+}
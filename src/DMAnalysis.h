@@ -17,11 +17,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string>
+#include <vector>
 
 // ROOT libraries:
+#include "TFile.h"
+#include "TMath.h"
+#include "TNamed.h"
 #include "TString.h"
+#include "TSystem.h"
 
 // Package libraries:
+#include "CommonFunc.h"
 #include "Config.h"
 
 namespace DMAnalysis {
@@ -33,6 +39,7 @@ namespace DMAnalysis {
   TString getPrintVarName(TString varName);
   int getMediatorMass(Config *config, TString modeName);
   int getDarkMatterMass(Config *config, TString modeName);
+  std::vector<int> getExtraToyMuValues(Config *config, TString toyOptions);
   bool isBkgSample(Config *config, TString sampleName);
   bool isDMSample(Config *config, TString sampleName);
   bool isSkimmed(Config *config, TString fileName);
@@ -40,6 +47,8 @@ namespace DMAnalysis {
   bool isSignalSample(Config *config, TString sampleName);
   bool isWeightedSample(Config *config, TString sampleName);
   TString nameToFileList(Config *config, TString name, bool useSys);  
+  bool skimHasBranches(TString skimName, std::vector<TString> systList,
+		       int objectBranches);
   
 };
 
@@ -7,6 +7,11 @@
 //  Date: 20/04/2015                                                          //
 //                                                                            //
 //  This class checks to see whether jobs of a particular type have finished. //
+//  The states of the jobs are read from the DMJobLedger. Job types without   //
+//  records in the ledger are checked by the existence of their outputs.      //
+//                                                                            //
+//  Jobs that are still running are not resubmitted, but failed and stalled   //
+//  jobs are. The PseudoExp jobs are listed by signal and seed.               //
 //                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -18,15 +23,19 @@
 */
 DMCheckJobs::DMCheckJobs(TString configFileName) {
   m_config = new Config(configFileName);
+  m_ledger = new DMJobLedger(configFileName);
+  m_ledger->readLedger();
   updateJobStatus("DMWorkspace");
   updateJobStatus("DMTestStat");
   updateJobStatus("DMMuLimit");
+  updateJobStatus("DMPseudoExp");
   return;
 }
 
 /**
    Get the number of jobs that need to be resubmitted.
-   @param jobType - the type of job (DMWorkspace, DMTestStat, DMMuLimit).
+   @param jobType - the type of job (DMWorkspace, DMTestStat, DMMuLimit,
+   DMPseudoExp).
    @returns - the number of jobs that failed the first attempt.
 */
 int DMCheckJobs::getNumberToResubmit(TString jobType) {
@@ -35,79 +44,135 @@ int DMCheckJobs::getNumberToResubmit(TString jobType) {
 }
 
 /**
-   Get the list of signal points that must be resubmitted.
-   @param jobType - the type of job (DMWorkspace, DMTestStat).
-   @returns - a vector of the signal point names.
+   Get the list of signal points (or toy signals and seeds) that must be
+   resubmitted.
+   @param jobType - the type of job (DMWorkspace, DMTestStat, DMMuLimit,
+   DMPseudoExp).
+   @returns - a vector of the signal point names (or "<signal> <seed>").
 */
 std::vector<TString> DMCheckJobs::getResubmitList(TString jobType) {
   std::vector<TString> result; result.clear();
   if (jobType.EqualTo("DMWorkspace")) result = m_listDMWorkspace;
   else if (jobType.EqualTo("DMTestStat")) result = m_listDMTestStat;
   else if (jobType.EqualTo("DMMuLimit")) result = m_listDMMuLimit;
+  else if (jobType.EqualTo("DMPseudoExp")) result = m_listDMPseudoExp;
   return result;
 }
 
+/**
+   Check whether a job must be resubmitted.
+   @param jobType - the type of job (as recorded in the ledger).
+   @param signal - the signal of the job.
+   @param seed - the first seed of the job (-1 for jobs without toys).
+   @returns - true iff the job is missing, failed, or stalled.
+*/
+bool DMCheckJobs::needsResubmit(TString jobType, TString signal, int seed) {
+  if (m_ledger->hasRecords(jobType)) {
+    int state = m_ledger->getJobState(jobType, signal, seed);
+    return (state != DMJobLedger::kRunning &&
+	    state != DMJobLedger::kSucceeded);
+  }
+  
+  // Jobs from before the ledger only have their output files:
+  std::ifstream testFile(m_ledger->getOutputFileName(jobType, signal, seed));
+  return !testFile;
+}
+
 /**
    Update the status of jobs from a particular program.
-   @param jobType - the type of job (DMWorkspace, DMTestStat)
-   @returns - void. Updates the lists of failed jobs.
+   @param jobType - the type of job (DMWorkspace, DMTestStat, DMMuLimit,
+   DMPseudoExp).
+   @returns - void. Updates the list of failed jobs of that type.
 */
 void DMCheckJobs::updateJobStatus(TString jobType) {
   
   // Save names of failed jobs:
-  m_listDMWorkspace.clear();
-  m_listDMTestStat.clear();
-  m_listDMMuLimit.clear();
+  std::vector<TString> failedJobs; failedJobs.clear();
   
-  // Then loop over submissions to see whether output files exist:
-  std::vector<TString> sigDMModes = m_config->getStrV("sigDMModes");
-  for (int i_DM = 0; i_DM < (int)sigDMModes.size(); i_DM++) {
-    TString currDMSignal = sigDMModes[i_DM];
-    
-    TString fileName;
-    TString fullName;
-    if (jobType.EqualTo("DMWorkspace")) {
-      fileName = Form("workspaceDM_%s.root", currDMSignal.Data());
-      fullName = Form("%s/%s/DMWorkspace/rootfiles/%s", 
-		      (m_config->getStr("masterOutput")).Data(),
-		      (m_config->getStr("jobName")).Data(), fileName.Data());
-    }
-    if (jobType.EqualTo("DMTestStat")) {
-      fileName = Form("CL_values_%s.txt", currDMSignal.Data());
-      fullName = Form("%s/%s/DMTestStat/CL/%s", 
-		      (m_config->getStr("masterOutput")).Data(), 
-		      (m_config->getStr("jobName")).Data(), fileName.Data());
-    }
-    
-    if (jobType.EqualTo("DMMuLimit")) {
-      fileName = Form("text_CLs_%s.txt", currDMSignal.Data());
-      fullName = Form("%s/%s/DMMuLimit/single_files/%s", 
-		      (m_config->getStr("masterOutput")).Data(), 
-		      (m_config->getStr("jobName")).Data(), fileName.Data());
-    }
-
-    // Then test the existence of the file.
-    std::ifstream testFile(fullName);
-    if (!testFile) {
-      if (jobType.EqualTo("DMWorkspace")) {
-	m_listDMWorkspace.push_back(currDMSignal);
+  // The toys are resubmitted by signal and seed. One job makes the toys of
+  // every signal strength for its seed (0, 1 and the extra ImportanceMuDM
+  // values, as submitted by DMMaster). The seeds are the fixed ensemble of the
+  // example signal, and the jobs of any signal submitted by AdaptivePseudoExp
+  // or recorded in the ledger:
+  if (jobType.EqualTo("DMPseudoExp")) {
+    m_toyMuValues
+      = DMAnalysis::getExtraToyMuValues(m_config,
+					m_config->getStr("pseudoExpOptions"));
+    m_toyMuValues.insert(m_toyMuValues.begin(), 1);
+    m_toyMuValues.insert(m_toyMuValues.begin(), 0);
+    TString exampleSignal = m_config->getStr("exampleSignal");
+    int toySeed = m_config->getInt("toySeed");
+    int nToysTotal = m_config->getInt("nToysTotal");
+    int nToysPerJob = m_config->getInt("nToysPerJob");
+    std::vector<TString> sigDMModes = m_config->getStrV("sigDMModes");
+    for (int i_DM = 0; i_DM < (int)sigDMModes.size(); i_DM++) {
+      TString currSignal = sigDMModes[i_DM];
+      std::map<int,int> seeds; seeds.clear();
+      if (currSignal.EqualTo(exampleSignal)) {
+	for (int i_s = toySeed; i_s < toySeed+nToysTotal; i_s += nToysPerJob) {
+	  seeds[i_s] = nToysPerJob;
+	}
       }
-      if (jobType.EqualTo("DMTestStat")) {
-	m_listDMTestStat.push_back(currDMSignal);
+      for (int i_m = 0; i_m < (int)m_toyMuValues.size(); i_m++) {
+	std::map<int,int> jobSeeds
+	  = m_ledger->getJobSeeds(Form("DMPseudoExp_mu%d", m_toyMuValues[i_m]),
+				  currSignal);
+	seeds.insert(jobSeeds.begin(), jobSeeds.end());
       }
-      if (jobType.EqualTo("DMMuLimit")) {
-	m_listDMMuLimit.push_back(currDMSignal);
+      std::ifstream submitFile(Form("%s/%s/DMToyController/submitted_%s.txt",
+				    (m_config->getStr("masterOutput")).Data(),
+				    (m_config->getStr("jobName")).Data(),
+				    currSignal.Data()));
+      long submitTime; int seed, nToys;
+      while (submitFile >> submitTime >> seed >> nToys) seeds[seed] = nToys;
+      submitFile.close();
+      
+      for (std::map<int,int>::iterator iter = seeds.begin();
+	   iter != seeds.end(); iter++) {
+	bool isFailed = false;
+	for (int i_m = 0; i_m < (int)m_toyMuValues.size(); i_m++) {
+	  if (needsResubmit(Form("DMPseudoExp_mu%d", m_toyMuValues[i_m]),
+			    currSignal, iter->first)) {
+	    isFailed = true;
+	  }
+	}
+	if (isFailed) {
+	  failedJobs.push_back(Form("%s %d", currSignal.Data(), iter->first));
+	}
       }
     }
+    m_listDMPseudoExp = failedJobs;
+    return;
   }
+  
+  // Then loop over submissions to see whether they succeeded:
+  std::vector<TString> sigDMModes = m_config->getStrV("sigDMModes");
+  for (int i_DM = 0; i_DM < (int)sigDMModes.size(); i_DM++) {
+    TString currDMSignal = sigDMModes[i_DM];
+    if (needsResubmit(jobType, currDMSignal, -1)) {
+      failedJobs.push_back(currDMSignal);
+    }
+  }
+  if (jobType.EqualTo("DMWorkspace")) m_listDMWorkspace = failedJobs;
+  else if (jobType.EqualTo("DMTestStat")) m_listDMTestStat = failedJobs;
+  else if (jobType.EqualTo("DMMuLimit")) m_listDMMuLimit = failedJobs;
 }
 
 /**
    Print the list and number of failed jobs.
-   @param jobType - the type of job (DMWorkspace, DMTestStat).
+   @param jobType - the type of job (DMWorkspace, DMTestStat, DMMuLimit,
+   DMPseudoExp).
    @returns void. Prints to the terminal.
 */
 void DMCheckJobs::printResubmitList(TString jobType) {
+  // Summarize the states recorded in the ledger:
+  if (jobType.EqualTo("DMPseudoExp")) {
+    for (int i_m = 0; i_m < (int)m_toyMuValues.size(); i_m++) {
+      m_ledger->printSummary(Form("DMPseudoExp_mu%d", m_toyMuValues[i_m]));
+    }
+  }
+  else m_ledger->printSummary(jobType);
+  
   // Get the relevant list of failed jobs:
   std::vector<TString> currList = getResubmitList(jobType);
   std::cout << "Failed to make the following " << jobType << " files ("
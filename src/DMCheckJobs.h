@@ -17,6 +17,7 @@
 #include <stdio.h>
 #include <string>
 #include <iostream>
+#include <map>
 #include <vector>
 
 // ROOT libraries:
@@ -25,6 +26,7 @@
 // Package libraries:
 #include "Config.h"
 #include "DMAnalysis.h"
+#include "DMJobLedger.h"
 
 class DMCheckJobs {
 
@@ -44,11 +46,18 @@ class DMCheckJobs {
   
  private:
   
+  bool needsResubmit(TString jobType, TString signal, int seed);
+  
   Config *m_config;
-
+  DMJobLedger *m_ledger;
+  
   std::vector<TString> m_listDMWorkspace;
   std::vector<TString> m_listDMTestStat;
   std::vector<TString> m_listDMMuLimit;
+  std::vector<TString> m_listDMPseudoExp;
+  
+  // The signal strengths made by each pseudo-experiment job:
+  std::vector<int> m_toyMuValues;
   
 };
 
@@ -0,0 +1,263 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: DMFilePrefetcher.cxx                                                //
+//                                                                            //
+//  Created: agent                                                            //
+//  Date: 16/10/2026                                                          //
+//                                                                            //
+//  This class makes local copies of the input files in a background thread,  //
+//  so that copying the next files overlaps with processing the current one.  //
+//  At most "cacheSize" local copies exist at any time. A file is deleted as  //
+//  soon as all of its users have released it, which lets the next copy       //
+//  start.                                                                    //
+//                                                                            //
+//  Files on EOS or behind root:// are copied with xrdcp, others with cp, so  //
+//  a local directory can stand in for the remote storage. Inputs that are    //
+//  already in the local directory are used in place and never deleted.       //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include "DMFilePrefetcher.h"
+
+/**
+   -----------------------------------------------------------------------------
+   Initialize the prefetcher. No files are copied until start() is called.
+   @param fileNames - The names of the original (remote) input files.
+   @param localDirectory - The directory for the local copies.
+   @param cacheSize - The maximum number of local copies at any time.
+*/
+DMFilePrefetcher::DMFilePrefetcher(std::vector<TString> fileNames,
+				   TString localDirectory, int cacheSize) {
+  std::cout << "DMFilePrefetcher: Initializing with " << fileNames.size()
+	    << " files and a cache of " << cacheSize << " files in "
+	    << localDirectory << std::endl;
+  
+  m_fileNames = fileNames;
+  m_localDirectory = localDirectory;
+  m_cacheSize = (cacheSize < 1) ? 1 : cacheSize;
+  m_nCached = 0;
+  m_stop = false;
+  m_waitTime = 0.0;
+  system(Form("mkdir -vp %s", m_localDirectory.Data()));
+  
+  // The local copy keeps the name of the original file:
+  char *localPath = realpath(m_localDirectory.Data(), NULL);
+  TString localDirPath = localPath ? localPath : "";
+  free(localPath);
+  for (int i_f = 0; i_f < (int)m_fileNames.size(); i_f++) {
+    TString baseName = gSystem->BaseName(m_fileNames[i_f].Data());
+    m_localNames.push_back(Form("%s/%s", m_localDirectory.Data(),
+				baseName.Data()));
+    char *filePath = realpath(m_fileNames[i_f].Data(), NULL);
+    TString inputPath = filePath ? filePath : "";
+    TString copyPath = Form("%s/%s", localDirPath.Data(), baseName.Data());
+    m_isLocalInput.push_back(!localDirPath.EqualTo("") &&
+			     inputPath.EqualTo(copyPath));
+    free(filePath);
+  }
+  m_fileStates.assign(m_fileNames.size(), kWaiting);
+  m_nUsers.assign(m_fileNames.size(), 0);
+  m_copyOrder.clear();
+  
+  m_thread = NULL;
+  m_mutex = new TMutex();
+  m_fileCopied = new TCondition(m_mutex);
+  m_fileReleased = new TCondition(m_mutex);
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Stop the copying thread and remove any remaining local copies.
+*/
+DMFilePrefetcher::~DMFilePrefetcher() {
+  stop();
+  delete m_fileCopied;
+  delete m_fileReleased;
+  delete m_mutex;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Wait until the local copy of a file is available. The file must have been
+   scheduled in start(), and must be released with releaseFile() when done.
+   @param fileIndex - The index of the file in the original list.
+   @return - The name of the local copy of the file.
+*/
+TString DMFilePrefetcher::acquireFile(int fileIndex) {
+  if (fileIndex < 0 || fileIndex >= nFiles() || m_nUsers[fileIndex] <= 0) {
+    std::cout << "DMFilePrefetcher: Error! File " << fileIndex
+	      << " was not scheduled for copying." << std::endl;
+    exit(0);
+  }
+  
+  TStopwatch timer;
+  timer.Start();
+  m_mutex->Lock();
+  while (m_fileStates[fileIndex] == kWaiting ||
+	 m_fileStates[fileIndex] == kCopying) {
+    m_fileCopied->Wait();
+  }
+  int state = m_fileStates[fileIndex];
+  timer.Stop();
+  m_waitTime += timer.RealTime();
+  m_mutex->UnLock();
+  
+  if (state != kCopied) {
+    std::cout << "DMFilePrefetcher: Error! Could not copy "
+	      << m_fileNames[fileIndex] << std::endl;
+    exit(0);
+  }
+  return m_localNames[fileIndex];
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Make the local copy of one file. The copy is written to a temporary name
+   first, so a partially copied file is never read.
+   @param fileIndex - The index of the file in the original list.
+   @return - True iff the copy was successful.
+*/
+bool DMFilePrefetcher::copyFile(int fileIndex) {
+  if (m_isLocalInput[fileIndex]) return true;
+  
+  TString source = m_fileNames[fileIndex];
+  TString target = m_localNames[fileIndex];
+  TString partName = Form("%s.part", target.Data());
+  std::cout << "DMFilePrefetcher: Copying " << source << std::endl;
+  
+  int status = 0;
+  if (source.BeginsWith("root://") || source.Contains("eos/atlas")) {
+    status = system(Form("xrdcp -f -s %s %s", source.Data(), partName.Data()));
+  }
+  else {
+    status = system(Form("cp %s %s", source.Data(), partName.Data()));
+  }
+  if (status != 0 || gSystem->Rename(partName, target) != 0) {
+    gSystem->Unlink(partName);
+    return false;
+  }
+  return true;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Copy the scheduled files in order, waiting whenever the cache is full.
+*/
+void DMFilePrefetcher::copyLoop() {
+  for (int i_o = 0; i_o < (int)m_copyOrder.size(); i_o++) {
+    int fileIndex = m_copyOrder[i_o];
+  
+    // Wait for space in the local cache (inputs used in place need none):
+    m_mutex->Lock();
+    if (!m_isLocalInput[fileIndex]) {
+      while (m_nCached >= m_cacheSize && !m_stop) m_fileReleased->Wait();
+      m_nCached++;
+    }
+    if (m_stop) {
+      m_mutex->UnLock();
+      break;
+    }
+    m_fileStates[fileIndex] = kCopying;
+    m_mutex->UnLock();
+  
+    // Copy without holding the lock, so the workers can continue:
+    bool success = copyFile(fileIndex);
+  
+    m_mutex->Lock();
+    m_fileStates[fileIndex] = success ? kCopied : kFailed;
+    m_fileCopied->Broadcast();
+    m_mutex->UnLock();
+  }
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Static entry point for the copying thread.
+   @param prefetcher - The DMFilePrefetcher that owns the thread.
+*/
+void* DMFilePrefetcher::copyLoopThread(void *prefetcher) {
+  ((DMFilePrefetcher*)prefetcher)->copyLoop();
+  return NULL;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Delete the local copy of a file. The mutex must be held by the caller.
+   @param fileIndex - The index of the file in the original list.
+*/
+void DMFilePrefetcher::evictFile(int fileIndex) {
+  if (m_fileStates[fileIndex] != kCopied) return;
+  if (!m_isLocalInput[fileIndex]) {
+    gSystem->Unlink(m_localNames[fileIndex]);
+    m_nCached--;
+  }
+  m_fileStates[fileIndex] = kEvicted;
+  m_fileReleased->Signal();
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Get the name of the local copy of a file.
+   @param fileIndex - The index of the file in the original list.
+   @return - The name of the local copy.
+*/
+TString DMFilePrefetcher::getLocalName(int fileIndex) {
+  return m_localNames[fileIndex];
+}
+
+/**
+   -----------------------------------------------------------------------------
+   @return - The number of files handled by the prefetcher.
+*/
+int DMFilePrefetcher::nFiles() {
+  return (int)m_fileNames.size();
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Release a file acquired with acquireFile(). The local copy is deleted once
+   all of the users of the file have released it.
+   @param fileIndex - The index of the file in the original list.
+*/
+void DMFilePrefetcher::releaseFile(int fileIndex) {
+  m_mutex->Lock();
+  m_nUsers[fileIndex]--;
+  if (m_nUsers[fileIndex] == 0) evictFile(fileIndex);
+  m_mutex->UnLock();
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Start copying files in the background.
+   @param copyOrder - The indices of the files in the order they are needed.
+   @param nUsers - The number of users of each file. A file is deleted after it
+   has been released this many times.
+*/
+void DMFilePrefetcher::start(std::vector<int> copyOrder,
+			     std::vector<int> nUsers) {
+  m_copyOrder = copyOrder;
+  m_nUsers = nUsers;
+  m_stop = false;
+  m_thread = new TThread("DMFilePrefetcher",
+			 DMFilePrefetcher::copyLoopThread, (void*)this);
+  m_thread->Run();
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Stop the copying thread and delete the local copies that remain.
+*/
+void DMFilePrefetcher::stop() {
+  if (!m_thread) return;
+  m_mutex->Lock();
+  m_stop = true;
+  m_fileReleased->Broadcast();
+  m_mutex->UnLock();
+  m_thread->Join();
+  delete m_thread;
+  m_thread = NULL;
+  
+  for (int i_f = 0; i_f < nFiles(); i_f++) evictFile(i_f);
+  std::cout << "DMFilePrefetcher: Waited " << m_waitTime
+	    << " s in total for local copies." << std::endl;
+}
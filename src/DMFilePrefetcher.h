@@ -0,0 +1,81 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: DMFilePrefetcher.h                                                  //
+//  Class: DMFilePrefetcher.cxx                                               //
+//                                                                            //
+//  Author: agent                                                             //
+//  Date: 16/10/2026                                                          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef DMFilePrefetcher_h
+#define DMFilePrefetcher_h
+
+// C++ includes:
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+
+// ROOT includes:
+#include "TString.h"
+#include "TSystem.h"
+#include "TThread.h"
+#include "TMutex.h"
+#include "TCondition.h"
+#include "TStopwatch.h"
+
+class DMFilePrefetcher
+{
+  
+ public:
+  
+  // Status of each file in the prefetcher:
+  enum FileState { kWaiting, kCopying, kCopied, kFailed, kEvicted };
+  
+  DMFilePrefetcher(std::vector<TString> fileNames, TString localDirectory,
+		   int cacheSize);
+  virtual ~DMFilePrefetcher();
+  
+  // Accessors:
+  TString getLocalName(int fileIndex);
+  int nFiles();
+  
+  // Mutators:
+  TString acquireFile(int fileIndex);
+  void releaseFile(int fileIndex);
+  void start(std::vector<int> copyOrder, std::vector<int> nUsers);
+  void stop();
+  
+ private:
+  
+  // Member methods:
+  bool copyFile(int fileIndex);
+  void copyLoop();
+  static void* copyLoopThread(void *prefetcher);
+  void evictFile(int fileIndex);
+  
+  // Member objects:
+  std::vector<TString> m_fileNames;
+  std::vector<TString> m_localNames;
+  std::vector<bool> m_isLocalInput;
+  std::vector<int> m_fileStates;
+  std::vector<int> m_nUsers;
+  std::vector<int> m_copyOrder;
+  TString m_localDirectory;
+  int m_cacheSize;
+  int m_nCached;
+  bool m_stop;
+  double m_waitTime;
+  
+  // Copying thread and its synchronization:
+  TThread *m_thread;
+  TMutex *m_mutex;
+  TCondition *m_fileCopied;
+  TCondition *m_fileReleased;
+  
+};
+
+#endif
@@ -0,0 +1,543 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: DMGridScan.cxx                                                      //
+//                                                                            //
+//  Created: agent                                                            //
+//  Date: 16/10/2026                                                          //
+//                                                                            //
+//  This class scans the grid of cut values used by the optimizer in a single //
+//  process, as a fast alternative to one batch job per grid point. Each      //
+//  sample is read once, and every event is tested against the selection of   //
+//  all grid cells. The weighted yields are accumulated per cell and category //
+//  in a narrow mass window (signal, SM Higgs, data) and in the sidebands     //
+//  (data).                                                                   //
+//                                                                            //
+//  The statistics are computed from the yields with a counting experiment in //
+//  each category: the non-resonant background in the window is extrapolated  //
+//  from the data sidebands assuming a flat spectrum, and the SM Higgs is an  //
+//  additional background. Cells with identical yields share their results,   //
+//  and cells without signal are not evaluated. This is an approximation of   //
+//  the full fits in DMTestStat, intended for finding the region of interest. //
+//                                                                            //
+//  The counting results are written to DMGridScan/countingResults.txt, and   //
+//  are only used to select the most promising cells ("GridScanNSelected"     //
+//  per signal). DMMaster then runs the full Workspace and DMTestStat chain   //
+//  on the selected cells, whose results are read by DMOptAnalysis.           //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include "DMGridScan.h"
+
+/**
+   -----------------------------------------------------------------------------
+   Initialize the scanner and build the grid of cut values. The cells are
+   ordered as the jobs of recursiveOptimizer() in DMMaster.
+   @param newConfigFile - The analysis configuration file.
+   @param newOptions - The job options ("FromSkim" to read the skims).
+*/
+DMGridScan::DMGridScan(TString newConfigFile, TString newOptions) {
+  std::cout << "DMGridScan: Initializing DMGridScan" << std::endl;
+  
+  m_configFileName = newConfigFile;
+  m_options = newOptions;
+  m_config = new Config(m_configFileName);
+  m_nCategories = m_config->getInt("nCategories");
+  m_nMxAODCuts = (int)(m_config->getStrV("MxAODCutList")).size();
+  
+  // The counting is done in a window around the Higgs mass:
+  m_myyRangeLo = m_config->getNum("DMMyyRangeLo");
+  m_myyRangeHi = m_config->getNum("DMMyyRangeHi");
+  m_windowLo = m_config->getNum("GridScanWindowLo", 120.0);
+  m_windowHi = m_config->getNum("GridScanWindowHi", 130.0);
+  
+  // The counting results are kept apart from those of the full chain:
+  m_outputDir = Form("%s/%s/DMGridScan", 
+		     (m_config->getStr("masterOutput")).Data(),
+		     (m_config->getStr("jobName")).Data());
+  system(Form("mkdir -vp %s", m_outputDir.Data()));
+  
+  // Each cut adds one dimension to the grid. The last cut varies fastest:
+  int nCuts = m_config->getInt("NOptVar");
+  m_cutNames.clear();
+  m_cellCutValues.clear();
+  m_cellCutValues.push_back(std::vector<double>());
+  for (int i_c = 0; i_c < nCuts; i_c++) {
+    m_cutNames.push_back(m_config->getStr(Form("OptVar%d", i_c)));
+    std::vector<double> cutPositions
+      = m_config->getNumV(Form("OptVarPos%d", i_c));
+    
+    // Only use a single grid point in test mode:
+    if (m_config->getBool("doTestMode") && cutPositions.size() > 1) {
+      cutPositions.resize(1);
+    }
+    
+    std::vector<std::vector<double> > newCells; newCells.clear();
+    for (int i_o = 0; i_o < (int)m_cellCutValues.size(); i_o++) {
+      for (int i_p = 0; i_p < (int)cutPositions.size(); i_p++) {
+	std::vector<double> currCell = m_cellCutValues[i_o];
+	currCell.push_back(cutPositions[i_p]);
+	newCells.push_back(currCell);
+      }
+    }
+    m_cellCutValues = newCells;
+  }
+  
+  // Each cell has its own settings and selector, with the cuts replaced:
+  m_cellConfigs.clear();
+  m_cellSelectors.clear();
+  for (int i_g = 0; i_g < nCells(); i_g++) {
+    Config *currConfig = new Config(m_configFileName);
+    for (int i_c = 0; i_c < nCuts; i_c++) {
+      currConfig->setValue(m_cutNames[i_c],
+			   Form("%f", m_cellCutValues[i_g][i_c]));
+    }
+    m_cellConfigs.push_back(currConfig);
+    m_cellSelectors.push_back(new DMEvtSelect(NULL, currConfig));
+  }
+  
+  m_windowYields.clear();
+  m_sidebandYields.clear();
+  m_selectedCells.clear();
+  std::cout << "DMGridScan: Scanning " << nCells() << " grid points."
+	    << std::endl;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Delete the selectors and settings of the grid cells.
+*/
+DMGridScan::~DMGridScan() {
+  for (int i_g = 0; i_g < nCells(); i_g++) {
+    delete m_cellSelectors[i_g];
+    delete m_cellConfigs[i_g];
+  }
+  delete m_config;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Calculate the CL value from qMu, as in DMTestStat.
+   @param qMu - The test statistic qMu.
+   @param N - The sigma value (-2,-1,0,1,2). Use 0 for median.
+   @return - The CL value.
+*/
+double DMGridScan::getCLFromQMu(double qMu, double N) {
+  double pMu = 1 - ROOT::Math::gaussian_cdf(sqrt(fabs(qMu)));
+  double pB = 1 - ROOT::Math::gaussian_cdf(N);
+  return (1.0 - (pMu / (1.0 - pB)));
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Get the background yield in the mass window for one cell and category. The
+   SM Higgs samples are included if they were loaded.
+   @param cellIndex - The index of the grid cell.
+   @param cateIndex - The index of the category.
+   @return - The expected number of background events.
+*/
+double DMGridScan::getBkgYield(int cellIndex, int cateIndex) {
+  int yieldIndex = cellIndex * m_nCategories + cateIndex;
+  double bkgYield = 0.0;
+  
+  // The SM Higgs is a resonant background:
+  std::vector<TString> sigSMModes = m_config->getStrV("sigSMModes");
+  for (int i_SM = 0; i_SM < (int)sigSMModes.size(); i_SM++) {
+    if (m_windowYields.count(sigSMModes[i_SM]) == 0) continue;
+    bkgYield += m_windowYields[sigSMModes[i_SM]][yieldIndex];
+  }
+  
+  // The non-resonant background is extrapolated from the data sidebands:
+  if (m_sidebandYields.count("Data") > 0) {
+    double windowWidth = m_windowHi - m_windowLo;
+    double sidebandWidth = (m_myyRangeHi - m_myyRangeLo) - windowWidth;
+    bkgYield += (m_sidebandYields["Data"][yieldIndex] * windowWidth /
+		 sidebandWidth);
+  }
+  return bkgYield;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Get the values of the optimized cuts in one grid cell.
+   @param cellIndex - The index of the grid cell.
+   @return - The cut values, in the order of the OptVar settings.
+*/
+std::vector<double> DMGridScan::getCellCutValues(int cellIndex) {
+  return m_cellCutValues[cellIndex];
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Get the cells selected by the counting approximation, for which the full
+   statistical analysis should be run. Filled by writeResults().
+   @return - The indices of the selected cells, in increasing order.
+*/
+std::vector<int> DMGridScan::getSelectedCells() {
+  return m_selectedCells;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Find the signal strength that minimizes the NLL of the counting experiment.
+   The derivative of the NLL increases with mu, so a bisection is used.
+   @param s - The signal yield in each category.
+   @param b - The background yield in each category.
+   @param n - The observed yield in each category.
+   @return - The best-fit signal strength.
+*/
+double DMGridScan::getMuHat(std::vector<double> s, std::vector<double> b,
+			    std::vector<double> n) {
+  // The expected yields must remain positive in all categories:
+  double muLo = -1.0e6;
+  for (int i_c = 0; i_c < (int)s.size(); i_c++) {
+    if (s[i_c] > 0.0) muLo = TMath::Max(muLo, -0.999999 * b[i_c] / s[i_c]);
+  }
+  double muHi = 1.0;
+  while (getNLLDerivative(s, b, n, muHi) < 0.0 && muHi < 1.0e6) muHi *= 2.0;
+  if (getNLLDerivative(s, b, n, muLo) >= 0.0) return muLo;
+  
+  for (int i_i = 0; i_i < 100; i_i++) {
+    double muMid = 0.5 * (muLo + muHi);
+    if (getNLLDerivative(s, b, n, muMid) < 0.0) muLo = muMid;
+    else muHi = muMid;
+  }
+  return 0.5 * (muLo + muHi);
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Calculate the negative log-likelihood of the counting experiment, without
+   the constant terms.
+   @param s - The signal yield in each category.
+   @param b - The background yield in each category.
+   @param n - The observed yield in each category.
+   @param mu - The signal strength.
+   @return - The NLL value.
+*/
+double DMGridScan::getNLL(std::vector<double> s, std::vector<double> b,
+			  std::vector<double> n, double mu) {
+  double nll = 0.0;
+  for (int i_c = 0; i_c < (int)s.size(); i_c++) {
+    double nu = mu * s[i_c] + b[i_c];
+    nll += nu;
+    if (n[i_c] > 0.0) nll -= n[i_c] * log(nu);
+  }
+  return nll;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Calculate the derivative of the NLL with respect to the signal strength.
+   @param s - The signal yield in each category.
+   @param b - The background yield in each category.
+   @param n - The observed yield in each category.
+   @param mu - The signal strength.
+   @return - The derivative of the NLL.
+*/
+double DMGridScan::getNLLDerivative(std::vector<double> s,
+				    std::vector<double> b,
+				    std::vector<double> n, double mu) {
+  double derivative = 0.0;
+  for (int i_c = 0; i_c < (int)s.size(); i_c++) {
+    derivative += s[i_c] - (n[i_c] * s[i_c] / (mu * s[i_c] + b[i_c]));
+  }
+  return derivative;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Calculate p0 from q0, as in DMTestStat.
+   @param q0 - The test statistic q0.
+   @return - The p0 value.
+*/
+double DMGridScan::getP0FromQ0(double q0) {
+  return (1 - ROOT::Math::gaussian_cdf(sqrt(fabs(q0))));
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Calculate the one-sided profile likelihood test statistic for the counting
+   experiment (q0 for muTest = 0, qMu otherwise).
+   @param s - The signal yield in each category.
+   @param b - The background yield in each category.
+   @param n - The observed yield in each category.
+   @param muTest - The tested signal strength.
+   @return - The value of the test statistic.
+*/
+double DMGridScan::getQ(std::vector<double> s, std::vector<double> b,
+			std::vector<double> n, double muTest) {
+  double muHat = getMuHat(s, b, n);
+  double q = 2.0 * (getNLL(s, b, n, muTest) - getNLL(s, b, n, muHat));
+  if (muTest == 0.0) return (muHat < 0.0) ? 0.0 : q;
+  return (muHat < muTest) ? q : 0.0;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Get the signal yield in the mass window for one cell and category.
+   @param signal - The name of the signal sample.
+   @param cellIndex - The index of the grid cell.
+   @param cateIndex - The index of the category.
+   @return - The expected number of signal events.
+*/
+double DMGridScan::getSignalYield(TString signal, int cellIndex,
+				  int cateIndex) {
+  if (m_windowYields.count(signal) == 0) {
+    std::cout << "DMGridScan: Error! Sample " << signal << " not loaded."
+	      << std::endl;
+    exit(0);
+  }
+  return m_windowYields[signal][cellIndex * m_nCategories + cateIndex];
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Read a sample once, and accumulate its yields for all grid cells.
+   @param sampleName - The name of the sample.
+*/
+void DMGridScan::loadSample(TString sampleName) {
+  std::cout << "DMGridScan: Loading sample " << sampleName << std::endl;
+  TStopwatch timer;
+  timer.Start();
+  
+  bool isWeighted = DMAnalysis::isWeightedSample(m_config, sampleName);
+  double sampleBR = DMAnalysis::isDMSample(m_config, sampleName) ?
+    m_config->getNum("BranchingRatioHyy") : 1.0;
+  double luminosity = 0.001 * m_config->getNum("analysisLuminosity");
+  
+  // Construct file list for the TChain:
+  TString listName = DMAnalysis::nameToFileList(m_config, sampleName, false);
+  TChain *chain = CommonFunc::MakeChain("CollectionTree", listName, "badfile");
+  
+  // Read the skims made by DMMassPoints instead of the full MxAODs. They must
+  // hold the object branches that any of the cell selections reads:
+  if (m_options.Contains("FromSkim")) {
+    int objectBranches = 0;
+    for (int i_g = 0; i_g < nCells(); i_g++) {
+      objectBranches |= m_cellSelectors[i_g]->requiredObjects();
+    }
+    TString defaultSkimDirectory
+      = Form("%s/Skims", (m_config->getStr("masterInput")).Data());
+    TString skimDirectory
+      = m_config->getStr("SkimDirectory", defaultSkimDirectory);
+    TChain *skimChain = new TChain(chain->GetName());
+    TObjArray *chainFiles = chain->GetListOfFiles();
+    for (int i_f = 0; i_f < chainFiles->GetEntries(); i_f++) {
+      TString inputName = chainFiles->At(i_f)->GetTitle();
+      TString skimName = Form("%s/%s", skimDirectory.Data(),
+			      gSystem->BaseName(inputName.Data()));
+      if (gSystem->AccessPathName(skimName)) {
+	std::cout << "DMGridScan: Error! No skim " << skimName << std::endl;
+	exit(0);
+      }
+      if (!DMAnalysis::skimHasBranches(skimName, std::vector<TString>(),
+				       objectBranches)) {
+	std::cout << "DMGridScan: Error! Skim " << skimName
+		  << " lacks object branches of the grid." << std::endl;
+	exit(0);
+      }
+      skimChain->AddFile(skimName);
+    }
+    delete chain;
+    chain = skimChain;
+  }
+  
+  // Index the metadata of the files, which is read when first needed:
+  TObjArray *chainFiles = chain->GetListOfFiles();
+  std::vector<TString> fileNames; fileNames.clear();
+  for (int i_f = 0; i_f < chainFiles->GetEntries(); i_f++) {
+    fileNames.push_back(chainFiles->At(i_f)->GetTitle());
+  }
+  DMxAODIndex *xAODIndex = new DMxAODIndex(fileNames, m_config);
+  
+  std::vector<TString> systList; systList.clear();
+  DMTree *dmt = new DMTree(chain, systList);
+  for (int i_g = 0; i_g < nCells(); i_g++) {
+    m_cellSelectors[i_g]->setTree(dmt);
+    m_cellSelectors[i_g]->clearCounters();
+  }
+  int allCutsID = m_cellSelectors[0]->cutIndex("AllCuts");
+  
+  std::vector<double> windowYields(nCells() * m_nCategories, 0.0);
+  std::vector<double> sidebandYields(nCells() * m_nCategories, 0.0);
+  
+  int currTreeNumber = -1;
+  double nTotalEventsInFile = 1.0;
+  Long64_t entries = chain->GetEntries();
+  for (Long64_t event = 0; event < entries; event++) {
+    chain->GetEntry(event);
+    
+    // The total number of events at the generator level, from the index:
+    if (chain->GetTreeNumber() != currTreeNumber) {
+      currTreeNumber = chain->GetTreeNumber();
+      nTotalEventsInFile = xAODIndex->nTotalEventsInFile(currTreeNumber);
+    }
+    
+    // Only events passing the MxAOD selection in the mass range are used:
+    if (dmt->HGamEventInfoAuxDyn_cutFlow[0] < m_nMxAODCuts) continue;
+    double invariantMass = dmt->HGamEventInfoAuxDyn_m_yy[0] / 1000.0;
+    if (invariantMass < m_myyRangeLo || invariantMass > m_myyRangeHi) {
+      continue;
+    }
+    bool inWindow = (invariantMass >= m_windowLo &&
+		     invariantMass < m_windowHi);
+    
+    // MC is normalized to 1 fb-1 (and BR for DM samples), then luminosity:
+    double evtWeight = 1.00000000;
+    if (isWeighted) {
+      evtWeight = (1000.0 * 
+		   dmt->HGamEventInfoAuxDyn_crossSectionBRfilterEff *
+		   dmt->HGamEventInfoAuxDyn_weight /
+		   nTotalEventsInFile) * sampleBR * luminosity;
+    }
+    
+    // Apply the selection of every grid cell to the event:
+    std::vector<double> &currYields = inWindow ? windowYields : sidebandYields;
+    for (int i_g = 0; i_g < nCells(); i_g++) {
+      if (!m_cellSelectors[i_g]->passesCut(allCutsID, evtWeight)) continue;
+      int currCate = m_cellSelectors[i_g]->getCategoryNumber(evtWeight);
+      currYields[i_g * m_nCategories + currCate] += evtWeight;
+    }
+  }
+  m_windowYields[sampleName] = windowYields;
+  m_sidebandYields[sampleName] = sidebandYields;
+  
+  delete dmt;
+  delete xAODIndex;
+  timer.Stop();
+  std::cout << "DMGridScan: Loaded " << entries << " events of " << sampleName
+	    << " in " << timer.RealTime() << " s." << std::endl;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   @return - The number of cells in the grid.
+*/
+int DMGridScan::nCells() {
+  return (int)m_cellCutValues.size();
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Compute the counting statistics of all cells and signals from the loaded
+   yields and write them to countingResults.txt. For each signal, the cells
+   with the best expected CL are selected for the full statistical analysis.
+*/
+void DMGridScan::writeResults() {
+  std::cout << "DMGridScan: Computing statistics for the grid." << std::endl;
+  
+  // The results are labelled, so they are not mistaken for DMTestStat ones:
+  ofstream countingFile;
+  countingFile.open(Form("%s/countingResults.txt", m_outputDir.Data()));
+  countingFile << "# DMGridScan counting approximation (not DMTestStat)"
+	       << std::endl;
+  countingFile << "Index";
+  for (int i_c = 0; i_c < (int)m_cutNames.size(); i_c++) {
+    countingFile << " " << m_cutNames[i_c];
+  }
+  countingFile << " Signal ExpP0 ObsP0 ObsCL ExpCLN2 ExpCLN1 ExpCL ExpCLP1"
+	       << " ExpCLP2" << std::endl;
+  
+  // The observed yields are only used when the analysis is not blinded:
+  bool useData = (!m_config->getBool("doBlind") &&
+		  m_windowYields.count("Data") > 0);
+  
+  // A minimum background keeps the significance of empty categories finite:
+  double minBkg = m_config->getNum("GridScanMinBkg", 0.1);
+  
+  // The number of cells to select for each signal:
+  int nSelected = m_config->getInt("GridScanNSelected", 5);
+  std::vector<bool> isSelected; isSelected.assign(nCells(), false);
+  
+  std::vector<TString> sigDMModes = m_config->getStrV("sigDMModes");
+  std::map<TString,std::vector<double> > cachedResults;
+  std::vector<std::vector<double> > signalExpCL(sigDMModes.size());
+  std::vector<std::vector<int> > signalCells(sigDMModes.size());
+  int nEvaluated = 0;
+  int nReused = 0;
+  for (int i_g = 0; i_g < nCells(); i_g++) {
+    
+    // The background yields do not depend on the signal:
+    std::vector<double> b; b.clear();
+    std::vector<double> n; n.clear();
+    for (int i_c = 0; i_c < m_nCategories; i_c++) {
+      b.push_back(TMath::Max(getBkgYield(i_g, i_c), minBkg));
+      n.push_back(useData ? 
+		  m_windowYields["Data"][i_g * m_nCategories + i_c] : b[i_c]);
+    }
+    
+    for (int i_DM = 0; i_DM < (int)sigDMModes.size(); i_DM++) {
+      std::vector<double> s; s.clear();
+      double totalSignal = 0.0;
+      TString yieldKey = "";
+      for (int i_c = 0; i_c < m_nCategories; i_c++) {
+	s.push_back(getSignalYield(sigDMModes[i_DM], i_g, i_c));
+	totalSignal += s[i_c];
+	yieldKey += Form("%.8e %.8e %.8e ", s[i_c], b[i_c], n[i_c]);
+      }
+      
+      // Cells without signal are not evaluated:
+      if (totalSignal <= 0.0) continue;
+      
+      // Cells with the same yields have the same results:
+      if (cachedResults.count(yieldKey) == 0) {
+	std::vector<double> asimovSB; asimovSB.clear();
+	for (int i_c = 0; i_c < m_nCategories; i_c++) {
+	  asimovSB.push_back(s[i_c] + b[i_c]);
+	}
+	double expQ0 = getQ(s, b, asimovSB, 0.0);
+	double obsQ0 = getQ(s, b, n, 0.0);
+	double expQMu = getQ(s, b, b, 1.0);
+	double obsQMu = getQ(s, b, n, 1.0);
+	
+	std::vector<double> currResults; currResults.clear();
+	currResults.push_back(getP0FromQ0(expQ0));
+	currResults.push_back(getP0FromQ0(obsQ0));
+	currResults.push_back(getCLFromQMu(obsQMu, 0));
+	for (int i_n = -2; i_n <= 2; i_n++) {
+	  currResults.push_back(getCLFromQMu(expQMu, i_n));
+	}
+	cachedResults[yieldKey] = currResults;
+	nEvaluated++;
+      }
+      else nReused++;
+      std::vector<double> results = cachedResults[yieldKey];
+      
+      // Write the cut values and the statistics:
+      countingFile << i_g;
+      for (int i_c = 0; i_c < (int)m_cutNames.size(); i_c++) {
+	countingFile << " " << m_cellCutValues[i_g][i_c];
+      }
+      countingFile << " " << sigDMModes[i_DM];
+      for (int i_r = 0; i_r < (int)results.size(); i_r++) {
+	countingFile << " " << results[i_r];
+      }
+      countingFile << std::endl;
+      
+      // The median expected CL ranks the cells:
+      signalExpCL[i_DM].push_back(results[5]);
+      signalCells[i_DM].push_back(i_g);
+    }
+  }
+  countingFile.close();
+  
+  // Select the cells with the highest expected CL for each signal:
+  for (int i_DM = 0; i_DM < (int)sigDMModes.size(); i_DM++) {
+    int nSignalCells = (int)signalCells[i_DM].size();
+    if (nSignalCells == 0) continue;
+    std::vector<int> order(nSignalCells, 0);
+    TMath::Sort(nSignalCells, &signalExpCL[i_DM][0], &order[0], true);
+    for (int i_s = 0; i_s < nSelected && i_s < nSignalCells; i_s++) {
+      isSelected[signalCells[i_DM][order[i_s]]] = true;
+    }
+  }
+  m_selectedCells.clear();
+  for (int i_g = 0; i_g < nCells(); i_g++) {
+    if (isSelected[i_g]) m_selectedCells.push_back(i_g);
+  }
+  
+  std::cout << "DMGridScan: Evaluated " << nEvaluated << " and reused "
+	    << nReused << " results for " << nCells() << " grid points, and"
+	    << " selected " << m_selectedCells.size() << " of them."
+	    << std::endl;
+}
@@ -0,0 +1,100 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: DMGridScan.h                                                        //
+//  Class: DMGridScan.cxx                                                     //
+//                                                                            //
+//  Author: agent                                                             //
+//  Date: 16/10/2026                                                          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef DMGridScan_h
+#define DMGridScan_h
+
+// C++ includes:
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <map>
+
+// ROOT includes:
+#include "TString.h"
+#include "TChain.h"
+#include "TSystem.h"
+#include "TStopwatch.h"
+#include "Math/DistFunc.h"
+
+// Package includes:
+#include "CommonFunc.h"
+#include "Config.h"
+#include "DMAnalysis.h"
+#include "DMEvtSelect.h"
+#include "DMTree.h"
+#include "DMxAODIndex.h"
+
+class DMGridScan 
+{
+  
+ public:
+  
+  DMGridScan(TString newConfigFile, TString newOptions);
+  virtual ~DMGridScan();
+  
+  // Accessors:
+  double getBkgYield(int cellIndex, int cateIndex);
+  std::vector<double> getCellCutValues(int cellIndex);
+  std::vector<int> getSelectedCells();
+  double getSignalYield(TString signal, int cellIndex, int cateIndex);
+  int nCells();
+  
+  // Mutators:
+  void loadSample(TString sampleName);
+  void writeResults();
+  
+ private:
+  
+  // Member methods:
+  double getCLFromQMu(double qMu, double N);
+  double getMuHat(std::vector<double> s, std::vector<double> b,
+		  std::vector<double> n);
+  double getNLL(std::vector<double> s, std::vector<double> b,
+		std::vector<double> n, double mu);
+  double getNLLDerivative(std::vector<double> s, std::vector<double> b,
+			  std::vector<double> n, double mu);
+  double getP0FromQ0(double q0);
+  double getQ(std::vector<double> s, std::vector<double> b,
+	      std::vector<double> n, double muTest);
+  
+  // Member objects:
+  Config *m_config;
+  TString m_configFileName;
+  TString m_options;
+  TString m_outputDir;
+  int m_nCategories;
+  int m_nMxAODCuts;
+  
+  // The mass window for the counting, and the full mass range:
+  double m_windowLo;
+  double m_windowHi;
+  double m_myyRangeLo;
+  double m_myyRangeHi;
+  
+  // The grid of cut values (one entry per cell):
+  std::vector<TString> m_cutNames;
+  std::vector<std::vector<double> > m_cellCutValues;
+  std::vector<Config*> m_cellConfigs;
+  std::vector<DMEvtSelect*> m_cellSelectors;
+  
+  // Yields of each sample, indexed by [cell*nCategories + category]:
+  std::map<TString,std::vector<double> > m_windowYields;
+  std::map<TString,std::vector<double> > m_sidebandYields;
+  
+  // The cells selected for the full statistical analysis:
+  std::vector<int> m_selectedCells;
+  
+};
+
+#endif
@@ -0,0 +1,314 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: DMJobLedger.cxx                                                     //
+//                                                                            //
+//  Created: agent                                                            //
+//  Date: 16/10/2026                                                          //
+//                                                                            //
+//  This class keeps an append-only ledger of the analysis jobs. Every job    //
+//  writes one record when it starts and one when it ends, with the job type, //
+//  signal, seed range, host, time, exit code and the MD5 checksum of its     //
+//  output. Each record is appended with a single write, so that concurrent   //
+//  jobs do not interleave their records.                                     //
+//                                                                            //
+//  The latest record of a job gives its state. A job that started more than  //
+//  "JobStallHours" ago without ending is stalled, and a job that ended       //
+//  without its output counts as failed.                                      //
+//                                                                            //
+//  The end record also notes whether the fits of the job converged. This is  //
+//  reported, but it does not change the state of the job, since running a    //
+//  job with fits that do not converge again gives the same result.           //
+//                                                                            //
+//  Record format (one per line):                                             //
+//    <time> <start|end> <jobType> <signal> <seed> <nSeeds> <host> <exitCode> //
+//    <checksum> [<converged>]                                                //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include "DMJobLedger.h"
+
+/**
+   -----------------------------------------------------------------------------
+   Initialize the ledger. The existing records are read by readLedger().
+   @param newConfigFile - The name of the analysis config file.
+*/
+DMJobLedger::DMJobLedger(TString newConfigFile) {
+  m_config = new Config(newConfigFile);
+  TString ledgerDir = Form("%s/%s/DMJobLedger",
+			   (m_config->getStr("masterOutput")).Data(),
+			   (m_config->getStr("jobName")).Data());
+  system(Form("mkdir -vp %s", ledgerDir.Data()));
+  m_ledgerFileName = Form("%s/ledger.txt", ledgerDir.Data());
+  m_stallTime = 3600.0 * m_config->getNum("JobStallHours", 12.0);
+  m_jobStates.clear();
+  m_fitsConverged.clear();
+  m_startTimes.clear();
+  m_jobSizes.clear();
+  m_nRecords.clear();
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Delete the ledger and its config.
+*/
+DMJobLedger::~DMJobLedger() {
+  delete m_config;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Check whether the fits of a job converged, from its latest end record.
+   @param jobType - The type of job (e.g. "DMWorkspace").
+   @param signal - The signal of the job.
+   @param seed - The first seed of the job (-1 for jobs without toys).
+   @return - False iff the job ended with fits that did not converge.
+*/
+bool DMJobLedger::fitsConverged(TString jobType, TString signal, int seed) {
+  TString key = getJobKey(jobType, signal, seed);
+  if (m_fitsConverged.count(key) == 0) return true;
+  return m_fitsConverged[key];
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Get the key of a job in the maps of the ledger.
+   @param jobType - The type of job (e.g. "DMWorkspace").
+   @param signal - The signal of the job.
+   @param seed - The first seed of the job (-1 for jobs without toys).
+   @return - The key of the job.
+*/
+TString DMJobLedger::getJobKey(TString jobType, TString signal, int seed) {
+  return Form("%s %s %d", jobType.Data(), signal.Data(), seed);
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Get the state of a job from the latest record read by readLedger().
+   @param jobType - The type of job (e.g. "DMWorkspace").
+   @param signal - The signal of the job.
+   @param seed - The first seed of the job (-1 for jobs without toys).
+   @return - The state of the job (kMissing if it has no records).
+*/
+int DMJobLedger::getJobState(TString jobType, TString signal, int seed) {
+  TString key = getJobKey(jobType, signal, seed);
+  if (m_jobStates.count(key) == 0) return kMissing;
+  return m_jobStates[key];
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Get the name of the main output file of a job.
+   @param jobType - The type of job (DMWorkspace, DMTestStat, DMMuLimit,
+   DMPseudoExp_mu0, DMPseudoExp_mu1).
+   @param signal - The signal of the job.
+   @param seed - The first seed of the job (-1 for jobs without toys).
+   @return - The name of the output file.
+*/
+TString DMJobLedger::getOutputFileName(TString jobType, TString signal,
+				       int seed) {
+  TString jobDir = Form("%s/%s", (m_config->getStr("masterOutput")).Data(),
+			(m_config->getStr("jobName")).Data());
+  if (jobType.EqualTo("DMWorkspace")) {
+    return Form("%s/DMWorkspace/rootfiles/workspaceDM_%s.root", jobDir.Data(),
+		signal.Data());
+  }
+  else if (jobType.EqualTo("DMTestStat")) {
+    return Form("%s/DMTestStat/CL/CL_values_%s.txt", jobDir.Data(),
+		signal.Data());
+  }
+  else if (jobType.EqualTo("DMMuLimit")) {
+    return Form("%s/DMMuLimit/single_files/text_CLs_%s.txt", jobDir.Data(),
+		signal.Data());
+  }
+  else if (jobType.BeginsWith("DMPseudoExp_")) {
+    TString muTag = jobType;
+    muTag.ReplaceAll("DMPseudoExp_", "");
+    return Form("%s/DMPseudoExp/single_files/%s/toy_%s_%d.root",
+		jobDir.Data(), signal.Data(), muTag.Data(), seed);
+  }
+  std::cout << "DMJobLedger: Error! Unknown job type " << jobType << std::endl;
+  exit(0);
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Get the first seeds of the recorded jobs of one type and signal, with their
+   numbers of seeds (toys).
+   @param jobType - The type of job (e.g. "DMPseudoExp_mu0").
+   @param signal - The signal of the jobs.
+   @return - The number of seeds of each job, indexed by its first seed.
+*/
+std::map<int,int> DMJobLedger::getJobSeeds(TString jobType, TString signal) {
+  std::map<int,int> result; result.clear();
+  TString prefix = getJobKey(jobType, signal, 0);
+  prefix.Remove(prefix.Length() - 1);
+  for (std::map<TString,int>::iterator iter = m_jobSizes.begin();
+       iter != m_jobSizes.end(); iter++) {
+    if (!(iter->first).BeginsWith(prefix)) continue;
+    TString seed = (iter->first)(prefix.Length(), (iter->first).Length());
+    if (seed.IsDigit()) result[seed.Atoi()] = iter->second;
+  }
+  return result;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Get the name of a job state, for printing.
+   @param state - The state of the job.
+   @return - The name of the state.
+*/
+TString DMJobLedger::getStateName(int state) {
+  if (state == kRunning) return "running";
+  else if (state == kStalled) return "stalled";
+  else if (state == kSucceeded) return "succeeded";
+  else if (state == kFailed) return "failed";
+  return "missing";
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Check whether any job of the given type has been recorded.
+   @param jobType - The type of job (e.g. "DMWorkspace").
+   @return - True iff the ledger has records for the job type.
+*/
+bool DMJobLedger::hasRecords(TString jobType) {
+  return (m_nRecords.count(jobType) > 0);
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Print the number of jobs of a given type in each state.
+   @param jobType - The type of job (e.g. "DMWorkspace").
+*/
+void DMJobLedger::printSummary(TString jobType) {
+  int nStates[5] = {0, 0, 0, 0, 0};
+  int nNotConverged = 0;
+  TString prefix = jobType + " ";
+  for (std::map<TString,int>::iterator iter = m_jobStates.begin();
+       iter != m_jobStates.end(); iter++) {
+    if (!(iter->first).BeginsWith(prefix)) continue;
+    nStates[iter->second]++;
+    if (m_fitsConverged.count(iter->first) > 0 &&
+	!m_fitsConverged[iter->first]) {
+      nNotConverged++;
+    }
+  }
+  std::cout << "DMJobLedger: " << jobType << " jobs: "
+	    << nStates[kSucceeded] << " succeeded, " << nStates[kRunning]
+	    << " running, " << nStates[kStalled] << " stalled, "
+	    << nStates[kFailed] << " failed, " << nNotConverged
+	    << " with fits that did not converge." << std::endl;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Read the records in the ledger, and update the state of every job.
+*/
+void DMJobLedger::readLedger() {
+  m_jobStates.clear();
+  m_fitsConverged.clear();
+  m_startTimes.clear();
+  m_jobSizes.clear();
+  m_nRecords.clear();
+  
+  std::ifstream ledgerFile(m_ledgerFileName);
+  if (!ledgerFile.is_open()) return;
+  long currTime = (long)time(NULL);
+  std::string line;
+  while (std::getline(ledgerFile, line)) {
+    std::istringstream record(line);
+    long recordTime; std::string event, jobType, signal, host, checksum;
+    int seed, nSeeds, exitCode;
+    if (!(record >> recordTime >> event >> jobType >> signal >> seed >> nSeeds
+	  >> host >> exitCode >> checksum)) {
+      continue;
+    }
+    
+    // Records from before the convergence field count as converged:
+    int converged = 1;
+    if (!(record >> converged)) converged = 1;
+    TString key = getJobKey(jobType.c_str(), signal.c_str(), seed);
+    m_nRecords[jobType.c_str()]++;
+    m_jobSizes[key] = nSeeds;
+  
+    // A job that ended without its output counts as failed:
+    if (event == "start") {
+      m_startTimes[key] = recordTime;
+      m_jobStates[key] = kRunning;
+      m_fitsConverged.erase(key);
+    }
+    else if (exitCode == 0 && checksum != "none") {
+      m_jobStates[key] = kSucceeded;
+    }
+    else {
+      m_jobStates[key] = kFailed;
+    }
+    if (event == "end") m_fitsConverged[key] = (converged != 0);
+  }
+  ledgerFile.close();
+  
+  // Jobs that have been running for too long are stalled:
+  for (std::map<TString,int>::iterator iter = m_jobStates.begin();
+       iter != m_jobStates.end(); iter++) {
+    if (iter->second == kRunning &&
+	currTime - m_startTimes[iter->first] > m_stallTime) {
+      iter->second = kStalled;
+    }
+  }
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Record the end of a job, with the checksum of its output.
+   @param jobType - The type of job (e.g. "DMWorkspace").
+   @param signal - The signal of the job.
+   @param seed - The first seed of the job (-1 for jobs without toys).
+   @param nSeeds - The number of seeds (toys) of the job.
+   @param exitCode - The exit code of the job (0 for success).
+   @param converged - True iff all fits of the job converged. This is kept
+   apart from the exit code, and does not make the job fail.
+*/
+void DMJobLedger::recordEnd(TString jobType, TString signal, int seed,
+			    int nSeeds, int exitCode, bool converged) {
+  TString checksum = "none";
+  TMD5 *md5 = TMD5::FileChecksum(getOutputFileName(jobType, signal, seed));
+  if (md5) checksum = md5->AsString();
+  delete md5;
+  writeRecord(Form("%ld end %s %s %d %d %s %d %s %d", (long)time(NULL),
+		   jobType.Data(), signal.Data(), seed, nSeeds,
+		   gSystem->HostName(), exitCode, checksum.Data(),
+		   (int)converged));
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Record the start of a job.
+   @param jobType - The type of job (e.g. "DMWorkspace").
+   @param signal - The signal of the job.
+   @param seed - The first seed of the job (-1 for jobs without toys).
+   @param nSeeds - The number of seeds (toys) of the job.
+*/
+void DMJobLedger::recordStart(TString jobType, TString signal, int seed,
+			      int nSeeds) {
+  writeRecord(Form("%ld start %s %s %d %d %s -1 -", (long)time(NULL),
+		   jobType.Data(), signal.Data(), seed, nSeeds,
+		   gSystem->HostName()));
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Append one record to the ledger. The record is written with a single call,
+   so that the records of concurrent jobs do not interleave.
+   @param record - The record, without the line break.
+*/
+void DMJobLedger::writeRecord(TString record) {
+  record += "\n";
+  int ledgerFile = open(m_ledgerFileName.Data(),
+			O_WRONLY | O_APPEND | O_CREAT, 0644);
+  if (ledgerFile < 0 ||
+      write(ledgerFile, record.Data(), record.Length()) != record.Length()) {
+    std::cout << "DMJobLedger: Error! Could not write to " << m_ledgerFileName
+	      << std::endl;
+  }
+  if (ledgerFile >= 0) close(ledgerFile);
+}
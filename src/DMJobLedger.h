@@ -0,0 +1,81 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: DMJobLedger.h                                                       //
+//  Class: DMJobLedger.cxx                                                    //
+//                                                                            //
+//  Author: agent                                                             //
+//  Date: 16/10/2026                                                          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef DMJobLedger_h
+#define DMJobLedger_h
+
+// C++ includes:
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <map>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// ROOT includes:
+#include "TString.h"
+#include "TSystem.h"
+#include "TMD5.h"
+
+// Package includes:
+#include "Config.h"
+
+class DMJobLedger
+{
+  
+ public:
+  
+  // Status of each job in the ledger:
+  enum JobState { kMissing, kRunning, kStalled, kSucceeded, kFailed };
+  
+  DMJobLedger(TString newConfigFile);
+  virtual ~DMJobLedger();
+  
+  // Accessors:
+  bool fitsConverged(TString jobType, TString signal, int seed);
+  std::map<int,int> getJobSeeds(TString jobType, TString signal);
+  int getJobState(TString jobType, TString signal, int seed);
+  TString getOutputFileName(TString jobType, TString signal, int seed);
+  TString getStateName(int state);
+  bool hasRecords(TString jobType);
+  void printSummary(TString jobType);
+  
+  // Mutators:
+  void readLedger();
+  void recordEnd(TString jobType, TString signal, int seed, int nSeeds,
+		 int exitCode, bool converged = true);
+  void recordStart(TString jobType, TString signal, int seed, int nSeeds);
+  
+ private:
+  
+  // Member methods:
+  TString getJobKey(TString jobType, TString signal, int seed);
+  void writeRecord(TString record);
+  
+  // Member objects:
+  Config *m_config;
+  TString m_ledgerFileName;
+  double m_stallTime;
+  
+  // The latest record of each job, and the number of jobs of each type:
+  std::map<TString,int> m_jobStates;
+  std::map<TString,bool> m_fitsConverged;
+  std::map<TString,long> m_startTimes;
+  std::map<TString,int> m_jobSizes;
+  std::map<TString,int> m_nRecords;
+  
+};
+
+#endif
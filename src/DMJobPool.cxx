@@ -0,0 +1,254 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: DMJobPool.cxx                                                       //
+//                                                                            //
+//  Created: agent                                                            //
+//  Date: 16/10/2026                                                          //
+//                                                                            //
+//  This class runs jobs in a bounded pool of worker processes on the local   //
+//  machine, as an alternative to submitting them to a batch system. Each job //
+//  is a shell command that runs in its own working directory, with stdout    //
+//  and stderr written to the given log files. At most "nSlots" jobs run at   //
+//  any time. The wall time and exit status of every job are recorded.        //
+//                                                                            //
+//  The working directory of a job is created when the job starts and is      //
+//  removed when it ends, so that jobs making local copies of their inputs    //
+//  (e.g. the workspace) do not interfere with each other. Jobs without a     //
+//  working directory run in the current directory.                           //
+//                                                                            //
+//  Jobs can be added while others are running, and waitForAnyJob() returns   //
+//  as soon as one job finishes, so that dependent jobs can be scheduled.     //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include "DMJobPool.h"
+
+/**
+   -----------------------------------------------------------------------------
+   Initialize the pool. No jobs are started until runJobs() is called.
+   @param nSlots - The maximum number of jobs running at the same time.
+*/
+DMJobPool::DMJobPool(int nSlots) {
+  m_nSlots = (nSlots < 1) ? 1 : nSlots;
+  m_nRunning = 0;
+  m_nextJob = 0;
+  std::cout << "DMJobPool: Initializing with " << m_nSlots << " slots."
+	    << std::endl;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Add a job to the queue of the pool.
+   @param jobName - A name for the job, used in the report.
+   @param command - The shell command to run.
+   @param workDirectory - The working directory of the job ("" for none).
+   @param outFileName - The file for the standard output of the job.
+   @param errFileName - The file for the standard error of the job.
+*/
+void DMJobPool::addJob(TString jobName, TString command, TString workDirectory,
+		       TString outFileName, TString errFileName) {
+  m_jobNames.push_back(jobName);
+  m_commands.push_back(command);
+  m_workDirectories.push_back(workDirectory);
+  m_outFileNames.push_back(outFileName);
+  m_errFileNames.push_back(errFileName);
+  m_jobStates.push_back(kQueued);
+  m_pids.push_back(-1);
+  m_exitStatus.push_back(-1);
+  m_startTimes.push_back(0);
+  m_wallTimes.push_back(0.0);
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Get the exit status of a job (-1 if it has not finished).
+   @param jobIndex - The index of the job, in the order it was added.
+   @return - The exit status of the job (128 + signal number if killed).
+*/
+int DMJobPool::getExitStatus(int jobIndex) {
+  return m_exitStatus[jobIndex];
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Get the wall time of a job.
+   @param jobIndex - The index of the job, in the order it was added.
+   @return - The wall time of the job in seconds.
+*/
+double DMJobPool::getWallTime(int jobIndex) {
+  return m_wallTimes[jobIndex];
+}
+
+/**
+   -----------------------------------------------------------------------------
+   @return - The number of jobs that finished with a non-zero exit status.
+*/
+int DMJobPool::nFailedJobs() {
+  int nFailed = 0;
+  for (int i_j = 0; i_j < nJobs(); i_j++) {
+    if (m_jobStates[i_j] == kFailed) nFailed++;
+  }
+  return nFailed;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   @return - The number of jobs in the pool.
+*/
+int DMJobPool::nJobs() {
+  return (int)m_jobNames.size();
+}
+
+/**
+   -----------------------------------------------------------------------------
+   @return - The number of jobs that are currently running.
+*/
+int DMJobPool::nRunningJobs() {
+  return m_nRunning;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Print the wall time and exit status of each job.
+*/
+void DMJobPool::printReport() {
+  std::cout << "DMJobPool: Report for " << nJobs() << " jobs:" << std::endl;
+  for (int i_j = 0; i_j < nJobs(); i_j++) {
+    std::cout << "\t" << m_jobNames[i_j] << "\tstatus " << m_exitStatus[i_j]
+	      << "\t" << m_wallTimes[i_j] << " s" << std::endl;
+  }
+  std::cout << "DMJobPool: " << nFailedJobs() << " of " << nJobs()
+	    << " jobs failed." << std::endl;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Run all of the queued jobs, and wait until they have finished.
+*/
+void DMJobPool::runJobs() {
+  while (m_nextJob < nJobs() || m_nRunning > 0) waitForAnyJob();
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Start a job in a new process.
+   @param jobIndex - The index of the job, in the order it was added.
+*/
+void DMJobPool::startJob(int jobIndex) {
+  bool hasWorkDirectory = !m_workDirectories[jobIndex].EqualTo("");
+  if (hasWorkDirectory) gSystem->mkdir(m_workDirectories[jobIndex], true);
+  std::cout << "DMJobPool: Starting " << m_jobNames[jobIndex] << std::endl;
+  
+  // Buffered output would otherwise be written by both processes:
+  std::cout.flush();
+  std::cerr.flush();
+  fflush(NULL);
+  
+  pid_t pid = fork();
+  if (pid < 0) {
+    std::cout << "DMJobPool: Error! Could not start " << m_jobNames[jobIndex]
+	      << std::endl;
+    exit(0);
+  }
+  
+  // The new process writes to the log files, from the working directory:
+  if (pid == 0) {
+    int outFile = open(m_outFileNames[jobIndex].Data(),
+		       O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    int errFile = open(m_errFileNames[jobIndex].Data(),
+		       O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (outFile < 0 || errFile < 0) _exit(127);
+    dup2(outFile, 1);
+    dup2(errFile, 2);
+    close(outFile);
+    close(errFile);
+    if (hasWorkDirectory && chdir(m_workDirectories[jobIndex].Data()) != 0) {
+      _exit(127);
+    }
+    execl("/bin/sh", "sh", "-c", m_commands[jobIndex].Data(), (char*)NULL);
+    _exit(127);
+  }
+  
+  m_pids[jobIndex] = (int)pid;
+  m_startTimes[jobIndex] = (Long64_t)gSystem->Now();
+  m_jobStates[jobIndex] = kRunning;
+  m_nRunning++;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Start queued jobs in the free slots, then wait until one of the running
+   jobs has finished.
+   @return - The index of the finished job, or -1 if no job is running.
+*/
+int DMJobPool::waitForAnyJob() {
+  while (m_nRunning < m_nSlots && m_nextJob < nJobs()) {
+    startJob(m_nextJob);
+    m_nextJob++;
+  }
+  return waitForJob();
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Wait until one of the running jobs has finished, and record its results.
+   Only the processes started by the pool are polled, so that other children
+   of the program (e.g. of system() calls in other threads) are not reaped.
+   @return - The index of the finished job, or -1 if no job is running.
+*/
+int DMJobPool::waitForJob() {
+  if (m_nRunning == 0) return -1;
+  
+  // Poll the running jobs, with a short sleep between the polls:
+  int status = 0;
+  int jobIndex = -1;
+  while (jobIndex < 0) {
+    for (int i_j = 0; i_j < nJobs() && jobIndex < 0; i_j++) {
+      if (m_jobStates[i_j] != kRunning) continue;
+      pid_t pid = waitpid((pid_t)m_pids[i_j], &status, WNOHANG);
+      if (pid == (pid_t)m_pids[i_j]) jobIndex = i_j;
+      else if (pid < 0 && errno != EINTR) {
+	std::cout << "DMJobPool: Error! Lost track of " << m_jobNames[i_j]
+		  << std::endl;
+	exit(0);
+      }
+    }
+    if (jobIndex < 0) gSystem->Sleep(100);
+  }
+  
+  // Record the results of the finished job:
+  m_wallTimes[jobIndex]
+    = 0.001 * (double)((Long64_t)gSystem->Now() - m_startTimes[jobIndex]);
+  if (WIFEXITED(status)) m_exitStatus[jobIndex] = WEXITSTATUS(status);
+  else if (WIFSIGNALED(status)) {
+    m_exitStatus[jobIndex] = 128 + WTERMSIG(status);
+  }
+  else m_exitStatus[jobIndex] = 127;
+  m_jobStates[jobIndex]
+    = (m_exitStatus[jobIndex] == 0) ? kSucceeded : kFailed;
+  m_nRunning--;
+  
+  // Remove the local copies of inputs made by the job:
+  if (!m_workDirectories[jobIndex].EqualTo("")) {
+    system(Form("rm -rf %s", m_workDirectories[jobIndex].Data()));
+  }
+  
+  std::cout << "DMJobPool: Finished " << m_jobNames[jobIndex]
+	    << " with status " << m_exitStatus[jobIndex] << " in "
+	    << m_wallTimes[jobIndex] << " s." << std::endl;
+  return jobIndex;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Write the name, exit status and wall time (s) of each job to a text file.
+   @param fileName - The name of the report file.
+*/
+void DMJobPool::writeReport(TString fileName) {
+  std::ofstream reportFile(fileName);
+  for (int i_j = 0; i_j < nJobs(); i_j++) {
+    reportFile << m_jobNames[i_j] << " " << m_exitStatus[i_j] << " "
+	       << m_wallTimes[i_j] << std::endl;
+  }
+  reportFile.close();
+}
@@ -0,0 +1,80 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: DMJobPool.h                                                         //
+//  Class: DMJobPool.cxx                                                      //
+//                                                                            //
+//  Author: agent                                                             //
+//  Date: 16/10/2026                                                          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef DMJobPool_h
+#define DMJobPool_h
+
+// C++ includes:
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+// ROOT includes:
+#include "TString.h"
+#include "TSystem.h"
+
+class DMJobPool
+{
+  
+ public:
+  
+  // Status of each job in the pool:
+  enum JobState { kQueued, kRunning, kSucceeded, kFailed };
+  
+  DMJobPool(int nSlots);
+  virtual ~DMJobPool() {};
+  
+  // Accessors:
+  int getExitStatus(int jobIndex);
+  double getWallTime(int jobIndex);
+  int nFailedJobs();
+  int nJobs();
+  int nRunningJobs();
+  void printReport();
+  void writeReport(TString fileName);
+  
+  // Mutators:
+  void addJob(TString jobName, TString command, TString workDirectory,
+	      TString outFileName, TString errFileName);
+  void runJobs();
+  int waitForAnyJob();
+  
+ private:
+  
+  // Member methods:
+  void startJob(int jobIndex);
+  int waitForJob();
+  
+  // Member objects:
+  std::vector<TString> m_jobNames;
+  std::vector<TString> m_commands;
+  std::vector<TString> m_workDirectories;
+  std::vector<TString> m_outFileNames;
+  std::vector<TString> m_errFileNames;
+  std::vector<int> m_jobStates;
+  std::vector<int> m_pids;
+  std::vector<int> m_exitStatus;
+  std::vector<Long64_t> m_startTimes;
+  std::vector<double> m_wallTimes;
+  int m_nSlots;
+  int m_nRunning;
+  int m_nextJob;
+  
+};
+
+#endif
@@ -10,15 +10,60 @@
 //  categorization and produce text files or RooDataSets.                     //
 //                                                                            //
 //  Can either run over the TTrees to create new mass points, or load the     //
-//  mass points from a previously generated text file, using newOptions =     //
-//  "FromFile" or "New".                                                      //
+//  mass points from a previously generated binary file, using newOptions =   //
+//  "FromFile" or "New". Each file has a DMMassPointsHeader followed by the   //
+//  mass and weight columns, and is loaded with mmap.                         //
 //                                                                            //
 //  New option: "Syst" to implement systematic variations.                    //
 //                                                                            //
+//  The event loop can run on several threads, set with "MassPointThreads" in //
+//  the config file.                                                          //
+//                                                                            //
+//  With the "CopyFile" option, local copies of the inputs are made in the    //
+//  background while the event loop runs. "CopyFileCacheSize" sets the max.   //
+//  number of local copies (raised to one more than the number of threads) and//
+//  "CopyFileDirectory" sets where they are made.                             //
+//                                                                            //
+//  The TTreeCache of the input chain is set with "TreeCacheSize" (MB),       //
+//  "TreeCacheLearnEntries" and "TreeCacheAsyncPrefetch".                     //
+//                                                                            //
+//  With the "WriteSkim" option, a skim of each input is written to           //
+//  "SkimDirectory" with the events passing "SkimMxAODCut" and the branches   //
+//  that are read. With "FromSkim", the skims are read instead of the inputs, //
+//  if they hold the systematic variations and object branches of the job.    //
+//                                                                            //
+//  The plotted variables are set with "HistVariables", and their binning     //
+//  with "HistBinning_<name>: nBins xMin xMax".                               //
+//                                                                            //
+//  With the "Incremental" option, the results of each input file are saved   //
+//  in DMMassPoints/Partials, keyed by a fingerprint of the file and of the   //
+//  selection settings. Later jobs only process the files that changed. The   //
+//  UUIDs of the files are cached there, so unchanged files are not opened.   //
+//                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
 
 #include "DMMassPoints.h"
 
+// Default binning of the variables that can be plotted (see DMHistVariable),
+// and whether their histograms are filled per category:
+struct DMHistDefault {
+  const char *name;
+  int nBins;
+  double xMin;
+  double xMax;
+  bool fillCates;
+};
+static const DMHistDefault histDefaults[kNHistVariables] = {
+  {"pTyy", 25, 0.0, 500.0, true},
+  {"ETMiss", 20, 0.0, 400.0, true},
+  {"ratioETMisspTyy", 20, 0.0, 4.0, true},
+  {"aTanRatio", 20, 0.0, TMath::Pi()/2.0, true},
+  {"myy", 20, 105.0, 160.0, true},
+  {"sumSqrtETMisspTyy", 20, 0.0, 600.0, true},
+  {"njets", 8, 0.0, 8.0, true},
+  {"nleptons", 5, 0.0, 5.0, false}
+};
+
 /**
    -----------------------------------------------------------------------------
    Initialize the DMMassPoint class and make a new RooCategory.
@@ -40,14 +85,26 @@ DMMassPoints::DMMassPoints(TString newConfigFile, TString newSampleName,
   m_configFileName = newConfigFile;
   m_options = newOptions;
   m_hists.clear();
+  m_histKeys.clear();
+  m_histVariables.clear();
+  m_histFillCates.clear();
+  m_histStride = 0;
   
   // For the full cut-flow:
   m_componentCutFlows.clear();
   m_componentNorms.clear();
   m_cutFlowHist = NULL;
+  m_prefetcher = NULL;
+  m_incremental = false;
+  m_writeSkim = false;
+  m_skimCutIndex = -1;
+  m_filePartials.clear();
+  m_chainFileIndices.clear();
+  m_xAODIndex = NULL;
   
   // Load the config file:
   m_config = new Config(m_configFileName);
+  m_cateScheme = m_config->getStr("cateScheme");
   
   // Assign the observable based on inputs:
   if (newObservable == NULL) {
@@ -56,6 +113,11 @@ DMMassPoints::DMMassPoints(TString newConfigFile, TString newSampleName,
   }
   else setMassObservable(newObservable);
   
+  // Skims are inputs for later jobs, so they are stored with the inputs:
+  TString defaultSkimDirectory
+    = Form("%s/Skims", (m_config->getStr("masterInput")).Data());
+  m_skimDirectory = m_config->getStr("SkimDirectory", defaultSkimDirectory);
+  
   // Assign output directory, and make sure it exists:
   m_outputDir = Form("%s/%s/DMMassPoints", 
 		     (m_config->getStr("masterOutput")).Data(), 
@@ -74,6 +136,138 @@ DMMassPoints::DMMassPoints(TString newConfigFile, TString newSampleName,
   return;
 }
 
+/**
+   -----------------------------------------------------------------------------
+   Store the cutflow of an input file and its normalization in a worker (or a
+   per-file result), to be combined in combineCutFlowHists().
+   @param worker - The worker or per-file result that stores the cutflow.
+   @param fileIndex - The index of the input file in the metadata index.
+*/
+void DMMassPoints::addFileCutFlow(DMMassPointsWorker *worker, int fileIndex) {
+  double currNorm = 1.00000000;
+  TH1F* currHist = (TH1F*)m_xAODIndex->getHist(fileIndex)->Clone();
+  currHist->SetDirectory(0);
+  if (m_isWeighted) {
+    // Normalization of inputs to 1 fb-1 (and BR for DM samples):
+    currNorm = (1000.0 * m_xAODIndex->crossSectionBRfilterEff(fileIndex) /
+		m_xAODIndex->nTotalEventsInFile(fileIndex)) * m_sampleBR;
+  }
+  worker->componentCutFlows.push_back(currHist);
+  worker->componentNorms.push_back(currNorm);
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Book the histograms of the variables listed in "HistVariables" (all of the
+   variables if it is not defined). The binning of a variable can be changed
+   with "HistBinning_<name>: nBins xMin xMax" in the config file.
+*/
+void DMMassPoints::bookHists() {
+  std::vector<TString> varNames; varNames.clear();
+  if (m_config->isDefined("HistVariables")) {
+    varNames = m_config->getStrV("HistVariables");
+  }
+  else {
+    for (int i_v = 0; i_v < kNHistVariables; i_v++) {
+      varNames.push_back(histDefaults[i_v].name);
+    }
+  }
+  
+  for (int i_n = 0; i_n < (int)varNames.size(); i_n++) {
+    int varID = -1;
+    for (int i_v = 0; i_v < kNHistVariables; i_v++) {
+      if (varNames[i_n].EqualTo(histDefaults[i_v].name)) varID = i_v;
+    }
+    if (varID < 0) {
+      std::cout << "DMMassPoints: Error! No histogram variable "
+		<< varNames[i_n] << std::endl;
+      exit(0);
+    }
+    int nBins = histDefaults[varID].nBins;
+    double xMin = histDefaults[varID].xMin;
+    double xMax = histDefaults[varID].xMax;
+    TString binningKey = Form("HistBinning_%s", varNames[i_n].Data());
+    if (m_config->isDefined(binningKey)) {
+      std::vector<double> binning = m_config->getNumV(binningKey);
+      if (binning.size() != 3) {
+	std::cout << "DMMassPoints: Error! " << binningKey
+		  << " needs nBins xMin xMax." << std::endl;
+	exit(0);
+      }
+      nBins = (int)binning[0];
+      xMin = binning[1];
+      xMax = binning[2];
+    }
+    newHist1D(varNames[i_n], nBins, xMin, xMax);
+    m_histVariables.push_back(varID);
+    m_histFillCates.push_back(histDefaults[varID].fillCates);
+  }
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Make an independent copy of a TChain for use in a worker thread. The entry
+   numbers stored in the original chain are reused so no files are reopened.
+   @param chain - The original TChain.
+   @return - A new TChain with the same files.
+*/
+TChain* DMMassPoints::cloneChain(TChain *chain) {
+  TChain *newChain = new TChain(chain->GetName());
+  TObjArray *chainFiles = chain->GetListOfFiles();
+  for (int i_f = 0; i_f < chainFiles->GetEntries(); i_f++) {
+    TChainElement *element = (TChainElement*)chainFiles->At(i_f);
+    newChain->AddFile(element->GetTitle(), element->GetEntries());
+  }
+  return newChain;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Write and close the skim that a worker is filling, if there is one. The skim
+   also gets a copy of the cutflow histograms and of the cross-section of the
+   input, for its normalization (even if no event passed), and the lists of
+   systematic variations and object branches it holds. It is written to a
+   temporary name first, so a failed job leaves no skim.
+   @param worker - The worker that fills the skim.
+*/
+void DMMassPoints::closeSkimFile(DMMassPointsWorker *worker) {
+  if (!worker->skimFile) return;
+  TString tempName = worker->skimFile->GetName();
+  TString skimName = tempName;
+  skimName.ReplaceAll(".part", "");
+  worker->skimFile->cd();
+  worker->skimTree->Write();
+  
+  // The normalization of the skim is taken from the same histograms:
+  int fileIndex = worker->skimIndex;
+  if (m_xAODIndex->isWeighted(fileIndex)) {
+    TH1F *histWeighted = m_xAODIndex->getHist(fileIndex, true);
+    histWeighted->Write(histWeighted->GetName());
+  }
+  TH1F *histUnweighted = m_xAODIndex->getHist(fileIndex, false);
+  histUnweighted->Write(histUnweighted->GetName());
+  
+  // The cross-section is stored with the events, which a skim might not have:
+  TNamed("skimCrossSectionBRfilterEff",
+	 Form("%.9g", m_xAODIndex->crossSectionBRfilterEff(fileIndex))).Write();
+  
+  // The variations and objects bound by the DMTree (including "Nominal"):
+  TString skimSystematics = "";
+  for (int i_s = 0; i_s < worker->tree->m_nSys; i_s++) {
+    if (i_s > 0) skimSystematics += " ";
+    skimSystematics += worker->tree->m_sysNames[i_s];
+  }
+  TNamed("skimSystematics", skimSystematics.Data()).Write();
+  TNamed("skimObjects", Form("%d", worker->tree->m_objectBranches)).Write();
+  
+  worker->skimFile->Close();
+  delete worker->skimFile;
+  worker->skimFile = NULL;
+  worker->skimTree = NULL;
+  gSystem->Rename(tempName, skimName);
+  std::cout << "DMMassPoints: Wrote skim " << skimName << std::endl;
+}
+
 /**
    -----------------------------------------------------------------------------
    Combine the MxAOD cutflow histograms with the histograms that have analysis-
@@ -89,7 +283,8 @@ void DMMassPoints::combineCutFlowHists() {
   int nMxAODCuts = (int)((m_config->getStrV("MxAODCutList")).size());
   
   // Check the sizes of samples:
-  if (m_componentNorms.size() != m_componentCutFlows.size()) {
+  if (m_componentCutFlows.empty() ||
+      m_componentNorms.size() != m_componentCutFlows.size()) {
     std::cout << "DMMassPoints: ERROR! Wrong normalization of samples." 
 	      << std::endl;
     exit(0);
@@ -124,9 +319,12 @@ void DMMassPoints::combineCutFlowHists() {
 	    << m_cutFlowHist->GetBinContent(nMxAODCuts) << " for " 
 	    << fullCutFlowHist->GetXaxis()->GetBinLabel(nMxAODCuts) 
 	    << std::endl;
-  double discrepancy = fabs((fullCutFlowHist->GetBinContent(nMxAODCuts) - 
-			     m_cutFlowHist->GetBinContent(nMxAODCuts)) / 
-			    fullCutFlowHist->GetBinContent(nMxAODCuts));
+  // Without any event passing the MxAOD cuts, the program must have none:
+  double discrepancy = fabs(fullCutFlowHist->GetBinContent(nMxAODCuts) - 
+			    m_cutFlowHist->GetBinContent(nMxAODCuts));
+  if (fullCutFlowHist->GetBinContent(nMxAODCuts) > 0.0) {
+    discrepancy /= fullCutFlowHist->GetBinContent(nMxAODCuts);
+  }
   if (discrepancy > 0.01) {
     std::cout << "DMMassPoints: ERROR! That discrepancy of " << discrepancy 
 	      << " is too large :(" << std::endl;
@@ -154,6 +352,52 @@ void DMMassPoints::combineCutFlowHists() {
   // This TH1F is written to file in the saveHists() method.
 }
 
+/**
+   -----------------------------------------------------------------------------
+   Create a chain that reads local copies of the files in the original chain.
+   The copies are made in the background by a DMFilePrefetcher, which is
+   started with scheduleLocalFiles() once the entry ranges are known. The
+   number of entries in each file is taken from the original chain, so the
+   local files are only opened when the event loop reaches them. The metadata
+   index also reads each file from its local copy.
+   @param chain - The original TChain, which is deleted.
+   @return - A new TChain with the local file names.
+*/
+TChain* DMMassPoints::createLocalChain(TChain *chain) {
+  std::cout << "DMMassPoints: createLocalChain." << std::endl;
+  std::vector<TString> fileNames; fileNames.clear();
+  std::vector<Long64_t> fileEntries; fileEntries.clear();
+  TObjArray *chainFiles = chain->GetListOfFiles();
+  for (int i_f = 0; i_f < chainFiles->GetEntries(); i_f++) {
+    TChainElement *element = (TChainElement*)chainFiles->At(i_f);
+    fileNames.push_back(element->GetTitle());
+    fileEntries.push_back(element->GetEntries());
+  }
+  
+  TString localDirectory = m_config->getStr("CopyFileDirectory", TString("."));
+  int cacheSize = m_config->getInt("CopyFileCacheSize", 2);
+  
+  // Each worker holds the copy it is reading, so at least one more copy is
+  // needed for the next file to arrive while all workers are busy:
+  int nThreads = m_config->getInt("MassPointThreads", 1);
+  if (cacheSize <= nThreads) {
+    std::cout << "DMMassPoints: CopyFileCacheSize " << cacheSize
+	      << " raised to " << nThreads + 1 << " for " << nThreads
+	      << " thread(s)." << std::endl;
+    cacheSize = nThreads + 1;
+  }
+  m_prefetcher = new DMFilePrefetcher(fileNames, localDirectory, cacheSize);
+  TChain *localChain = new TChain(chain->GetName());
+  for (int i_f = 0; i_f < (int)fileNames.size(); i_f++) {
+    localChain->AddFile(m_prefetcher->getLocalName(i_f), fileEntries[i_f]);
+    // The metadata is read from the copy, once the loop has acquired it:
+    m_xAODIndex->setLocalName(m_chainFileIndices[i_f],
+			      m_prefetcher->getLocalName(i_f));
+  }
+  delete chain;
+  return localChain;
+}
+
 /**
    -----------------------------------------------------------------------------
    Create local copies of files and a new file list.
@@ -196,24 +440,160 @@ TString DMMassPoints::createLocalFilesAndList(TString originListName) {
 
 /**
    -----------------------------------------------------------------------------
-   Fill a stored 1D histogram.
-   @param varName - The name of the quantity in the plot.
-   @param allEvents - True iff all events included.
-   @param xVal - The x-axis value for histogram filling.
-   @param xWeight - The weight value for histogram filling.
-   @param cateIndex - The analysis category for the event.
+   Create a chain that reads the skims of the files in the original chain. The
+   skims must have been written by a previous job with the "WriteSkim" option,
+   with all of the systematic variations and object branches of this job.
+   @param chain - The original TChain, which is deleted.
+   @param systList - The systematic variations evaluated by this job.
+   @param objectBranches - The object branches read by this job.
+   @return - A new TChain with the skim file names.
 */
-void DMMassPoints::fillHist1D(TString varName, bool allEvents, double xVal,
-			      double xWeight, int cateIndex) {
+TChain* DMMassPoints::createSkimChain(TChain *chain,
+				      std::vector<TString> systList,
+				      int objectBranches) {
+  std::cout << "DMMassPoints: createSkimChain." << std::endl;
+  TChain *skimChain = new TChain(chain->GetName());
+  TObjArray *chainFiles = chain->GetListOfFiles();
+  for (int i_f = 0; i_f < chainFiles->GetEntries(); i_f++) {
+    TString skimName = getSkimFileName(chainFiles->At(i_f)->GetTitle());
+    if (gSystem->AccessPathName(skimName)) {
+      std::cout << "DMMassPoints: Error! No skim " << skimName
+		<< ". Run with the WriteSkim option first." << std::endl;
+      exit(0);
+    }
+    if (!DMAnalysis::skimHasBranches(skimName, systList, objectBranches)) {
+      std::cout << "DMMassPoints: Error! Skim " << skimName
+		<< " lacks systematic variations or objects of this job. Run"
+		<< " with the WriteSkim option again." << std::endl;
+      exit(0);
+    }
+    skimChain->AddFile(skimName);
+  }
+  
+  // Set the number of entries in each file, as for the original chain:
+  skimChain->GetEntries();
+  delete chain;
+  return skimChain;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Fill a histogram of a worker. The fill is buffered, and the buffer is
+   written to the histograms once it is full (see flushHistBuffer()).
+   @param worker - The worker whose histograms are filled.
+   @param handle - The handle of the variable, from newHist1D().
+   @param allEvents - True iff filling before the analysis selection.
+   @param xVal - The value of the variable.
+   @param xWeight - The weight of the event.
+   @param cateIndex - The category of the event, or -1 for no category fill.
+*/
+void DMMassPoints::fillHist1D(DMMassPointsWorker *worker, int handle,
+			      bool allEvents, double xVal, double xWeight,
+			      int cateIndex) {
+  int base = handle * m_histStride;
   if (allEvents) {
-    m_hists[Form("%s_ALL",varName.Data())]->Fill(xVal, xWeight);
+    worker->fillSlots.push_back(base);
+    worker->fillValues.push_back(xVal);
+    worker->fillWeights.push_back(xWeight);
   }
   else {
-    m_hists[Form("%s_PASS",varName.Data())]->Fill(xVal, xWeight);
+    worker->fillSlots.push_back(base + 1);
+    worker->fillValues.push_back(xVal);
+    worker->fillWeights.push_back(xWeight);
     if (cateIndex >= 0) {
-      m_hists[Form("%s_c%d_PASS",varName.Data(),cateIndex)]->Fill(xVal,xWeight);
+      worker->fillSlots.push_back(base + 2 + cateIndex);
+      worker->fillValues.push_back(xVal);
+      worker->fillWeights.push_back(xWeight);
+    }
+  }
+  if ((int)worker->fillSlots.size() >= 4096) flushHistBuffer(worker);
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Write the buffered fills of a worker to its histograms.
+   @param worker - The worker whose histograms are filled.
+*/
+void DMMassPoints::flushHistBuffer(DMMassPointsWorker *worker) {
+  for (int i_f = 0; i_f < (int)worker->fillSlots.size(); i_f++) {
+    worker->hists[worker->fillSlots[i_f]]->Fill(worker->fillValues[i_f],
+						worker->fillWeights[i_f]);
+  }
+  worker->fillSlots.clear();
+  worker->fillValues.clear();
+  worker->fillWeights.clear();
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Move the results that a worker collected for one input file into the
+   partial results of that file. The worker results are reset afterwards.
+   @param worker - The worker that processed the file.
+   @param fileIndex - The index of the file in the original list.
+*/
+void DMMassPoints::flushFilePartial(DMMassPointsWorker *worker,
+				    int fileIndex) {
+  DMMassPointsWorker *partial = m_filePartials[fileIndex];
+  partial->selector->addCounters(worker->selector);
+  worker->selector->clearCounters();
+  flushHistBuffer(worker);
+  for (int i_h = 0; i_h < (int)worker->hists.size(); i_h++) {
+    partial->hists[i_h]->Add(worker->hists[i_h]);
+    worker->hists[i_h]->Reset();
+  }
+  for (int i_c = 0; i_c < 20; i_c++) {
+    partial->masses[i_c].swap(worker->masses[i_c]);
+    partial->weights[i_c].swap(worker->weights[i_c]);
+    worker->masses[i_c].clear();
+    worker->weights[i_c].clear();
+  }
+  partial->componentCutFlows.swap(worker->componentCutFlows);
+  partial->componentNorms.swap(worker->componentNorms);
+  worker->componentCutFlows.clear();
+  worker->componentNorms.clear();
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Get the name of the file holding the partial results of one input file. The
+   name contains a fingerprint of the input file (its UUID, size and number of
+   entries) and of all settings that change the selection, so any change to
+   either gives a new name.
+   @param fileIndex - The index of the input file in the metadata index.
+   @param entries - The number of entries of the input file.
+   @param getSystematics - True iff systematic variations are evaluated.
+   @return - The name of the partial results file.
+*/
+TString DMMassPoints::getPartialFileName(int fileIndex, Long64_t entries,
+					 bool getSystematics) {
+  TString fingerprint = Form("%s;%lld;%lld;%s;%d;",
+			     m_xAODIndex->getUUID(fileIndex).Data(),
+			     m_xAODIndex->getFileSize(fileIndex), entries,
+			     m_sampleName.Data(), (int)getSystematics);
+  
+  // Settings that change the selection, in the order of the config file:
+  const int nSettings = 13;
+  TString settings[nSettings] = {"AnaCut", "LeptonVeto", "cateScheme",
+				 "nCategories", "MxAODCutList", "RatioCut",
+				 "ETMissCut", "DiphotonPTCut", "PTHardCut",
+				 "SystematicsList", "BranchingRatioHyy",
+				 "DMMyyRange", "Hist"};
+  TIter next(m_config->getDB()->GetTable());
+  while (TEnvRec *record = (TEnvRec*)next()) {
+    TString name = record->GetName();
+    for (int i_s = 0; i_s < nSettings; i_s++) {
+      if (name.BeginsWith(settings[i_s])) {
+	fingerprint += Form("%s=%s;", name.Data(), record->GetValue());
+	break;
+      }
     }
   }
+  
+  TMD5 md5;
+  md5.Update((const UChar_t*)fingerprint.Data(), fingerprint.Length());
+  md5.Final();
+  return Form("%s/Partials/%s_%s.root", m_outputDir.Data(),
+	      m_sampleName.Data(), md5.AsString());
 }
 
 /**
@@ -248,18 +628,30 @@ TString DMMassPoints::getMassPointsFileName(int cateIndex) {
 
 /**
    -----------------------------------------------------------------------------
-   Get the name of the output textfile for the given category index.
-   @param cateIndex - The index of the category for which we want the .txt name.
+   Get the name of the output binary file for the given category index.
+   @param cateIndex - The index of the category for which we want the name.
    @param newSampleName - The name of the data/MC sample.
-   @return - The full path of the mass points text file.
+   @return - The full path of the mass points binary file.
 */
 TString DMMassPoints::getMassPointsFileName(int cateIndex, TString sampleName) {
-  TString name = Form("%s/%s_%d_%s.txt", m_outputDir.Data(), 
+  TString name = Form("%s/%s_%d_%s.bin", m_outputDir.Data(), 
 		      (m_config->getStr("cateScheme")).Data(),
 		      cateIndex, sampleName.Data());
   return name;
 }
 
+/**
+   -----------------------------------------------------------------------------
+   Get the name of the skim of an input file. The skim keeps the name of the
+   input file, so that the skim tags in the name still apply.
+   @param fileName - The name of the input file.
+   @return - The name of the skim file.
+*/
+TString DMMassPoints::getSkimFileName(TString fileName) {
+  return Form("%s/%s", m_skimDirectory.Data(),
+	      gSystem->BaseName(fileName.Data()));
+}
+
 /**
    -----------------------------------------------------------------------------
    Merge two DMMassPoint objects, essentially combining the datasets. The 
@@ -268,7 +660,7 @@ TString DMMassPoints::getMassPointsFileName(int cateIndex, TString sampleName) {
    categories, the same observables, and both using weighted data.
    @param newSampleName - The name of the data/MC sample.
    @param inputMassPoints - The MassPoints object to merge into this one.
-   @param saveMassPoints - True iff. you want to immediately save to text file.
+   @param saveMassPoints - True iff. you want to immediately save to file.
                            Preferrable to save until last merge is complete.
 */
 void DMMassPoints::mergeMassPoints(TString newSampleName, 
@@ -286,66 +678,145 @@ void DMMassPoints::mergeMassPoints(TString newSampleName,
     // Then add the input datasets:
     m_cateData[i_c]->append(*(inputMassPoints->getCateDataSet(i_c)));
     
-    // Open input and output files:
-    std::ifstream inputFile1;
-    inputFile1.open(getMassPointsFileName(i_c));
-    std::ifstream inputFile2;
-    inputFile2.open(inputMassPoints->getMassPointsFileName(i_c));
-    
-    std::ofstream outputFile;
-    outputFile.open(getMassPointsFileName(i_c, newSampleName));
-    
-    // Then save the output, if requested:
+    // Then save the output, if requested, by concatenating the files:
     if (saveMassPoints) {
-      double currMass; double currWeight;
-      while (!inputFile1.eof()) {
-	inputFile1 >> currMass >> currWeight;
-	outputFile << currMass << " " << currWeight << std::endl;
-      }
-      
-      while (!inputFile2.eof()) {
-	inputFile2 >> currMass >> currWeight;
-	outputFile << currMass << " " << currWeight << std::endl;
+      std::vector<double> masses; std::vector<double> weights;
+      std::vector<double> inputMasses; std::vector<double> inputWeights;
+      if (!readMassPointsFile(getMassPointsFileName(i_c), masses, weights) ||
+	  !readMassPointsFile(inputMassPoints->getMassPointsFileName(i_c),
+			      inputMasses, inputWeights)) {
+	std::cout << "DMMassPoints: Error! Cannot merge mass points files."
+		  << std::endl;
+	exit(0);
       }
-    }  
-    // Close input and output files:
-    inputFile1.close();
-    inputFile2.close();
-    outputFile.close();
+      masses.insert(masses.end(), inputMasses.begin(), inputMasses.end());
+      weights.insert(weights.end(), inputWeights.begin(), inputWeights.end());
+      writeMassPointsFile(getMassPointsFileName(i_c, newSampleName),
+			  newSampleName, i_c, masses, weights);
+    }
   }
   m_sampleName = newSampleName;
 }
 
 /**
    -----------------------------------------------------------------------------
-   Create a new 1D histogram.
+   Create the ALL, PASS and per-category histograms of a new variable.
    @param varName - The name of the quantity in the plot.
    @param nBins - The number of bins.
    @param xMin - The minimum value of the histogram.
    @param xMax - The maximum value of the histogram.
+   @return - The handle of the variable, for use with fillHist1D().
 */
-void DMMassPoints::newHist1D(TString varName, int nBins, double xMin,
-			     double xMax) {
-  // Inclusive histograms:
-  m_hists[Form("%s_ALL",varName.Data())]
-    = new TH1F(Form("%s_ALL",varName.Data()), Form("%s_ALL",varName.Data()),
-	       nBins, xMin, xMax);
-  if (m_isWeighted) m_hists[Form("%s_ALL",varName.Data())]->Sumw2(true);
+int DMMassPoints::newHist1D(TString varName, int nBins, double xMin,
+			    double xMax) {
+  int nCategories = m_config->getInt("nCategories");
+  m_histStride = 2 + nCategories;
   
-  m_hists[Form("%s_PASS",varName.Data())]
-    = new TH1F(Form("%s_PASS",varName.Data()), Form("%s_PASS",varName.Data()),
-	       nBins, xMin, xMax);
-  if (m_isWeighted) m_hists[Form("%s_PASS",varName.Data())]->Sumw2(true);
+  // Inclusive histograms, then categorized histograms:
+  std::vector<TString> keys; keys.clear();
+  keys.push_back(Form("%s_ALL", varName.Data()));
+  keys.push_back(Form("%s_PASS", varName.Data()));
+  for (int i_c = 0; i_c < nCategories; i_c++) {
+    keys.push_back(Form("%s_c%d_PASS", varName.Data(), i_c));
+  }
+  for (int i_k = 0; i_k < (int)keys.size(); i_k++) {
+    TH1F *hist = new TH1F(keys[i_k], keys[i_k], nBins, xMin, xMax);
+    if (m_isWeighted) hist->Sumw2(true);
+    m_hists.push_back(hist);
+    m_histKeys.push_back(keys[i_k]);
+  }
+  return (int)(m_hists.size() / m_histStride) - 1;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Load the partial results of one input file saved by a previous job.
+   @param partial - The (empty) partial results of the file.
+   @param partialName - The name of the partial results file.
+*/
+void DMMassPoints::loadFilePartial(DMMassPointsWorker *partial,
+				   TString partialName) {
+  TFile partialFile(partialName, "READ");
+  TVectorD *counters = (TVectorD*)partialFile.Get("counters");
+  if (!counters) {
+    std::cout << "DMMassPoints: Error! No counters in " << partialName
+	      << std::endl;
+    exit(0);
+  }
+  std::vector<double> values(counters->GetMatrixArray(),
+			     counters->GetMatrixArray() + counters->GetNrows());
+  partial->selector->addCounterValues(values);
+  partial->selector->retrieveCutflowHist(true)
+    ->Add((TH1F*)partialFile.Get("cutFlowWeighted"));
+  partial->selector->retrieveCutflowHist(false)
+    ->Add((TH1F*)partialFile.Get("cutFlowUnweighted"));
   
-  // Categorized histograms:
-  for (int i_c = 0; i_c < m_config->getInt("nCategories"); i_c++) {
-    m_hists[Form("%s_c%d_PASS",varName.Data(),i_c)]
-      = new TH1F(Form("%s_c%d_PASS",varName.Data(),i_c),
-		 Form("%s_c%d_PASS",varName.Data(),i_c),nBins,xMin,xMax);
-    if (m_isWeighted) {
-      m_hists[Form("%s_c%d_PASS",varName.Data(),i_c)]->Sumw2(true);
-    }
+  for (int i_h = 0; i_h < (int)partial->hists.size(); i_h++) {
+    partial->hists[i_h]->Add((TH1F*)partialFile.Get(m_histKeys[i_h]));
   }
+  
+  for (int i_c = 0; i_c < 20; i_c++) {
+    TVectorD *masses = (TVectorD*)partialFile.Get(Form("masses_%d", i_c));
+    TVectorD *weights = (TVectorD*)partialFile.Get(Form("weights_%d", i_c));
+    if (!masses || !weights) continue;
+    const double *massArray = masses->GetMatrixArray();
+    const double *weightArray = weights->GetMatrixArray();
+    partial->masses[i_c].assign(massArray, massArray + masses->GetNrows());
+    partial->weights[i_c].assign(weightArray,
+				 weightArray + weights->GetNrows());
+  }
+  
+  TVectorD *norms = (TVectorD*)partialFile.Get("componentNorms");
+  for (int i_h = 0; norms && i_h < norms->GetNrows(); i_h++) {
+    TH1F *cutFlow = (TH1F*)partialFile.Get(Form("componentCutFlow_%d", i_h));
+    partial->componentCutFlows.push_back((TH1F*)cutFlow->Clone());
+    partial->componentNorms.push_back((*norms)[i_h]);
+  }
+  partialFile.Close();
+  std::cout << "DMMassPoints: Loaded partial results " << partialName
+	    << std::endl;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Save the partial results of one input file, so that later jobs with the same
+   inputs and selection do not need to process the file again.
+   @param partial - The partial results of the file.
+   @param partialName - The name of the partial results file.
+*/
+void DMMassPoints::saveFilePartial(DMMassPointsWorker *partial,
+				   TString partialName) {
+  // Write to a temporary name first, so a failed job leaves no partial file:
+  TString tempName = Form("%s.part", partialName.Data());
+  TFile partialFile(tempName, "RECREATE");
+  std::vector<double> values = partial->selector->getCounterValues();
+  TVectorD counters(values.size(), &values[0]);
+  counters.Write("counters");
+  partial->selector->retrieveCutflowHist(true)->Write("cutFlowWeighted");
+  partial->selector->retrieveCutflowHist(false)->Write("cutFlowUnweighted");
+  
+  for (int i_h = 0; i_h < (int)partial->hists.size(); i_h++) {
+    partial->hists[i_h]->Write(m_histKeys[i_h]);
+  }
+  
+  for (int i_c = 0; i_c < 20; i_c++) {
+    int nPoints = (int)partial->masses[i_c].size();
+    if (nPoints == 0) continue;
+    TVectorD masses(nPoints, &partial->masses[i_c][0]);
+    TVectorD weights(nPoints, &partial->weights[i_c][0]);
+    masses.Write(Form("masses_%d", i_c));
+    weights.Write(Form("weights_%d", i_c));
+  }
+  
+  int nComponents = (int)partial->componentNorms.size();
+  TVectorD norms(nComponents);
+  for (int i_h = 0; i_h < nComponents; i_h++) {
+    partial->componentCutFlows[i_h]->Write(Form("componentCutFlow_%d", i_h));
+    norms[i_h] = partial->componentNorms[i_h];
+  }
+  norms.Write("componentNorms");
+  partialFile.Close();
+  gSystem->Rename(tempName, partialName);
 }
 
 /**
@@ -356,10 +827,7 @@ void DMMassPoints::saveHists() {
   TFile *outputFile = new TFile(Form("%s/hists_%s.root", m_outputDir.Data(),
 				     m_sampleName.Data()), "RECREATE");
   // Loop over the saved histograms:
-  std::map<TString,TH1F*>::iterator histIter;
-  for (histIter = m_hists.begin(); histIter != m_hists.end(); histIter++) {
-    histIter->second->Write();
-  }
+  for (int i_h = 0; i_h < (int)m_hists.size(); i_h++) m_hists[i_h]->Write();
   // Also save the cutflow hist to this file:
   m_cutFlowHist->Write();
 
@@ -367,6 +835,53 @@ void DMMassPoints::saveHists() {
   delete outputFile;
 }
 
+/**
+   -----------------------------------------------------------------------------
+   Start the background copies of the input files. The files are copied in 
+   turn for each worker, so that all workers get their first files early. The
+   worker ranges are aligned to the files, so each copy has a single user and
+   is deleted as soon as that worker releases it.
+   @param workers - The workers of the event loop, with their entry ranges.
+*/
+void DMMassPoints::scheduleLocalFiles(std::vector<DMMassPointsWorker*>
+				      workers) {
+  int nFiles = m_prefetcher->nFiles();
+  Long64_t *treeOffsets = workers[0]->chain->GetTreeOffset();
+  
+  // The files needed by each worker, in the order it reads them:
+  std::vector<int> nUsers; nUsers.assign(nFiles, 0);
+  std::vector<std::vector<int> > workerFiles; workerFiles.clear();
+  int maxWorkerFiles = 0;
+  for (int i_w = 0; i_w < (int)workers.size(); i_w++) {
+    std::vector<int> currFiles; currFiles.clear();
+    for (int i_f = 0; i_f < nFiles; i_f++) {
+      if (treeOffsets[i_f] < workers[i_w]->lastEntry &&
+	  treeOffsets[i_f+1] > workers[i_w]->firstEntry) {
+	currFiles.push_back(i_f);
+	nUsers[i_f]++;
+      }
+    }
+    workerFiles.push_back(currFiles);
+    if ((int)currFiles.size() > maxWorkerFiles) {
+      maxWorkerFiles = (int)currFiles.size();
+    }
+  }
+  
+  // Interleave the workers, copying each file only once:
+  std::vector<int> copyOrder; copyOrder.clear();
+  std::vector<bool> isScheduled; isScheduled.assign(nFiles, false);
+  for (int i_f = 0; i_f < maxWorkerFiles; i_f++) {
+    for (int i_w = 0; i_w < (int)workers.size(); i_w++) {
+      if (i_f >= (int)workerFiles[i_w].size()) continue;
+      int fileIndex = workerFiles[i_w][i_f];
+      if (isScheduled[fileIndex]) continue;
+      copyOrder.push_back(fileIndex);
+      isScheduled[fileIndex] = true;
+    }
+  }
+  m_prefetcher->start(copyOrder, nUsers);
+}
+
 /**
    -----------------------------------------------------------------------------
    Set the pointer to the observable. 
@@ -379,7 +894,10 @@ void DMMassPoints::setMassObservable(RooRealVar *newObservable) {
 
 /**
    -----------------------------------------------------------------------------
-   Create new mass points by looping over the TTree.
+   Create new mass points by looping over the TTree. The loop can be split 
+   across several threads (config setting "MassPointThreads"), each of which
+   processes a contiguous range of entries. The worker results are merged in
+   order of their entry ranges, so outputs do not depend on thread timing.
    @return - void.
 */
 void DMMassPoints::createNewMassPoints() {
@@ -394,207 +912,321 @@ void DMMassPoints::createNewMassPoints() {
   TString listName
     = DMAnalysis::nameToFileList(m_config, m_sampleName, getSystematics);
   
-  // If option says copy files, make local file copies and then run:
-  if (m_options.Contains("CopyFile")) {
-    listName = createLocalFilesAndList(listName);
-  }
   TChain *chain = CommonFunc::MakeChain("CollectionTree", listName, "badfile");
-  DMTree *dmt = new DMTree(chain, systList);
   
-  // Tool to implement the cutflow, categorization, and counting. 
-  DMEvtSelect *selector = new DMEvtSelect(dmt, m_configFileName);
+  // The object branches that the workers read:
+  int objectBranches = requiredObjects();
   
-  // Also instantiate tools with systematics:
-  std::map<TString, DMEvtSelect*> sysSelectors; sysSelectors.clear();
-  if (getSystematics) {
-    for (int i_s = 0; i_s < (int)systList.size(); i_s++) {
-      sysSelectors[systList[i_s]] = new DMEvtSelect(dmt, m_configFileName);
-      sysSelectors[systList[i_s]]->setSysVariation(systList[i_s]);
+  // Read the skims made by a previous job instead of the full MxAODs:
+  if (m_options.Contains("FromSkim")) {
+    chain = createSkimChain(chain, systList, objectBranches);
+  }
+  
+  // Index the metadata of the files, which is read when first needed:
+  TObjArray *chainFiles = chain->GetListOfFiles();
+  std::vector<TString> fileNames; fileNames.clear();
+  m_chainFileIndices.clear();
+  for (int i_f = 0; i_f < chainFiles->GetEntries(); i_f++) {
+    fileNames.push_back(chainFiles->At(i_f)->GetTitle());
+    m_chainFileIndices.push_back(i_f);
+  }
+  m_xAODIndex = new DMxAODIndex(fileNames, m_config);
+  
+  // With the "Incremental" option, only process files without saved results
+  // (and, with "WriteSkim", with a skim of the variations of this job):
+  m_incremental = m_options.Contains("Incremental");
+  m_writeSkim = m_options.Contains("WriteSkim");
+  std::vector<TString> partialNames; partialNames.clear();
+  std::vector<bool> hasPartial; hasPartial.clear();
+  if (m_incremental) {
+    system(Form("mkdir -vp %s/Partials", m_outputDir.Data()));
+    
+    // Files that did not change are identified without opening them:
+    m_xAODIndex->setUUIDCache(Form("%s/Partials/fileUUIDs.txt",
+				   m_outputDir.Data()));
+    TChain *newChain = new TChain(chain->GetName());
+    m_chainFileIndices.clear();
+    for (int i_f = 0; i_f < chainFiles->GetEntries(); i_f++) {
+      TChainElement *element = (TChainElement*)chainFiles->At(i_f);
+      partialNames.push_back(getPartialFileName(i_f, element->GetEntries(),
+						getSystematics));
+      hasPartial.push_back(false);
+      if (!gSystem->AccessPathName(partialNames[i_f])) {
+	TFile partialFile(partialNames[i_f], "READ");
+	hasPartial[i_f] = (!partialFile.IsZombie() &&
+			   partialFile.Get("counters") != NULL);
+	partialFile.Close();
+      }
+      if (hasPartial[i_f] && m_writeSkim &&
+	  !DMAnalysis::skimHasBranches(getSkimFileName(element->GetTitle()),
+				       systList, objectBranches)) {
+	hasPartial[i_f] = false;
+      }
+      if (!hasPartial[i_f]) {
+	newChain->AddFile(element->GetTitle(), element->GetEntries());
+	m_chainFileIndices.push_back(i_f);
+      }
     }
+    m_xAODIndex->saveUUIDCache();
+    std::cout << "DMMassPoints: " << m_chainFileIndices.size() << " of "
+	      << chainFiles->GetEntries() << " files must be processed."
+	      << std::endl;
+    delete chain;
+    chain = newChain;
   }
   
-  // For updating the nTotalEventsInFile:
-  TString currFileName = "";
-  double nTotalEventsInFile = 0.0;
-
-  std::map<string,RooDataSet*> dataMap;
-  dataMap.clear();
+  // If option says copy files, read local copies made during the loop:
+  if (m_options.Contains("CopyFile")) chain = createLocalChain(chain);
+  Long64_t entries = chain->GetEntries();
   
-  RooRealVar wt("wt","wt",1);
-  RooArgSet *args = new RooArgSet();
-  args->add(*m_yy);
+  // Settings that are constant throughout the event loop:
+  std::vector<TString> mxAODCutList = m_config->getStrV("MxAODCutList");
+  m_nMxAODCuts = (int)mxAODCutList.size();
+  
+  // Write skims with the events that pass the "SkimMxAODCut" cut:
+  if (m_writeSkim) {
+    TString skimCut = m_config->getStr("SkimMxAODCut", TString("DiphotonMass"));
+    m_skimCutIndex = -1;
+    for (int i_c = 0; i_c < m_nMxAODCuts; i_c++) {
+      if (mxAODCutList[i_c].EqualTo(skimCut)) m_skimCutIndex = i_c;
+    }
+    if (m_skimCutIndex < 0) {
+      std::cout << "DMMassPoints: Error! Skim cut " << skimCut
+		<< " is not in MxAODCutList." << std::endl;
+      exit(0);
+    }
+    system(Form("mkdir -vp %s", m_skimDirectory.Data()));
+  }
+  m_sampleBR = DMAnalysis::isDMSample(m_config, m_sampleName) ?
+    m_config->getNum("BranchingRatioHyy") : 1.0;
+  
+  // Read settings for the input chain (the branches are set by each worker):
+  m_readProfile.cacheSize
+    = (Long64_t)(m_config->getNum("TreeCacheSize", 30.0) * 1048576);
+  m_readProfile.learnEntries = m_config->getInt("TreeCacheLearnEntries", 0);
+  m_readProfile.asyncPrefetch
+    = m_config->getBool("TreeCacheAsyncPrefetch", false);
+  m_readProfile.branches.clear();
+  
+  // Number of threads to use for the event loop:
+  int nThreads = m_config->getInt("MassPointThreads", 1);
+  if (nThreads < 1) nThreads = 1;
+  if ((Long64_t)nThreads > entries) nThreads = (entries > 1) ? (int)entries : 1;
+  if (nThreads > 1 || m_incremental) {
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,6,0)
+    ROOT::EnableThreadSafety();
+#else
+    TThread::Initialize();
+#endif
+    // Histograms must not be owned by the files opened in the threads or
+    // by the files holding the per-file results:
+    TH1::AddDirectory(kFALSE);
+  }
   
   // Define histograms to save:
-  newHist1D("pTyy", 25, 0.0, 500.0);
-  newHist1D("ETMiss", 20, 0.0, 400.0);
-  newHist1D("ratioETMisspTyy", 20, 0.0, 4.0);
-  newHist1D("aTanRatio", 20, 0.0, TMath::Pi()/2.0);
-  newHist1D("myy", 20, 105.0, 160.0);
-  newHist1D("sumSqrtETMisspTyy", 20, 0.0, 600);
-  //newHist1D("dPhiyyETMiss", 20, 0.0, TMath::Pi());
-  newHist1D("njets", 8, 0, 8);
-  newHist1D("nleptons", 5, 0, 5);
+  bookHists();
+  
+  // Create the workers, each with its own tree, selectors and histograms:
+  std::vector<DMMassPointsWorker*> workers; workers.clear();
+  for (int i_w = 0; i_w < nThreads; i_w++) {
+    DMMassPointsWorker *worker = new DMMassPointsWorker();
+    worker->massPoints = this;
+    worker->index = i_w;
+    worker->firstEntry = (entries * i_w) / nThreads;
+    worker->lastEntry = (entries * (i_w + 1)) / nThreads;
+    
+    // Results per file (and skims) require that each file is read by a
+    // single worker. So do the local copies, which would otherwise stay in
+    // the cache until both workers sharing a file are done with it:
+    if (m_incremental || m_writeSkim || m_prefetcher) {
+      worker->firstEntry = (i_w == 0) ? 0 : workers[i_w-1]->lastEntry;
+      worker->lastEntry = entries;
+      Long64_t *treeOffsets = chain->GetTreeOffset();
+      for (int i_f = 0; i_w < nThreads-1 && i_f < chain->GetNtrees(); i_f++) {
+	if (treeOffsets[i_f+1] >= (entries * (i_w + 1)) / nThreads) {
+	  worker->lastEntry = treeOffsets[i_f+1];
+	  break;
+	}
+      }
+    }
+    worker->cacheStats.hits = 0.0;
+    worker->cacheStats.entries = 0.0;
+    worker->skimFile = NULL;
+    worker->skimTree = NULL;
+    worker->skimIndex = -1;
+    worker->chain = (i_w == 0) ? chain : cloneChain(chain);
+    worker->tree = new DMTree(worker->chain, systList);
+    worker->tree->requireObjects(objectBranches);
+    
+    // Tool to implement the cutflow, categorization, and counting. The
+    // systematic variations are evaluated by the same tool, in one pass:
+    worker->selector = new DMEvtSelect(worker->tree, m_configFileName);
+    worker->selector->setSysVariationList(systList);
+    
+    // A single worker fills the output histograms directly:
+    for (int i_h = 0; i_h < (int)m_hists.size(); i_h++) {
+      if (nThreads == 1 && !m_incremental) {
+	worker->hists.push_back(m_hists[i_h]);
+      }
+      else {
+	worker->hists.push_back((TH1F*)m_hists[i_h]
+	  ->Clone(Form("%s_worker%d", m_histKeys[i_h].Data(), i_w)));
+      }
+    }
+    workers.push_back(worker);
+  }
+  
+  // Start copying the files in the order that the workers need them:
+  if (m_prefetcher) scheduleLocalFiles(workers);
+  
+  // Create the per-file results, loading those that were saved previously:
+  m_filePartials.clear();
+  if (m_incremental) {
+    for (int i_f = 0; i_f < (int)partialNames.size(); i_f++) {
+      DMMassPointsWorker *partial = new DMMassPointsWorker();
+      partial->massPoints = this;
+      partial->index = i_f;
+      partial->tree = workers[0]->tree;
+      partial->selector = new DMEvtSelect(partial->tree, m_configFileName);
+      partial->selector->setSysVariationList(systList);
+      for (int i_h = 0; i_h < (int)m_hists.size(); i_h++) {
+	partial->hists.push_back((TH1F*)m_hists[i_h]
+	  ->Clone(Form("%s_file%d", m_histKeys[i_h].Data(), i_f)));
+      }
+      if (hasPartial[i_f]) loadFilePartial(partial, partialNames[i_f]);
+      m_filePartials.push_back(partial);
+    }
+  }
+  
+  // Loop over the input DMTree:
+  CommonFunc::ResetReadStats();
+  std::cout << "DMMassPoints: Loop over DMTree with " << entries
+	    << " entries using " << nThreads << " thread(s)." << std::endl;
+  if (nThreads == 1) processEntries(workers[0]);
+  else {
+    std::vector<TThread*> threads; threads.clear();
+    for (int i_w = 0; i_w < nThreads; i_w++) {
+      threads.push_back(new TThread(Form("DMMassPoints_%d", i_w),
+				    DMMassPoints::processEntriesThread,
+				    (void*)workers[i_w]));
+      threads[i_w]->Run();
+    }
+    for (int i_w = 0; i_w < nThreads; i_w++) {
+      threads[i_w]->Join();
+      delete threads[i_w];
+    }
+  }
+  std::cout << "DMMassPoints: End of loop over input DMTree." << std::endl;
+  
+  // Report the reads from the input files:
+  CommonFunc::CacheStats cacheStats;
+  cacheStats.hits = 0.0;
+  cacheStats.entries = 0.0;
+  for (int i_w = 0; i_w < nThreads; i_w++) {
+    cacheStats.hits += workers[i_w]->cacheStats.hits;
+    cacheStats.entries += workers[i_w]->cacheStats.entries;
+  }
+  CommonFunc::PrintReadStats("DMMassPoints",
+			     CommonFunc::CacheHitRate(cacheStats));
+  
+  // Remove the remaining local copies of the input files:
+  if (m_prefetcher) {
+    delete m_prefetcher;
+    m_prefetcher = NULL;
+  }
+  
+  // Files without events (e.g. skims in which no event passed the skim cut)
+  // are never loaded in the loop, but their cutflows are still counted:
+  TObjArray *loopFiles = chain->GetListOfFiles();
+  for (int i_f = 0; i_f < loopFiles->GetEntries(); i_f++) {
+    if (((TChainElement*)loopFiles->At(i_f))->GetEntries() > 0) continue;
+    int fileIndex = m_chainFileIndices[i_f];
+    addFileCutFlow(m_incremental ? m_filePartials[fileIndex] : workers[0],
+		   fileIndex);
+  }
+  
+  // Save the results of the files that were processed in this job:
+  if (m_incremental) {
+    for (int i_f = 0; i_f < (int)m_chainFileIndices.size(); i_f++) {
+      int fileIndex = m_chainFileIndices[i_f];
+      saveFilePartial(m_filePartials[fileIndex], partialNames[fileIndex]);
+    }
+  }
+  
+  // Merge the results in order of their entry ranges (or files):
+  std::vector<DMMassPointsWorker*> results
+    = m_incremental ? m_filePartials : workers;
+  DMEvtSelect *selector = workers[0]->selector;
+  for (int i_r = 0; i_r < (int)results.size(); i_r++) {
+    if (results[i_r]->selector != selector) {
+      selector->addCounters(results[i_r]->selector);
+    }
+    if (nThreads > 1 || m_incremental) {
+      for (int i_h = 0; i_h < (int)m_hists.size(); i_h++) {
+	m_hists[i_h]->Add(results[i_r]->hists[i_h]);
+      }
+    }
+    for (int i_h = 0; i_h < (int)results[i_r]->componentCutFlows.size(); i_h++){
+      m_componentCutFlows.push_back(results[i_r]->componentCutFlows[i_h]);
+      m_componentNorms.push_back(results[i_r]->componentNorms[i_h]);
+    }
+  }
   
   // Define datasets and mass files in loop over categories:
-  std::ofstream massFiles[20];
+  RooRealVar wt("wt","wt",1);
   std::cout << "DMMassPoints: Define datasets & files." << std::endl;
   for (int i_c = 0; i_c < m_config->getInt("nCategories"); i_c++) {
-    
-    massFiles[i_c].open(getMassPointsFileName(i_c));
-    
     if (m_isWeighted) {
-      args->add(wt);
       m_cateData[i_c]
 	= new RooDataSet(Form("%s_%s_%d", m_sampleName.Data(),
-			      (m_config->getStr("cateScheme")).Data(), i_c),
+			      m_cateScheme.Data(), i_c),
 			 Form("%s_%s_%d", m_sampleName.Data(),
-			      (m_config->getStr("cateScheme")).Data(), i_c),
+			      m_cateScheme.Data(), i_c),
 			 RooArgSet(*m_yy, wt), RooFit::WeightVar(wt)); 
     }
     else {
       m_cateData[i_c]
 	= new RooDataSet(Form("%s_%s_%d", m_sampleName.Data(),
-			      (m_config->getStr("cateScheme")).Data(), i_c),
+			      m_cateScheme.Data(), i_c),
 			 Form("%s_%s_%d", m_sampleName.Data(),
-			      (m_config->getStr("cateScheme")).Data(), i_c),
+			      m_cateScheme.Data(), i_c),
 			 *m_yy);
     }
-    dataMap[Form("%s_%d",(m_config->getStr("cateScheme")).Data(),i_c)]
-      = m_cateData[i_c];
-  }
-  
-  // Loop over the input DMTree:
-  Long64_t entries = dmt->fChain->GetEntries();
-  std::cout << "DMMassPoints: Loop over DMTree with " << entries
-	    << " entries." << std::endl;
-  for (Long64_t event = 0; event < entries; event++) {
-  
-    // Load event and print the progress bar:
-    dmt->fChain->GetEntry(event);
-    printProgressBar(event, entries);
     
-    // Check if this is a new file (which requires a different overall norm:
-    if (!currFileName.EqualTo(chain->GetFile()->GetName())) {
-      currFileName = chain->GetFile()->GetName();
-      std::cout << "DMMassPoints: Switch to file : " << currFileName
-		<< std::endl;
-      // Tool to get the total number of events at the generator level.
-      DMxAODCutflow *dmx = new DMxAODCutflow(currFileName, m_configFileName);
-      nTotalEventsInFile = dmx->nTotalEventsInFile();
-            
-      // Then also get the cutflow histogram:
-      double currNorm = 1.00000000;
-      TH1F* currHist = (TH1F*)dmx->getHist()->Clone();
-      if (m_isWeighted) {
-	// Normalization of inputs to 1 fb-1:
-	currNorm
-	  = (1000.0 * 	   
-	     dmt->HGamEventInfoAuxDyn_crossSectionBRfilterEff["Nominal"] /
-	     nTotalEventsInFile);
-	
-	// Add branching ratio for DM samples:
-	if (DMAnalysis::isDMSample(m_config, m_sampleName)) {
-	  currNorm *= m_config->getNum("BranchingRatioHyy");
-	}
-      }
-      
-      m_componentCutFlows.push_back(currHist);
-      m_componentNorms.push_back(currNorm);
+    // Collect the mass points of the workers (or files) in order:
+    std::vector<double> masses; masses.clear();
+    std::vector<double> weights; weights.clear();
+    for (int i_r = 0; i_r < (int)results.size(); i_r++) {
+      masses.insert(masses.end(), results[i_r]->masses[i_c].begin(),
+		    results[i_r]->masses[i_c].end());
+      weights.insert(weights.end(), results[i_r]->weights[i_c].begin(),
+		     results[i_r]->weights[i_c].end());
     }
-        
-    // Calculate the weights for the cutflow first!
-    double evtWeight = 1.00000000;
-    if (m_isWeighted) {
-      // Normalization of inputs to 1 fb-1:
-      evtWeight = (1000.0 * 
-		   dmt->HGamEventInfoAuxDyn_crossSectionBRfilterEff["Nominal"] *
-		   dmt->HGamEventInfoAuxDyn_weight["Nominal"] / 
-		   nTotalEventsInFile);
-      
-      // Also add in branching ratio for DM samples:
-      if (DMAnalysis::isDMSample(m_config, m_sampleName)) {
-	evtWeight *= m_config->getNum("BranchingRatioHyy");
-      }
-    }
-        
-    // The mass parameter:
-    double invariantMass = dmt->HGamEventInfoAuxDyn_m_yy["Nominal"] / 1000.0;
-    std::vector<float> elPt = *dmt->HGamElectronsAuxDyn_pt;
-    std::vector<float> muPt = *dmt->HGamMuonsAuxDyn_pt;
-    int nLeptons = (int)(elPt.size() + muPt.size());
-        
-    // Then commence plotting for events passing inclusive H->yy selection:
-    double varEtMiss = dmt->HGamEventInfoAuxDyn_TST_met["Nominal"] / 1000.0;
-    double varPtYY = dmt->HGamEventInfoAuxDyn_pT_yy["Nominal"] / 1000.0;
-    int nJets = dmt->HGamEventInfoAuxDyn_Njets["Nominal"];
     
-    if (dmt->HGamEventInfoAuxDyn_cutFlow["Nominal"] >= 
-	(int)m_config->getStrV("MxAODCutList").size()) {
-      fillHist1D("pTyy", true, varPtYY, evtWeight, -1);
-      fillHist1D("ETMiss", true, varEtMiss, evtWeight, -1);
-      fillHist1D("ratioETMisspTyy", true, (varEtMiss / varPtYY), evtWeight, -1);
-      fillHist1D("sumSqrtETMisspTyy", true,
-		 sqrt(varEtMiss*varEtMiss+varPtYY*varPtYY), evtWeight, -1);
-      fillHist1D("aTanRatio",true,TMath::ATan(varEtMiss/varPtYY),evtWeight,-1);
-      fillHist1D("myy", true, invariantMass, evtWeight, -1);
-      fillHist1D("njets", true, nJets, evtWeight, -1);
-      fillHist1D("nleptons", true, nLeptons, evtWeight, -1);
-    }
-    
-    // For systematic variations of the selection:
-    if (getSystematics) {
-      for (int i_s = 0; i_s < (int)systList.size(); i_s++) {
-	if (sysSelectors[systList[i_s]]->passesCut("AllCuts", evtWeight)) {
-	  sysSelectors[systList[i_s]]
-	    ->getCategoryNumber(m_config->getStr("cateScheme"), evtWeight);
-	}
+    // Fill the datasets and write the mass points to file:
+    for (int i_e = 0; i_e < (int)masses.size(); i_e++) {
+      m_yy->setVal(masses[i_e]);
+      if (m_isWeighted) {
+	wt.setVal(weights[i_e]);
+	m_cateData[i_c]->add(RooArgSet(*m_yy,wt), weights[i_e]);
       }
+      else m_cateData[i_c]->add(*m_yy);
     }
-    
-    // Make sure events pass the selection:
-    if (!selector->passesCut("AllCuts", evtWeight)) continue;
-    
-    // Save the categories:
-    int currCate = selector->getCategoryNumber(m_config->getStr("cateScheme"),
-					       evtWeight);
-    
-    // Fill the datasets:
-    m_yy->setVal(invariantMass);
-    if (m_isWeighted) {
-      wt.setVal(evtWeight);
-      m_cateData[currCate]->add(RooArgSet(*m_yy,wt), evtWeight);
-    }
-    else m_cateData[currCate]->add(*m_yy);
-    
-    // Write mass point to file:
-    massFiles[currCate] << invariantMass << " " << evtWeight << std::endl;
-        
-    // Then commence plotting for PASSING events:
-    fillHist1D("pTyy", false, varPtYY, evtWeight, currCate);
-    fillHist1D("ETMiss", false, varEtMiss, evtWeight, currCate);
-    fillHist1D("ratioETMisspTyy", false,(varEtMiss/varPtYY),evtWeight,currCate);
-    fillHist1D("sumSqrtETMisspTyy", false, 
-	       sqrt(varEtMiss*varEtMiss+varPtYY*varPtYY), evtWeight, currCate);
-    fillHist1D("aTanRatio", false, TMath::ATan(varEtMiss/varPtYY), 
-	       evtWeight, currCate);
-    fillHist1D("myy", false, invariantMass, evtWeight, currCate);
-    fillHist1D("njets", false, nJets, evtWeight, currCate);
-    fillHist1D("nleptons", false, nLeptons, evtWeight, -1);
+    writeMassPointsFile(getMassPointsFileName(i_c), m_sampleName, i_c,
+			masses, weights);
   }
-  std::cout << "DMMassPoints: End of loop over input DMTree." << std::endl;
   
   // For systematic variations of the selection:
   if (getSystematics) {
     for (int i_s = 0; i_s < (int)systList.size(); i_s++) {
-      sysSelectors[systList[i_s]]
-	->saveCutflow(Form("%s/Systematics/cutflow_%s_%s.txt",
-			   m_outputDir.Data(), systList[i_s].Data(),
-			   m_sampleName.Data()), m_isWeighted);
-      sysSelectors[systList[i_s]]
-	->saveCategorization(Form("%s/Systematics/categorization_%s_%s_%s.txt",
-				  m_outputDir.Data(), systList[i_s].Data(),
-				  (m_config->getStr("cateScheme")).Data(),
-				  m_sampleName.Data()), m_isWeighted);
+      selector->saveSysCutflow(i_s, Form("%s/Systematics/cutflow_%s_%s.txt",
+					 m_outputDir.Data(),
+					 systList[i_s].Data(),
+					 m_sampleName.Data()), m_isWeighted);
+      selector->saveSysCategorization
+	(i_s, Form("%s/Systematics/categorization_%s_%s_%s.txt",
+		   m_outputDir.Data(), systList[i_s].Data(),
+		   m_cateScheme.Data(), m_sampleName.Data()), m_isWeighted);
     }
   }
   
@@ -604,37 +1236,48 @@ void DMMassPoints::createNewMassPoints() {
   selector->saveCutflow(Form("%s/cutflow_%s.txt", m_outputDir.Data(),
 			     m_sampleName.Data()), m_isWeighted);
   selector->saveCategorization(Form("%s/categorization_%s_%s.txt",
-				    m_outputDir.Data(),
-				    (m_config->getStr("cateScheme")).Data(),
+				    m_outputDir.Data(), m_cateScheme.Data(),
 				    m_sampleName.Data()), m_isWeighted);
   
   // Then retrieve the cutflow hist and save it:
   m_cutFlowHist = selector->retrieveCutflowHist(m_isWeighted);
   combineCutFlowHists();
   
-  // Close output mass point files.
-  for (int i_f = 0; i_f < m_config->getInt("nCategories"); i_f++) {
-    massFiles[i_f].close();
-  }
-  
-  // If options said to run locally, remove the files.
-  if (m_options.Contains("CopyFile")) removeLocalFilesAndList(listName);
-
   // Finally, save the histograms (including variables and cutflow) to file:
   saveHists();
   
+  // Clean up the per-file results and the workers (the cutflow histogram of
+  // worker 0 is kept):
+  for (int i_f = 0; i_f < (int)m_filePartials.size(); i_f++) {
+    for (int i_h = 0; i_h < (int)m_filePartials[i_f]->hists.size(); i_h++) {
+      delete m_filePartials[i_f]->hists[i_h];
+    }
+    delete m_filePartials[i_f]->selector;
+    delete m_filePartials[i_f];
+  }
+  m_filePartials.clear();
+  delete m_xAODIndex;
+  m_xAODIndex = NULL;
+  for (int i_w = 0; i_w < nThreads; i_w++) {
+    if (i_w > 0) {
+      delete workers[i_w]->selector;
+      delete workers[i_w]->chain;
+    }
+    delete workers[i_w]->tree;
+    delete workers[i_w];
+  }
+  
   std::cout << "DMMassPoints: Finished creating new mass points!" << std::endl;
-  delete selector;
 }
 
 /**
    -----------------------------------------------------------------------------
-   Load the mass points from text files that have already been produced. This is
-   much faster than producing mass points from scratch, and is preferred. 
+   Load the mass points from binary files that have already been produced. This
+   is much faster than producing mass points from scratch, and is preferred. 
    @return - void.
 */
 void DMMassPoints::loadMassPointsFromFile() {
-  std::cout << "DMMassPoints: loading mass points from .txt file." << std::endl;
+  std::cout << "DMMassPoints: loading mass points from .bin file." << std::endl;
   if (m_isWeighted) std::cout << "\tMass points will be weighted." << std::endl;
   else std::cout << "\tMass points will be un-weighted." << std::endl;
 
@@ -664,22 +1307,21 @@ void DMMassPoints::loadMassPointsFromFile() {
 			 *m_yy);
     }
     
-    double readMass; double readWeight;
-    std::ifstream massFile(getMassPointsFileName(i_c));
+    std::vector<double> masses; std::vector<double> weights;
     std::cout << "DMMassPoints: opening " << getMassPointsFileName(i_c)
 	      << std::endl;
     
     // First check that file exists. If it does not, we need to create inputs.
-    if (!massFile) {
+    if (!readMassPointsFile(getMassPointsFileName(i_c), masses, weights)) {
       std::cout << "DMMassPoints: Error! Cannot load from file." << std::endl;
       createNewMassPoints();
       return;
     }
-    while (massFile >> readMass >> readWeight) {
-      m_yy->setVal(readMass);
+    for (int i_e = 0; i_e < (int)masses.size(); i_e++) {
+      m_yy->setVal(masses[i_e]);
       if (m_isWeighted) {
-	wt.setVal(readWeight);
-	m_cateData[i_c]->add(RooArgSet(*m_yy, wt), readWeight);
+	wt.setVal(weights[i_e]);
+	m_cateData[i_c]->add(RooArgSet(*m_yy, wt), weights[i_e]);
       }
       else {
 	m_cateData[i_c]->add(*m_yy);
@@ -695,6 +1337,37 @@ void DMMassPoints::loadMassPointsFromFile() {
   std::cout << "DMMassPoints: Finished loading data set. " << std::endl;
 }
 
+/**
+   -----------------------------------------------------------------------------
+   Start the skim of an input file. The skim holds only the branches that are
+   bound by the DMTree. It is filled in input order into a temporary file,
+   which closeSkimFile() completes once the input file is done.
+   @param worker - The worker that fills the skim.
+   @param fileIndex - The index of the input file in the metadata index.
+*/
+void DMMassPoints::openSkimFile(DMMassPointsWorker *worker, int fileIndex) {
+  TString skimName = getSkimFileName(m_xAODIndex->getFileName(fileIndex));
+  worker->skimFile = new TFile(Form("%s.part", skimName.Data()), "RECREATE");
+  worker->skimIndex = fileIndex;
+  
+  // Only the active branches (those bound by the DMTree) are cloned:
+  worker->skimTree = worker->chain->GetTree()->CloneTree(0);
+  worker->skimTree->SetDirectory(worker->skimFile);
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Check whether a variable is plotted in the event loop.
+   @param varID - The DMHistVariable of the variable.
+   @return - True iff the variable was booked from "HistVariables".
+*/
+bool DMMassPoints::plotsVariable(int varID) {
+  for (int i_h = 0; i_h < (int)m_histVariables.size(); i_h++) {
+    if (m_histVariables[i_h] == varID) return true;
+  }
+  return false;
+}
+
 /**
    -----------------------------------------------------------------------------
    Prints a progress bar to screen to provide elapsed time and remaining time
@@ -717,6 +1390,244 @@ void DMMassPoints::printProgressBar(int index, int total) {
   }
 }
 
+/**
+   -----------------------------------------------------------------------------
+   Loop over a range of entries in the input chain. All results are stored in 
+   the worker, which must not share any objects with the other workers.
+   @param worker - The worker holding the entry range, tree and outputs.
+*/
+void DMMassPoints::processEntries(DMMassPointsWorker *worker) {
+  DMTree *dmt = worker->tree;
+  TChain *chain = worker->chain;
+  
+  // For updating the nTotalEventsInFile (from the metadata index):
+  int currTreeNumber = -1;
+  int currIndexedFile = -1;
+  double nTotalEventsInFile = 0.0;
+  
+  // The selection is applied using the integer cut ID:
+  int allCutsID = worker->selector->cutIndex("AllCuts");
+  
+  // The leptons are only read by the selection or for their histogram:
+  bool plotNLeptons = plotsVariable(kHistNLeptons);
+  
+  // With local copies, each file must be acquired before it is read:
+  Long64_t *treeOffsets = chain->GetTreeOffset();
+  int currFileIndex = -1;
+  
+  // Measure the event processing rate:
+  TStopwatch timer;
+  timer.Start();
+  
+  for (Long64_t event = worker->firstEntry; event < worker->lastEntry; event++){
+    
+    // Wait for the local copy when moving to a new file:
+    if (m_prefetcher) {
+      int fileIndex = (currFileIndex < 0) ? 0 : currFileIndex;
+      while (event >= treeOffsets[fileIndex+1]) fileIndex++;
+      if (fileIndex != currFileIndex) {
+	if (currFileIndex >= 0) m_prefetcher->releaseFile(currFileIndex);
+	m_prefetcher->acquireFile(fileIndex);
+	currFileIndex = fileIndex;
+      }
+    }
+    
+    // Set up the read cache once the first file is loaded, with the branches
+    // that are bound by the DMTree:
+    if (event == worker->firstEntry) {
+      chain->LoadTree(event);
+      CommonFunc::ReadProfile profile = m_readProfile;
+      profile.branches = dmt->m_activeBranches;
+      CommonFunc::SetReadProfile(chain, profile);
+    }
+    
+    // Load event and print the progress bar (first worker only):
+    chain->GetEntry(event);
+    if (worker->index == 0) {
+      printProgressBar(event - worker->firstEntry,
+		       worker->lastEntry - worker->firstEntry);
+    }
+    
+    // Check if this is a new file (which requires a different overall norm:
+    if (chain->GetTreeNumber() != currTreeNumber) {
+      currTreeNumber = chain->GetTreeNumber();
+      std::cout << "DMMassPoints: Switch to file : "
+		<< chain->GetFile()->GetName() << std::endl;
+      
+      // With the "Incremental" option, results are collected per input file:
+      if (m_incremental && currIndexedFile >= 0) {
+	flushFilePartial(worker, currIndexedFile);
+      }
+      currIndexedFile = m_chainFileIndices[currTreeNumber];
+      
+      // Each input file has its own skim:
+      if (m_writeSkim) {
+	closeSkimFile(worker);
+	openSkimFile(worker, currIndexedFile);
+      }
+      
+      // The total number of events at the generator level, from the index:
+      nTotalEventsInFile = m_xAODIndex->nTotalEventsInFile(currIndexedFile);
+      
+      // The cutflow of a file is only stored by the worker with its 1st entry:
+      if (treeOffsets[currTreeNumber] == event) {
+	addFileCutFlow(worker, currIndexedFile);
+      }
+    }
+    
+    // Keep the event in the skim if any variation passes the skim cut:
+    if (m_writeSkim) {
+      for (int i_s = 0; i_s < dmt->m_nSys; i_s++) {
+	if (dmt->HGamEventInfoAuxDyn_cutFlow[i_s] > m_skimCutIndex) {
+	  worker->skimTree->Fill();
+	  break;
+	}
+      }
+    }
+    
+    // Calculate the weights for the cutflow first!
+    double evtWeight = 1.00000000;
+    if (m_isWeighted) {
+      // Normalization of inputs to 1 fb-1 (and BR for DM samples):
+      evtWeight = (1000.0 * 
+		   dmt->HGamEventInfoAuxDyn_crossSectionBRfilterEff *
+		   dmt->HGamEventInfoAuxDyn_weight / 
+		   nTotalEventsInFile) * m_sampleBR;
+    }
+    
+    // The mass parameter:
+    double invariantMass = dmt->HGamEventInfoAuxDyn_m_yy[0] / 1000.0;
+    int nLeptons = plotNLeptons ? dmt->nLeptons() : 0;
+    
+    // Then commence plotting for events passing inclusive H->yy selection:
+    double varEtMiss = dmt->HGamEventInfoAuxDyn_TST_met[0] / 1000.0;
+    double varPtYY = dmt->HGamEventInfoAuxDyn_pT_yy[0] / 1000.0;
+    int nJets = dmt->HGamEventInfoAuxDyn_Njets;
+    
+    // Values of the variables that can be plotted (see DMHistVariable):
+    double histValues[kNHistVariables];
+    histValues[kHistPTyy] = varPtYY;
+    histValues[kHistETMiss] = varEtMiss;
+    histValues[kHistRatioETMisspTyy] = dmt->ratioETMisspTyy(0);
+    histValues[kHistATanRatio] = dmt->aTanRatio(0);
+    histValues[kHistMyy] = invariantMass;
+    histValues[kHistSumSqrtETMisspTyy] = dmt->sumSqrtETMisspTyy(0) / 1000.0;
+    histValues[kHistNJets] = nJets;
+    histValues[kHistNLeptons] = nLeptons;
+    
+    int nHists = (int)m_histVariables.size();
+    if (dmt->HGamEventInfoAuxDyn_cutFlow[0] >= m_nMxAODCuts) {
+      for (int i_h = 0; i_h < nHists; i_h++) {
+	fillHist1D(worker, i_h, true, histValues[m_histVariables[i_h]],
+		   evtWeight, -1);
+      }
+    }
+    
+    // For systematic variations of the selection (all in a single pass):
+    worker->selector->evaluateSysVariations(evtWeight);
+    
+    // Make sure events pass the selection:
+    if (!worker->selector->passesCut(allCutsID, evtWeight)) continue;
+    
+    // Save the categories:
+    int currCate = worker->selector->getCategoryNumber(evtWeight);
+    
+    // Store the mass point for the datasets and text files:
+    worker->masses[currCate].push_back(invariantMass);
+    worker->weights[currCate].push_back(evtWeight);
+    
+    // Then commence plotting for PASSING events:
+    for (int i_h = 0; i_h < nHists; i_h++) {
+      fillHist1D(worker, i_h, false, histValues[m_histVariables[i_h]],
+		 evtWeight, m_histFillCates[i_h] ? currCate : -1);
+    }
+  }
+  flushHistBuffer(worker);
+  closeSkimFile(worker);
+  if (m_prefetcher && currFileIndex >= 0) {
+    m_prefetcher->releaseFile(currFileIndex);
+  }
+  if (m_incremental && currIndexedFile >= 0) {
+    flushFilePartial(worker, currIndexedFile);
+  }
+  
+  // Report the processing rate and cache performance of this worker:
+  timer.Stop();
+  Long64_t nProcessed = worker->lastEntry - worker->firstEntry;
+  CommonFunc::AddCacheStats(chain, nProcessed, worker->cacheStats);
+  double cacheHitRate = CommonFunc::CacheHitRate(worker->cacheStats);
+  std::cout << "DMMassPoints: Worker " << worker->index << " processed "
+	    << nProcessed << " events in " << timer.RealTime() << " s ("
+	    << (timer.RealTime() > 0.0 ? nProcessed / timer.RealTime() : 0.0)
+	    << " events/s, cache hit rate " << 100.0 * cacheHitRate
+	    << " %)." << std::endl;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Thread entry point for the event loop.
+   @param worker - The DMMassPointsWorker to process.
+   @return - NULL.
+*/
+void* DMMassPoints::processEntriesThread(void *worker) {
+  DMMassPointsWorker *currWorker = (DMMassPointsWorker*)worker;
+  currWorker->massPoints->processEntries(currWorker);
+  return NULL;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Read a binary mass points file. The file is mapped into memory and the mass
+   and weight columns are copied directly, without any parsing.
+   @param fileName - The name of the mass points file.
+   @param masses - The vector that will hold the masses.
+   @param weights - The vector that will hold the weights.
+   @return - True iff the file was read successfully.
+*/
+bool DMMassPoints::readMassPointsFile(TString fileName,
+				      std::vector<double> &masses,
+				      std::vector<double> &weights) {
+  masses.clear();
+  weights.clear();
+  int fileDescriptor = open(fileName.Data(), O_RDONLY);
+  if (fileDescriptor < 0) return false;
+  struct stat fileStat;
+  if (fstat(fileDescriptor, &fileStat) != 0 ||
+      fileStat.st_size < (off_t)sizeof(DMMassPointsHeader)) {
+    close(fileDescriptor);
+    return false;
+  }
+  size_t fileSize = (size_t)fileStat.st_size;
+  void *fileMap = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fileDescriptor,
+		       0);
+  close(fileDescriptor);
+  if (fileMap == MAP_FAILED) return false;
+  
+  // Check the header before using the columns:
+  const DMMassPointsHeader *header = (const DMMassPointsHeader*)fileMap;
+  Long64_t nEvents = header->nEvents;
+  if (strncmp(header->magic, "DMMASSPT", 8) != 0 || header->version != 1 ||
+      nEvents < 0 || fileSize != (sizeof(DMMassPointsHeader) +
+				  (size_t)(2 * nEvents) * sizeof(double))) {
+    std::cout << "DMMassPoints: Error! Bad mass points file " << fileName
+	      << std::endl;
+    munmap(fileMap, fileSize);
+    return false;
+  }
+  if ((bool)header->isWeighted != m_isWeighted) {
+    std::cout << "DMMassPoints: Warning! Weighting of " << fileName
+	      << " does not match the sample." << std::endl;
+  }
+  
+  const double *massColumn
+    = (const double*)((const char*)fileMap + sizeof(DMMassPointsHeader));
+  const double *weightColumn = massColumn + nEvents;
+  masses.assign(massColumn, massColumn + nEvents);
+  weights.assign(weightColumn, weightColumn + nEvents);
+  munmap(fileMap, fileSize);
+  return true;
+}
+
 /**
    -----------------------------------------------------------------------------
    Remove the local files and file list.
@@ -734,3 +1645,74 @@ void DMMassPoints::removeLocalFilesAndList(TString listName) {
   localFile.close();
   system(Form("rm %s", listName.Data()));
 }
+
+/**
+   -----------------------------------------------------------------------------
+   Get the object branches of the DMTree that this job reads: those of the
+   selection and of the plotted variables, or all of them for the skims.
+   @return - The DMTree::ObjectBranches flags.
+*/
+int DMMassPoints::requiredObjects() {
+  int objectBranches = DMTree::kLeptonBranches | DMTree::kPhotonJetBranches;
+  if (m_options.Contains("WriteSkim")) return objectBranches;
+  
+  // The selection is only compiled here, without a tree:
+  DMEvtSelect *selector = new DMEvtSelect(NULL, m_configFileName);
+  objectBranches = selector->requiredObjects();
+  delete selector;
+  
+  // The histograms are booked later, so read their list (default is all):
+  bool plotNLeptons = !m_config->isDefined("HistVariables");
+  if (!plotNLeptons) {
+    std::vector<TString> varNames = m_config->getStrV("HistVariables");
+    for (int i_n = 0; i_n < (int)varNames.size(); i_n++) {
+      if (varNames[i_n].EqualTo(histDefaults[kHistNLeptons].name)) {
+	plotNLeptons = true;
+      }
+    }
+  }
+  if (plotNLeptons) objectBranches |= DMTree::kLeptonBranches;
+  return objectBranches;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Write a binary mass points file, with a header followed by the mass column
+   and the weight column.
+   @param fileName - The name of the mass points file.
+   @param sampleName - The name of the data/MC sample.
+   @param cateIndex - The index of the category.
+   @param masses - The masses of the selected events.
+   @param weights - The weights of the selected events.
+*/
+void DMMassPoints::writeMassPointsFile(TString fileName, TString sampleName,
+				       int cateIndex,
+				       std::vector<double> &masses,
+				       std::vector<double> &weights) {
+  DMMassPointsHeader header;
+  memset(&header, 0, sizeof(DMMassPointsHeader));
+  memcpy(header.magic, "DMMASSPT", 8);
+  header.version = 1;
+  header.category = cateIndex;
+  header.isWeighted = (Int_t)m_isWeighted;
+  header.nEvents = (Long64_t)masses.size();
+  strncpy(header.sampleName, sampleName.Data(), sizeof(header.sampleName)-1);
+  strncpy(header.cateScheme, m_cateScheme.Data(), sizeof(header.cateScheme)-1);
+  
+  FILE *massFile = fopen(fileName.Data(), "wb");
+  bool success = (massFile != NULL);
+  if (success) {
+    success = (fwrite(&header, sizeof(DMMassPointsHeader), 1, massFile) == 1);
+    if (success && header.nEvents > 0) {
+      success = ((fwrite(&masses[0], sizeof(double), masses.size(), massFile)
+		  == masses.size()) &&
+		 (fwrite(&weights[0], sizeof(double), weights.size(),
+			 massFile) == weights.size()));
+    }
+    success = (fclose(massFile) == 0) && success;
+  }
+  if (!success) {
+    std::cout << "DMMassPoints: Error! Cannot write " << fileName << std::endl;
+    exit(0);
+  }
+}
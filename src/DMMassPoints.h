@@ -19,12 +19,23 @@
 #include <fstream>
 #include <vector>
 #include <string>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 // ROOT libraries:
 #include "TFile.h"
 #include "TTree.h"
+#include "TChain.h"
+#include "TChainElement.h"
 #include "TROOT.h"
+#include "RVersion.h"
 #include "TString.h"
+#include "TThread.h"
+#include "TMD5.h"
+#include "TVectorD.h"
 
 // Package libraries:
 #include "Config.h"
@@ -33,8 +44,54 @@
 #include "RooFitHead.h"
 #include "DMAnalysis.h"
 #include "DMEvtSelect.h"
+#include "DMFilePrefetcher.h"
 #include "DMTree.h"
-#include "DMxAODCutflow.h"
+#include "DMxAODIndex.h"
+
+class DMMassPoints;
+
+// Header of a binary mass points file. It is followed by the mass column and
+// then the weight column, each holding nEvents doubles.
+struct DMMassPointsHeader {
+  char magic[8];
+  Int_t version;
+  Int_t category;
+  Int_t isWeighted;
+  Int_t padding;
+  Long64_t nEvents;
+  char sampleName[128];
+  char cateScheme[64];
+};
+
+// Variables that can be plotted in the event loop, with "HistVariables":
+enum DMHistVariable { kHistPTyy, kHistETMiss, kHistRatioETMisspTyy,
+		      kHistATanRatio, kHistMyy, kHistSumSqrtETMisspTyy,
+		      kHistNJets, kHistNLeptons, kNHistVariables };
+
+// Everything owned by one worker of the event loop. Each worker processes a
+// contiguous range of chain entries, so merging the workers in order gives
+// the same outputs as a single pass over the chain.
+struct DMMassPointsWorker {
+  DMMassPoints *massPoints;
+  int index;
+  Long64_t firstEntry;
+  Long64_t lastEntry;
+  TChain *chain;
+  DMTree *tree;
+  DMEvtSelect *selector;
+  std::vector<TH1F*> hists;
+  std::vector<int> fillSlots;
+  std::vector<double> fillValues;
+  std::vector<double> fillWeights;
+  std::vector<double> masses[20];
+  std::vector<double> weights[20];
+  std::vector<TH1F*> componentCutFlows;
+  std::vector<double> componentNorms;
+  CommonFunc::CacheStats cacheStats;
+  TFile *skimFile;
+  TTree *skimTree;
+  int skimIndex;
+};
 
 class DMMassPoints {
   
@@ -61,13 +118,38 @@ class DMMassPoints {
  private:
   
   // Member methods:
+  void addFileCutFlow(DMMassPointsWorker *worker, int fileIndex);
+  TChain* cloneChain(TChain *chain);
+  void closeSkimFile(DMMassPointsWorker *worker);
+  TChain* createLocalChain(TChain *chain);
   void createNewMassPoints();
-  void fillHist1D(TString varName, bool allEvents, double xVal, double xWeight,
-		  int cateIndex);
+  TChain* createSkimChain(TChain *chain, std::vector<TString> systList,
+			  int objectBranches);
+  void bookHists();
+  void fillHist1D(DMMassPointsWorker *worker, int handle, bool allEvents,
+		  double xVal, double xWeight, int cateIndex);
+  void flushHistBuffer(DMMassPointsWorker *worker);
+  void flushFilePartial(DMMassPointsWorker *worker, int fileIndex);
+  TString getPartialFileName(int fileIndex, Long64_t entries,
+			     bool getSystematics);
+  TString getSkimFileName(TString fileName);
+  void loadFilePartial(DMMassPointsWorker *partial, TString partialName);
   void loadMassPointsFromFile();
+  void openSkimFile(DMMassPointsWorker *worker, int fileIndex);
+  bool plotsVariable(int varID);
   void printProgressBar(int index, int total);
-  void newHist1D(TString varName, int nBins, double xMin, double xMax);
+  bool readMassPointsFile(TString fileName, std::vector<double> &masses,
+			  std::vector<double> &weights);
+  int newHist1D(TString varName, int nBins, double xMin, double xMax);
+  void processEntries(DMMassPointsWorker *worker);
+  static void* processEntriesThread(void *worker);
+  int requiredObjects();
+  void saveFilePartial(DMMassPointsWorker *partial, TString partialName);
   void saveHists();
+  void scheduleLocalFiles(std::vector<DMMassPointsWorker*> workers);
+  void writeMassPointsFile(TString fileName, TString sampleName, int cateIndex,
+			   std::vector<double> &masses,
+			   std::vector<double> &weights);
   
   // Member variables:
   TString m_sampleName;
@@ -81,13 +163,46 @@ class DMMassPoints {
   RooDataSet *m_cateData[20];
   RooRealVar *m_yy;
   
-  // Plotting information:
-  std::map<TString,TH1F*> m_hists;
+  // Plotting information. Each variable booked with newHist1D() has a handle,
+  // and its histograms are stored at [handle*m_histStride + slot], where slot
+  // 0 is ALL, slot 1 is PASS and slot 2+i is category i:
+  std::vector<TH1F*> m_hists;
+  std::vector<TString> m_histKeys;
+  std::vector<int> m_histVariables;
+  std::vector<bool> m_histFillCates;
+  int m_histStride;
   
   // Cut-flow:
   std::vector<TH1F*> m_componentCutFlows;
   std::vector<double> m_componentNorms;
   TH1F* m_cutFlowHist;
+  
+  // Settings that are constant during the event loop:
+  TString m_cateScheme;
+  int m_nMxAODCuts;
+  double m_sampleBR;
+  
+  // Read settings for the input chain:
+  CommonFunc::ReadProfile m_readProfile;
+  
+  // Makes local copies of the inputs during the loop ("CopyFile" option):
+  DMFilePrefetcher *m_prefetcher;
+  
+  // Metadata of the input files, and the index in it of each tree of the
+  // chain that is processed:
+  DMxAODIndex *m_xAODIndex;
+  std::vector<int> m_chainFileIndices;
+  
+  // Results per input file, saved for later jobs ("Incremental" option),
+  // indexed in the same way as the metadata index:
+  bool m_incremental;
+  std::vector<DMMassPointsWorker*> m_filePartials;
+  
+  // Compact skims of the inputs ("WriteSkim" and "FromSkim" options). Events
+  // are kept if a variation passes the MxAOD cut with index m_skimCutIndex:
+  bool m_writeSkim;
+  TString m_skimDirectory;
+  int m_skimCutIndex;
 
 };
 
@@ -2,7 +2,7 @@
 //                                                                            //
 //  Name: DMMaster.cxx                                                        //
 //                                                                            //
-//  Created: Andrew Hard                                                      //
+//  Created: agent                                                            //
 //  Email: ahard@cern.ch                                                      //
 //  Date: 03/08/2015                                                          //
 //                                                                            //
@@ -13,10 +13,15 @@
 //  commands to submit jobs to various clusters.                              //
 //                                                                            //
 //  To run:                                                                   //
-//    ./bin/DMMaster <MasterOption> <configFileName>                          //
+//    ./bin/DMMaster <MasterOption> <configFileName> [<unit>]                 //
+//                                                                            //
+//  The optional unit restricts MassPoints to one sample, and SigParam,       //
+//  Workspace, TestStat and MuLimit to one signal ("SM" for the SM signal     //
+//  parameterization). The Pipeline option runs DMMaster once per unit.       //
 //                                                                            //
 //  MasterOption - Note: Each can be followed by the suffix "New"             //
 //    - Cleanup                                                               //
+//    - Pipeline (optionally with "Force")                                    //
 //    - MassPoints                                                            //
 //    - GetSystematics                                                        //
 //    - RankSystematics                                                       //
@@ -26,11 +31,14 @@
 //    - Workspace                                                             //
 //    - ResubmitWorkspace                                                     //
 //    - TossPseudoExp                                                         //
+//    - ResubmitPseudoExp                                                     //
+//    - AdaptivePseudoExp                                                     //
 //    - PlotPseudoExp                                                         //
 //    - TestStat                                                              //
 //    - ResubmitTestStat                                                      //
 //    - MuLimit                                                               //
 //    - Optimizer                                                             //
+//    - GridScan (optionally with "FromSkim")                                 //
 //    - OptAnalysis                                                           //
 //                                                                            //
 //  Need to rethink the DMSigParam handling of the RooDataSet. Maybe we       //
@@ -48,6 +56,131 @@ void compileMacro(TString macroName) {
   system(Form("make bin/%s",macroName.Data()));  
 }
 
+/**
+   -----------------------------------------------------------------------------
+   Submit one optimization job, which runs the full analysis with the given
+   cut values. The job index and cut values are added to the job summary.
+   @param exeConfigOrigin - The original analysis config file.
+   @param exeOption - The executable options for the job.
+   @param cutName - A vector of cut names.
+   @param cutVal - A vector of cut values.
+*/
+void submitOptimizerJob(TString exeConfigOrigin, TString exeOption,
+			std::vector<TString> cutName,
+			std::vector<double> cutVal) {
+  // First copy the config file (special config file) and make changes:
+  //  - change cut values.
+  //  - change output directory.
+  ifstream inputConfig;
+  inputConfig.open(exeConfigOrigin);
+  TString exeConfigNew = Form("exeConfig%d.cfg", m_jobIndex);
+  ofstream outputConfig; outputConfig.open(exeConfigNew);
+  std::string key;
+  // Loop over each line of the config file:
+  while (!inputConfig.eof()) {
+    std::getline(inputConfig, key);
+    TString currLine = TString(key);
+  
+    // Check if the current line specifies cut information:
+    bool lineSpecifiesCut = false; 
+    TString specifiedName = "";
+    double specifiedVal = 0.0;
+    for (int i_c = 0; i_c < (int)cutName.size(); i_c++) {
+      if (currLine.Contains(cutName[i_c]) && !currLine.Contains("#")) {
+	lineSpecifiesCut = true;
+	specifiedName = cutName[i_c];
+	specifiedVal = cutVal[i_c];
+      }
+    }
+  
+    // Change the cut value, if the current line specifies cut information:
+    if (lineSpecifiesCut) {
+      outputConfig << specifiedName << ": \t" << specifiedVal << std::endl;
+    }
+    // Make the output local (on lxbatch as opposed to afs):
+    else if (currLine.Contains("masterOutput:") && !currLine.Contains("#")){
+      outputConfig << "masterOutput: \t" << "." << std::endl;
+    }
+    else if (currLine.Contains("NoSMProdModes:")&&!currLine.Contains("#")) {
+      outputConfig << "NoSMProdModes: \t" << "NO" << std::endl;
+    }
+    // Just copy the configuration otherwise:
+    else {
+      outputConfig << currLine << std::endl;
+    }
+  }
+  inputConfig.close();
+  outputConfig.close();
+  
+  // BEGIN JOB SUBMISSION SECTION!
+  
+  // Make directories for job info:
+  TString dir = Form("%s/%s_DMMaster",
+		     (m_config->getStr("clusterFileLocation")).Data(),
+		     (m_config->getStr("jobName")).Data());
+  TString out = Form("%s/out", dir.Data());
+  TString err = Form("%s/err", dir.Data());
+  TString exe = Form("%s/exe", dir.Data());
+  system(Form("mkdir -vp %s", out.Data()));
+  system(Form("mkdir -vp %s", err.Data()));
+  system(Form("mkdir -vp %s", exe.Data()));
+  
+  // Create .tar file with everything needed to run remotely:
+  TString tempDir = Form("KillMe%d", m_jobIndex);
+  TString tarFile = Form("Cocoon%d.tar", m_jobIndex);
+  system(Form("mkdir -vp %s", tempDir.Data()));
+  system(Form("cp %s/bin/%s %s/", 
+	      (m_config->getStr("packageLocation")).Data(), 
+	      (m_config->getStr("exeMaster")).Data(), tempDir.Data()));
+  system(Form("mv %s %s/", exeConfigNew.Data(), tempDir.Data()));
+  system(Form("cp %s/%s %s/",
+	      (m_config->getStr("packageLocation")).Data(),
+	      (m_config->getStr("jobScriptMaster")).Data(), 
+	      tempDir.Data()));
+  system(Form("mv %s %s/", tempDir.Data(), exe.Data()));
+  
+  // Is this necessary? Probably...
+  system(Form("cp -f %s/%s %s/jobFileWorkspace.sh", 
+	      (m_config->getStr("packageLocation")).Data(), 
+	      (m_config->getStr("jobScriptMaster")).Data(), exe.Data()));
+  
+  //TString inputFile = Form("%s/%s", exe.Data(), tarFile.Data());
+  TString inputFile = Form("%s/%s", exe.Data(), tempDir.Data());
+  TString nameOutFile = Form("%s/out/%s_%d.out", dir.Data(), 
+			     (m_config->getStr("jobName")).Data(),m_jobIndex);
+  TString nameErrFile = Form("%s/err/%s_%d.err", dir.Data(), 
+			     (m_config->getStr("jobName")).Data(),m_jobIndex);
+  
+  // Define the arguments for the job script:
+  TString nameJScript = Form("%s/jobFileWorkspace.sh %s %s %s %s %s %d",
+			     exe.Data(),
+			     (m_config->getStr("jobName")).Data(),
+			     exeConfigNew.Data(),
+			     inputFile.Data(),
+			     exeOption.Data(),
+			     (m_config->getStr("exeMaster")).Data(),
+			     m_jobIndex);
+  // Submit the job:
+  system(Form("bsub -q wisc -o %s -e %s %s", nameOutFile.Data(), 
+	      nameErrFile.Data(), nameJScript.Data()));
+  
+  // END JOB SUBMISSION SECTION!
+  
+  // Note: job script should copy output files to a new output directory.
+  system(Form("rm -rf %s", tempDir.Data()));
+  
+  m_headFile << m_jobIndex;
+  for (int i_c = 0; i_c < (int)cutName.size(); i_c++) {
+    if (i_c == (int)cutName.size()-1) {
+      m_headFile << " " << cutVal[i_c] << std::endl;
+    }
+    else {
+      m_headFile << " " << cutVal[i_c];
+    }
+  }
+  m_jobIndex++;
+}
+
 /**
    -----------------------------------------------------------------------------
    Recursive method to alter selection cuts and submit jobs. The recursive case
@@ -98,117 +231,7 @@ void recursiveOptimizer(TString exeConfigOrigin, TString exeOption,
   
   // The base case (No more cuts to change, so just submit job:
   else {
-    // First copy the config file (special config file) and make changes:
-    //  - change cut values.
-    //  - change output directory.
-    ifstream inputConfig;
-    inputConfig.open(exeConfigOrigin);
-    TString exeConfigNew = Form("exeConfig%d.cfg", m_jobIndex);
-    ofstream outputConfig; outputConfig.open(exeConfigNew);
-    std::string key;
-    // Loop over each line of the config file:
-    while (!inputConfig.eof()) {
-      std::getline(inputConfig, key);
-      TString currLine = TString(key);
-            
-      // Check if the current line specifies cut information:
-      bool lineSpecifiesCut = false; 
-      TString specifiedName = "";
-      double specifiedVal = 0.0;
-      for (int i_c = 0; i_c < (int)cutName.size(); i_c++) {
-	if (currLine.Contains(cutName[i_c]) && !currLine.Contains("#")) {
-	  lineSpecifiesCut = true;
-	  specifiedName = cutName[i_c];
-	  specifiedVal = cutVal[i_c];
-	}
-      }
-      
-      // Change the cut value, if the current line specifies cut information:
-      if (lineSpecifiesCut) {
-	outputConfig << specifiedName << ": \t" << specifiedVal << std::endl;
-      }
-      // Make the output local (on lxbatch as opposed to afs):
-      else if (currLine.Contains("masterOutput:") && !currLine.Contains("#")){
-	outputConfig << "masterOutput: \t" << "." << std::endl;
-      }
-      else if (currLine.Contains("NoSMProdModes:")&&!currLine.Contains("#")) {
-	outputConfig << "NoSMProdModes: \t" << "NO" << std::endl;
-      }
-      // Just copy the configuration otherwise:
-      else {
-	outputConfig << currLine << std::endl;
-      }
-    }
-    inputConfig.close();
-    outputConfig.close();
-    
-    // BEGIN JOB SUBMISSION SECTION!
-    
-    // Make directories for job info:
-    TString dir = Form("%s/%s_DMMaster",
-		       (m_config->getStr("clusterFileLocation")).Data(),
-		       (m_config->getStr("jobName")).Data());
-    TString out = Form("%s/out", dir.Data());
-    TString err = Form("%s/err", dir.Data());
-    TString exe = Form("%s/exe", dir.Data());
-    system(Form("mkdir -vp %s", out.Data()));
-    system(Form("mkdir -vp %s", err.Data()));
-    system(Form("mkdir -vp %s", exe.Data()));
-    
-    // Create .tar file with everything needed to run remotely:
-    TString tempDir = Form("KillMe%d", m_jobIndex);
-    TString tarFile = Form("Cocoon%d.tar", m_jobIndex);
-    system(Form("mkdir -vp %s", tempDir.Data()));
-    system(Form("cp %s/bin/%s %s/", 
-		(m_config->getStr("packageLocation")).Data(), 
-		(m_config->getStr("exeMaster")).Data(), tempDir.Data()));
-    system(Form("mv %s %s/", exeConfigNew.Data(), tempDir.Data()));
-    system(Form("cp %s/%s %s/",
-		(m_config->getStr("packageLocation")).Data(),
-		(m_config->getStr("jobScriptMaster")).Data(), 
-		tempDir.Data()));
-    system(Form("mv %s %s/", tempDir.Data(), exe.Data()));
-    
-    // Is this necessary? Probably...
-    system(Form("cp -f %s/%s %s/jobFileWorkspace.sh", 
-		(m_config->getStr("packageLocation")).Data(), 
-		(m_config->getStr("jobScriptMaster")).Data(), exe.Data()));
-    
-    //TString inputFile = Form("%s/%s", exe.Data(), tarFile.Data());
-    TString inputFile = Form("%s/%s", exe.Data(), tempDir.Data());
-    TString nameOutFile = Form("%s/out/%s_%d.out", dir.Data(), 
-			       (m_config->getStr("jobName")).Data(),m_jobIndex);
-    TString nameErrFile = Form("%s/err/%s_%d.err", dir.Data(), 
-			       (m_config->getStr("jobName")).Data(),m_jobIndex);
-    
-    // Define the arguments for the job script:
-    TString nameJScript = Form("%s/jobFileWorkspace.sh %s %s %s %s %s %d",
-			       exe.Data(),
-			       (m_config->getStr("jobName")).Data(),
-			       exeConfigNew.Data(),
-			       inputFile.Data(),
-			       exeOption.Data(),
-			       (m_config->getStr("exeMaster")).Data(),
-			       m_jobIndex);
-    // Submit the job:
-    system(Form("bsub -q wisc -o %s -e %s %s", nameOutFile.Data(), 
-		nameErrFile.Data(), nameJScript.Data()));
-    
-    // END JOB SUBMISSION SECTION!
-    
-    // Note: job script should copy output files to a new output directory.
-    system(Form("rm -rf %s", tempDir.Data()));
-    
-    m_headFile << m_jobIndex;
-    for (int i_c = 0; i_c < (int)cutName.size(); i_c++) {
-      if (i_c == (int)cutName.size()-1) {
-	m_headFile << " " << cutVal[i_c] << std::endl;
-      }
-      else {
-	m_headFile << " " << cutVal[i_c];
-      }
-    }
-    m_jobIndex++;
+    submitOptimizerJob(exeConfigOrigin, exeOption, cutName, cutVal);
   }
 }
 
@@ -217,8 +240,11 @@ void recursiveOptimizer(TString exeConfigOrigin, TString exeOption,
    Submit the DMMainMethod to run remotely on lxbatch.
    @param exeConfigOrigin - The original config file for batch jobs.
    @param exeOption - The option for the executable...
+   @param cells - The cut values of the grid cells to run (e.g. those selected
+   by DMGridScan). All cells of the grid are run if it is empty.
 */
-void submitToOptimize(TString exeConfigOrigin, TString exeOption) {
+void submitToOptimize(TString exeConfigOrigin, TString exeOption,
+		      std::vector<std::vector<double> > cells) {
   std::cout << "DMMaster: Preparing to run myself remotely for optimization!"
 	    << std::endl;
   
@@ -249,7 +275,19 @@ void submitToOptimize(TString exeConfigOrigin, TString exeOption) {
   // Call the recursive function:
   std::vector<TString> cutName; cutName.clear();
   std::vector<double> cutVal; cutVal.clear();
-  recursiveOptimizer(exeConfigOrigin, exeOption, 0, cutName, cutVal);
+  if (cells.empty()) {
+    recursiveOptimizer(exeConfigOrigin, exeOption, 0, cutName, cutVal);
+  }
+  
+  // Or submit the given cells only:
+  else {
+    for (int i_c = 0; i_c < nCuts; i_c++) {
+      cutName.push_back(m_config->getStr(Form("OptVar%d",i_c)));
+    }
+    for (int i_g = 0; i_g < (int)cells.size(); i_g++) {
+      submitOptimizerJob(exeConfigOrigin, exeOption, cutName, cells[i_g]);
+    }
+  }
   
   // Close the file that records job indices and cuts:
   m_headFile.close();
@@ -472,12 +510,133 @@ void submitPEViaBsub(TString exeConfigFile, TString exeOption,
 			     (m_config->getStr("exePseudoExp")).Data(),
 			     exeSignal.Data(), exeOption.Data(), exeSeed,
 			     exeToysPerJob);
+  // Extra signal strengths for importance-sampled toys:
+  std::vector<int> extraMuValues
+    = DMAnalysis::getExtraToyMuValues(m_config, exeOption);
+  for (int i_m = 0; i_m < (int)extraMuValues.size(); i_m++) {
+    nameJScript += Form(" %d", extraMuValues[i_m]);
+  }
   
   // submit the job:
   system(Form("bsub -q wisc -o %s -e %s %s", nameOutFile.Data(), 
 	      nameErrFile.Data(), nameJScript.Data()));
 }
 
+/**
+   -----------------------------------------------------------------------------
+   Get the command that runs an executable of the package on this machine.
+   @param exeKey - The config key for the executable (e.g. "exeWorkspace").
+   @param exeArguments - The arguments following the config file.
+   @return - The command for a local job.
+*/
+TString localCommand(TString exeKey, TString exeArguments) {
+  return Form("%s/bin/%s %s %s", gSystem->WorkingDirectory(),
+	      (m_config->getStr(exeKey)).Data(), m_localConfigPath.Data(),
+	      exeArguments.Data());
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Run the jobs in the local pool, then report their wall time and status.
+   @param stepName - The name of the analysis step (for the job directory).
+*/
+void runLocalJobs(TString stepName) {
+  if (!m_jobPool) return;
+  m_jobPool->runJobs();
+  m_jobPool->printReport();
+  m_jobPool->writeReport(Form("%s/%s_%s/jobReport.txt",
+			      (m_config->getStr("clusterFileLocation")).Data(),
+			      (m_config->getStr("jobName")).Data(),
+			      stepName.Data()));
+  delete m_jobPool;
+  m_jobPool = NULL;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Add a job to the local pool of worker processes. The logs use the out/err
+   layout of the batch jobs, and each job has its own working directory.
+   @param stepName - The name of the analysis step (e.g. "DMWorkspace").
+   @param jobTag - The tag of the job (e.g. the signal name).
+   @param command - The command to run.
+*/
+void submitViaLocalPool(TString stepName, TString jobTag, TString command) {
+  // Make directories for job info:
+  TString dir = Form("%s/%s_%s",
+		     (m_config->getStr("clusterFileLocation")).Data(),
+		     (m_config->getStr("jobName")).Data(), stepName.Data());
+  system(Form("mkdir -vp %s/out", dir.Data()));
+  system(Form("mkdir -vp %s/err", dir.Data()));
+  
+  // The pool runs as many jobs at once as there are cores by default:
+  if (!m_jobPool) {
+    int nSlots = m_config->getInt("LocalJobSlots", 0);
+    if (nSlots < 1) nSlots = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    m_jobPool = new DMJobPool(nSlots);
+  }
+  
+  TString nameOutFile = Form("%s/out/%s_%s.out", dir.Data(),
+			     (m_config->getStr("jobName")).Data(),
+			     jobTag.Data());
+  TString nameErrFile = Form("%s/err/%s_%s.err", dir.Data(),
+			     (m_config->getStr("jobName")).Data(),
+			     jobTag.Data());
+  m_jobPool->addJob(Form("%s_%s", stepName.Data(), jobTag.Data()), command,
+		    Form("%s/run/%s", dir.Data(), jobTag.Data()),
+		    nameOutFile, nameErrFile);
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Submit one pseudo-experiment job, which makes the background-only and the
+   signal+background toys for one seed (and the toys at the other signal
+   strengths of "ImportanceMuDM" for importance sampling).
+   @param exeConfigFile - The config file (for batch jobs).
+   @param exeOption - The job options for the executable.
+   @param exeSignal - The signal to process in the executable.
+   @param exeSeed - The seed for the randomized dataset generation.
+   @param exeToysPerJob - The number of toy datasets to create per job.
+*/
+void submitPseudoExp(TString exeConfigFile, TString exeOption,
+		     TString exeSignal, int exeSeed, int exeToysPerJob) {
+  if (m_useLocalPool) {
+    // Background-only and signal+background toys, as in the job script:
+    TString toyArguments = Form("%s %s %d %d", exeSignal.Data(),
+				exeOption.Data(), exeSeed, exeToysPerJob);
+    TString toyCommand
+      = Form("%s 0 && %s 1",
+	     (localCommand("exePseudoExp", toyArguments)).Data(),
+	     (localCommand("exePseudoExp", toyArguments)).Data());
+    std::vector<int> extraMuValues
+      = DMAnalysis::getExtraToyMuValues(m_config, exeOption);
+    for (int i_m = 0; i_m < (int)extraMuValues.size(); i_m++) {
+      toyCommand += Form(" && %s %d",
+			 (localCommand("exePseudoExp", toyArguments)).Data(),
+			 extraMuValues[i_m]);
+    }
+    submitViaLocalPool("PseudoExp", Form("%s_%d", exeSignal.Data(), exeSeed),
+		       toyCommand);
+  }
+  else {
+    submitPEViaBsub(exeConfigFile, exeOption, exeSignal, exeSeed,
+		    exeToysPerJob);
+    m_isFirstJob = false;
+  }
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Restrict the samples or signals of an analysis step to the unit of this job.
+   @param samples - The samples or signals of the analysis step.
+   @return - The samples or signals to process.
+*/
+std::vector<TString> restrictToUnit(std::vector<TString> samples) {
+  if (m_masterUnit.EqualTo("")) return samples;
+  std::vector<TString> result; result.clear();
+  result.push_back(m_masterUnit);
+  return result;
+}
+
 /**
    -----------------------------------------------------------------------------
    This is the main DMMaster method:
@@ -485,7 +644,7 @@ void submitPEViaBsub(TString exeConfigFile, TString exeOption,
 int main (int argc, char **argv) {
   // Check arguments:
   if (argc < 3) {
-    printf("\nUsage: %s <option> <configFileName> \n\n", argv[0]);
+    printf("\nUsage: %s <option> <configFileName> [<unit>]\n\n", argv[0]);
     exit(0);
   }
   
@@ -509,6 +668,18 @@ int main (int argc, char **argv) {
   bool runInParallel = m_config->getBool("RunInParallel");
   m_isFirstJob = true;
   
+  // A single sample or signal is always processed in this job:
+  m_masterUnit = (argc > 3) ? TString(argv[3]) : TString("");
+  if (!m_masterUnit.EqualTo("")) runInParallel = false;
+  
+  // Parallel jobs can also run in a pool of processes on this machine:
+  m_useLocalPool
+    = (m_config->getStr("JobBackend", TString("bsub"))).EqualTo("local");
+  m_jobPool = NULL;
+  m_localConfigPath = gSystem->IsAbsoluteFileName(configFileName) ?
+    configFileName :
+    TString(Form("%s/%s", gSystem->WorkingDirectory(), configFileName.Data()));
+  
   // Options for each analysis step:
   TString massPointOptions = m_config->getStr("massPointOptions");
   TString sigParamOptions  = m_config->getStr("sigParamOptions");
@@ -527,6 +698,28 @@ int main (int argc, char **argv) {
 		(m_config->getStr("jobName")).Data()));
   }
   
+  // Jobs run in this process are recorded in the ledger (after the cleanup):
+  m_jobLedger = new DMJobLedger(configFileName);
+  
+  //--------------------------------------//
+  // Step 0.1: Run the analysis steps as a graph of local jobs:
+  if (masterOption.Contains("Pipeline")) {
+    std::cout << "DMMaster: Step 0.1 - Run the analysis pipeline." << std::endl;
+    std::vector<TString> pipelineSteps = m_config->getStrV("PipelineSteps");
+    for (int i_s = 0; i_s < (int)pipelineSteps.size(); i_s++) {
+      if (pipelineSteps[i_s].EqualTo("MuLimit")) compileMacro("DMMuLimit");
+    }
+    DMPipeline *dmp = new DMPipeline(m_localConfigPath, masterOption);
+    dmp->buildAnalysis(pipelineSteps);
+    dmp->printSteps();
+    if (!dmp->run()) {
+      std::cout << "DMMaster: Problem with the analysis pipeline!"
+		<< std::endl;
+      exit(0);
+    }
+    delete dmp;
+  }
+  
   //--------------------------------------//
   // Step 1.1: Make or load mass points:
   if (masterOption.Contains("MassPoints")) {
@@ -540,6 +733,7 @@ int main (int argc, char **argv) {
     allSamples.insert(allSamples.end(),sigSMModes.begin(),sigSMModes.end());
     allSamples.insert(allSamples.end(),sigDMModes.begin(),sigDMModes.end());
     allSamples.insert(allSamples.end(),bkgProcesses.begin(),bkgProcesses.end());
+    allSamples = restrictToUnit(allSamples);
     
     // Loop over all samples:
     for (int i_s = 0; i_s < (int)allSamples.size(); i_s++) {
@@ -612,8 +806,20 @@ int main (int argc, char **argv) {
   if (masterOption.Contains("SigParam")) {
     std::cout << "DMMaster: Step 2 - Make signal parameterization." 
 	      << std::endl;
-    SigParamInterface *spi = new SigParamInterface(configFileName,
-						   sigParamOptions);
+    SigParamInterface *spi = NULL;
+    if (m_masterUnit.EqualTo("")) {
+      spi = new SigParamInterface(configFileName, sigParamOptions);
+    }
+    else {
+      // The SM unit includes the separate SM production modes:
+      std::vector<TString> signalTypes; signalTypes.clear();
+      if (m_masterUnit.EqualTo("SM") && m_config->getBool("SplitSMProdModes")) {
+	signalTypes = m_config->getStrV("sigSMModes");
+      }
+      signalTypes.push_back(m_masterUnit);
+      spi = new SigParamInterface(configFileName, sigParamOptions,
+				  signalTypes);
+    }
     delete spi;
   }
   
@@ -633,17 +839,27 @@ int main (int argc, char **argv) {
     std::cout << "DMMaster: Step 4.1 - Making the workspaces." << std::endl;
     
     int jobCounterWS = 0;
-    std::vector<TString> sigDMModes = m_config->getStrV("sigDMModes");
+    std::vector<TString> sigDMModes
+      = restrictToUnit(m_config->getStrV("sigDMModes"));
     for (int i_DM = 0; i_DM < (int)sigDMModes.size(); i_DM++) {
       TString currSignal = sigDMModes[i_DM];
-      if (runInParallel) {
+      if (runInParallel && m_useLocalPool) {
+	submitViaLocalPool("DMWorkspace", currSignal,
+			   localCommand("exeWorkspace",
+					currSignal + " " + workspaceOptions));
+	jobCounterWS++;
+      }
+      else if (runInParallel) {
 	submitWSViaBsub(fullConfigPath, workspaceOptions, currSignal);
 	jobCounterWS++;
 	m_isFirstJob = false;
       }
       else {
+	m_jobLedger->recordStart("DMWorkspace", currSignal, -1, 0);
 	DMWorkspace *dmw = new DMWorkspace(configFileName, currSignal,
 					   workspaceOptions);
+	m_jobLedger->recordEnd("DMWorkspace", currSignal, -1, 0, 0,
+			       dmw->fitsAllConverged());
 	if (dmw->fitsAllConverged()) jobCounterWS++;
 	else {
 	  std::cout << "DMMaster: Problem with workspace fit!" << std::endl;
@@ -652,6 +868,7 @@ int main (int argc, char **argv) {
 	delete dmw;
       }
     }
+    runLocalJobs("DMWorkspace");
     std::cout << "Submitted/completed " << jobCounterWS << " jobs" << std::endl;
   }
   
@@ -672,14 +889,23 @@ int main (int argc, char **argv) {
     for (int i_DM = 0; i_DM < (int)resubmitSignals.size(); i_DM++) {
       TString currSignal = resubmitSignals[i_DM];
       
-      if (runInParallel) {
+      if (runInParallel && m_useLocalPool) {
+	submitViaLocalPool("DMWorkspace", currSignal,
+			   localCommand("exeWorkspace",
+					currSignal + " " + workspaceOptions));
+	jobCounterWS++;
+      }
+      else if (runInParallel) {
 	submitWSViaBsub(fullConfigPath, workspaceOptions, currSignal);
 	jobCounterWS++;
 	m_isFirstJob = false;
       }
       else {
+	m_jobLedger->recordStart("DMWorkspace", currSignal, -1, 0);
 	DMWorkspace *dmw = new DMWorkspace(configFileName, currSignal,
 					   workspaceOptions);
+	m_jobLedger->recordEnd("DMWorkspace", currSignal, -1, 0, 0,
+			       dmw->fitsAllConverged());
 	if (dmw->fitsAllConverged()) jobCounterWS++;
 	else {
 	  std::cout << "DMMaster: Problem with workspace fit!" << std::endl;
@@ -688,6 +914,7 @@ int main (int argc, char **argv) {
 	delete dmw;
       }
     }
+    runLocalJobs("DMWorkspace");
     delete dmc;
     std::cout << "Resubmitted " << jobCounterWS << " jobs" << std::endl;
   }
@@ -706,14 +933,77 @@ int main (int argc, char **argv) {
     int highestSeed = toySeed + nToysTotal;
     
     for (int i_s = toySeed; i_s < highestSeed; i_s += increment) {
-      submitPEViaBsub(fullConfigPath, pseudoExpOptions, currToySignal, i_s,
+      submitPseudoExp(fullConfigPath, pseudoExpOptions, currToySignal, i_s,
 		      nToysPerJob);
-      m_isFirstJob = false;
     }
+    runLocalJobs("PseudoExp");
     std::cout << "DMMaster: Submitted " << (int)(nToysTotal/nToysPerJob) 
 	      << " total pseudo-experiments." << std::endl;
   }
   
+  //--------------------------------------//
+  // Step 5.1.1: Resubmit any failed or stalled pseudo-experiment jobs:
+  if (masterOption.Contains("ResubmitPseudoExp")) {
+    std::cout << "DMMaster: Step 5.1.1 - Resubmit failed pseudoexperiments."
+	      << std::endl;
+    
+    // Get the signals and seeds to resubmit:
+    DMCheckJobs *dmc = new DMCheckJobs(configFileName);
+    vector<TString> resubmitSeeds = dmc->getResubmitList("DMPseudoExp");
+    dmc->printResubmitList("DMPseudoExp");
+    
+    // Then resubmit as necessary:
+    int nToysPerJob = m_config->getInt("nToysPerJob");
+    for (int i_s = 0; i_s < (int)resubmitSeeds.size(); i_s++) {
+      TObjArray *tokens = resubmitSeeds[i_s].Tokenize(" ");
+      TString resubmitSignal = ((TObjString*)tokens->At(0))->GetString();
+      TString resubmitSeed = ((TObjString*)tokens->At(1))->GetString();
+      delete tokens;
+      submitPseudoExp(fullConfigPath, pseudoExpOptions, resubmitSignal,
+		      resubmitSeed.Atoi(), nToysPerJob);
+    }
+    runLocalJobs("PseudoExp");
+    delete dmc;
+    std::cout << "Resubmitted " << (int)resubmitSeeds.size() << " jobs"
+	      << std::endl;
+  }
+  
+  //--------------------------------------//
+  // Step 5.1.2: Toss pseudoexperiments until the toy CLs and p0 are precise:
+  if (masterOption.Contains("AdaptivePseudoExp")) {
+    std::cout << "DMMaster: Step 5.1.2 - Toss pseudoexperiments for signals "
+	      << "without precise toy results." << std::endl;
+    
+    // Local jobs are waited for, so that several rounds run in one call. Each
+    // call submits one round of batch jobs:
+    std::vector<TString> sigDMModes
+      = restrictToUnit(m_config->getStrV("sigDMModes"));
+    int nToysPerJob = m_config->getInt("nToysPerJob");
+    int nRounds = m_useLocalPool ? m_config->getInt("ToyMaxRounds", 10) : 1;
+    DMToyController *dmtc = new DMToyController(configFileName);
+    for (int i_r = 0; i_r <= nRounds; i_r++) {
+      dmtc->update(sigDMModes);
+      dmtc->printSummary();
+      if (i_r == nRounds) break;
+      
+      int nJobs = 0;
+      for (int i_DM = 0; i_DM < (int)sigDMModes.size(); i_DM++) {
+	std::vector<int> seeds = dmtc->getNewSeeds(sigDMModes[i_DM]);
+	for (int i_s = 0; i_s < (int)seeds.size(); i_s++) {
+	  submitPseudoExp(fullConfigPath, pseudoExpOptions, sigDMModes[i_DM],
+			  seeds[i_s], nToysPerJob);
+	  dmtc->recordSubmission(sigDMModes[i_DM], seeds[i_s], nToysPerJob);
+	  nJobs++;
+	}
+      }
+      std::cout << "DMMaster: Submitted " << nJobs << " pseudo-experiment jobs"
+		<< " in round " << i_r << "." << std::endl;
+      if (nJobs == 0 || !m_useLocalPool) break;
+      runLocalJobs("PseudoExp");
+    }
+    delete dmtc;
+  }
+  
   //--------------------------------------//
   // Step 5.2: Plot pseudo-experiment ensemble results:
   if (masterOption.Contains("PlotPseudoExp")) {
@@ -730,20 +1020,30 @@ int main (int argc, char **argv) {
     std::cout << "DMMaster: Step 6.1 - Calculating CL and p0." << std::endl;
 
     int jobCounterTS = 0;
-    std::vector<TString> sigDMModes = m_config->getStrV("sigDMModes");
+    std::vector<TString> sigDMModes
+      = restrictToUnit(m_config->getStrV("sigDMModes"));
     for (int i_DM = 0; i_DM < (int)sigDMModes.size(); i_DM++) {
       TString currSignal = sigDMModes[i_DM];
       
-      if (runInParallel) {
+      if (runInParallel && m_useLocalPool) {
+	submitViaLocalPool("DMTestStat", currSignal,
+			   localCommand("exeTestStat",
+					currSignal + " " + testStatOptions));
+	jobCounterTS++;
+      }
+      else if (runInParallel) {
 	submitTSViaBsub(fullConfigPath, testStatOptions, currSignal);
 	jobCounterTS++;
 	m_isFirstJob = false;
       }
       else {
+	m_jobLedger->recordStart("DMTestStat", currSignal, -1, 0);
 	DMTestStat *dmts = new DMTestStat(configFileName, currSignal, 
 					  testStatOptions, NULL);
 	dmts->calculateNewCL();
 	dmts->calculateNewP0();
+	m_jobLedger->recordEnd("DMTestStat", currSignal, -1, 0, 0,
+			       dmts->fitsAllConverged());
 	if (dmts->fitsAllConverged()) jobCounterTS++;
 	else {
 	  std::cout << "DMMaster: Problem with test-stat fit!" << std::endl;
@@ -752,6 +1052,7 @@ int main (int argc, char **argv) {
 	delete dmts;
       }
     }
+    runLocalJobs("DMTestStat");
     std::cout << "Submitted/completed " << jobCounterTS << " jobs" << std::endl;
   }
   
@@ -772,16 +1073,25 @@ int main (int argc, char **argv) {
     for (int i_DM = 0; i_DM < (int)resubmitSignals.size(); i_DM++) {
       TString currSignal = resubmitSignals[i_DM];
       
-      if (runInParallel) {
+      if (runInParallel && m_useLocalPool) {
+	submitViaLocalPool("DMTestStat", currSignal,
+			   localCommand("exeTestStat",
+					currSignal + " " + testStatOptions));
+	jobCounterTS++;
+      }
+      else if (runInParallel) {
 	submitTSViaBsub(fullConfigPath, testStatOptions, currSignal);
       	jobCounterTS++;
 	m_isFirstJob = false;
       }
       else {
+	m_jobLedger->recordStart("DMTestStat", currSignal, -1, 0);
 	DMTestStat *dmts = new DMTestStat(configFileName, currSignal,
 					  testStatOptions, NULL);
 	dmts->calculateNewCL();
 	dmts->calculateNewP0();
+	m_jobLedger->recordEnd("DMTestStat", currSignal, -1, 0, 0,
+			       dmts->fitsAllConverged());
 	if (dmts->fitsAllConverged()) jobCounterTS++;
 	else {
 	  std::cout << "DMMaster: Problem with test-stat fit!" << std::endl;
@@ -790,6 +1100,7 @@ int main (int argc, char **argv) {
 	delete dmts;
       }
     }
+    runLocalJobs("DMTestStat");
     delete dmc;
     std::cout << "Resubmitted " << jobCounterTS << " jobs" << std::endl;
   }
@@ -805,11 +1116,17 @@ int main (int argc, char **argv) {
     
     // Loop over signals for jobs:
     int jobCounterML = 0;
-    std::vector<TString> sigDMModes = m_config->getStrV("sigDMModes");
+    std::vector<TString> sigDMModes
+      = restrictToUnit(m_config->getStrV("sigDMModes"));
     for (int i_DM = 0; i_DM < (int)sigDMModes.size(); i_DM++) {
       TString currSignal = sigDMModes[i_DM];
       
-      if (runInParallel) {
+      if (runInParallel && m_useLocalPool) {
+	submitViaLocalPool("DMMuLimit", currSignal,
+			   localCommand("exeMuLimit",
+					currSignal + " " + muLimitOptions));
+      }
+      else if (runInParallel) {
 	//submitMuLimitViaBsub(fullConfigPath, muLimitOptions, currSignal);
 	m_isFirstJob = false;
       }
@@ -831,6 +1148,7 @@ int main (int argc, char **argv) {
       }
       jobCounterML++;
     }
+    runLocalJobs("DMMuLimit");
     std::cout << "Submitted/completed " << jobCounterML << " jobs" << std::endl;
   }
   
@@ -854,7 +1172,12 @@ int main (int argc, char **argv) {
     for (int i_DM = 0; i_DM < (int)resubmitSignals.size(); i_DM++) {
       TString currSignal = resubmitSignals[i_DM];
       
-      if (runInParallel) {
+      if (runInParallel && m_useLocalPool) {
+	submitViaLocalPool("DMMuLimit", currSignal,
+			   localCommand("exeMuLimit",
+					currSignal + " " + muLimitOptions));
+      }
+      else if (runInParallel) {
 	submitMuLimitViaBsub(fullConfigPath, muLimitOptions, currSignal);
 	m_isFirstJob = false;
       }
@@ -876,6 +1199,7 @@ int main (int argc, char **argv) {
       }
       jobCounterML++;
     }
+    runLocalJobs("DMMuLimit");
     delete dmc;
     std::cout << "Resubmitted " << jobCounterML << " jobs" << std::endl;
   }
@@ -883,7 +1207,38 @@ int main (int argc, char **argv) {
   //--------------------------------------//
   // Step 8: Optimize the analysis!
   if (masterOption.Contains("Optimizer")) {
-    submitToOptimize(configFileName, m_config->getStr("masterJobOptions"));
+    std::vector<std::vector<double> > allCells; allCells.clear();
+    submitToOptimize(configFileName, m_config->getStr("masterJobOptions"),
+		     allCells);
+  }
+  
+  //--------------------------------------//
+  // Step 8.1: Scan the optimization grid locally, reading each sample once:
+  if (masterOption.Contains("GridScan")) {
+    std::cout << "DMMaster: Step 8.1 - Grid scan." << std::endl;
+    DMGridScan *dmgs = new DMGridScan(configFileName, masterOption);
+    dmgs->loadSample("Data");
+    std::vector<TString> sigSMModes = m_config->getStrV("sigSMModes");
+    for (int i_SM = 0; i_SM < (int)sigSMModes.size(); i_SM++) {
+      dmgs->loadSample(sigSMModes[i_SM]);
+    }
+    std::vector<TString> sigDMModes = m_config->getStrV("sigDMModes");
+    for (int i_DM = 0; i_DM < (int)sigDMModes.size(); i_DM++) {
+      dmgs->loadSample(sigDMModes[i_DM]);
+    }
+    dmgs->writeResults();
+    
+    // The full statistical analysis is run on the selected cells only:
+    std::vector<int> selectedCells = dmgs->getSelectedCells();
+    std::vector<std::vector<double> > cells; cells.clear();
+    for (int i_g = 0; i_g < (int)selectedCells.size(); i_g++) {
+      cells.push_back(dmgs->getCellCutValues(selectedCells[i_g]));
+    }
+    if (!cells.empty()) {
+      submitToOptimize(configFileName, m_config->getStr("masterJobOptions"),
+		       cells);
+    }
+    delete dmgs;
   }
   
   //--------------------------------------//
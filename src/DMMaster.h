@@ -16,10 +16,15 @@
 #include "Config.h"
 #include "DMAnalysis.h"
 #include "DMCheckJobs.h"
+#include "DMGridScan.h"
+#include "DMJobLedger.h"
+#include "DMJobPool.h"
 #include "DMMassPoints.h"
 #include "DMOptAnalysis.h"
+#include "DMPipeline.h"
 #include "DMTestStat.h"
 #include "DMToyAnalysis.h"
+#include "DMToyController.h"
 #include "SigParamInterface.h"
 #include "SystematicsTool.h"
 
@@ -32,11 +37,26 @@ ofstream m_headFile;
 
 bool m_isFirstJob;
 
+// Pool of local worker processes, for the "local" JobBackend:
+DMJobPool *m_jobPool;
+bool m_useLocalPool;
+TString m_localConfigPath;
+
+// The single sample or signal to process, if any (used by DMPipeline):
+TString m_masterUnit;
+
+// Ledger of the jobs run in this process:
+DMJobLedger *m_jobLedger;
+
 // Mutators:
 void recursiveOptimizer(TString exeConfigOrigin, TString exeOption, 
 			int cutIndex, std::vector<TString> cutN,
 			std::vector<double> cutV);
-void submitToOptimize(TString exeConfigOrigin, TString exeOption);
+void submitOptimizerJob(TString exeConfigOrigin, TString exeOption,
+			std::vector<TString> cutName,
+			std::vector<double> cutVal);
+void submitToOptimize(TString exeConfigOrigin, TString exeOption,
+		      std::vector<std::vector<double> > cells);
 
 void submitWSViaBsub(TString exeConfigFile, TString exeOption,
 		     TString exeSignal);
@@ -49,3 +69,7 @@ void submitMLViaBsub(TString exeConfigFile, TString exeOption,
 
 void submitPEViaBsub(TString exeConfigFile, TString exeOption, 
 		     TString exeSignal, int exeSeed, int exeToysPerJob);
+
+TString localCommand(TString exeKey, TString exeArguments);
+void runLocalJobs(TString stepName);
+void submitViaLocalPool(TString stepName, TString jobTag, TString command);
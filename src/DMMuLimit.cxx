@@ -89,6 +89,7 @@ NOTE: The script runs significantly faster when compiled
 #include "RooStatsHead.h"
 #include "statistics.h"
 #include "DMAnalysis.h"
+#include "DMJobLedger.h"
 
 using namespace std;
 using namespace RooFit;
@@ -1490,6 +1491,10 @@ int main(int argc, char* argv[]) {
   
   Config *config = new Config(configFile);
   
+  // Record the job in the ledger:
+  DMJobLedger *ledger = new DMJobLedger(configFile);
+  ledger->recordStart("DMMuLimit", INPUTDMSignal, -1, 0);
+  
   // Set input locations:
   TString inputDir = Form("%s/%s", (config->getStr("masterOutput")).Data(),
 			  (config->getStr("jobName")).Data());
@@ -1522,4 +1527,6 @@ int main(int argc, char* argv[]) {
   
   // Remove the local input file copy when job completes.
   system(Form("rm %s", localInputFileName.Data()));
+  ledger->recordEnd("DMMuLimit", INPUTDMSignal, -1, 0, 0);
+  delete ledger;
 }
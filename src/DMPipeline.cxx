@@ -0,0 +1,561 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: DMPipeline.cxx                                                      //
+//                                                                            //
+//  Created: agent                                                            //
+//  Date: 16/10/2026                                                          //
+//                                                                            //
+//  This class runs the analysis steps as a graph of jobs on this machine.    //
+//  Each step declares its command, output files, the config settings it      //
+//  depends on, and the steps that produce its inputs. A step runs as soon    //
+//  as all of its dependencies have finished, so independent chains (e.g.     //
+//  different DM signals) overlap in the DMJobPool.                           //
+//                                                                            //
+//  A step is skipped when it is up to date: the command and settings match   //
+//  the stamp of its last successful run, and its outputs exist and are no    //
+//  older than the outputs of its dependencies. Use the "Force" option to     //
+//  run every step regardless.                                                //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include "DMPipeline.h"
+
+/**
+   -----------------------------------------------------------------------------
+   Initialize the pipeline. No steps are defined until addStep() or
+   buildAnalysis() is called.
+   @param newConfigFile - The name of the analysis config file.
+   @param newOptions - The options for the pipeline.
+*/
+DMPipeline::DMPipeline(TString newConfigFile, TString newOptions) {
+  std::cout << "DMPipeline: Initializing with options " << newOptions
+	    << std::endl;
+  
+  m_configFile = newConfigFile;
+  m_options = newOptions;
+  m_config = new Config(m_configFile);
+  
+  // The stamps of successful steps are kept with the analysis outputs:
+  m_outputDir = Form("%s/%s/DMPipeline",
+		     (m_config->getStr("masterOutput")).Data(),
+		     (m_config->getStr("jobName")).Data());
+  system(Form("mkdir -vp %s/stamps", m_outputDir.Data()));
+  
+  // The logs use the out/err layout of the batch jobs:
+  m_logDir = Form("%s/%s_DMPipeline",
+		  (m_config->getStr("clusterFileLocation")).Data(),
+		  (m_config->getStr("jobName")).Data());
+  system(Form("mkdir -vp %s/out", m_logDir.Data()));
+  system(Form("mkdir -vp %s/err", m_logDir.Data()));
+  
+  m_stepNames.clear();
+  m_commands.clear();
+  m_workDirectories.clear();
+  m_outputs.clear();
+  m_settings.clear();
+  m_dependencies.clear();
+  m_stepStates.clear();
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Delete the pipeline and its config.
+*/
+DMPipeline::~DMPipeline() {
+  delete m_config;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Add a step to the pipeline. Dependencies must be added before the steps that
+   depend on them.
+   @param stepName - The unique name of the step.
+   @param command - The command to run.
+   @param workDirectory - The working directory of the job ("" for the current
+   directory). A non-empty directory is removed when the job ends.
+   @param outputs - The files that the step produces.
+   @param settings - The prefixes of the config settings used by the step.
+   @param dependencies - The indices of the steps producing the inputs.
+   @return - The index of the new step.
+*/
+int DMPipeline::addStep(TString stepName, TString command,
+			TString workDirectory, std::vector<TString> outputs,
+			std::vector<TString> settings,
+			std::vector<int> dependencies) {
+  if (findStep(stepName) >= 0) {
+    std::cout << "DMPipeline: Error! Step " << stepName << " already exists."
+	      << std::endl;
+    exit(0);
+  }
+  m_stepNames.push_back(stepName);
+  m_commands.push_back(command);
+  m_workDirectories.push_back(workDirectory);
+  m_outputs.push_back(outputs);
+  m_settings.push_back(settings);
+  m_dependencies.push_back(dependencies);
+  m_stepStates.push_back(kPending);
+  return nSteps() - 1;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Define the steps of the analysis. Each signal has its own chain of steps,
+   and the chains share the mass points and the SM signal parameterization.
+   Steps that are not requested are assumed to have been run already.
+   @param stepTypes - The requested steps (MassPoints, SigParam, Workspace,
+   TestStat, MuLimit, PseudoExp).
+*/
+void DMPipeline::buildAnalysis(std::vector<TString> stepTypes) {
+  TString stepList = "";
+  for (int i_t = 0; i_t < (int)stepTypes.size(); i_t++) {
+    stepList += stepTypes[i_t] + " ";
+  }
+  std::cout << "DMPipeline: Building the steps " << stepList << std::endl;
+  
+  TString jobDir = Form("%s/%s", (m_config->getStr("masterOutput")).Data(),
+			(m_config->getStr("jobName")).Data());
+  TString binDir = Form("%s/bin", gSystem->WorkingDirectory());
+  TString master = Form("%s/%s", binDir.Data(),
+			(m_config->getStr("exeMaster")).Data());
+  TString cateScheme = m_config->getStr("cateScheme");
+  int nCategories = m_config->getInt("nCategories");
+  bool splitSMModes = m_config->getBool("SplitSMProdModes");
+  std::vector<int> noDependencies; noDependencies.clear();
+  
+  // Settings used by each type of step, in the order of the config file:
+  const int nMassPointSettings = 20;
+  TString massPointSettings[nMassPointSettings]
+    = {"MxAODDirectory", "MxAODForm_DM", "TagUnskimmed", "TagSkimmed",
+       "AnaCut", "LeptonVeto", "cateScheme", "nCategories", "MxAODCutList",
+       "RatioCut", "ETMissCut", "DiphotonPTCut", "PTHardCut",
+       "BranchingRatioHyy", "DMMyyRange", "HistVariables", "HistBinning",
+       "SkimMxAODCut", "SystematicsList", "massPointOptions"};
+  const int nSigParamSettings = 6;
+  TString sigParamSettings[nSigParamSettings]
+    = {"resonancePDF", "higgsMass", "SplitSMProdModes", "cateScheme",
+       "nCategories", "sigParamOptions"};
+  const int nWorkspaceSettings = 11;
+  TString workspaceSettings[nWorkspaceSettings]
+    = {"analysisLuminosity", "higgsMass", "sigSMModes", "BkgProcesses",
+       "SplitSMProdModes", "BranchingRatioHyy", "DMMyyRange", "doBlind",
+       "bkgFunctions", "useSameDMSMSigPDF", "workspaceOptions"};
+  const int nTestStatSettings = 2;
+  TString testStatSettings[nTestStatSettings]
+    = {"doBlind", "testStatOptions"};
+  const int nMuLimitSettings = 2;
+  TString muLimitSettings[nMuLimitSettings] = {"doBlind", "muLimitOptions"};
+  const int nPseudoExpSettings = 7;
+  TString pseudoExpSettings[nPseudoExpSettings]
+    = {"toySeed", "nToysTotal", "nToysPerJob", "pseudoExpOptions",
+       "PseudoExpWorkers", "ToyBins", "ImportanceMuDM"};
+  
+  std::vector<TString> sigSMModes = m_config->getStrV("sigSMModes");
+  std::vector<TString> sigDMModes = m_config->getStrV("sigDMModes");
+  std::vector<TString> bkgProcesses = m_config->getStrV("BkgProcesses");
+  std::vector<TString> allSamples; allSamples.clear();
+  allSamples.push_back("Data");
+  allSamples.insert(allSamples.end(),sigSMModes.begin(),sigSMModes.end());
+  allSamples.insert(allSamples.end(),sigDMModes.begin(),sigDMModes.end());
+  allSamples.insert(allSamples.end(),bkgProcesses.begin(),bkgProcesses.end());
+  
+  // Step 1: The mass points of each sample. The MxAOD list of the sample is
+  // part of its settings, since the MxAODs themselves are remote:
+  if (stepList.Contains("MassPoints")) {
+    for (int i_s = 0; i_s < (int)allSamples.size(); i_s++) {
+      std::vector<TString> outputs; outputs.clear();
+      for (int i_c = 0; i_c < nCategories; i_c++) {
+	outputs.push_back(Form("%s/DMMassPoints/%s_%d_%s.bin", jobDir.Data(),
+			       cateScheme.Data(), i_c, allSamples[i_s].Data()));
+      }
+      std::vector<TString> settings(massPointSettings,
+				    massPointSettings + nMassPointSettings);
+      settings.push_back(Form("MxAODList_%s", allSamples[i_s].Data()));
+      addStep(Form("MassPoints_%s", allSamples[i_s].Data()),
+	      Form("%s MassPoints %s %s", master.Data(), m_configFile.Data(),
+		   allSamples[i_s].Data()),
+	      "", outputs, settings, noDependencies);
+    }
+  }
+  
+  // Step 2: The SM signal parameterization is shared by all DM signals:
+  std::vector<TString> sigParamInputs(sigParamSettings,
+				      sigParamSettings + nSigParamSettings);
+  if (stepList.Contains("SigParam")) {
+    std::vector<TString> outputs; outputs.clear();
+    outputs.push_back(Form("%s/DMSigParam/res_SMworkspace.root",
+			   jobDir.Data()));
+    std::vector<TString> dependencies; dependencies.clear();
+    for (int i_SM = 0; i_SM < (int)sigSMModes.size(); i_SM++) {
+      dependencies.push_back(Form("MassPoints_%s", sigSMModes[i_SM].Data()));
+      if (splitSMModes) {
+	outputs.push_back(Form("%s/DMSigParam/res_%sworkspace.root",
+			       jobDir.Data(), sigSMModes[i_SM].Data()));
+      }
+    }
+    addStep("SigParam_SM", Form("%s SigParam %s SM", master.Data(),
+				m_configFile.Data()),
+	    "", outputs, sigParamInputs, findSteps(dependencies));
+  }
+  
+  // Steps 2-7: The chain of steps for each DM signal:
+  for (int i_DM = 0; i_DM < (int)sigDMModes.size(); i_DM++) {
+    TString currSignal = sigDMModes[i_DM];
+  
+    if (stepList.Contains("SigParam")) {
+      std::vector<TString> outputs; outputs.clear();
+      outputs.push_back(Form("%s/DMSigParam/res_%sworkspace.root",
+			     jobDir.Data(), currSignal.Data()));
+      std::vector<TString> dependencies; dependencies.clear();
+      dependencies.push_back(Form("MassPoints_%s", currSignal.Data()));
+      addStep(Form("SigParam_%s", currSignal.Data()),
+	      Form("%s SigParam %s %s", master.Data(), m_configFile.Data(),
+		   currSignal.Data()),
+	      "", outputs, sigParamInputs, findSteps(dependencies));
+    }
+  
+    if (stepList.Contains("Workspace")) {
+      std::vector<TString> outputs; outputs.clear();
+      outputs.push_back(Form("%s/DMWorkspace/rootfiles/workspaceDM_%s.root",
+			     jobDir.Data(), currSignal.Data()));
+      std::vector<TString> dependencies; dependencies.clear();
+      dependencies.push_back("SigParam_SM");
+      dependencies.push_back(Form("SigParam_%s", currSignal.Data()));
+      dependencies.push_back("MassPoints_Data");
+      dependencies.push_back(Form("MassPoints_%s", currSignal.Data()));
+      for (int i_SM = 0; i_SM < (int)sigSMModes.size(); i_SM++) {
+	dependencies.push_back(Form("MassPoints_%s", sigSMModes[i_SM].Data()));
+      }
+      for (int i_b = 0; i_b < (int)bkgProcesses.size(); i_b++) {
+	dependencies.push_back(Form("MassPoints_%s",bkgProcesses[i_b].Data()));
+      }
+      addStep(Form("Workspace_%s", currSignal.Data()),
+	      Form("%s Workspace %s %s", master.Data(), m_configFile.Data(),
+		   currSignal.Data()),
+	      "", outputs,
+	      std::vector<TString>(workspaceSettings,
+				   workspaceSettings + nWorkspaceSettings),
+	      findSteps(dependencies));
+    }
+  
+    std::vector<TString> workspaceStep; workspaceStep.clear();
+    workspaceStep.push_back(Form("Workspace_%s", currSignal.Data()));
+  
+    if (stepList.Contains("TestStat")) {
+      std::vector<TString> outputs; outputs.clear();
+      outputs.push_back(Form("%s/DMTestStat/CL/CL_values_%s.txt",
+			     jobDir.Data(), currSignal.Data()));
+      outputs.push_back(Form("%s/DMTestStat/p0/p0_values_%s.txt",
+			     jobDir.Data(), currSignal.Data()));
+      addStep(Form("TestStat_%s", currSignal.Data()),
+	      Form("%s TestStat %s %s", master.Data(), m_configFile.Data(),
+		   currSignal.Data()),
+	      "", outputs,
+	      std::vector<TString>(testStatSettings,
+				   testStatSettings + nTestStatSettings),
+	      findSteps(workspaceStep));
+    }
+  
+    // DMMuLimit copies the workspace of the signal into the current directory:
+    if (stepList.Contains("MuLimit")) {
+      std::vector<TString> outputs; outputs.clear();
+      outputs.push_back(Form("%s/DMMuLimit/single_files/text_CLs_%s.txt",
+			     jobDir.Data(), currSignal.Data()));
+      addStep(Form("MuLimit_%s", currSignal.Data()),
+	      Form("%s/%s %s %s %s", binDir.Data(),
+		   (m_config->getStr("exeMuLimit")).Data(),
+		   m_configFile.Data(), currSignal.Data(),
+		   (m_config->getStr("muLimitOptions")).Data()),
+	      "", outputs,
+	      std::vector<TString>(muLimitSettings,
+				   muLimitSettings + nMuLimitSettings),
+	      findSteps(workspaceStep));
+    }
+  
+    // The toys of the example signal, as in DMMaster (including the extra
+    // signal strengths for importance sampling). Every job copies the
+    // workspace into the current directory, so each needs its own directory:
+    if (stepList.Contains("PseudoExp") &&
+	currSignal.EqualTo(m_config->getStr("exampleSignal"))) {
+      int toySeed = m_config->getInt("toySeed");
+      int nToysTotal = m_config->getInt("nToysTotal");
+      int nToysPerJob = m_config->getInt("nToysPerJob");
+      TString toyOptions = m_config->getStr("pseudoExpOptions");
+      std::vector<int> toyMuValues
+	= DMAnalysis::getExtraToyMuValues(m_config, toyOptions);
+      toyMuValues.insert(toyMuValues.begin(), 1);
+      toyMuValues.insert(toyMuValues.begin(), 0);
+      for (int i_s = toySeed; i_s < toySeed + nToysTotal; i_s += nToysPerJob) {
+	TString toyCommand = Form("%s/%s %s %s %s %d %d", binDir.Data(),
+				  (m_config->getStr("exePseudoExp")).Data(),
+				  m_configFile.Data(), currSignal.Data(),
+				  toyOptions.Data(), i_s, nToysPerJob);
+	std::vector<TString> outputs; outputs.clear();
+	TString stepCommand = "";
+	for (int i_m = 0; i_m < (int)toyMuValues.size(); i_m++) {
+	  outputs.push_back(Form("%s/DMPseudoExp/single_files/%s/toy_mu%d_%d"
+				 ".root", jobDir.Data(), currSignal.Data(),
+				 toyMuValues[i_m], i_s));
+	  if (i_m > 0) stepCommand += " && ";
+	  stepCommand += Form("%s %d", toyCommand.Data(), toyMuValues[i_m]);
+	}
+	TString stepName = Form("PseudoExp_%s_%d", currSignal.Data(), i_s);
+	addStep(stepName, stepCommand,
+		Form("%s/run/%s", m_logDir.Data(), stepName.Data()), outputs,
+		std::vector<TString>(pseudoExpSettings,
+				     pseudoExpSettings + nPseudoExpSettings),
+		findSteps(workspaceStep));
+      }
+    }
+  }
+  std::cout << "DMPipeline: Defined " << nSteps() << " steps." << std::endl;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Find a step by name.
+   @param stepName - The name of the step.
+   @return - The index of the step, or -1 if it does not exist.
+*/
+int DMPipeline::findStep(TString stepName) {
+  for (int i_s = 0; i_s < nSteps(); i_s++) {
+    if (m_stepNames[i_s].EqualTo(stepName)) return i_s;
+  }
+  return -1;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Find the steps that exist among a list of names. Steps that are not in the
+   pipeline are assumed to have been run already.
+   @param stepNames - The names of the steps.
+   @return - The indices of the steps in the pipeline.
+*/
+std::vector<int> DMPipeline::findSteps(std::vector<TString> stepNames) {
+  std::vector<int> result; result.clear();
+  for (int i_n = 0; i_n < (int)stepNames.size(); i_n++) {
+    int stepIndex = findStep(stepNames[i_n]);
+    if (stepIndex >= 0) result.push_back(stepIndex);
+  }
+  return result;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Get the modification time of a file.
+   @param fileName - The name of the file.
+   @return - The modification time in seconds, or -1 if the file is missing.
+*/
+Long_t DMPipeline::getModTime(TString fileName) {
+  FileStat_t fileInfo;
+  if (gSystem->GetPathInfo(fileName, fileInfo) != 0) return -1;
+  return fileInfo.fMtime;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Get the stamp of a step, which changes whenever the command or any of the
+   config settings used by the step changes.
+   @param stepIndex - The index of the step.
+   @return - The MD5 sum of the command and settings.
+*/
+TString DMPipeline::getStamp(int stepIndex) {
+  TString fingerprint = Form("%s;", m_commands[stepIndex].Data());
+  std::vector<TString> settings = m_settings[stepIndex];
+  TIter next(m_config->getDB()->GetTable());
+  while (TEnvRec *record = (TEnvRec*)next()) {
+    TString name = record->GetName();
+    for (int i_s = 0; i_s < (int)settings.size(); i_s++) {
+      if (name.BeginsWith(settings[i_s])) {
+	fingerprint += Form("%s=%s;", name.Data(), record->GetValue());
+	break;
+      }
+    }
+  }
+  
+  TMD5 md5;
+  md5.Update((const UChar_t*)fingerprint.Data(), fingerprint.Length());
+  md5.Final();
+  return md5.AsString();
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Get the name of the stamp file of a step.
+   @param stepIndex - The index of the step.
+   @return - The name of the stamp file.
+*/
+TString DMPipeline::getStampFileName(int stepIndex) {
+  return Form("%s/stamps/%s.stamp", m_outputDir.Data(),
+	      m_stepNames[stepIndex].Data());
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Check whether a step can be skipped. The stamp of the last successful run
+   must match, and the outputs must exist and be no older than the outputs of
+   the dependencies.
+   @param stepIndex - The index of the step.
+   @return - True iff the step is up to date.
+*/
+bool DMPipeline::isUpToDate(int stepIndex) {
+  if (m_options.Contains("Force")) return false;
+  
+  // The command and settings must match those of the last successful run:
+  std::ifstream stampFile(getStampFileName(stepIndex));
+  if (!stampFile.is_open()) return false;
+  std::string stamp;
+  stampFile >> stamp;
+  stampFile.close();
+  if (!getStamp(stepIndex).EqualTo(stamp.c_str())) return false;
+  
+  // The oldest output must be newer than the outputs of the dependencies:
+  Long_t oldestOutput = -1;
+  for (int i_o = 0; i_o < (int)m_outputs[stepIndex].size(); i_o++) {
+    Long_t modTime = getModTime(m_outputs[stepIndex][i_o]);
+    if (modTime < 0) return false;
+    if (oldestOutput < 0 || modTime < oldestOutput) oldestOutput = modTime;
+  }
+  for (int i_d = 0; i_d < (int)m_dependencies[stepIndex].size(); i_d++) {
+    int dependency = m_dependencies[stepIndex][i_d];
+    for (int i_o = 0; i_o < (int)m_outputs[dependency].size(); i_o++) {
+      if (getModTime(m_outputs[dependency][i_o]) > oldestOutput) return false;
+    }
+  }
+  return true;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   @return - The number of steps in the pipeline.
+*/
+int DMPipeline::nSteps() {
+  return (int)m_stepNames.size();
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Check that all of the outputs of a step exist.
+   @param stepIndex - The index of the step.
+   @return - True iff all outputs exist.
+*/
+bool DMPipeline::outputsExist(int stepIndex) {
+  for (int i_o = 0; i_o < (int)m_outputs[stepIndex].size(); i_o++) {
+    if (gSystem->AccessPathName(m_outputs[stepIndex][i_o])) {
+      std::cout << "DMPipeline: Missing output " << m_outputs[stepIndex][i_o]
+		<< std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Print the steps of the pipeline and their dependencies.
+*/
+void DMPipeline::printSteps() {
+  std::cout << "DMPipeline: Printing steps." << std::endl;
+  for (int i_s = 0; i_s < nSteps(); i_s++) {
+    std::cout << "\t" << m_stepNames[i_s] << " <-";
+    for (int i_d = 0; i_d < (int)m_dependencies[i_s].size(); i_d++) {
+      std::cout << " " << m_stepNames[m_dependencies[i_s][i_d]];
+    }
+    std::cout << std::endl;
+  }
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Run the pipeline. Steps start as soon as their dependencies have finished,
+   and steps depending on a failed step are blocked.
+   @return - True iff all steps succeeded or were up to date.
+*/
+bool DMPipeline::run() {
+  int nSlots = m_config->getInt("LocalJobSlots", 0);
+  if (nSlots < 1) nSlots = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  DMJobPool *pool = new DMJobPool(nSlots);
+  std::vector<int> jobSteps; jobSteps.clear();
+  
+  while (true) {
+    // Queue (or skip) every step whose dependencies have finished:
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      for (int i_s = 0; i_s < nSteps(); i_s++) {
+	if (m_stepStates[i_s] != kPending) continue;
+	bool isReady = true;
+	bool isBlocked = false;
+	for (int i_d = 0; i_d < (int)m_dependencies[i_s].size(); i_d++) {
+	  int state = m_stepStates[m_dependencies[i_s][i_d]];
+	  if (state == kFailed || state == kBlocked) isBlocked = true;
+	  else if (state != kDone && state != kUpToDate) isReady = false;
+	}
+	if (isBlocked) {
+	  std::cout << "DMPipeline: Blocked " << m_stepNames[i_s] << std::endl;
+	  m_stepStates[i_s] = kBlocked;
+	  changed = true;
+	}
+	else if (isReady && isUpToDate(i_s)) {
+	  std::cout << "DMPipeline: Up to date " << m_stepNames[i_s]
+		    << std::endl;
+	  m_stepStates[i_s] = kUpToDate;
+	  changed = true;
+	}
+	else if (isReady) {
+	  TString jobName = m_config->getStr("jobName");
+	  pool->addJob(m_stepNames[i_s], m_commands[i_s],
+		       m_workDirectories[i_s],
+		       Form("%s/out/%s_%s.out", m_logDir.Data(), jobName.Data(),
+			    m_stepNames[i_s].Data()),
+		       Form("%s/err/%s_%s.err", m_logDir.Data(), jobName.Data(),
+			    m_stepNames[i_s].Data()));
+	  jobSteps.push_back(i_s);
+	  m_stepStates[i_s] = kRunning;
+	}
+      }
+    }
+  
+    // Wait for the next job to finish:
+    int nActive = 0;
+    for (int i_s = 0; i_s < nSteps(); i_s++) {
+      if (m_stepStates[i_s] == kRunning) nActive++;
+    }
+    if (nActive == 0) break;
+    int jobIndex = pool->waitForAnyJob();
+    if (jobIndex < 0) continue;
+  
+    // A job that exits normally can still be missing outputs:
+    int stepIndex = jobSteps[jobIndex];
+    if (pool->getExitStatus(jobIndex) == 0 && outputsExist(stepIndex)) {
+      m_stepStates[stepIndex] = kDone;
+      writeStamp(stepIndex);
+    }
+    else {
+      std::cout << "DMPipeline: Failed " << m_stepNames[stepIndex]
+		<< std::endl;
+      m_stepStates[stepIndex] = kFailed;
+    }
+  }
+  pool->printReport();
+  pool->writeReport(Form("%s/jobReport.txt", m_logDir.Data()));
+  delete pool;
+  
+  // Summarize the states of all steps:
+  int nStates[6] = {0, 0, 0, 0, 0, 0};
+  for (int i_s = 0; i_s < nSteps(); i_s++) nStates[m_stepStates[i_s]]++;
+  std::cout << "DMPipeline: " << nStates[kDone] << " steps done, "
+	    << nStates[kUpToDate] << " up to date, " << nStates[kFailed]
+	    << " failed, " << nStates[kBlocked] << " blocked." << std::endl;
+  return (nStates[kFailed] == 0 && nStates[kBlocked] == 0);
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Write the stamp of a successful step.
+   @param stepIndex - The index of the step.
+*/
+void DMPipeline::writeStamp(int stepIndex) {
+  std::ofstream stampFile(getStampFileName(stepIndex));
+  stampFile << getStamp(stepIndex) << std::endl;
+  stampFile.close();
+}
@@ -0,0 +1,87 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: DMPipeline.h                                                        //
+//  Class: DMPipeline.cxx                                                     //
+//                                                                            //
+//  Author: agent                                                             //
+//  Date: 16/10/2026                                                          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef DMPipeline_h
+#define DMPipeline_h
+
+// C++ includes:
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <unistd.h>
+
+// ROOT includes:
+#include "TString.h"
+#include "TSystem.h"
+#include "TEnv.h"
+#include "THashList.h"
+#include "TMD5.h"
+
+// Package includes:
+#include "Config.h"
+#include "DMAnalysis.h"
+#include "DMJobPool.h"
+
+class DMPipeline
+{
+  
+ public:
+  
+  // Status of each step in the pipeline:
+  enum StepState { kPending, kRunning, kDone, kUpToDate, kFailed, kBlocked };
+  
+  DMPipeline(TString newConfigFile, TString newOptions);
+  virtual ~DMPipeline();
+  
+  // Accessors:
+  int findStep(TString stepName);
+  bool isUpToDate(int stepIndex);
+  int nSteps();
+  void printSteps();
+  
+  // Mutators:
+  int addStep(TString stepName, TString command, TString workDirectory,
+	      std::vector<TString> outputs, std::vector<TString> settings,
+	      std::vector<int> dependencies);
+  void buildAnalysis(std::vector<TString> stepTypes);
+  bool run();
+  
+ private:
+  
+  // Member methods:
+  std::vector<int> findSteps(std::vector<TString> stepNames);
+  Long_t getModTime(TString fileName);
+  TString getStamp(int stepIndex);
+  TString getStampFileName(int stepIndex);
+  bool outputsExist(int stepIndex);
+  void writeStamp(int stepIndex);
+  
+  // Member objects:
+  Config *m_config;
+  TString m_configFile;
+  TString m_options;
+  TString m_outputDir;
+  TString m_logDir;
+  
+  // The steps of the pipeline (indexed by step):
+  std::vector<TString> m_stepNames;
+  std::vector<TString> m_commands;
+  std::vector<TString> m_workDirectories;
+  std::vector<std::vector<TString> > m_outputs;
+  std::vector<std::vector<TString> > m_settings;
+  std::vector<std::vector<int> > m_dependencies;
+  std::vector<int> m_stepStates;
+  
+};
+
+#endif
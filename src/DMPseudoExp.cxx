@@ -11,11 +11,33 @@
 //                                                                            //
 //  Note: this program has been developed to work in conjunction with the     //
 //  DMTestStat class, in order to reduce the code redundancy for calculation  //
-//  of test statistics. Also, the input workspace is loaded in a loop because //
-//  for some reason it is impossible to overwrite entries in a workspace.     //
+//  of test statistics. The input workspace and likelihood are loaded once    //
+//  per job: the toy datasets are kept out of the workspace, and only the     //
+//  data of the NLL are replaced from one toy to the next.                    //
+//                                                                            //
+//  The toys of a job can be split among "PseudoExpWorkers" forked worker     //
+//  processes. Each worker has its own copy of the loaded workspace, and fits //
+//  every N-th toy. The main process is the only writer of the output tree,   //
+//  and collects the toys in seed order, so that the output is identical to   //
+//  that of a single process.                                                 //
+//                                                                            //
+//  The names of the nuisance parameters and global observables are written   //
+//  once per file (TNamed "toyNamesNP" and "toyNamesGlobs"), and each toy     //
+//  stores their values as fixed-size float arrays in the same order. The     //
+//  tree is saved every "ToyFlushInterval" toys. If a job stops, the next job //
+//  with the same seed keeps the saved toys and continues after them, but     //
+//  only if the TNamed "toyStamp" (workspace MD5, options, FixMu, ToyBins and //
+//  toys per job) matches and the file holds no more toys than the job.       //
+//  Otherwise the file is recreated.                                          //
+//                                                                            //
+//  With the "Importance" option, the NLL of each toy is also evaluated at    //
+//  the generated parameters for each mu_DM in "ImportanceMuDM" (TNamed       //
+//  "toyWeightMuValues", branch "nllGen"). Toys generated at any of these     //
+//  signal strengths can then be weighted to the background-only hypothesis,  //
+//  in order to reach small tail p-values with fewer toys (DMToyAnalysis).    //
 //                                                                            //
 //  options:                                                                  //
-//      Binned, FixMu                                                         //
+//      Binned, RooFitBinned, FixMu, Importance                               //
 //                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -24,12 +46,30 @@
 #include "CommonFunc.h"
 #include "Config.h"
 #include "DMAnalysis.h"
+#include "DMJobLedger.h"
 #include "DMTestStat.h"
 #include "RooBernsteinM.h"
 #include "RooFitHead.h"
 #include "RooStatsHead.h"
 #include "statistics.h"
 
+// C++ includes:
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+// The results of the fits to one pseudo-experiment:
+struct ToyResult {
+  int seed;
+  double numEvents, muDMVal, nllMu0, nllMu1, nllMuFree;
+  double llrL1L0, llrL0Lfree, llrL1Lfree;
+  bool convergedMu0, convergedMu1, convergedMuFree;
+  std::vector<double> valuesNPMu0, valuesNPMu1, valuesNPMuFree;
+  std::vector<double> valuesGlobsMu0, valuesGlobsMu1, valuesGlobsMuFree;
+  std::vector<double> nllGen;
+};
+
 /*
    -----------------------------------------------------------------------------
    Generates a pseudo-experiment dataset. 
@@ -110,6 +150,200 @@ void createPseudoData(RooWorkspace *w, ModelConfig *mc, int seed) {
 }
 */
 
+/**
+   -----------------------------------------------------------------------------
+   Generate and fit one pseudo-experiment. The result only depends on the seed,
+   not on the toys that were previously fitted with the same DMTestStat.
+   @param dmts - the DMTestStat with the loaded workspace.
+   @param seed - the random seed for the pseudo-experiment.
+   @param inputMuDM - the value of the DM signal strength to use.
+   @param fixMu - true if mu should be fixed for the generation.
+   @param weightMuValues - the values of mu at which to evaluate the NLL of the
+   toy before the fits, for importance weights (can be empty).
+   @param toy - the results of the fits (passed by reference).
+*/
+void fitToy(DMTestStat *dmts, int seed, int inputMuDM, bool fixMu,
+	    std::vector<double> weightMuValues, ToyResult &toy) {
+  
+  // Restore the parameters as loaded from the file:
+  dmts->resetParams();
+  
+  // Create a pseudo-dataset (not imported into the workspace):
+  RooDataSet *toyData = dmts->generatePseudoData(seed, inputMuDM, 1, fixMu);
+  toy.seed = seed;
+  toy.numEvents = toyData->sumEntries();
+  
+  // The NLL at the generated parameters, for importance weights:
+  toy.nllGen = dmts->getToyNLLValues(toyData, weightMuValues);
+  
+  // Mu = 0 fits:
+  toy.nllMu0 = dmts->getFitNLL(toyData, 0, true, toy.muDMVal);
+  toy.convergedMu0 = dmts->fitsAllConverged();
+  toy.valuesNPMu0 = dmts->getNPValues();
+  toy.valuesGlobsMu0 = dmts->getGlobsValues();
+  
+  // Mu = 1 fits:
+  toy.nllMu1 = dmts->getFitNLL(toyData, 1, true, toy.muDMVal);
+  toy.convergedMu1 = dmts->fitsAllConverged();
+  toy.valuesNPMu1 = dmts->getNPValues();
+  toy.valuesGlobsMu1 = dmts->getGlobsValues();
+  
+  // Mu free fits:
+  toy.nllMuFree = dmts->getFitNLL(toyData, 1, false, toy.muDMVal);
+  toy.convergedMuFree = dmts->fitsAllConverged();
+  toy.valuesNPMuFree = dmts->getNPValues();
+  toy.valuesGlobsMuFree = dmts->getGlobsValues();
+  
+  // Calculate profile likelihood ratios:
+  toy.llrL1L0 = toy.nllMu1 - toy.nllMu0;
+  toy.llrL1Lfree = toy.muDMVal > 1.0 ? 0.0 : (toy.nllMu1 - toy.nllMuFree);
+  toy.llrL0Lfree = toy.muDMVal < 0.0 ? 0.0 : (toy.nllMu0 - toy.nllMuFree);
+  
+  delete toyData;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Read or write a block of bytes through a pipe, in as many calls as needed.
+   @param fd - the file descriptor of the pipe.
+   @param buffer - the bytes to read or write.
+   @param size - the number of bytes.
+   @param doWrite - true to write, false to read.
+   @returns - true iff all of the bytes were transferred.
+*/
+bool transferBytes(int fd, void *buffer, size_t size, bool doWrite) {
+  char *bytes = (char*)buffer;
+  while (size > 0) {
+    ssize_t nBytes = doWrite ? write(fd, bytes, size) : read(fd, bytes, size);
+    if (nBytes <= 0) return false;
+    bytes += nBytes;
+    size -= nBytes;
+  }
+  return true;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Read or write a vector of values through a pipe, preceded by its size.
+   @param fd - the file descriptor of the pipe.
+   @param values - the values to read or write (passed by reference).
+   @param doWrite - true to write, false to read.
+   @returns - true iff all of the values were transferred.
+*/
+bool transferValues(int fd, std::vector<double> &values, bool doWrite) {
+  int size = (int)values.size();
+  if (!transferBytes(fd, &size, sizeof(size), doWrite)) return false;
+  values.resize(size);
+  return (size == 0 ||
+	  transferBytes(fd, &values[0], size * sizeof(double), doWrite));
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Read or write the results of one pseudo-experiment through a pipe.
+   @param fd - the file descriptor of the pipe.
+   @param toy - the results to read or write (passed by reference).
+   @param doWrite - true to write, false to read.
+   @returns - true iff the results were transferred.
+*/
+bool transferToy(int fd, ToyResult &toy, bool doWrite) {
+  double values[9] = {toy.numEvents, toy.muDMVal, toy.nllMu0, toy.nllMu1,
+		      toy.nllMuFree, toy.llrL1L0, toy.llrL0Lfree,
+		      toy.llrL1Lfree, 0.0};
+  values[8] = (toy.convergedMu0 ? 1.0 : 0.0) + (toy.convergedMu1 ? 2.0 : 0.0)
+    + (toy.convergedMuFree ? 4.0 : 0.0);
+  if (!transferBytes(fd, &toy.seed, sizeof(toy.seed), doWrite) ||
+      !transferBytes(fd, values, sizeof(values), doWrite) ||
+      !transferValues(fd, toy.valuesNPMu0, doWrite) ||
+      !transferValues(fd, toy.valuesNPMu1, doWrite) ||
+      !transferValues(fd, toy.valuesNPMuFree, doWrite) ||
+      !transferValues(fd, toy.valuesGlobsMu0, doWrite) ||
+      !transferValues(fd, toy.valuesGlobsMu1, doWrite) ||
+      !transferValues(fd, toy.valuesGlobsMuFree, doWrite) ||
+      !transferValues(fd, toy.nllGen, doWrite)) {
+    return false;
+  }
+  toy.numEvents = values[0];
+  toy.muDMVal = values[1];
+  toy.nllMu0 = values[2];
+  toy.nllMu1 = values[3];
+  toy.nllMuFree = values[4];
+  toy.llrL1L0 = values[5];
+  toy.llrL0Lfree = values[6];
+  toy.llrL1Lfree = values[7];
+  int converged = (int)values[8];
+  toy.convergedMu0 = (converged & 1);
+  toy.convergedMu1 = (converged & 2);
+  toy.convergedMuFree = (converged & 4);
+  return true;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Get the names of a set of parameters, separated by spaces. The order is that
+   of the values from DMTestStat::getNPValues() and getGlobsValues().
+   @param set - the set of parameters.
+   @returns - the list of names.
+*/
+TString getNameList(const RooArgSet *set) {
+  TString nameList = "";
+  TIterator *iterSet = set->createIterator();
+  RooAbsArg *currArg = NULL;
+  while ((currArg = (RooAbsArg*)iterSet->Next())) {
+    if (!nameList.EqualTo("")) nameList += " ";
+    nameList += currArg->GetName();
+  }
+  delete iterSet;
+  return nameList;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Create a branch of the toy tree, or connect an existing one.
+   @param tree - the toy tree.
+   @param name - the name of the branch.
+   @param address - the address of the variable for the branch.
+   @param leafList - the leaf list of the branch.
+   @param create - true to create the branch, false to connect it.
+*/
+void connectBranch(TTree *tree, TString name, void *address, TString leafList,
+		   bool create) {
+  if (create) tree->Branch(name, address, leafList);
+  else tree->SetBranchAddress(name, address);
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Copy the values of the parameters of a toy into the fixed-size arrays of the
+   tree, in single precision.
+   @param toy - the results of the fits to the toy.
+   @param columns - the arrays (NPs for mu = 0, 1, free, then the global
+   observables for mu = 0, 1, free).
+   @param nllGen - the array of NLL values for importance weights, which are
+   kept in double precision.
+*/
+void fillColumns(ToyResult &toy, std::vector<float> &columns,
+		 std::vector<double> &nllGen) {
+  std::vector<double> *values[6] = {&toy.valuesNPMu0, &toy.valuesNPMu1,
+				    &toy.valuesNPMuFree, &toy.valuesGlobsMu0,
+				    &toy.valuesGlobsMu1,
+				    &toy.valuesGlobsMuFree};
+  int nNP = (int)toy.valuesNPMu0.size();
+  int nGlobs = (int)toy.valuesGlobsMu0.size();
+  int index = 0;
+  for (int i_v = 0; i_v < 6; i_v++) {
+    int nValues = (i_v < 3) ? nNP : nGlobs;
+    for (int i_p = 0; i_p < nValues && index < (int)columns.size(); i_p++) {
+      columns[index] = (float)((*values[i_v])[i_p]);
+      index++;
+    }
+  }
+  for (int i_m = 0; i_m < (int)toy.nllGen.size() &&
+	 i_m < (int)nllGen.size(); i_m++) {
+    nllGen[i_m] = toy.nllGen[i_m];
+  }
+}
+
 /**
    -----------------------------------------------------------------------------
    The main method. 
@@ -137,6 +371,12 @@ int main(int argc, char **argv) {
   // Load the analysis configurations from file:
   Config *config = new Config(configFile);
   
+  // Record the job in the ledger, by the first seed:
+  int firstSeed = seed;
+  TString ledgerJobType = Form("DMPseudoExp_mu%d", inputMuDM);
+  DMJobLedger *ledger = new DMJobLedger(configFile);
+  ledger->recordStart(ledgerJobType, DMSignal, firstSeed, nToysPerJob);
+  
   // Copy the input workspace file locally:
   TString originFile = Form("%s/%s/DMWorkspace/rootfiles/workspaceDM_%s.root",
 			    (config->getStr("masterOutput")).Data(), 
@@ -145,143 +385,249 @@ int main(int argc, char **argv) {
   TString copiedFile = Form("workspaceDM_%s.root", DMSignal.Data());
   system(Form("cp %s %s", originFile.Data(), copiedFile.Data()));
   
-  // Create output TTree:
+  // Output file name:
   TString outputDir = Form("%s/%s/DMPseudoExp", 
 			   (config->getStr("masterOutput")).Data(),
 			   (config->getStr("jobName")).Data());
-  TString tempOutputFileName = Form("%s/single_files/toy_mu%i_%i.root",
-				    outputDir.Data(), inputMuDM, seed);
+  TString tempOutputFileName = Form("%s/single_files/%s/toy_mu%i_%i.root",
+				    outputDir.Data(), DMSignal.Data(),
+				    inputMuDM, seed);
   
   // Construct the output directories:
   system(Form("mkdir -vp %s/err", outputDir.Data()));
   system(Form("mkdir -vp %s/log", outputDir.Data()));
-  system(Form("mkdir -vp %s/single_files", outputDir.Data()));
+  system(Form("mkdir -vp %s/single_files/%s", outputDir.Data(),
+	      DMSignal.Data()));
+  
+  // Load the model from the workspace once, and reuse it for all of the toys:
+  TFile inputFile(copiedFile, "read");
+  RooWorkspace *workspace = (RooWorkspace*)inputFile.Get("combinedWS");
+  ModelConfig *mc = (ModelConfig*)workspace->obj("modelConfig");
+  DMTestStat *dmts = new DMTestStat(configFile, DMSignal, "new_" + options,
+				    workspace);
+  bool fixMu = options.Contains("FixMu");
+  
+  // The signal strengths for the importance weights, stored once per file:
+  std::vector<double> weightMuValues; weightMuValues.clear();
+  TString namesWeightMu = "";
+  if (options.Contains("Importance")) {
+    weightMuValues = config->getNumV("ImportanceMuDM");
+    for (int i_m = 0; i_m < (int)weightMuValues.size(); i_m++) {
+      if (i_m > 0) namesWeightMu += " ";
+      namesWeightMu += Form("%g", weightMuValues[i_m]);
+    }
+  }
+  
+  // The names of the parameters, stored once per file:
+  TString namesNP = getNameList(mc->GetNuisanceParameters());
+  TString namesGlobs = getNameList(mc->GetGlobalObservables());
+  int nNP = mc->GetNuisanceParameters()->getSize();
+  int nGlobs = mc->GetGlobalObservables()->getSize();
+  
+  // The settings that the toys depend on, stored once per file:
+  TString workspaceMD5 = "none";
+  TMD5 *md5 = TMD5::FileChecksum(copiedFile);
+  if (md5) workspaceMD5 = md5->AsString();
+  delete md5;
+  TString toyStamp = Form("%s %s fixMu=%d bins=%d nToys=%d",
+			  workspaceMD5.Data(), options.Data(), (int)fixMu,
+			  config->getInt("ToyBins", 120), nToysPerJob);
   
-  // Output file:
-  TFile fOutputFile(tempOutputFileName, "recreate");
-  TTree fOutputTree("toy", "toy");
+  // Keep the toys saved by a previous job with the same seed and settings:
+  int nSavedToys = 0;
+  TFile *fOutputFile = TFile::Open(tempOutputFileName, "update");
+  TTree *toyTree = NULL;
+  if (fOutputFile && !fOutputFile->IsZombie()) {
+    toyTree = (TTree*)fOutputFile->Get("toy");
+    TNamed *savedNamesNP = (TNamed*)fOutputFile->Get("toyNamesNP");
+    TNamed *savedNamesGlobs = (TNamed*)fOutputFile->Get("toyNamesGlobs");
+    TNamed *savedWeightMu = (TNamed*)fOutputFile->Get("toyWeightMuValues");
+    TString savedNamesWeightMu = savedWeightMu ? savedWeightMu->GetTitle() : "";
+    TNamed *savedStamp = (TNamed*)fOutputFile->Get("toyStamp");
+    if (toyTree && savedNamesNP && savedNamesGlobs && savedStamp &&
+	namesNP.EqualTo(savedNamesNP->GetTitle()) &&
+	namesGlobs.EqualTo(savedNamesGlobs->GetTitle()) &&
+	namesWeightMu.EqualTo(savedNamesWeightMu) &&
+	toyStamp.EqualTo(savedStamp->GetTitle()) &&
+	toyTree->GetEntries() <= nToysPerJob) {
+      nSavedToys = (int)toyTree->GetEntries();
+    }
+    else {
+      if (toyTree) {
+	std::cout << "DMPseudoExp: Saved toys in " << tempOutputFileName
+		  << " do not match the job settings, recreating." << std::endl;
+      }
+      toyTree = NULL;
+    }
+  }
+  if (!toyTree) {
+    if (fOutputFile) delete fOutputFile;
+    fOutputFile = new TFile(tempOutputFileName, "recreate");
+    TNamed("toyNamesNP", namesNP.Data()).Write();
+    TNamed("toyNamesGlobs", namesGlobs.Data()).Write();
+    TNamed("toyStamp", toyStamp.Data()).Write();
+    if (weightMuValues.size() > 0) {
+      TNamed("toyWeightMuValues", namesWeightMu.Data()).Write();
+    }
+    toyTree = new TTree("toy", "toy");
+  }
+  else {
+    std::cout << "DMPseudoExp: Keeping " << nSavedToys << " saved toys from "
+	      << tempOutputFileName << std::endl;
+  }
   
   // Variables to store in the TTree:
-  double numEvents;
-  bool convergedMu1, convergedMu0, convergedMuFree;
-  double muDMVal, nllMu0, nllMu1, nllMuFree, llrL1L0, llrL0Lfree, llrL1Lfree;
-  
-  std::vector<std::string> namesNP; namesNP.clear();
-  std::vector<double> valuesNPMu0; valuesNPMu0.clear();
-  std::vector<double> valuesNPMu1; valuesNPMu1.clear();
-  std::vector<double> valuesNPMuFree; valuesNPMuFree.clear();
-  std::vector<string> namesGlobs; namesGlobs.clear();
-  std::vector<double> valuesGlobsMu0; valuesGlobsMu0.clear();
-  std::vector<double> valuesGlobsMu1; valuesGlobsMu1.clear();
-  std::vector<double> valuesGlobsMuFree; valuesGlobsMuFree.clear();
-    
-  fOutputTree.Branch("seed", &seed, "seed/I");
-  fOutputTree.Branch("numEvents", &numEvents, "numEvents/D");
-  fOutputTree.Branch("muDMVal", &muDMVal, "muDMVal/D");
-  fOutputTree.Branch("convergedMu0", &convergedMu0, "convergedMu0/O");
-  fOutputTree.Branch("convergedMu1", &convergedMu1, "convergedMu1/O");
-  fOutputTree.Branch("convergedMuFree", &convergedMuFree, "convergedMuFree/O");
-  fOutputTree.Branch("nllMu0", &nllMu0, "nllMu0/D");
-  fOutputTree.Branch("nllMu1", &nllMu1, "nllMu1/D");
-  fOutputTree.Branch("nllMuFree", &nllMuFree, "nllMuFree/D");
-  fOutputTree.Branch("llrL1L0", &llrL1L0, "llrL1L0/D");
-  fOutputTree.Branch("llrL0Lfree", &llrL0Lfree, "llrL0Lfree/D");
-  fOutputTree.Branch("llrL1Lfree", &llrL1Lfree, "llrL1Lfree/D");
-  //fOutputTree.Branch("numEventsPerCate", &numEventsPerCate);
-  fOutputTree.Branch("namesNP", &namesNP);
-  fOutputTree.Branch("valuesNPMu0", &valuesNPMu0);
-  fOutputTree.Branch("valuesNPMu1", &valuesNPMu1);
-  fOutputTree.Branch("valuesNPMuFree", &valuesNPMuFree);
-  fOutputTree.Branch("namesGlobs", &namesGlobs);
-  fOutputTree.Branch("valuesGlobsMu1", &valuesGlobsMu1);
-  fOutputTree.Branch("valuesGlobsMu0", &valuesGlobsMu0);
-  fOutputTree.Branch("valuesGlobsMuFree", &valuesGlobsMuFree);
+  ToyResult toy;
+  std::vector<float> columns(3 * (nNP + nGlobs) + 1, 0.0);
+  bool create = (nSavedToys == 0);
+  connectBranch(toyTree, "seed", &toy.seed, "seed/I", create);
+  connectBranch(toyTree, "numEvents", &toy.numEvents, "numEvents/D", create);
+  connectBranch(toyTree, "muDMVal", &toy.muDMVal, "muDMVal/D", create);
+  connectBranch(toyTree, "convergedMu0", &toy.convergedMu0, "convergedMu0/O",
+		create);
+  connectBranch(toyTree, "convergedMu1", &toy.convergedMu1, "convergedMu1/O",
+		create);
+  connectBranch(toyTree, "convergedMuFree", &toy.convergedMuFree,
+		"convergedMuFree/O", create);
+  connectBranch(toyTree, "nllMu0", &toy.nllMu0, "nllMu0/D", create);
+  connectBranch(toyTree, "nllMu1", &toy.nllMu1, "nllMu1/D", create);
+  connectBranch(toyTree, "nllMuFree", &toy.nllMuFree, "nllMuFree/D", create);
+  connectBranch(toyTree, "llrL1L0", &toy.llrL1L0, "llrL1L0/D", create);
+  connectBranch(toyTree, "llrL0Lfree", &toy.llrL0Lfree, "llrL0Lfree/D",
+		create);
+  connectBranch(toyTree, "llrL1Lfree", &toy.llrL1Lfree, "llrL1Lfree/D",
+		create);
+  TString arrayNames[6] = {"valuesNPMu0", "valuesNPMu1", "valuesNPMuFree",
+			   "valuesGlobsMu0", "valuesGlobsMu1",
+			   "valuesGlobsMuFree"};
+  int index = 0;
+  for (int i_a = 0; i_a < 6; i_a++) {
+    int nValues = (i_a < 3) ? nNP : nGlobs;
+    if (nValues == 0) continue;
+    connectBranch(toyTree, arrayNames[i_a], &columns[index],
+		  Form("%s[%d]/F", arrayNames[i_a].Data(), nValues), create);
+    index += nValues;
+  }
+  std::vector<double> nllGen(weightMuValues.size() + 1, 0.0);
+  if (weightMuValues.size() > 0) {
+    connectBranch(toyTree, "nllGen", &nllGen[0],
+		  Form("nllGen[%d]/D", (int)weightMuValues.size()), create);
+  }
   
   // Loop to generate pseudo experiments:
-  std::cout << "DMPseudoExp: Generating " << nToysPerJob
+  std::cout << "DMPseudoExp: Generating " << (nToysPerJob - nSavedToys)
 	    << " toys with mu_DM = " << inputMuDM << endl;
-  for (int i_t = 0; i_t < nToysPerJob; i_t++) {
-    
-    // Load model, data, etc. from workspace:
-    TFile inputFile(copiedFile, "read");
-    RooWorkspace *workspace = (RooWorkspace*)inputFile.Get("combinedWS");    
-    
-    /*
-    ModelConfig *mc = (ModelConfig*)workspace->obj("modelConfig");
-    TString dataName = (DMAnalysis::doBlind) ? "asimovDataMu0" : "obsData";
-    if (options.Contains("FixBkgParam")) dataName = "asimovDataMu0";
-    RooAbsData *obsData = workspace->data(dataName);
-    
-    // Get the POI (mu):
-    RooRealVar* firstPOI = (RooRealVar*)mc->GetParametersOfInterest()->first();
-    //statistics::setDefaultPrintLevel(0);
-    //statistics::setDefaultMinimizer("Minuit");
-    
-    // Load snapshot of profiled data:
-    workspace->loadSnapshot("paramsOrigin");
-    RooArgSet* nuisAndPOI = new RooArgSet();
-    nuisAndPOI->add(*(RooArgSet*)mc->GetNuisanceParameters());
-    nuisAndPOI->add(*(RooArgSet*)mc->GetParametersOfInterest());
-    double fixedMu = (double)inputMuDM;
-    
-    // Load the newly-created snapshot:
-    workspace->loadSnapshot("paramsOrigin");
-    if (options.Contains("FixMu")) {
-      firstPOI->setVal(fixedMu);
-      firstPOI->setConstant(true);
+  int flushInterval = config->getInt("ToyFlushInterval", 20);
+  if (flushInterval < 1) flushInterval = 1;
+  TStopwatch timer;
+  timer.Start();
+  
+  // Fit the toys in this process:
+  int nWorkers = config->getInt("PseudoExpWorkers", 1);
+  if (nWorkers > nToysPerJob - nSavedToys) nWorkers = nToysPerJob - nSavedToys;
+  if (nWorkers <= 1) {
+    for (int i_t = nSavedToys; i_t < nToysPerJob; i_t++) {
+      fitToy(dmts, seed + i_t, inputMuDM, fixMu, weightMuValues, toy);
+      fillColumns(toy, columns, nllGen);
+      toyTree->Fill();
+      if ((i_t + 1) % flushInterval == 0) toyTree->AutoSave("SaveSelf");
+    }
+  }
+  
+  // Or fit every N-th toy in each of N worker processes:
+  else {
+    std::cout << "DMPseudoExp: Using " << nWorkers << " worker processes."
+	      << std::endl;
+    std::vector<int> workerPipes; workerPipes.clear();
+    std::vector<pid_t> workerPIDs; workerPIDs.clear();
+    for (int i_w = 0; i_w < nWorkers; i_w++) {
+      int fds[2];
+      if (pipe(fds) != 0) {
+	std::cout << "DMPseudoExp: Error! Could not create a pipe."
+		  << std::endl;
+	ledger->recordEnd(ledgerJobType, DMSignal, firstSeed, nToysPerJob, 1);
+	exit(1);
+      }
+      
+      // Buffered output would otherwise be written by both processes:
+      std::cout.flush();
+      std::cerr.flush();
+      fflush(NULL);
+      
+      pid_t pid = fork();
+      if (pid < 0) {
+	std::cout << "DMPseudoExp: Error! Could not start a worker."
+		  << std::endl;
+	ledger->recordEnd(ledgerJobType, DMSignal, firstSeed, nToysPerJob, 1);
+	exit(1);
+      }
+      
+      // The worker sends its toys to the main process, and exits without
+      // touching the output file:
+      if (pid == 0) {
+	close(fds[0]);
+	for (int i_p = 0; i_p < (int)workerPipes.size(); i_p++) {
+	  close(workerPipes[i_p]);
+	}
+	for (int i_t = nSavedToys + i_w; i_t < nToysPerJob; i_t += nWorkers) {
+	  fitToy(dmts, seed + i_t, inputMuDM, fixMu, weightMuValues, toy);
+	  if (!transferToy(fds[1], toy, true)) _exit(1);
+	}
+	close(fds[1]);
+	std::cout.flush();
+	fflush(NULL);
+	_exit(0);
+      }
+      close(fds[1]);
+      workerPipes.push_back(fds[0]);
+      workerPIDs.push_back(pid);
     }
     
-    // Create a pseudo-dataset:
-    createPseudoData(workspace, mc, seed);
-    firstPOI->setConstant(false);
-    */
-        
-    DMTestStat *dmts = new DMTestStat(configFile, DMSignal, "new", workspace);
-    
-    RooDataSet *newToyData
-      = dmts->createPseudoData(seed, inputMuDM, 1, options.Contains("FixMu"));
-    numEvents = workspace->data("toyData")->sumEntries();
-    
-    // Mu = 0 fits:
-    nllMu0 = dmts->getFitNLL("toyData", 0, true, muDMVal);
-    convergedMu0 = dmts->fitsAllConverged();
-    namesNP = dmts->getNPNames();
-    valuesNPMu0 = dmts->getNPValues();
-    namesGlobs = dmts->getGlobsNames();
-    valuesGlobsMu0 = dmts->getGlobsValues();
-    
-    // Mu = 1 fits:
-    nllMu1 = dmts->getFitNLL("toyData", 1, true, muDMVal);
-    convergedMu1 = dmts->fitsAllConverged();
-    valuesNPMu1 = dmts->getNPValues();
-    valuesGlobsMu1 = dmts->getGlobsValues();
-    
-    // Mu free fits:
-    nllMuFree = dmts->getFitNLL("toyData", 1, false, muDMVal);
-    convergedMuFree = dmts->fitsAllConverged();
-    valuesNPMuFree = dmts->getNPValues();
-    valuesGlobsMuFree = dmts->getGlobsValues();
-    
-    // Calculate profile likelihood ratios:
-    llrL1L0 = nllMu1 - nllMu0;
-    llrL1Lfree = muDMVal > 1.0 ? 0.0 : (nllMu1 - nllMuFree);
-    llrL0Lfree = muDMVal < 0.0 ? 0.0 : (nllMu0 - nllMuFree);
-    
-    // Fill the tree:
-    fOutputTree.Fill();
-    
-    // Count the toys:
-    seed++;
-    fOutputTree.AutoSave("SaveSelf");
-    
-    // Close the input file before the loop repeats:
-    inputFile.Close();
+    // Write the toys in seed order, as they would be written by one process:
+    bool allWorkersOK = true;
+    for (int i_t = nSavedToys; i_t < nToysPerJob; i_t++) {
+      int worker = (i_t - nSavedToys) % nWorkers;
+      if (!transferToy(workerPipes[worker], toy, false)) {
+	std::cout << "DMPseudoExp: Error! Worker " << worker
+		  << " failed before toy " << (seed + i_t) << std::endl;
+	allWorkersOK = false;
+	break;
+      }
+      fillColumns(toy, columns, nllGen);
+      toyTree->Fill();
+      if ((i_t + 1) % flushInterval == 0) toyTree->AutoSave("SaveSelf");
+    }
+    for (int i_w = 0; i_w < nWorkers; i_w++) {
+      if (!allWorkersOK) kill(workerPIDs[i_w], SIGTERM);
+      close(workerPipes[i_w]);
+      int status = 0;
+      waitpid(workerPIDs[i_w], &status, 0);
+      if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) allWorkersOK = false;
+    }
+    if (!allWorkersOK) {
+      // Save the completed toys for the next job:
+      toyTree->AutoSave("SaveSelf");
+      ledger->recordEnd(ledgerJobType, DMSignal, firstSeed, nToysPerJob, 1);
+      exit(1);
+    }
+  }
+  delete dmts;
+  inputFile.Close();
+  timer.Stop();
+  std::cout << "DMPseudoExp: Fitted " << (nToysPerJob - nSavedToys)
+	    << " toys in " << timer.RealTime() << " s";
+  if (nToysPerJob > nSavedToys && timer.RealTime() > 0.0) {
+    std::cout << " (" << (nToysPerJob - nSavedToys) / timer.RealTime()
+	      << " toys/s)";
   }
+  std::cout << "." << std::endl;
   
   // Write the output file, delete local file copies:
-  fOutputFile.cd();
-  fOutputTree.Write();
-  fOutputFile.Close();
+  fOutputFile->cd();
+  toyTree->Write("", TObject::kOverwrite);
+  fOutputFile->Close();
   system(Form("rm %s",copiedFile.Data()));
+  ledger->recordEnd(ledgerJobType, DMSignal, firstSeed, nToysPerJob, 0);
+  delete ledger;
   return 0;
 }
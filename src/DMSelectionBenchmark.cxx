@@ -0,0 +1,404 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: DMSelectionBenchmark.cxx                                            //
+//                                                                            //
+//  Creator: agent                                                            //
+//  Date: 16/10/2026                                                          //
+//                                                                            //
+//  This program times the compiled selection plan of DMEvtSelect against the //
+//  former string-based passesCut() and getCategoryNumber() on the same       //
+//  events, and checks that the two cutflows and categorizations are          //
+//  identical (integer and weighted counts compared exactly).                 //
+//                                                                            //
+//  The events are first copied into a memory-resident tree, so that file     //
+//  access does not enter the comparison. The time to read the events alone   //
+//  is measured separately and subtracted from both selections.               //
+//                                                                            //
+//  Usage: DMSelectionBenchmark <configFile> <sampleName> [nEvents]           //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// C++ libraries:
+#include <iostream>
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+// ROOT libraries:
+#include "TChain.h"
+#include "TLorentzVector.h"
+#include "TROOT.h"
+#include "TStopwatch.h"
+#include "TString.h"
+#include "TTree.h"
+
+// Package libraries:
+#include "CommonFunc.h"
+#include "Config.h"
+#include "DMAnalysis.h"
+#include "DMEvtSelect.h"
+#include "DMTree.h"
+
+/**
+   -----------------------------------------------------------------------------
+   The string-based selection that DMEvtSelect used before the selection plan
+   was compiled. The cuts and categories are looked up by name and the
+   thresholds are read from the configuration for every event. Only the
+   nominal selection is reproduced.
+*/
+class DMLegacySelect
+{
+
+ public:
+
+  DMLegacySelect(DMTree *newTree, Config *newConfig);
+
+  bool passesCut(TString cutName, double weight);
+  int getCategoryNumber(TString cateScheme, double weight);
+
+  Config *m_config;
+  DMTree *m_evtTree;
+  std::vector<TString> m_cutList;
+  std::map<TString,int> m_evtCountPass;
+  std::map<TString,double> m_evtCountPassWt;
+  std::map<TString,int> m_evtCountTot;
+  std::map<TString,double> m_evtCountTotWt;
+  std::map<TString,int> m_cateCount;
+  std::map<TString,double> m_cateCountWt;
+};
+
+/**
+   -----------------------------------------------------------------------------
+   Initializes the cut list and the counters as the former DMEvtSelect did.
+   @param newTree - The tree which contains the sample.
+   @param newConfig - The analysis configuration.
+*/
+DMLegacySelect::DMLegacySelect(DMTree *newTree, Config *newConfig) {
+  m_config = newConfig;
+  m_evtTree = newTree;
+
+  // Get the MxAOD cuts and then the analysis-specific cuts:
+  m_cutList = m_config->getStrV("MxAODCutList");
+  if (m_config->getBool("LeptonVeto")) m_cutList.push_back("LeptonVeto");
+  if (m_config->isDefined("AnaCutDiphotonPT")) {
+    m_cutList.push_back("DiphotonPT");
+  }
+  if (m_config->isDefined("AnaCutETMiss")) {
+    m_cutList.push_back("DiphotonETMiss");
+  }
+  m_cutList.push_back("AllCuts");
+
+  // Initialize all counters to zero:
+  for (int i_c = 0; i_c < (int)m_cutList.size(); i_c++) {
+    m_evtCountPass[m_cutList[i_c]] = 0;
+    m_evtCountPassWt[m_cutList[i_c]] = 0.0;
+    m_evtCountTot[m_cutList[i_c]] = 0;
+    m_evtCountTotWt[m_cutList[i_c]] = 0.0;
+  }
+  TString cateScheme = m_config->getStr("cateScheme");
+  for (int i_c = 0; i_c < m_config->getInt("nCategories"); i_c++) {
+    m_cateCount[Form("%s_%d", cateScheme.Data(), i_c)] = 0;
+    m_cateCountWt[Form("%s_%d", cateScheme.Data(), i_c)] = 0.0;
+  }
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Check whether a weighted event passes the specified cut, by name.
+   @param cutName - The name of the cut.
+   @param weight - The event weight.
+   @return - True iff the event passes the cut.
+*/
+bool DMLegacySelect::passesCut(TString cutName, double weight) {
+
+  bool passes = true;
+
+  bool isMxAODCut = false;
+  int currCutIndex = 0;
+  std::vector<TString> cutFlowMxAODs = m_config->getStrV("MxAODCutList");
+  for (currCutIndex = 0; currCutIndex < (int)cutFlowMxAODs.size();
+       currCutIndex++) {
+    if (cutName.EqualTo(cutFlowMxAODs[currCutIndex])) {
+      isMxAODCut = true;
+      break;
+    }
+  }
+
+  // MxAOD cuts:
+  if (isMxAODCut) {
+    passes = (m_evtTree->HGamEventInfoAuxDyn_cutFlow[0] > currCutIndex);
+  }
+  // Lepton Veto Cut:
+  else if (cutName.EqualTo("LeptonVeto") && m_config->getBool("LeptonVeto")) {
+    passes = ((m_evtTree->HGamElectronsAuxDyn_pt)->size() == 0 &&
+	      (m_evtTree->HGamMuonsAuxDyn_pt)->size() == 0);
+  }
+  // Cut on the diphoton transverse momentum:
+  else if (cutName.EqualTo("DiphotonPT")) {
+    passes = (m_evtTree->HGamEventInfoAuxDyn_pT_yy[0] >
+	      m_config->getNum("AnaCutDiphotonPT"));
+  }
+  // Cut on the event missing transverse energy:
+  else if (cutName.EqualTo("DiphotonETMiss")) {
+    passes = (m_evtTree->HGamEventInfoAuxDyn_TST_met[0] >
+	      m_config->getNum("AnaCutETMiss"));
+  }
+  // Check whether event passes all of the cuts above:
+  else if (cutName.EqualTo("AllCuts")) {
+    for (int i_c = 0; i_c < (int)m_cutList.size(); i_c++) {
+      if (m_cutList[i_c].EqualTo("AllCuts")) {
+	continue;
+      }
+      else if (!passesCut(m_cutList[i_c], weight)) {
+	passes = false;
+	break;
+      }
+    }
+  }
+
+  // Add to the counters:
+  m_evtCountTot[cutName]++;
+  m_evtCountTotWt[cutName] += weight;
+  if (passes) {
+    m_evtCountPass[cutName]++;
+    m_evtCountPassWt[cutName] += weight;
+  }
+  return passes;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Find the category in which this weighted event belongs, by scheme name.
+   @param cateScheme - The name of the categorization.
+   @param weight - The event weight.
+   @return - The category number for the event.
+*/
+int DMLegacySelect::getCategoryNumber(TString cateScheme, double weight) {
+
+  int currCate = -1;
+  double etMiss = m_evtTree->HGamEventInfoAuxDyn_TST_met[0];
+  double pTyy = m_evtTree->HGamEventInfoAuxDyn_pT_yy[0];
+
+  // Inclusive categorization - only 1 category.
+  if (cateScheme.EqualTo("inclusive")) {
+    currCate = 0;
+  }
+  // Split MET - low and high MET categories.
+  else if (cateScheme.EqualTo("splitETMiss")) {
+    if (etMiss > 140000.0) currCate = 1;
+    else currCate = 0;
+  }
+  // Ratio ETMiss/pT categorization:
+  else if (cateScheme.EqualTo("RatioEtmPt")) {
+    double ratioCut1 = m_config->getNum("RatioCut1");
+    double ratioCut2 = m_config->getNum("RatioCut2");
+    double currRatio = (m_evtTree->HGamEventInfoAuxDyn_TST_met[0] /
+			m_evtTree->HGamEventInfoAuxDyn_pT_yy[0]);
+    if (currRatio < ratioCut1) currCate = 0;
+    else if (currRatio >= ratioCut1 && currRatio < ratioCut2) currCate = 1;
+    else if (currRatio >= ratioCut2) currCate = 2;
+  }
+  else if (cateScheme.EqualTo("combined")) {
+
+    // Calculate pTHard. The phi and m of the objects only enter the z and E
+    // components of these vectors, so they are no longer read (set to 0):
+    TLorentzVector sumParticles;
+    for (int i_p = 0; i_p < (int)(m_evtTree->HGamPhotonsAuxDyn_pt)->size();
+	 i_p++) {
+      TLorentzVector photon((*m_evtTree->HGamPhotonsAuxDyn_pt)[i_p],
+			    (*m_evtTree->HGamPhotonsAuxDyn_eta)[i_p],
+			    0.0, 0.0);
+      sumParticles += photon;
+    }
+    for (int i_j = 0; i_j <
+	   (int)(m_evtTree->HGamAntiKt4EMTopoJetsAuxDyn_pt)->size(); i_j++) {
+      TLorentzVector jet((*m_evtTree->HGamAntiKt4EMTopoJetsAuxDyn_pt)[i_j],
+			 (*m_evtTree->HGamAntiKt4EMTopoJetsAuxDyn_eta)[i_j],
+			 0.0, 0.0);
+      sumParticles += jet;
+    }
+    double pTHard = sumParticles.Pt();
+
+    if (etMiss > m_config->getNum("ETMissCut2")) {
+      if (pTyy > m_config->getNum("DiphotonPTCut2")) currCate = 4;
+      else currCate = 3;
+    }
+    else if (etMiss > m_config->getNum("ETMissCut1") &&
+	     pTHard > m_config->getNum("PTHardCut")) {
+      currCate = 2;
+    }
+    else if (pTyy > m_config->getNum("DiphotonPTCut1")) {
+      currCate = 1;
+    }
+    else {
+      currCate = 0;
+    }
+  }
+  if (currCate == -1) {
+    std::cout << "DMLegacySelect: Categorization error for " << cateScheme
+	      << std::endl;
+    exit(0);
+  }
+
+  // Add to category counters:
+  m_cateCount[Form("%s_%d",cateScheme.Data(),currCate)]++;
+  m_cateCountWt[Form("%s_%d",cateScheme.Data(),currCate)] += weight;
+  return currCate;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   The weight of the current event, as used for the cutflow.
+   @param dmt - The tree holding the current event.
+   @param isWeighted - True iff the sample is weighted.
+   @return - The event weight.
+*/
+double eventWeight(DMTree *dmt, bool isWeighted) {
+  if (!isWeighted) return 1.0;
+  return (1000.0 * dmt->HGamEventInfoAuxDyn_crossSectionBRfilterEff *
+	  dmt->HGamEventInfoAuxDyn_weight);
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Compare one pair of counters and print any difference.
+   @param name - The name of the counter.
+   @param legacyValue - The value from the string-based selection.
+   @param planValue - The value from the compiled selection plan.
+   @return - True iff the two values are identical.
+*/
+bool sameCount(TString name, double legacyValue, double planValue) {
+  if (legacyValue == planValue) return true;
+  printf("DMSelectionBenchmark: Mismatch in %s: %.17g vs. %.17g\n",
+	 name.Data(), legacyValue, planValue);
+  return false;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   The main method times the two selections and compares their counters.
+   @param configFile - The analysis configuration file.
+   @param sampleName - The sample whose events are selected.
+   @param nEvents - The maximum number of events to use (default 100000).
+*/
+int main(int argc, char **argv) {
+
+  // Check that arguments are provided.
+  if (argc < 3) {
+    std::cout << "\nUsage: " << argv[0]
+	      << " <configFile> <sampleName> [nEvents]" << std::endl;
+    exit(0);
+  }
+  TString configFile = argv[1];
+  TString sampleName = argv[2];
+  Long64_t nEvents = (argc > 3) ? atol(argv[3]) : 100000;
+
+  // Load the analysis configuration file:
+  Config *config = new Config(configFile);
+  TString cateScheme = config->getStr("cateScheme");
+  bool isWeighted = DMAnalysis::isWeightedSample(config, sampleName);
+
+  // Bind all of the branches either selection can use:
+  TString listName = DMAnalysis::nameToFileList(config, sampleName, false);
+  TChain *chain = CommonFunc::MakeChain("CollectionTree", listName, "badfile");
+  std::vector<TString> noSys; noSys.clear();
+  DMTree *fileTree = new DMTree(chain, noSys);
+  fileTree->requireObjects(DMTree::kLeptonBranches |
+			   DMTree::kPhotonJetBranches);
+
+  // Copy the events into memory, so that both selections read the same events
+  // without touching the files:
+  if (nEvents <= 0 || nEvents > chain->GetEntries()) {
+    nEvents = chain->GetEntries();
+  }
+  gROOT->cd();
+  TTree *memTree = chain->CloneTree(0);
+  memTree->SetDirectory(0);
+  for (Long64_t event = 0; event < nEvents; event++) {
+    chain->GetEntry(event);
+    memTree->Fill();
+  }
+  std::cout << "DMSelectionBenchmark: Copied " << nEvents << " events of "
+	    << sampleName << " into memory." << std::endl;
+
+  DMTree *dmt = new DMTree(memTree, noSys);
+  dmt->requireObjects(DMTree::kLeptonBranches | DMTree::kPhotonJetBranches);
+  DMLegacySelect *legacy = new DMLegacySelect(dmt, config);
+  DMEvtSelect *selector = new DMEvtSelect(dmt, config);
+  int allCutsID = selector->cutIndex("AllCuts");
+
+  // Time the reading of the events alone:
+  TStopwatch timer;
+  timer.Start();
+  for (Long64_t event = 0; event < nEvents; event++) {
+    dmt->fChain->GetEntry(event);
+    eventWeight(dmt, isWeighted);
+  }
+  double readTime = timer.RealTime();
+
+  // Time the string-based selection:
+  timer.Start();
+  for (Long64_t event = 0; event < nEvents; event++) {
+    dmt->fChain->GetEntry(event);
+    double evtWeight = eventWeight(dmt, isWeighted);
+    if (!legacy->passesCut("AllCuts", evtWeight)) continue;
+    legacy->getCategoryNumber(cateScheme, evtWeight);
+  }
+  double legacyTime = timer.RealTime() - readTime;
+
+  // Time the compiled selection plan:
+  timer.Start();
+  for (Long64_t event = 0; event < nEvents; event++) {
+    dmt->fChain->GetEntry(event);
+    double evtWeight = eventWeight(dmt, isWeighted);
+    if (!selector->passesCut(allCutsID, evtWeight)) continue;
+    selector->getCategoryNumber(evtWeight);
+  }
+  double planTime = timer.RealTime() - readTime;
+
+  // Compare the cutflows and categorizations exactly:
+  bool identical = true;
+  for (int i_c = 0; i_c < (int)legacy->m_cutList.size(); i_c++) {
+    TString cutName = legacy->m_cutList[i_c];
+    identical &= sameCount(cutName + " passing",
+			   legacy->m_evtCountPass[cutName],
+			   selector->getPassingEvents(cutName));
+    identical &= sameCount(cutName + " passing weighted",
+			   legacy->m_evtCountPassWt[cutName],
+			   selector->getPassingEventsWt(cutName));
+    identical &= sameCount(cutName + " total",
+			   legacy->m_evtCountTot[cutName],
+			   selector->getTotalEvents(cutName));
+    identical &= sameCount(cutName + " total weighted",
+			   legacy->m_evtCountTotWt[cutName],
+			   selector->getTotalEventsWt(cutName));
+  }
+  for (int i_c = 0; i_c < config->getInt("nCategories"); i_c++) {
+    TString cateName = Form("%s_%d", cateScheme.Data(), i_c);
+    identical &= sameCount(cateName, legacy->m_cateCount[cateName],
+			   selector->getEventsPerCate(cateScheme, i_c));
+    identical &= sameCount(cateName + " weighted",
+			   legacy->m_cateCountWt[cateName],
+			   selector->getEventsPerCateWt(cateScheme, i_c));
+  }
+
+  // Print the summary:
+  printf("\nDMSelectionBenchmark: %lld events, reading %.3f s\n",
+	 nEvents, readTime);
+  printf("  string-based selection: %.3f s (%.3g events/s)\n", legacyTime,
+	 legacyTime > 0.0 ? nEvents / legacyTime : 0.0);
+  printf("  compiled selection:     %.3f s (%.3g events/s)\n", planTime,
+	 planTime > 0.0 ? nEvents / planTime : 0.0);
+  if (planTime > 0.0) printf("  speedup: %.2f\n", legacyTime / planTime);
+  printf("  cutflows and categories: %s\n\n",
+	 identical ? "identical" : "DIFFERENT");
+
+  delete selector;
+  delete legacy;
+  delete dmt;
+  delete memTree;
+  delete fileTree;
+  delete chain;
+  return identical ? 0 : 1;
+}
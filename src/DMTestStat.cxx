@@ -9,6 +9,16 @@
 //  This class allows the user to calculate p0, CL, and CLs based on an input //
 //  workspace.                                                                //
 //                                                                            //
+//  For pseudo-experiments, one instance can fit many toy datasets: the NLL   //
+//  is built for the first toy and only its data are replaced afterwards, and //
+//  resetParams() restores the parameters between toys.                       //
+//                                                                            //
+//  With the "Binned" option, toys are drawn as Poisson counts in "ToyBins"   //
+//  bins of each category, from expected yields that are cached until the     //
+//  parameters (not the global observables) change, and checked once against  //
+//  the RooFit binned generator. "RooFitBinned" uses the RooFit binned        //
+//  generator.                                                                //
+//                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
 
 #include "DMTestStat.h"
@@ -85,6 +95,10 @@ DMTestStat::DMTestStat(TString newConfigFile, TString newDMSignal,
     exit(0);
   }
   
+  // Keep the initial parameters in memory, to reset them between toys:
+  m_initialParams = (RooArgSet*)m_workspace->allVars().snapshot();
+  m_toyNLL = NULL;
+  
   // Map storing all calculations:
   m_calculatedValues.clear();
   
@@ -104,6 +118,15 @@ DMTestStat::DMTestStat(TString newConfigFile, TString newDMSignal,
   return;
 }
 
+/**
+   -----------------------------------------------------------------------------
+   Delete the NLL and parameter snapshot owned by the class.
+*/
+DMTestStat::~DMTestStat() {
+  if (m_toyNLL) delete m_toyNLL;
+  delete m_initialParams;
+}
+
 /**
    -----------------------------------------------------------------------------
    Get the value of one of the test statistics.
@@ -127,10 +150,7 @@ void DMTestStat::calculateNewCL() {
   std::cout << "DMTestStat: Calculating CLs" << std::endl;
   
   // Calculate observed qmu: 
-  double muHatObs = 0.0;
-  double nllMu1Obs = getFitNLL(m_dataForObsQMu, 1.0, true, muHatObs);
-  double nllMuHatObs = getFitNLL(m_dataForObsQMu, 1.0, false, muHatObs);
-  double obsQMu = getQMuFromNLL(nllMu1Obs, nllMuHatObs, muHatObs, 1);
+  double obsQMu = calculateObsTestStat("QMu");
   
   // Calculate expected qmu:
   double muHatExp = 0.0;
@@ -192,10 +212,7 @@ void DMTestStat::calculateNewP0() {
   std::cout << "DMTestStat: calculating p0." << std::endl;
   
   // Calculate observed q0: 
-  double muHatObs = 0.0;
-  double nllMu0Obs = getFitNLL(m_dataForObsQ0, 0.0, true, muHatObs);
-  double nllMuHatObs = getFitNLL(m_dataForObsQ0, 0.0, false, muHatObs);
-  double obsQ0 = getQ0FromNLL(nllMu0Obs, nllMuHatObs, muHatObs);
+  double obsQ0 = calculateObsTestStat("Q0");
   
   // Calculate expected q0:
   double muHatExp = 0.0;
@@ -229,6 +246,29 @@ void DMTestStat::calculateNewP0() {
   m_calculatedValues[getKey("p0", 0, 0)] = expP0;
 }
 
+/**
+   -----------------------------------------------------------------------------
+   Calculate the observed value of a test statistic using model fits.
+   @param testStat - the test statistic ("QMu" or "Q0").
+   @returns - the observed value of the test statistic.
+*/
+double DMTestStat::calculateObsTestStat(TString testStat) {
+  double muHatObs = 0.0;
+  if (testStat.EqualTo("QMu")) {
+    double nllMu1Obs = getFitNLL(m_dataForObsQMu, 1.0, true, muHatObs);
+    double nllMuHatObs = getFitNLL(m_dataForObsQMu, 1.0, false, muHatObs);
+    return getQMuFromNLL(nllMu1Obs, nllMuHatObs, muHatObs, 1);
+  }
+  else if (testStat.EqualTo("Q0")) {
+    double nllMu0Obs = getFitNLL(m_dataForObsQ0, 0.0, true, muHatObs);
+    double nllMuHatObs = getFitNLL(m_dataForObsQ0, 0.0, false, muHatObs);
+    return getQ0FromNLL(nllMu0Obs, nllMuHatObs, muHatObs);
+  }
+  std::cout << "DMTestStat: Error! Unknown test statistic " << testStat
+	    << std::endl;
+  exit(0);
+}
+
 /**
    -----------------------------------------------------------------------------
    Clears all data stored by the class, but does not modify the workspace.
@@ -340,7 +380,8 @@ void DMTestStat::createAsimovData(TString datasetName) {
 
 /**
    -----------------------------------------------------------------------------
-   Create a pseudo-dataset with a given value of DM and SM signal strength.
+   Create a pseudo-dataset with a given value of DM and SM signal strength, and
+   import it into the workspace as "toyData".
    @param seed - the random seed for dataset generation.
    @param valMuDM - the value of the DM signal strength.
    @param valMuSM - the value of the SM signal strength.
@@ -348,6 +389,28 @@ void DMTestStat::createAsimovData(TString datasetName) {
 */
 RooDataSet* DMTestStat::createPseudoData(int seed, int valMuDM, int valMuSM,
 					 bool fixMu) {
+  RooDataSet* pseudoData = generatePseudoData(seed, valMuDM, valMuSM, fixMu);
+  
+  // Import into the workspace:
+  m_workspace->import(*pseudoData);
+  
+  return pseudoData;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Generate a pseudo-dataset with a given value of DM and SM signal strength.
+   The dataset is not imported into the workspace, and belongs to the caller.
+   The global observables and the events of each category are drawn from
+   separate streams keyed by (signal, mu_DM, seed, stream), so that any toy
+   can be regenerated exactly however the toys are split among jobs.
+   @param seed - the index of the toy, which keys its random streams.
+   @param valMuDM - the value of the DM signal strength.
+   @param valMuSM - the value of the SM signal strength.
+   @returns - a pseudo-dataset.
+*/
+RooDataSet* DMTestStat::generatePseudoData(int seed, int valMuDM, int valMuSM,
+					   bool fixMu) {
   std::cout << "DMTestStat: Create pseudodata with seed = " << seed 
 	    << "muDM = " << valMuDM << " muSM = " << valMuSM << std::endl;
   
@@ -358,11 +421,7 @@ RooDataSet* DMTestStat::createPseudoData(int seed, int valMuDM, int valMuSM,
   RooArgSet* nuisanceParameters = (RooArgSet*)m_mc->GetNuisanceParameters();
   RooArgSet* globalObservables = (RooArgSet*)m_mc->GetGlobalObservables();
   RooArgSet* observables = (RooArgSet*)m_mc->GetObservables();
-  RooArgSet* originValsNP
-    = (RooArgSet*)m_mc->GetNuisanceParameters()->snapshot();
-  RooRealVar* firstPOI = (RooRealVar*)m_mc->GetParametersOfInterest()->first();
   
-  RooRandom::randomGenerator()->SetSeed(seed);
   statistics::constSet(nuisanceParameters, true);
   statistics::constSet(globalObservables, false);
   
@@ -371,11 +430,17 @@ RooDataSet* DMTestStat::createPseudoData(int seed, int valMuDM, int valMuSM,
   TIterator *cateIter = combPdf->indexCat().typeIterator();
   RooCatType *cateType = NULL;
   RooDataSet *dataTemp[20];
+  RooRealVar wt("wt", "wt", 1);
+  bool useBinnedData = false;
   
   // Loop over all channels:
   int index = 0;
   // Previously this was commented and similar line below was uncommented
-  statistics::randomizeSet(combPdf, globalObservables, seed); 
+  // The full 32-bit seed is set here, since randomizeSet takes an int:
+  RooRandom::randomGenerator()
+    ->SetSeed(statistics::toySeed(m_DMSignal, valMuDM, seed,
+				  statistics::kToyGlobs));
+  statistics::randomizeSet(combPdf, globalObservables, -1, &m_globSamplers);
   statistics::constSet(globalObservables, true);
   
   //numEventsPerCate.clear();
@@ -401,21 +466,32 @@ RooDataSet* DMTestStat::createPseudoData(int seed, int valMuDM, int valMuSM,
   while ((cateType = (RooCatType*)cateIter->Next())) {
     RooAbsPdf *currPDF = combPdf->getPdf(cateType->GetName());
     RooArgSet *currObs = currPDF->getObservables(observables);
-    RooArgSet *currGlobs = currPDF->getObservables(globalObservables);
-    RooRealVar *t = (RooRealVar*)currObs->first();
     
     //statistics::randomizeSet(currPDF, currGlobs, -1);
     //statistics::constSet(currGlobs, true);
     
-    // If you want to bin the pseudo-data (speeds up calculation):
-    if (m_options.Contains("Binned")) {
+    // Each category has its own stream of events:
+    RooRandom::randomGenerator()
+      ->SetSeed(statistics::toySeed(m_DMSignal, valMuDM, seed,
+				    statistics::kToyEvents + index));
+    
+    // Draw Poisson counts from the cached yields per bin (fastest):
+    if (m_options.Contains("Binned") && !m_options.Contains("RooFitBinned") &&
+	currObs->getSize() == 1) {
+      dataTemp[index] = generateBinnedData(currPDF, currObs, &wt,
+					   cateType->GetName());
+      useBinnedData = true;
+    }
+    // Or let RooFit bin the pseudo-data (speeds up calculation):
+    else if (m_options.Contains("Binned")) {
       currPDF->setAttribute("PleaseGenerateBinned");
       TIterator *iterObs = currObs->createIterator();
-      RooRealVar *currObs = NULL;
+      RooRealVar *currVar = NULL;
       // Bin each of the observables:
-      while ((currObs = (RooRealVar*)iterObs->Next())) {
-	currObs->setBins(120);
+      while ((currVar = (RooRealVar*)iterObs->Next())) {
+	currVar->setBins(120);
       }
+      delete iterObs;
       dataTemp[index]
 	= (RooDataSet*)currPDF->generate(*currObs, AutoBinned(true),
 					 Extended(currPDF->canBeExtended()),
@@ -428,23 +504,177 @@ RooDataSet* DMTestStat::createPseudoData(int seed, int valMuDM, int valMuSM,
     
     toyDataMap[(std::string)cateType->GetName()] = dataTemp[index];
     //numEventsPerCate.push_back((double)dataTemp[index]->sumEntries());
+    delete currObs;
     index++;
   }
-  
-  // Import the new data into the workspace:
-  RooDataSet* pseudoData = new RooDataSet("toyData", "toyData", *observables, 
-					  RooFit::Index(*categories),
-					  RooFit::Import(toyDataMap));
+  delete cateIter;
+  
+  // Combine the data from the categories (which are copied):
+  RooDataSet* pseudoData = NULL;
+  if (useBinnedData) {
+    RooArgSet dataArgs(*observables, wt);
+    pseudoData = new RooDataSet("toyData", "toyData", dataArgs,
+				RooFit::Index(*categories),
+				RooFit::Import(toyDataMap), WeightVar(wt));
+  }
+  else {
+    pseudoData = new RooDataSet("toyData", "toyData", *observables, 
+				RooFit::Index(*categories),
+				RooFit::Import(toyDataMap));
+  }
+  for (int i_d = 0; i_d < index; i_d++) delete dataTemp[i_d];
   
   // release nuisance parameters:
   statistics::constSet(nuisanceParameters, false);
   
-  // Import into the workspace:
-  m_workspace->import(*pseudoData);
-  
   return pseudoData;
 }
 
+/**
+   -----------------------------------------------------------------------------
+   Generate a binned, weighted pseudo-dataset for one category, by drawing a
+   Poisson count in each bin. The expected yields per bin are integrated with
+   Simpson's rule over the observable-dependent terms of the PDF (without the
+   constraint terms) and normalized to the expected events of the PDF. They
+   are cached, and only recomputed when the parameters of the PDF change.
+   @param currPDF - the PDF of the category.
+   @param currObs - the observable of the category (only one is supported).
+   @param weight - the weight variable of the dataset.
+   @param cateName - the name of the category.
+   @returns - a pseudo-dataset for the category.
+*/
+RooDataSet* DMTestStat::generateBinnedData(RooAbsPdf *currPDF,
+					   RooArgSet *currObs,
+					   RooRealVar *weight,
+					   TString cateName) {
+  RooRealVar *obsVar = (RooRealVar*)currObs->first();
+  int nBins = m_config->getInt("ToyBins", 120);
+  double binWidth = (obsVar->getMax() - obsVar->getMin()) / ((double)nBins);
+  
+  // The parameters of the PDF at the current point. The global observables
+  // are redrawn for each toy but only enter the constraint terms, which cancel
+  // in the normalized PDF, so they are left out of the cache key:
+  std::vector<double> paramValues; paramValues.clear();
+  RooArgSet *params = currPDF->getParameters(currObs);
+  if (m_mc->GetGlobalObservables()) {
+    params->remove(*m_mc->GetGlobalObservables(), true, true);
+  }
+  TIterator *iterParams = params->createIterator();
+  RooRealVar *currParam = NULL;
+  while ((currParam = (RooRealVar*)iterParams->Next())) {
+    paramValues.push_back(currParam->getVal());
+  }
+  delete iterParams;
+  delete params;
+  
+  // Compute the expected yields again if the parameters have changed:
+  std::vector<double> &binYields = m_binYields[cateName];
+  if ((int)binYields.size() != nBins || m_binParams[cateName] != paramValues) {
+    // The constraint terms are not normalized over the observable:
+    RooAbsPdf *obsPDF = RooStats::MakeUnconstrainedPdf(*currPDF, *currObs);
+    if (!obsPDF) {
+      std::cout << "DMTestStat: Error! No observable terms in the PDF of "
+		<< cateName << std::endl;
+      exit(0);
+    }
+    double origObsVal = obsVar->getVal();
+    double integral = 0.0;
+    binYields.clear();
+    for (int i_b = 0; i_b < nBins; i_b++) {
+      double binMin = obsVar->getMin() + i_b * binWidth;
+      obsVar->setVal(binMin);
+      double valMin = obsPDF->getVal(currObs);
+      obsVar->setVal(binMin + 0.5 * binWidth);
+      double valMid = obsPDF->getVal(currObs);
+      obsVar->setVal(binMin + binWidth);
+      double valMax = obsPDF->getVal(currObs);
+      binYields.push_back(binWidth * (valMin + 4.0*valMid + valMax) / 6.0);
+      integral += binYields[i_b];
+    }
+    obsVar->setVal(origObsVal);
+    
+    // Check the binned integral against the RooFit normalization:
+    if (fabs(integral - 1.0) > 0.01) {
+      std::cout << "DMTestStat: Warning! Binned PDF integral in " << cateName
+		<< " is " << integral << ", increase ToyBins." << std::endl;
+    }
+    double nExpected = currPDF->expectedEvents(*currObs);
+    for (int i_b = 0; i_b < nBins; i_b++) {
+      binYields[i_b] *= (nExpected / integral);
+    }
+    m_binParams[cateName] = paramValues;
+    
+    // Validate the yields against the RooFit binned generator once:
+    if (!m_binValidated[cateName]) {
+      validateBinYields(obsPDF, currObs, binYields, cateName);
+      m_binValidated[cateName] = true;
+    }
+    delete obsPDF;
+  }
+  
+  // Draw the number of events in each bin:
+  RooArgSet dataArgs(*obsVar, *weight);
+  RooDataSet *binnedData = new RooDataSet(Form("toyData_%s", cateName.Data()),
+					  Form("toyData_%s", cateName.Data()),
+					  dataArgs, WeightVar(*weight));
+  for (int i_b = 0; i_b < nBins; i_b++) {
+    double nEvents = RooRandom::randomGenerator()->Poisson(binYields[i_b]);
+    if (nEvents <= 0) continue;
+    obsVar->setVal(obsVar->getMin() + (i_b + 0.5) * binWidth);
+    weight->setVal(nEvents);
+    binnedData->add(RooArgSet(*obsVar, *weight), nEvents);
+  }
+  return binnedData;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Compare the expected yields per bin used for the binned toys with the
+   expected data of the RooFit binned generator, in the same binning. RooFit
+   evaluates the PDF at the bin centers, so small differences are expected in
+   bins where the PDF is strongly curved. A warning is printed if a bin with
+   at least one expected event deviates by more than 1%.
+   @param currPDF - the observable-dependent terms of the PDF of the category.
+   @param currObs - the observable of the category (only one is supported).
+   @param binYields - the expected yields per bin from generateBinnedData().
+   @param cateName - the name of the category.
+*/
+void DMTestStat::validateBinYields(RooAbsPdf *currPDF, RooArgSet *currObs,
+				   std::vector<double> binYields,
+				   TString cateName) {
+  RooRealVar *obsVar = (RooRealVar*)currObs->first();
+  int origBins = obsVar->getBins();
+  double origObsVal = obsVar->getVal();
+  obsVar->setBins((int)binYields.size());
+  
+  RooDataHist *expected
+    = currPDF->generateBinned(*currObs, ExpectedData(true),
+			      Extended(currPDF->canBeExtended()));
+  double maxDeviation = 0.0;
+  int maxBin = -1;
+  for (int i_b = 0; i_b < (int)binYields.size(); i_b++) {
+    expected->get(i_b);
+    double rooFitYield = expected->weight();
+    if (rooFitYield < 1.0) continue;
+    double deviation = fabs(binYields[i_b] - rooFitYield) / rooFitYield;
+    if (deviation > maxDeviation) {
+      maxDeviation = deviation;
+      maxBin = i_b;
+    }
+  }
+  std::cout << "DMTestStat: Binned toy yields in " << cateName << " agree with"
+	    << " RooFit within " << 100.0 * maxDeviation << "%." << std::endl;
+  if (maxDeviation > 0.01) {
+    std::cout << "DMTestStat: Warning! Binned toy yield in " << cateName
+	      << " bin " << maxBin << " deviates from RooFit by "
+	      << 100.0 * maxDeviation << "%, check ToyBins." << std::endl;
+  }
+  delete expected;
+  
+  obsVar->setBins(origBins);
+  obsVar->setVal(origObsVal);
+}
+
 /**
    -----------------------------------------------------------------------------
    Check if all of the fits done by this class have converged.
@@ -471,7 +701,7 @@ double DMTestStat::functionQMu(double x) {
    Implements the functional form of qMuTilde.
    @param x - the value of the test statistic.
    @param asimovTestStat - the test stat value on Asimov data with mu=0 but
-                           fitting under mu=1 hypothesis.
+			   fitting under mu=1 hypothesis.
    @returns - the value of the asymptotic test statistic distribution.
 */
 double DMTestStat::functionQMuTilde(double x, double asimovTestStat) {
@@ -550,6 +780,45 @@ double DMTestStat::getCLsFromQMu(double qMu, bool observed, double N) {
 */
 double DMTestStat::getFitNLL(TString datasetName, double muVal, bool fixMu,
 			     double &profiledMu) { 
+  // Check that dataset exists:
+  if (!m_workspace->data(datasetName)) {
+    std::cout << "DMTestStat: Error! Requested data not available: " 
+	      << datasetName << std::endl;
+    exit(0);
+  }
+  return fitNLL(m_workspace->data(datasetName), muVal, fixMu, profiledMu,
+		false);
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Get the negative-log-likelihood for a fit of a specified type to a dataset
+   that is not in the workspace (e.g. a toy dataset). The NLL is built for the
+   first dataset, and only its data are replaced for the following datasets.
+   @param data - the dataset to fit.
+   @param muVal - the mu value to fix.
+   @param fixMu - true if mu should be fixed to the specified value.
+   @param &profiledMu - the profiled value of mu (passed by reference)
+   @returns - the nll value.
+*/
+double DMTestStat::getFitNLL(RooAbsData *data, double muVal, bool fixMu,
+			     double &profiledMu) {
+  return fitNLL(data, muVal, fixMu, profiledMu, true);
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Fit a dataset and get the negative-log-likelihood.
+   @param data - the dataset to fit.
+   @param muVal - the mu value to fix.
+   @param fixMu - true if mu should be fixed to the specified value.
+   @param &profiledMu - the profiled value of mu (passed by reference)
+   @param reuseNLL - true if the NLL of the toy datasets should be reused.
+   @returns - the nll value.
+*/
+double DMTestStat::fitNLL(RooAbsData *data, double muVal, bool fixMu,
+			  double &profiledMu, bool reuseNLL) {
+  TString datasetName = data->GetName();
   std::cout << "DMTestStat: getFitNLL(" << datasetName << ", " << muVal
 	    << ", " << fixMu << ")" << std::endl;
     
@@ -564,14 +833,8 @@ double DMTestStat::getFitNLL(TString datasetName, double muVal, bool fixMu,
   poiAndNuis->add(*nuisanceParameters);
   poiAndNuis->add(*poi);
     
-  // Check that dataset exists:
-  if (!m_workspace->data(datasetName)) {
-    std::cout << "DMTestStat: Error! Requested data not available: " 
-	      << datasetName << std::endl;
-    exit(0);
-  }
-  // Check PDF also exists:
-  else if (!combPdf) {
+  // Check PDF exists:
+  if (!combPdf) {
     std::cout << "DMTestStat: ERROR! Requested PDF not found..." << std::endl;
     exit(0);
   }
@@ -601,14 +864,19 @@ double DMTestStat::getFitNLL(TString datasetName, double muVal, bool fixMu,
     currMuConst->setVal(1.0);
     currMuConst->setConstant(true);
   }
+  delete iterMuConst;
    
-  // The actual fit command:
-  RooNLLVar* varNLL = (RooNLLVar*)combPdf
-    ->createNLL(*m_workspace->data(datasetName), Constrain(*nuisanceParameters),
-  		Extended(combPdf->canBeExtended()));
+  // The actual fit command (the toy NLL only needs the new data):
+  RooAbsReal* varNLL = NULL;
+  if (reuseNLL) varNLL = getToyNLL(data);
+  else {
+    varNLL = combPdf->createNLL(*data, Constrain(*nuisanceParameters),
+				Extended(combPdf->canBeExtended()));
+  }
     
   RooFitResult *fitResult = statistics::minimize(varNLL, "", NULL, true);
   if (!fitResult || fitResult->status() != 0) m_allGoodFits = false;
+  if (fitResult) delete fitResult;
   
   // Save a snapshot if requested:
   if (m_doSaveSnapshot) {
@@ -616,9 +884,10 @@ double DMTestStat::getFitNLL(TString datasetName, double muVal, bool fixMu,
     m_workspace->saveSnapshot(Form("paramsProfileMu%s", muDMValue.Data()),
 			      *poiAndNuis);
   }
+  delete poiAndNuis;
   
   // Plot the fit result if the user has set an output directory for plots:
-  if (m_doPlot) {
+  if (m_doPlot && m_workspace->data(datasetName)) {
     if (fixMu && ((int)muVal) == 1) plotFits("Mu1", datasetName);
     else if (fixMu && ((int)muVal) == 0) plotFits("Mu0", datasetName);
     else plotFits("MuFree", datasetName);
@@ -627,7 +896,7 @@ double DMTestStat::getFitNLL(TString datasetName, double muVal, bool fixMu,
   // Save the NLL and mu from profiling:
   profiledMu = firstpoi->getVal();
   double nllValue = varNLL->getVal();
-  delete varNLL;
+  if (!reuseNLL) delete varNLL;
   
   // Save names and values of nuisance parameters:
   m_namesNP.clear();
@@ -638,6 +907,7 @@ double DMTestStat::getFitNLL(TString datasetName, double muVal, bool fixMu,
     m_namesNP.push_back((std::string)currNuis->GetName());
     m_valuesNP.push_back(currNuis->getVal());
   }
+  delete iterNuis;
   
   // Save names and values of global observables:
   m_namesGlobs.clear();
@@ -648,6 +918,7 @@ double DMTestStat::getFitNLL(TString datasetName, double muVal, bool fixMu,
     m_namesGlobs.push_back((std::string)currGlob->GetName());
     m_valuesGlobs.push_back(currGlob->getVal());
   }
+  delete iterGlobs;
   
   // release nuisance parameters after fit and recovery the default values
   statistics::constSet(nuisanceParameters, false, origValNP);
@@ -801,6 +1072,50 @@ double DMTestStat::getQMuTildeFromNLL(double nllMu, double nllMu0,
   return qMuTilde;
 }
 
+/**
+   -----------------------------------------------------------------------------
+   Get the NLL that is reused for the toy datasets, with its data replaced by a
+   new dataset. The NLL is created with the first toy.
+   @param data - the toy dataset.
+   @returns - the NLL of the toy datasets.
+*/
+RooAbsReal* DMTestStat::getToyNLL(RooAbsData *data) {
+  if (m_toyNLL) m_toyNLL->setData(*data, false);
+  else {
+    RooAbsPdf* combPdf = m_mc->GetPdf();
+    m_toyNLL
+      = combPdf->createNLL(*data, Constrain(*m_mc->GetNuisanceParameters()),
+			   Extended(combPdf->canBeExtended()));
+  }
+  return m_toyNLL;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Evaluate the NLL of a pseudo-dataset at several values of the DM signal
+   strength, without fitting. This must be called right after the toy is
+   generated: the other parameters keep their generated values, so that the
+   differences between the NLL values are the log-ratios of the probabilities
+   of the toy under the different signal strengths.
+   @param data - the pseudo-dataset from generatePseudoData().
+   @param muValues - the values of the DM signal strength.
+   @returns - the NLL value for each value of the DM signal strength.
+*/
+std::vector<double> DMTestStat::getToyNLLValues(RooAbsData *data,
+						std::vector<double> muValues) {
+  std::vector<double> result; result.clear();
+  if (muValues.size() == 0) return result;
+  RooRealVar *poi = m_workspace->var("mu_DM");
+  double generatedMuDM = poi->getVal();
+  RooAbsReal *varNLL = getToyNLL(data);
+  for (int i_m = 0; i_m < (int)muValues.size(); i_m++) {
+    poi->setVal(muValues[i_m]);
+    result.push_back(varNLL->getVal());
+  }
+  poi->setVal(generatedMuDM);
+  return result;
+}
+
 /**
    -----------------------------------------------------------------------------
    Load the statistics files (p0 and CL) that were previously generated. If none
@@ -858,6 +1173,26 @@ void DMTestStat::loadStatsFromFile() {
   m_calculatedValues[getKey("CLs", 1, 0)] = getCLsFromCL(inObsCL);
 }
 
+/**
+   -----------------------------------------------------------------------------
+   Restore the values, errors and constant states of all parameters to those at
+   construction, and clear the fit status. This lets one instance process many
+   pseudo-experiments as if each had a freshly loaded workspace.
+*/
+void DMTestStat::resetParams() {
+  TIterator *iterParams = m_initialParams->createIterator();
+  RooRealVar *currParam = NULL;
+  while ((currParam = (RooRealVar*)iterParams->Next())) {
+    RooRealVar *wsParam = m_workspace->var(currParam->GetName());
+    if (!wsParam) continue;
+    wsParam->setVal(currParam->getVal());
+    wsParam->setError(currParam->getError());
+    wsParam->setConstant(currParam->isConstant());
+  }
+  delete iterParams;
+  m_allGoodFits = true;
+}
+
 /**
    -----------------------------------------------------------------------------
    Check whether the specified value has been stored in the value map.
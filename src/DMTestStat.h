@@ -29,17 +29,20 @@ class DMTestStat {
   
   DMTestStat(TString newConfigFile, TString newDMSignal, TString newOptions, 
 	     RooWorkspace *newWorkspace);
-  virtual ~DMTestStat() {};
+  virtual ~DMTestStat();
   
   double accessValue(TString testStat, bool observed, int N);
   void calculateNewCL();
   void calculateNewP0();
+  double calculateObsTestStat(TString testStat);
   void clearData();
   void clearFitParamSettings();
   //void createAsimovData(int valMuDH, int valMuSH);
   //void createAsimovData(TString datasetName);
   RooDataSet* createPseudoData(int seed, int valMuDM, int valMuSM, bool fixMu);
   bool fitsAllConverged();
+  RooDataSet* generatePseudoData(int seed, int valMuDM, int valMuSM,
+				 bool fixMu);
   double functionQMu(double x);
   double functionQMuTilde(double x, double asimovTestStat);
   double getCLFromCLs(double CLs);
@@ -48,6 +51,8 @@ class DMTestStat {
   double getCLsFromQMu(double qMu, bool observed, double N);
   double getFitNLL(TString datasetName, double muVal, bool fixMu,
 		   double &profiledMu);
+  double getFitNLL(RooAbsData *data, double muVal, bool fixMu,
+		   double &profiledMu);
   std::vector<std::string> getGlobsNames();
   std::vector<double> getGlobsValues();
   std::vector<std::string> getNPNames();
@@ -56,12 +61,16 @@ class DMTestStat {
   double getPbFromN(double N);
   double getPbFromQMu(double qMu, double sigma, double mu);
   double getPMuFromQMu(double qMu);
-  double getQ0FromNLL(double nllMu0, double nllMuHat, double muHat);
-  double getQMuFromNLL(double nllMu, double nllMuHat, double muHat,
-		       double muTest);
-  double getQMuTildeFromNLL(double nllMu, double nllMu0, double nllMuHat,
-			    double muHat, double muTest);
+  static double getQ0FromNLL(double nllMu0, double nllMuHat, double muHat);
+  static double getQMuFromNLL(double nllMu, double nllMuHat, double muHat,
+			      double muTest);
+  static double getQMuTildeFromNLL(double nllMu, double nllMu0,
+				   double nllMuHat, double muHat,
+				   double muTest);
+  std::vector<double> getToyNLLValues(RooAbsData *data,
+				      std::vector<double> muValues);
   void loadStatsFromFile();
+  void resetParams();
   TGraphErrors* plotDivision(RooAbsData *data, RooAbsPdf *pdf, TString cateName,
 			     double xMin, double xMax, double xBins);
   void saveSnapshots(bool doSaveSnapshot);
@@ -70,7 +79,14 @@ class DMTestStat {
   
  private:
   
+  double fitNLL(RooAbsData *data, double muVal, bool fixMu,
+		double &profiledMu, bool reuseNLL);
+  RooDataSet* generateBinnedData(RooAbsPdf *currPDF, RooArgSet *currObs,
+				 RooRealVar *weight, TString cateName);
   TString getKey(TString testStat, bool observed, int N);
+  void validateBinYields(RooAbsPdf *currPDF, RooArgSet *currObs,
+			 std::vector<double> binYields, TString cateName);
+  RooAbsReal* getToyNLL(RooAbsData *data);
   bool mapValueExists(TString mapKey);
   void plotFits(TString fitType, TString datasetName);
   
@@ -102,6 +118,19 @@ class DMTestStat {
   // The workspace for the fits:
   RooWorkspace *m_workspace;
   ModelConfig *m_mc;
+  
+  // The parameters at construction, and the NLL reused for toy datasets:
+  RooArgSet *m_initialParams;
+  RooAbsReal *m_toyNLL;
+  
+  // Expected yields per bin for binned toys, and the parameters they were
+  // computed with (indexed by category name):
+  std::map<TString,std::vector<double> > m_binYields;
+  std::map<TString,std::vector<double> > m_binParams;
+  std::map<TString,bool> m_binValidated;
+  
+  // Samplers of the global observables, which point into the workspace:
+  statistics::GlobSamplerMap m_globSamplers;
 
   // Store the calculated values:
   std::map<TString,double> m_calculatedValues;
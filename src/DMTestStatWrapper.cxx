@@ -11,6 +11,7 @@
 //                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
 
+#include "DMJobLedger.h"
 #include "DMTestStat.h"
 
 int main(int argc, char **argv) {
@@ -30,6 +31,10 @@ int main(int argc, char **argv) {
   TString jobName = config->getStr("jobName");
   TString cateScheme = config->getStr("cateScheme");
   
+  // Record the job in the ledger:
+  DMJobLedger *ledger = new DMJobLedger(configFile);
+  ledger->recordStart("DMTestStat", DMSignal, -1, 0);
+  
   // Define the input file, then make a local copy (for remote jobs):
   TString originFile = Form("%s/%s/workspaces/rootfiles/workspaceDM_%s.root",
 			    (config->getStr("masterOutput")).Data(),
@@ -44,11 +49,14 @@ int main(int argc, char **argv) {
   DMTestStat *ts = new DMTestStat(configFile, DMSignal, "new", workspace);
   ts->calculateNewCL();
   ts->calculateNewP0();
-  if (ts->fitsAllConverged()) {
+  bool allConverged = ts->fitsAllConverged();
+  if (allConverged) {
     std::cout << "DMTestStatWrapper: All OK!" << std::endl;
   }
   
   inputFile.Close();
   system(Form("rm %s",copiedFile.Data()));
+  ledger->recordEnd("DMTestStat", DMSignal, -1, 0, 0, allConverged);
+  delete ledger;
   return 0;
 }
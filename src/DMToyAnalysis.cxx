@@ -9,6 +9,16 @@
 //  This program compares test statistic values from pseudo-experiment        //
 //  ensembles and asymptotic formulae.                                        //
 //                                                                            //
+//  The toy files of the DMPseudoExp jobs are read directly (without hadd) by //
+//  "ToyAnalysisThreads" threads. The histograms of each file are saved in a  //
+//  small summary file, which is used instead of the toy file until the toy   //
+//  file changes, so a rerun only reads the outputs of new jobs.              //
+//                                                                            //
+//  With the "Importance" toy option, the toys generated at every mu_DM in    //
+//  "ImportanceMuDM" are weighted to the background-only hypothesis, which    //
+//  gives the p0 far in the tail with much fewer toys. The weighted p0 is     //
+//  compared to the unweighted mu = 0 toys at a moderate significance.        //
+//                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
 
 // statistic == "QMu", "QMuTilde" 
@@ -22,16 +32,17 @@
 DMToyAnalysis::DMToyAnalysis(TString newConfigFile, TString newDMSignal) {
   
   // Load the config file:
-  Config *config = new Config(newConfigFile);
-  TString jobName = config->getStr("jobName");
+  m_config = new Config(newConfigFile);
+  m_DMSignal = newDMSignal;
+  TString jobName = m_config->getStr("jobName");
   
   // set input and output directories:
   m_outputDir = Form("%s/%s/DMToyAnalysis", 
-		     (config->getStr("masterOutput")).Data(), jobName.Data());
-  TString toyDir = Form("%s/%s/DMPseudoExp", 
-			(config->getStr("masterOutput")).Data(),jobName.Data());
+		     (m_config->getStr("masterOutput")).Data(), jobName.Data());
+  m_toyDir = Form("%s/%s/DMPseudoExp", 
+		  (m_config->getStr("masterOutput")).Data(), jobName.Data());
   TString wsFileName = Form("%s/%s/DMWorkspace/rootfiles/workspaceDM_%s.root",
-			    (config->getStr("masterOutput")).Data(),
+			    (m_config->getStr("masterOutput")).Data(),
 			    jobName.Data(), newDMSignal.Data());
   
   // Set the internal (private) variable initial conditions:
@@ -49,35 +60,27 @@ DMToyAnalysis::DMToyAnalysis(TString newConfigFile, TString newDMSignal) {
   // Set ATLAS style template:
   CommonFunc::SetAtlasStyle();
   
-  // Add all of the individual pseudoexperiment files together:
-  TString toyFileMu0 = Form("%s/toy_mu0.root", toyDir.Data());
-  TString toyFileMu1 = Form("%s/toy_mu1.root", toyDir.Data());
-  system(Form("hadd -f %s %s/single_files/toy_mu0*",
-	      toyFileMu0.Data(), toyDir.Data()));
-  system(Form("hadd -f %s %s/single_files/toy_mu1*", 
-	      toyFileMu1.Data(), toyDir.Data()));
-  
-  // Create temporary file lists:
-  TString listMu0 = "temp_list_mu0.txt";
-  TString listMu1 = "temp_list_mu1.txt";
-  system(Form("echo %s | tee %s", toyFileMu0.Data(), listMu0.Data()));
-  system(Form("echo %s | tee %s", toyFileMu1.Data(), listMu1.Data()));
-  
-  // Create TChain of ntuples:
-  TChain* chainMu0 = CommonFunc::MakeChain("toy", listMu0, "badfile");
-  TChain* chainMu1 = CommonFunc::MakeChain("toy", listMu1, "badfile");
-  DMToyTree *treeMu0 = new DMToyTree(chainMu0);
-  DMToyTree *treeMu1 = new DMToyTree(chainMu1);
-  
-  // Store the toy data:
-  fillToyHistograms(0, treeMu0);
-  fillToyHistograms(1, treeMu1);
-  
-  // Get the Asimov form of the test statistic:
+  // Load the workspace, which is used to calculate the test statistics:
   TFile workspaceFile(wsFileName, "read");
   m_workspace = (RooWorkspace*)workspaceFile.Get("combinedWS");
   m_dmts = new DMTestStat(newConfigFile, newDMSignal, "new", m_workspace);
   
+  // Read the individual pseudoexperiment files of each mu value:
+  int nToys[2] = {0, 0};
+  for (int i_m = 0; i_m < 2; i_m++) {
+    TString fileList
+      = gSystem->GetFromPipe(Form("ls %s/single_files/%s/toy_mu%d_*.root",
+				  m_toyDir.Data(), m_DMSignal.Data(), i_m));
+    TObjArray *tokens = fileList.Tokenize("\n");
+    std::vector<TString> fileNames; fileNames.clear();
+    for (int i_f = 0; i_f < tokens->GetEntries(); i_f++) {
+      fileNames.push_back(((TObjString*)tokens->At(i_f))->GetString());
+    }
+    delete tokens;
+    fillToyHistograms(i_m, fileNames);
+    nToys[i_m] = (int)m_hMuProfiled[i_m]->GetEntries();
+  }
+  
   // Get the asymptotic test statistic distribution:
   getAsymptoticForm("QMu");// THIS SHOULD BE GENERALIZED!!!
   
@@ -88,29 +91,24 @@ DMToyAnalysis::DMToyAnalysis(TString newConfigFile, TString newDMSignal) {
   plotTestStatComparison("QMu");
   plotTestStatComparison("Q0");
   
-  // Remove the temporary file lists:
-  system(Form("rm %s", listMu0.Data()));
-  system(Form("rm %s", listMu1.Data()));
+  // Weighted tail p-values from the importance-sampled toys:
+  if ((m_config->getStr("pseudoExpOptions")).Contains("Importance")) {
+    calculateWeightedP0();
+  }
   
   std::cout << "DMToyAnalysis: Finished!" << std::endl;
-  std::cout << "\t" << treeMu0->fChain->GetEntries()
+  std::cout << "\t" << nToys[0]
 	    << " mu=0 pseudo experiments were analyzed" << std::endl;
-  std::cout << "\t" << treeMu1->fChain->GetEntries()
+  std::cout << "\t" << nToys[1]
 	    << " mu=1 pseudo experiments were analyzed" << std::endl;
 }
 
 /**
    -----------------------------------------------------------------------------
-   Fill the histograms containing toy Data.
+   Book the histograms for the toys of one mu value, and list their keys.
    @param muValue - the mu hypothesis under which the toys were generated.
-   @param toyTree - the TTree containing the pseudo data.
 */
-void DMToyAnalysis::fillToyHistograms(int muValue, DMToyTree *toyTree) {
-  int nEvents = toyTree->fChain->GetEntries();
-  std::cout << "DMToyAnalysis: Loop over " << nEvents
-	    << " pseudoexperiments with mu = " << muValue << std::endl;
-  
-  // Instantiate the histograms:
+void DMToyAnalysis::bookHists(int muValue) {
   m_hMuProfiled[muValue] = new TH1F(Form("hMuProfiled%d",muValue),
 				    Form("hMuProfiled%d",muValue), 
 				    m_nBins, -2.0, 4.0);
@@ -118,27 +116,282 @@ void DMToyAnalysis::fillToyHistograms(int muValue, DMToyTree *toyTree) {
 			     m_nBins, m_binMin, m_binMax);
   m_hQ0[muValue] = new TH1F(Form("hQ0%d",muValue),Form("hQ0%d",muValue),
 			    m_nBins, m_binMin, m_binMax);
+  m_hists[muValue].clear();
+  m_hists[muValue].push_back(m_hMuProfiled[muValue]);
+  m_hists[muValue].push_back(m_hQMu[muValue]);
+  m_hists[muValue].push_back(m_hQ0[muValue]);
   
   for (int i_p = 0; i_p < 20; i_p++) {
-    m_hNuisMu0[i_p][muValue] = new TH1F(Form("hNuisMu0_%d",muValue),
+    m_hNuisMu0[i_p][muValue] = new TH1F(Form("hNuisMu0_%d_%d",i_p,muValue),
 					Form("hNuisMu0_%d",muValue),100,-5,5);
-    m_hNuisMu1[i_p][muValue] = new TH1F(Form("hNuisMu1_%d",muValue),
+    m_hNuisMu1[i_p][muValue] = new TH1F(Form("hNuisMu1_%d_%d",i_p,muValue),
 					Form("hNuisMu1_%d",muValue),100,-5,5);
-    m_hNuisMuFree[i_p][muValue] = new TH1F(Form("hNuisMuFree_%d",muValue),
-					   Form("hNuisMuFree_%d",muValue),
-					   100,-5,5);
+    m_hNuisMuFree[i_p][muValue]
+      = new TH1F(Form("hNuisMuFree_%d_%d",i_p,muValue),
+		 Form("hNuisMuFree_%d",muValue), 100,-5,5);
     
-    m_hGlobsMu0[i_p][muValue] = new TH1F(Form("hGlobsMu0_%d",muValue),
+    m_hGlobsMu0[i_p][muValue] = new TH1F(Form("hGlobsMu0_%d_%d",i_p,muValue),
 					 Form("hGlobsMu0_%d",muValue),100,-5,5);
-    m_hGlobsMu1[i_p][muValue] = new TH1F(Form("hGlobsMu1_%d",muValue),
+    m_hGlobsMu1[i_p][muValue] = new TH1F(Form("hGlobsMu1_%d_%d",i_p,muValue),
 					 Form("hGlobsMu1_%d",muValue),100,-5,5);
-    m_hGlobsMuFree[i_p][muValue] = new TH1F(Form("hGlobsMuFree_%d",muValue),
-					    Form("hGlobsMuFree_%d",muValue),
-					    100,-5,5);
+    m_hGlobsMuFree[i_p][muValue]
+      = new TH1F(Form("hGlobsMuFree_%d_%d",i_p,muValue),
+		 Form("hGlobsMuFree_%d",muValue), 100,-5,5);
+    
+    m_hists[muValue].push_back(m_hNuisMu0[i_p][muValue]);
+    m_hists[muValue].push_back(m_hNuisMu1[i_p][muValue]);
+    m_hists[muValue].push_back(m_hNuisMuFree[i_p][muValue]);
+    m_hists[muValue].push_back(m_hGlobsMu0[i_p][muValue]);
+    m_hists[muValue].push_back(m_hGlobsMu1[i_p][muValue]);
+    m_hists[muValue].push_back(m_hGlobsMuFree[i_p][muValue]);
+  }
+  
+  // The keys do not depend on mu, so that summaries can be read for both:
+  m_histKeys.clear();
+  for (int i_h = 0; i_h < (int)m_hists[muValue].size(); i_h++) {
+    TString currKey = m_hists[muValue][i_h]->GetName();
+    currKey.Remove(currKey.Length() - 1);
+    m_histKeys.push_back(currKey);
+  }
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Calculate p0 from the importance-sampled toys. The toys generated at every
+   mu_DM in "ImportanceMuDM" are pooled, and each toy is weighted by the ratio
+   of its likelihood under mu_DM = 0 to its likelihood under the mixture of the
+   generated signal strengths. The weighted p0 at q0 = Z^2 for Z = 1, 2, 3 is
+   compared to the fraction of mu = 0 toys above q0, to check the weights.
+*/
+void DMToyAnalysis::calculateWeightedP0() {
+  std::cout << "DMToyAnalysis: Calculating p0 with importance weights."
+	    << std::endl;
+  
+  // The generated signal strengths, which must include the background-only:
+  std::vector<double> muValues = m_config->getNumV("ImportanceMuDM");
+  int nMu = (int)muValues.size();
+  int indexMu0 = -1;
+  for (int i_m = 0; i_m < nMu; i_m++) {
+    if (fabs(muValues[i_m]) < 1e-6) indexMu0 = i_m;
   }
+  if (indexMu0 < 0 || nMu > kMaxWeightMus) {
+    std::cout << "DMToyAnalysis: Error! ImportanceMuDM must include 0, with "
+	      << "at most " << kMaxWeightMus << " values." << std::endl;
+    return;
+  }
+  
+  // The toy files are named by integer mu_DM, so each value must be distinct:
+  for (int i_m = 0; i_m < nMu; i_m++) {
+    bool isRepeated = false;
+    for (int i_p = 0; i_p < i_m; i_p++) {
+      if (TMath::Nint(muValues[i_p]) == TMath::Nint(muValues[i_m])) {
+	isRepeated = true;
+      }
+    }
+    if (isRepeated ||
+	fabs(muValues[i_m] - TMath::Nint(muValues[i_m])) > 1e-6) {
+      std::cout << "DMToyAnalysis: Error! ImportanceMuDM value "
+		<< muValues[i_m] << " is not a distinct integer." << std::endl;
+      return;
+    }
+  }
+  
+  // Read q0 and the NLL at each generated mu for the toys of every mu:
+  std::vector<double> valuesQ0; valuesQ0.clear();
+  std::vector<std::vector<double> > valuesNLL; valuesNLL.clear();
+  std::vector<double> valuesQ0Mu0; valuesQ0Mu0.clear();
+  std::vector<double> fractions(nMu, 0.0);
+  for (int i_m = 0; i_m < nMu; i_m++) {
+    TString fileList
+      = gSystem->GetFromPipe(Form("ls %s/single_files/%s/toy_mu%d_*.root",
+				  m_toyDir.Data(), m_DMSignal.Data(),
+				  TMath::Nint(muValues[i_m])));
+    TObjArray *tokens = fileList.Tokenize("\n");
+    for (int i_f = 0; i_f < tokens->GetEntries(); i_f++) {
+      TString fileName = ((TObjString*)tokens->At(i_f))->GetString();
+      TFile *toyFile = TFile::Open(fileName, "READ");
+      if (!toyFile || toyFile->IsZombie() || !toyFile->Get("toy")) {
+	std::cout << "DMToyAnalysis: Skipping " << fileName << std::endl;
+	if (toyFile) delete toyFile;
+	continue;
+      }
+      DMToyTree *toyTree = new DMToyTree((TTree*)toyFile->Get("toy"));
+      
+      // The NLL values must have been saved for the same signal strengths:
+      bool sameMuValues = ((int)toyTree->weightMuValues.size() == nMu &&
+			   toyTree->fChain->GetBranch("nllGen"));
+      for (int i_w = 0; sameMuValues && i_w < nMu; i_w++) {
+	if (fabs(toyTree->weightMuValues[i_w] - muValues[i_w]) > 1e-6) {
+	  sameMuValues = false;
+	}
+      }
+      if (!sameMuValues) {
+	std::cout << "DMToyAnalysis: Skipping " << fileName
+		  << " (no NLL values for ImportanceMuDM)" << std::endl;
+	delete toyTree;
+	continue;
+      }
+      
+      int nEvents = toyTree->fChain->GetEntries();
+      for (int i_e = 0; i_e < nEvents; i_e++) {
+	toyTree->fChain->GetEntry(i_e);
+	if (!(toyTree->convergedMu0 && toyTree->convergedMuFree)) continue;
+	double valueQ0 = m_dmts->getQ0FromNLL(toyTree->nllMu0,
+					      toyTree->nllMuFree,
+					      toyTree->muDMVal);
+	valuesQ0.push_back(valueQ0);
+	valuesNLL.push_back(std::vector<double>(toyTree->nllGen,
+						toyTree->nllGen + nMu));
+	fractions[i_m]++;
+	if (i_m == indexMu0) valuesQ0Mu0.push_back(valueQ0);
+      }
+      delete toyTree;
+    }
+    delete tokens;
+    std::cout << "DMToyAnalysis: " << fractions[i_m] << " toys with mu = "
+	      << muValues[i_m] << std::endl;
+  }
+  int nToys = (int)valuesQ0.size();
+  int nToysMu0 = (int)valuesQ0Mu0.size();
+  if (nToys == 0) {
+    std::cout << "DMToyAnalysis: Error! No importance-sampled toys."
+	      << std::endl;
+    return;
+  }
+  
+  // The weights for the mixture of the generated signal strengths:
+  for (int i_m = 0; i_m < nMu; i_m++) fractions[i_m] /= ((double)nToys);
+  std::vector<double> weights; weights.clear();
+  for (int i_t = 0; i_t < nToys; i_t++) {
+    weights.push_back(statistics::importanceWeight(valuesNLL[i_t], indexMu0,
+						   fractions));
+  }
+  
+  // The weighted, brute-force and asymptotic p0 for the observed q0:
+  double obsQ0 = m_dmts->calculateObsTestStat("Q0");
+  double errorWeighted = 0.0;
+  double p0Weighted = statistics::pvalueFromWeightedToy(valuesQ0, weights,
+							obsQ0, errorWeighted);
+  std::vector<double> unitWeights(nToysMu0, 1.0);
+  double errorToy = 0.0;
+  double p0Toy = statistics::pvalueFromWeightedToy(valuesQ0Mu0, unitWeights,
+						   obsQ0, errorToy);
+  double p0Asym = m_dmts->getP0FromQ0(obsQ0);
+  
+  // Write the results, and validate the weights at moderate significance:
+  ofstream outputFile(Form("%s/weighted_p0_%s.txt", m_outputDir.Data(),
+			   m_DMSignal.Data()));
+  outputFile << "q0Obs " << obsQ0 << std::endl;
+  outputFile << "p0Weighted " << p0Weighted << " " << errorWeighted
+	     << std::endl;
+  outputFile << "p0Toy " << p0Toy << " " << errorToy << std::endl;
+  outputFile << "p0Asymptotic " << p0Asym << std::endl;
+  std::cout << "DMToyAnalysis: Observed q0 = " << obsQ0 << std::endl;
+  std::cout << "\tWeighted p0 = " << p0Weighted << " +/- " << errorWeighted
+	    << " (" << nToys << " toys)" << std::endl;
+  std::cout << "\tToy p0 = " << p0Toy << " +/- " << errorToy << " ("
+	    << nToysMu0 << " mu=0 toys)" << std::endl;
+  std::cout << "\tAsymptotic p0 = " << p0Asym << std::endl;
+  for (int i_z = 1; i_z <= 3; i_z++) {
+    double currQ0 = i_z * i_z;
+    double currErrorWeighted = 0.0;
+    double currWeighted
+      = statistics::pvalueFromWeightedToy(valuesQ0, weights, currQ0,
+					  currErrorWeighted);
+    double currErrorToy = 0.0;
+    double currToy
+      = statistics::pvalueFromWeightedToy(valuesQ0Mu0, unitWeights, currQ0,
+					  currErrorToy);
+    double currError = sqrt(currErrorWeighted * currErrorWeighted +
+			    currErrorToy * currErrorToy);
+    double pull = (currError > 0.0) ? (currWeighted - currToy) / currError : 0;
+    outputFile << "Z" << i_z << " " << currWeighted << " " << currErrorWeighted
+	       << " " << currToy << " " << currErrorToy << " " << pull
+	       << std::endl;
+    std::cout << "\tAt " << i_z << " sigma: weighted p0 = " << currWeighted
+	      << " +/- " << currErrorWeighted << ", toy p0 = " << currToy
+	      << " +/- " << currErrorToy << ", pull = " << pull << std::endl;
+  }
+  outputFile.close();
+  
+  // Plot the weighted, brute-force and asymptotic p0 as a function of q0:
+  TGraphErrors *gWeighted = new TGraphErrors();
+  TGraphErrors *gToy = new TGraphErrors();
+  TGraph *gAsym = new TGraph();
+  for (int i_p = 0; i_p <= 50; i_p++) {
+    double currQ0 = m_binMin + i_p * (m_binMax - m_binMin) / 50.0;
+    double currError = 0.0;
+    double currP0 = statistics::pvalueFromWeightedToy(valuesQ0, weights,
+						      currQ0, currError);
+    gWeighted->SetPoint(i_p, currQ0, currP0);
+    gWeighted->SetPointError(i_p, 0.0, currError);
+    currP0 = statistics::pvalueFromWeightedToy(valuesQ0Mu0, unitWeights,
+					       currQ0, currError);
+    gToy->SetPoint(i_p, currQ0, currP0);
+    gToy->SetPointError(i_p, 0.0, currError);
+    gAsym->SetPoint(i_p, currQ0, m_dmts->getP0FromQ0(currQ0));
+  }
+  
+  TCanvas *can = new TCanvas("can", "can", 800, 800);
+  can->cd();
+  gPad->SetLogy();
+  gWeighted->SetLineColor(kRed);
+  gWeighted->SetMarkerColor(kRed);
+  gToy->SetLineColor(kBlue);
+  gToy->SetMarkerColor(kBlue);
+  gAsym->SetLineColor(kBlack);
+  gWeighted->GetXaxis()->SetTitle(printStatName("Q0"));
+  gWeighted->GetYaxis()->SetTitle("p_{0}");
+  gWeighted->GetYaxis()->SetRangeUser(1e-8, 1.0);
+  gWeighted->Draw("AP");
+  gToy->Draw("PSAME");
+  gAsym->Draw("LSAME");
+  
+  TLegend leg(0.49, 0.76, 0.84, 0.9);
+  leg.SetBorderSize(0);
+  leg.SetFillColor(0);
+  leg.SetTextSize(0.04);
+  leg.AddEntry(gWeighted, "Weighted toy MC", "LEP");
+  leg.AddEntry(gToy, "#mu=0 toy MC", "LEP");
+  leg.AddEntry(gAsym, "Asymptotic", "L");
+  leg.Draw("SAME");
   
-  // Loop over events in the TTree:
-  bool isFirstLoop = true;
+  can->Print(Form("%s/plot_weighted_p0.eps", m_outputDir.Data()));
+  can->Print(Form("%s/plot_weighted_p0.png", m_outputDir.Data()));
+  can->Clear();
+  gPad->SetLogy(0);
+  delete gWeighted;
+  delete gToy;
+  delete gAsym;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Make an empty copy of the histograms of one mu value, e.g. for a thread.
+   @param muValue - the mu hypothesis under which the toys were generated.
+   @param suffix - the suffix for the names of the copies.
+   @returns - the copies, in the order of the keys.
+*/
+std::vector<TH1F*> DMToyAnalysis::cloneHists(int muValue, TString suffix) {
+  std::vector<TH1F*> hists; hists.clear();
+  for (int i_h = 0; i_h < (int)m_hists[muValue].size(); i_h++) {
+    TH1F *currHist = (TH1F*)m_hists[muValue][i_h]
+      ->Clone(Form("%s_%s", m_hists[muValue][i_h]->GetName(), suffix.Data()));
+    currHist->Reset();
+    hists.push_back(currHist);
+  }
+  return hists;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Fill histograms with the toys in one tree. The parameter names must have
+   been loaded by loadParamNames().
+   @param toyTree - the TTree containing the pseudo data.
+   @param hists - the histograms, in the order of the keys.
+*/
+void DMToyAnalysis::fillHists(DMToyTree *toyTree, std::vector<TH1F*> hists) {
+  int nEvents = toyTree->fChain->GetEntries();
   for (int i_e = 0; i_e < nEvents; i_e++) {
     toyTree->fChain->GetEntry(i_e);
     
@@ -153,33 +406,102 @@ void DMToyAnalysis::fillToyHistograms(int muValue, DMToyTree *toyTree) {
 					  toyTree->muDMVal);
     
     // Fill histograms for the test statistics and POI:
-    m_hQMu[muValue]->Fill(valueQMu);
-    m_hQ0[muValue]->Fill(valueQ0);
-    m_hMuProfiled[muValue]->Fill(toyTree->muDMVal);
+    hists[0]->Fill(toyTree->muDMVal);
+    hists[1]->Fill(valueQMu);
+    hists[2]->Fill(valueQ0);
     
-    // Fill the nuisance parameter histograms:
-    if (isFirstLoop) m_nNuis = (int)((*toyTree->namesNP).size());
-    // loop over the nuisance parameters in the tree:
+    // Fill the nuisance parameter and global observable histograms:
     for (int i_p = 0; i_p < m_nNuis; i_p++) {
-      m_hNuisMu0[i_p][muValue]->Fill((*toyTree->valuesNPMu0)[i_p] );
-      m_hNuisMu1[i_p][muValue]->Fill((*toyTree->valuesNPMu1)[i_p] );
-      m_hNuisMuFree[i_p][muValue]->Fill((*toyTree->valuesNPMuFree)[i_p]);
-      if (isFirstLoop) m_namesNuis.push_back((*toyTree->namesNP)[i_p]);
+      hists[3 + 6*i_p]->Fill(toyTree->valuesNPMu0[i_p]);
+      hists[4 + 6*i_p]->Fill(toyTree->valuesNPMu1[i_p]);
+      hists[5 + 6*i_p]->Fill(toyTree->valuesNPMuFree[i_p]);
     }
-    
-    // Fill the global observable histograms:
-    if (isFirstLoop) m_nGlobs = (int)((*toyTree->namesGlobs).size());
-    // loop over the nuisance parameters in the tree:
     for (int i_p = 0; i_p < m_nGlobs; i_p++) {
-      m_hGlobsMu0[i_p][muValue]->Fill((*toyTree->valuesGlobsMu0)[i_p]);
-      m_hGlobsMu1[i_p][muValue]->Fill((*toyTree->valuesGlobsMu1)[i_p]);
-      m_hGlobsMuFree[i_p][muValue]->Fill((*toyTree->valuesGlobsMuFree)[i_p]);
-      if (isFirstLoop) m_namesNuis.push_back((*toyTree->namesNP)[i_p]);
+      hists[6 + 6*i_p]->Fill(toyTree->valuesGlobsMu0[i_p]);
+      hists[7 + 6*i_p]->Fill(toyTree->valuesGlobsMu1[i_p]);
+      hists[8 + 6*i_p]->Fill(toyTree->valuesGlobsMuFree[i_p]);
     }
-    
-    isFirstLoop = false;
+  }
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Fill the histograms containing toy Data from the individual toy files. The
+   files are divided among threads, and the histograms of each file are taken
+   from its summary if the file has not changed since the summary was saved.
+   @param muValue - the mu hypothesis under which the toys were generated.
+   @param fileNames - the names of the toy files.
+*/
+void DMToyAnalysis::fillToyHistograms(int muValue,
+				      std::vector<TString> fileNames) {
+  std::cout << "DMToyAnalysis: Reading " << fileNames.size()
+	    << " toy files with mu = " << muValue << std::endl;
+  
+  // Number of threads to read the files:
+  int nThreads = m_config->getInt("ToyAnalysisThreads", 1);
+  if (nThreads > (int)fileNames.size()) nThreads = (int)fileNames.size();
+  if (nThreads < 1) nThreads = 1;
+  if (nThreads > 1) {
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,6,0)
+    ROOT::EnableThreadSafety();
+#else
+    TThread::Initialize();
+#endif
+  }
+  // Histograms must not be owned by the toy and summary files:
+  TH1::AddDirectory(kFALSE);
+  
+  // Instantiate the histograms, and get the parameter names:
+  bookHists(muValue);
+  if (fileNames.size() > 0) loadParamNames(fileNames[0]);
+  system(Form("mkdir -vp %s/summaries/%s", m_outputDir.Data(),
+	      m_DMSignal.Data()));
+  
+  // Create the workers, which read every N-th file:
+  std::vector<DMToyAnalysisWorker*> workers; workers.clear();
+  for (int i_w = 0; i_w < nThreads; i_w++) {
+    DMToyAnalysisWorker *worker = new DMToyAnalysisWorker();
+    worker->toyAnalysis = this;
+    worker->muValue = muValue;
+    worker->fileNames.clear();
+    for (int i_f = i_w; i_f < (int)fileNames.size(); i_f += nThreads) {
+      worker->fileNames.push_back(fileNames[i_f]);
+    }
+    worker->hists = cloneHists(muValue, Form("worker%d", i_w));
+    worker->nReadFiles = 0;
+    workers.push_back(worker);
   }
   
+  // Read the files:
+  if (nThreads == 1) processFiles(workers[0]);
+  else {
+    std::vector<TThread*> threads; threads.clear();
+    for (int i_w = 0; i_w < nThreads; i_w++) {
+      threads.push_back(new TThread(Form("DMToyAnalysis_%d", i_w),
+				    DMToyAnalysis::processFilesThread,
+				    (void*)workers[i_w]));
+      threads[i_w]->Run();
+    }
+    for (int i_w = 0; i_w < nThreads; i_w++) {
+      threads[i_w]->Join();
+      delete threads[i_w];
+    }
+  }
+  
+  // Merge the histograms of the workers:
+  int nReadFiles = 0;
+  for (int i_w = 0; i_w < nThreads; i_w++) {
+    for (int i_h = 0; i_h < (int)m_hists[muValue].size(); i_h++) {
+      m_hists[muValue][i_h]->Add(workers[i_w]->hists[i_h]);
+      delete workers[i_w]->hists[i_h];
+    }
+    nReadFiles += workers[i_w]->nReadFiles;
+    delete workers[i_w];
+  }
+  std::cout << "DMToyAnalysis: Read " << nReadFiles << " new or changed files, "
+	    << ((int)fileNames.size() - nReadFiles) << " from summaries."
+	    << std::endl;
+  
   // Then scale the histograms:
   m_hQMu[muValue]->Scale(1.0 / m_hQMu[muValue]->Integral(1, m_nBins));
   m_hQ0[muValue]->Scale(1.0 / m_hQ0[muValue]->Integral(1, m_nBins));
@@ -238,6 +560,31 @@ TH1F* DMToyAnalysis::getAsymptoticHist() {
   return m_hAsymptotic;
 }
 
+/**
+   -----------------------------------------------------------------------------
+   Get the stamp of a toy file, which changes when the file or the binning of
+   the histograms changes.
+   @param fileName - the name of the toy file.
+   @returns - the stamp (size, modification time and binning).
+*/
+TString DMToyAnalysis::getFileStamp(TString fileName) {
+  TString stamp = getToyFileStamp(fileName);
+  if (stamp.EqualTo("none")) return stamp;
+  return Form("%s %d %d %d", stamp.Data(), m_nBins, m_binMin, m_binMax);
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Get the stamp of a toy file, which changes when the file changes.
+   @param fileName - the name of the toy file.
+   @returns - the stamp (size and modification time).
+*/
+TString DMToyAnalysis::getToyFileStamp(TString fileName) {
+  FileStat_t fileStat;
+  if (gSystem->GetPathInfo(fileName, fileStat) != 0) return "none";
+  return Form("%lld %ld", fileStat.fSize, fileStat.fMtime);
+}
+
 /**
    -----------------------------------------------------------------------------
    Get the histogram of a particular global observable.
@@ -276,6 +623,141 @@ TH1F* DMToyAnalysis::getNuisHist(TString paramName, TString fitType,
   else return NULL;
 }
 
+/**
+   -----------------------------------------------------------------------------
+   Get the name of the summary file of a toy file.
+   @param fileName - the name of the toy file.
+   @returns - the name of the summary file.
+*/
+TString DMToyAnalysis::getSummaryName(TString fileName) {
+  return Form("%s/summaries/%s/summary_%s", m_outputDir.Data(),
+	      m_DMSignal.Data(), gSystem->BaseName(fileName));
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Add the histograms from the summary of a toy file, if the toy file has not
+   changed since the summary was saved.
+   @param fileName - the name of the toy file.
+   @param hists - the histograms, in the order of the keys.
+   @returns - true iff the summary was up to date and loaded.
+*/
+bool DMToyAnalysis::loadFileSummary(TString fileName,
+				    std::vector<TH1F*> hists) {
+  TString summaryName = getSummaryName(fileName);
+  if (gSystem->AccessPathName(summaryName)) return false;
+  TFile summaryFile(summaryName, "READ");
+  TNamed *stamp = (TNamed*)summaryFile.Get("stamp");
+  if (!stamp || !getFileStamp(fileName).EqualTo(stamp->GetTitle())) {
+    summaryFile.Close();
+    return false;
+  }
+  for (int i_h = 0; i_h < (int)hists.size(); i_h++) {
+    TH1F *currHist = (TH1F*)summaryFile.Get(m_histKeys[i_h]);
+    if (currHist) hists[i_h]->Add(currHist);
+  }
+  summaryFile.Close();
+  return true;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Get the test statistics of the converged toys in a toy file, from its
+   statistics summary if the toy file has not changed since the summary was
+   saved. Otherwise the toy file is read and its summary is saved, so that
+   DMToyController only reads the new toy files in each round. The summary
+   directory must exist.
+   @param fileName - the name of the toy file.
+   @param summaryDir - the directory of the summaries.
+   @param valuesQMu - the values of qMu (for mu = 1), filled by this method.
+   @param valuesQ0 - the values of q0, filled by this method.
+   @returns - true iff the toy file or its summary could be read.
+*/
+bool DMToyAnalysis::loadToyStats(TString fileName, TString summaryDir,
+				 std::vector<double> &valuesQMu,
+				 std::vector<double> &valuesQ0) {
+  valuesQMu.clear();
+  valuesQ0.clear();
+  TString stamp = getToyFileStamp(fileName);
+  TString summaryName = Form("%s/stats_%s", summaryDir.Data(),
+			     gSystem->BaseName(fileName));
+  
+  // Use the summary if it is up to date:
+  if (!gSystem->AccessPathName(summaryName)) {
+    TFile summaryFile(summaryName, "READ");
+    TNamed *savedStamp = (TNamed*)summaryFile.Get("stamp");
+    TVectorD *savedQMu = (TVectorD*)summaryFile.Get("valuesQMu");
+    TVectorD *savedQ0 = (TVectorD*)summaryFile.Get("valuesQ0");
+    if (savedStamp && savedQMu && savedQ0 &&
+	stamp.EqualTo(savedStamp->GetTitle())) {
+      for (int i_t = 0; i_t < savedQMu->GetNrows(); i_t++) {
+	valuesQMu.push_back((*savedQMu)[i_t]);
+	valuesQ0.push_back((*savedQ0)[i_t]);
+      }
+      summaryFile.Close();
+      return true;
+    }
+    summaryFile.Close();
+  }
+  
+  // Otherwise read the toy file (deleting the tree also closes the file):
+  TFile *toyFile = TFile::Open(fileName, "READ");
+  if (!toyFile || toyFile->IsZombie() || !toyFile->Get("toy")) {
+    if (toyFile) delete toyFile;
+    return false;
+  }
+  DMToyTree *toyTree = new DMToyTree((TTree*)toyFile->Get("toy"));
+  int nEvents = toyTree->fChain->GetEntries();
+  for (int i_e = 0; i_e < nEvents; i_e++) {
+    toyTree->fChain->GetEntry(i_e);
+    if (!(toyTree->convergedMu0 && toyTree->convergedMu1 &&
+	  toyTree->convergedMuFree)) continue;
+    valuesQMu.push_back(DMTestStat::getQMuFromNLL(toyTree->nllMu1,
+						  toyTree->nllMuFree,
+						  toyTree->muDMVal, 1));
+    valuesQ0.push_back(DMTestStat::getQ0FromNLL(toyTree->nllMu0,
+						toyTree->nllMuFree,
+						toyTree->muDMVal));
+  }
+  delete toyTree;
+  
+  // Save the summary, under a temporary name first:
+  TString tempName = Form("%s.part", summaryName.Data());
+  TFile summaryFile(tempName, "RECREATE");
+  TNamed("stamp", stamp.Data()).Write();
+  TVectorD vectorQMu((int)valuesQMu.size());
+  TVectorD vectorQ0((int)valuesQ0.size());
+  for (int i_t = 0; i_t < (int)valuesQMu.size(); i_t++) {
+    vectorQMu[i_t] = valuesQMu[i_t];
+    vectorQ0[i_t] = valuesQ0[i_t];
+  }
+  vectorQMu.Write("valuesQMu");
+  vectorQ0.Write("valuesQ0");
+  summaryFile.Close();
+  gSystem->Rename(tempName, summaryName);
+  return true;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Load the names of the nuisance parameters and global observables, which are
+   the same in all of the toy files.
+   @param fileName - the name of one toy file.
+*/
+void DMToyAnalysis::loadParamNames(TString fileName) {
+  TFile *toyFile = TFile::Open(fileName, "READ");
+  if (!toyFile || toyFile->IsZombie() || !toyFile->Get("toy")) {
+    std::cout << "DMToyAnalysis: Error! No toys in " << fileName << std::endl;
+    exit(0);
+  }
+  DMToyTree *toyTree = new DMToyTree((TTree*)toyFile->Get("toy"));
+  m_namesNuis = toyTree->namesNP;
+  m_namesGlobs = toyTree->namesGlobs;
+  m_nNuis = TMath::Min((int)m_namesNuis.size(), 20);
+  m_nGlobs = TMath::Min((int)m_namesGlobs.size(), 20);
+  delete toyTree;
+}
+
 /**
    -----------------------------------------------------------------------------
    Get the signal strength histogram.
@@ -298,6 +780,56 @@ TH1F* DMToyAnalysis::getStatHist(TString statistic, int toyMu) {
   else return NULL;
 }
 
+/**
+   -----------------------------------------------------------------------------
+   Fill the histograms of a worker with its toy files. Each file that is new or
+   has changed is read, and its histograms are saved in its summary.
+   @param worker - the worker, with its files and histograms.
+*/
+void DMToyAnalysis::processFiles(DMToyAnalysisWorker *worker) {
+  std::vector<TH1F*> fileHists
+    = cloneHists(worker->muValue, Form("file_%s", worker->fileNames.size() ?
+				       gSystem->BaseName(worker->fileNames[0]) :
+				       "none"));
+  for (int i_f = 0; i_f < (int)worker->fileNames.size(); i_f++) {
+    TString fileName = worker->fileNames[i_f];
+    for (int i_h = 0; i_h < (int)fileHists.size(); i_h++) {
+      fileHists[i_h]->Reset();
+    }
+    
+    // Read the toy file if its summary is missing or out of date:
+    if (!loadFileSummary(fileName, fileHists)) {
+      TFile *toyFile = TFile::Open(fileName, "READ");
+      if (!toyFile || toyFile->IsZombie() || !toyFile->Get("toy")) {
+	std::cout << "DMToyAnalysis: Skipping " << fileName << std::endl;
+	if (toyFile) delete toyFile;
+	continue;
+      }
+      DMToyTree *toyTree = new DMToyTree((TTree*)toyFile->Get("toy"));
+      fillHists(toyTree, fileHists);
+      delete toyTree;
+      saveFileSummary(fileName, fileHists);
+      worker->nReadFiles++;
+    }
+    for (int i_h = 0; i_h < (int)fileHists.size(); i_h++) {
+      worker->hists[i_h]->Add(fileHists[i_h]);
+    }
+  }
+  for (int i_h = 0; i_h < (int)fileHists.size(); i_h++) delete fileHists[i_h];
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Fill the histograms of a worker in a separate thread.
+   @param worker - the worker, with its files and histograms.
+   @returns - NULL.
+*/
+void* DMToyAnalysis::processFilesThread(void *worker) {
+  DMToyAnalysisWorker *currWorker = (DMToyAnalysisWorker*)worker;
+  currWorker->toyAnalysis->processFiles(currWorker);
+  return NULL;
+}
+
 /**
    -----------------------------------------------------------------------------
    Plot the distributions of nuisance parameters and global observables
@@ -655,3 +1187,23 @@ TString DMToyAnalysis::printStatName(TString statistic) {
   else return TString("q");
 }
 
+/**
+   -----------------------------------------------------------------------------
+   Save the histograms of a toy file in its summary, with the stamp of the toy
+   file. The summary is written to a temporary name first, so that an aborted
+   job leaves no partial summary.
+   @param fileName - the name of the toy file.
+   @param hists - the histograms of the toy file, in the order of the keys.
+*/
+void DMToyAnalysis::saveFileSummary(TString fileName,
+				    std::vector<TH1F*> hists) {
+  TString summaryName = getSummaryName(fileName);
+  TString tempName = Form("%s.part", summaryName.Data());
+  TFile summaryFile(tempName, "RECREATE");
+  TNamed("stamp", getFileStamp(fileName).Data()).Write();
+  for (int i_h = 0; i_h < (int)hists.size(); i_h++) {
+    if (hists[i_h]->GetEntries() > 0) hists[i_h]->Write(m_histKeys[i_h]);
+  }
+  summaryFile.Close();
+  gSystem->Rename(tempName, summaryName);
+}
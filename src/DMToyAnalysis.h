@@ -12,6 +12,12 @@
 #ifndef DMToyAnalysis_h
 #define DMToyAnalysis_h
 
+// ROOT libraries:
+#include "RVersion.h"
+#include "TSystem.h"
+#include "TThread.h"
+#include "TVectorD.h"
+
 // Package libraries:
 #include "CommonHead.h"
 #include "CommonFunc.h"
@@ -21,6 +27,18 @@
 #include "RooFitHead.h"
 #include "statistics.h"
 
+class DMToyAnalysis;
+
+// The files read by one thread, and the histograms it accumulates (in the
+// order of the keys in DMToyAnalysis::m_histKeys):
+struct DMToyAnalysisWorker {
+  DMToyAnalysis *toyAnalysis;
+  int muValue;
+  std::vector<TString> fileNames;
+  std::vector<TH1F*> hists;
+  int nReadFiles;
+};
+
 class DMToyAnalysis {
 
  public:
@@ -28,13 +46,18 @@ class DMToyAnalysis {
   DMToyAnalysis(TString newConfigFile, TString newDMSignal);
   virtual ~DMToyAnalysis() {};
   
-  void fillToyHistograms(int muValue, DMToyTree *toyTree);
+  void calculateWeightedP0();
+  void fillToyHistograms(int muValue, std::vector<TString> fileNames);
   void getAsymptoticForm(TString statistic);
   TH1F* getAsymptoticHist();
   TH1F* getGlobsHist(TString paramName, TString fitType, int toyMu);
   TH1F* getNuisHist(TString paramName, TString fitType, int toyMu);
   TH1F* getMuHist(int toyMu);
   TH1F* getStatHist(TString statistic, int toyMu);
+  static TString getToyFileStamp(TString fileName);
+  static bool loadToyStats(TString fileName, TString summaryDir,
+			   std::vector<double> &valuesQMu,
+			   std::vector<double> &valuesQ0);
   void plotParameter(TString paramName, TString paramType, int toyMu);
   void plotProfiledMu(); 
   void plotTestStat(TString statistic);
@@ -42,10 +65,23 @@ class DMToyAnalysis {
     
  private:
   
+  void bookHists(int muValue);
+  std::vector<TH1F*> cloneHists(int muValue, TString suffix);
+  void fillHists(DMToyTree *toyTree, std::vector<TH1F*> hists);
+  TString getFileStamp(TString fileName);
+  TString getSummaryName(TString fileName);
+  bool loadFileSummary(TString fileName, std::vector<TH1F*> hists);
+  void loadParamNames(TString fileName);
   TString printStatName(TString statistic);
+  void processFiles(DMToyAnalysisWorker *worker);
+  static void* processFilesThread(void *worker);
+  void saveFileSummary(TString fileName, std::vector<TH1F*> hists);
   
   // Private member variables:
+  Config *m_config;
+  TString m_DMSignal;
   TString m_outputDir;
+  TString m_toyDir;
   
   // Classes for statistics access:
   DMTestStat *m_dmts;
@@ -69,6 +105,10 @@ class DMToyAnalysis {
   TH1F *m_hGlobsMu1[20][2];
   TH1F *m_hGlobsMuFree[20][2];
   
+  // The histograms for each mu value, and their keys in the file summaries:
+  std::vector<TH1F*> m_hists[2];
+  std::vector<TString> m_histKeys;
+  
   // Parameter data:
   std::vector<std::string> m_namesGlobs;
   std::vector<std::string> m_namesNuis;
@@ -0,0 +1,460 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: DMToyController.cxx                                                 //
+//                                                                            //
+//  Created: agent                                                            //
+//  Date: 16/10/2026                                                          //
+//                                                                            //
+//  This class decides how many pseudo-experiments each signal needs. It      //
+//  reads the toys made so far, estimates CLs and p0 with their binomial      //
+//  uncertainties, and asks for more toys only for the signals that have not  //
+//  reached the relative precision "ToyPrecision" on the estimates listed in  //
+//  "ToyTargets" (CLs by default, and/or p0). CLs is also final when it is    //
+//  more than "ToyDecisionSigma" uncertainties away from "ToyCLsThreshold"    //
+//  (the exclusion is then decided), and p0 once its upper bound is below the //
+//  p-value of "ToyP0Sigma". No signal gets more than "ToyMaxPerSignal" toys. //
+//                                                                            //
+//  The toy p-values are:                                                     //
+//    CLs+b - fraction of mu=1 toys with qMu >= qMu(observed)                 //
+//    CLb   - fraction of mu=0 toys with qMu >= qMu(observed)                 //
+//    CLs   - CLs+b / CLb                                                     //
+//    p0    - fraction of mu=0 toys with q0 >= q0(observed)                   //
+//                                                                            //
+//  A p-value without any passing toys is taken as 1/N. The test statistics   //
+//  of each toy file are kept in a summary in DMToyAnalysis/summaries, so     //
+//  that each round only reads the new toy files.                             //
+//                                                                            //
+//  The submitted jobs are written to DMToyController/submitted_<signal>.txt, //
+//  so that jobs waiting in a batch queue are known to later calls. A signal  //
+//  gets no new toys while any of its jobs is pending.                        //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include "DMToyController.h"
+
+/**
+   -----------------------------------------------------------------------------
+   Initialize the controller. The toys are read by update().
+   @param newConfigFile - The name of the analysis config file.
+*/
+DMToyController::DMToyController(TString newConfigFile) {
+  m_configFile = newConfigFile;
+  m_config = new Config(newConfigFile);
+  m_ledger = new DMJobLedger(newConfigFile);
+  TString jobDir = Form("%s/%s", (m_config->getStr("masterOutput")).Data(),
+			(m_config->getStr("jobName")).Data());
+  m_outputDir = Form("%s/DMToyController", jobDir.Data());
+  m_toyDir = Form("%s/DMPseudoExp", jobDir.Data());
+  m_summaryDir = Form("%s/DMToyAnalysis/summaries", jobDir.Data());
+  system(Form("mkdir -vp %s", m_outputDir.Data()));
+  
+  // Settings of the controller:
+  m_precision = m_config->getNum("ToyPrecision", 0.1);
+  m_decisionSigma = m_config->getNum("ToyDecisionSigma", 3.0);
+  m_thresholdCLs = m_config->getNum("ToyCLsThreshold", 0.05);
+  TString targets = m_config->getStr("ToyTargets", TString("CLs"));
+  m_targetCLs = targets.Contains("CLs");
+  m_targetP0 = targets.Contains("p0");
+  m_thresholdP0
+    = RooStats::SignificanceToPValue(m_config->getNum("ToyP0Sigma", 3.0));
+  m_stallTime = 3600.0 * m_config->getNum("JobStallHours", 12.0);
+  m_firstSeed = m_config->getInt("toySeed");
+  m_nToysPerJob = m_config->getInt("nToysPerJob");
+  m_minToys = m_config->getInt("ToyMinPerSignal", m_nToysPerJob);
+  m_maxToys = m_config->getInt("ToyMaxPerSignal", 20000);
+  
+  m_signals.clear();
+  m_obsQMu.clear();
+  m_obsQ0.clear();
+  m_toyStates.clear();
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Delete the controller, its ledger and its config.
+*/
+DMToyController::~DMToyController() {
+  delete m_ledger;
+  delete m_config;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Get the toy estimate of CLs. A p-value without any passing toys is taken as
+   1/N, as in getCLsError(), so that CLs is never zero.
+   @param signal - The signal.
+   @return - The value of CLs.
+*/
+double DMToyController::getCLs(TString signal) {
+  if (m_nToysMu0[signal] == 0 || m_nToysMu1[signal] == 0) return 1.0;
+  double valueCLsb = ((double)TMath::Max(m_nPassCLsb[signal], 1))
+    / m_nToysMu1[signal];
+  double valueCLb = ((double)TMath::Max(m_nPassCLb[signal], 1))
+    / m_nToysMu0[signal];
+  return valueCLsb / valueCLb;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Get the uncertainty on the toy estimate of CLs, from the binomial
+   uncertainties on CLs+b and CLb. A p-value without any passing toys is taken
+   as 1/N, so that the uncertainty is not zero.
+   @param signal - The signal.
+   @return - The uncertainty on CLs.
+*/
+double DMToyController::getCLsError(TString signal) {
+  int nToysMu0 = m_nToysMu0[signal];
+  int nToysMu1 = m_nToysMu1[signal];
+  if (nToysMu0 == 0 || nToysMu1 == 0) return 1.0;
+  double valueCLsb = ((double)TMath::Max(m_nPassCLsb[signal], 1)) / nToysMu1;
+  double valueCLb = ((double)TMath::Max(m_nPassCLb[signal], 1)) / nToysMu0;
+  double relErrorCLsb
+    = statistics::pvalueError(valueCLsb, nToysMu1) / valueCLsb;
+  double relErrorCLb = statistics::pvalueError(valueCLb, nToysMu0) / valueCLb;
+  return (valueCLsb / valueCLb) * sqrt(relErrorCLsb * relErrorCLsb +
+				       relErrorCLb * relErrorCLb);
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Get the first seeds of the jobs that should be submitted next for a signal.
+   The state of the signal must have been set by update().
+   @param signal - The signal.
+   @return - The first seeds of the new jobs (empty if no toys are needed).
+*/
+std::vector<int> DMToyController::getNewSeeds(TString signal) {
+  std::vector<int> result; result.clear();
+  if (getToyState(signal) != kNeedsToys) return result;
+  int nJobs = (getNToysNeeded(signal) + m_nToysPerJob - 1) / m_nToysPerJob;
+  for (int i_j = 0; i_j < nJobs; i_j++) {
+    result.push_back(m_nextSeed[signal] + i_j * m_nToysPerJob);
+  }
+  return result;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Get the number of converged toys of a signal (the smaller of the mu=0 and
+   mu=1 counts).
+   @param signal - The signal.
+   @return - The number of toys.
+*/
+int DMToyController::getNToys(TString signal) {
+  return TMath::Min(m_nToysMu0[signal], m_nToysMu1[signal]);
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Get the number of toys that a signal still needs. The uncertainties scale as
+   1/sqrt(N), but the toys at most double in each round, since the estimated
+   uncertainties are noisy for few toys.
+   @param signal - The signal.
+   @return - The number of new toys.
+*/
+int DMToyController::getNToysNeeded(TString signal) {
+  int nSubmitted = m_nSubmitted[signal];
+  int nToys = getNToys(signal);
+  int nNew = m_minToys - nSubmitted;
+  if (nSubmitted >= m_minToys && nToys > 0) {
+    double ratio = 0.0;
+    if (m_targetP0 && !isP0Decided(signal)) {
+      ratio = getP0Error(signal) / (getP0(signal) * m_precision);
+    }
+    double errorCLs = getCLsError(signal);
+    if (m_targetCLs && errorCLs > m_precision * getCLs(signal) &&
+	fabs(getCLs(signal) - m_thresholdCLs) < m_decisionSigma * errorCLs) {
+      ratio = TMath::Max(ratio, errorCLs / (getCLs(signal) * m_precision));
+    }
+    nNew = (int)TMath::Min(nToys * ratio * ratio - nSubmitted,
+			   (double)nSubmitted);
+  }
+  nNew = TMath::Max(nNew, m_nToysPerJob);
+  return TMath::Min(nNew, m_maxToys - nSubmitted);
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Get the toy estimate of p0. A p0 without any passing toys is taken as 1/N.
+   @param signal - The signal.
+   @return - The value of p0.
+*/
+double DMToyController::getP0(TString signal) {
+  if (m_nToysMu0[signal] == 0) return 1.0;
+  return ((double)TMath::Max(m_nPassP0[signal], 1)) / m_nToysMu0[signal];
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Get the binomial uncertainty on the toy estimate of p0.
+   @param signal - The signal.
+   @return - The uncertainty on p0.
+*/
+double DMToyController::getP0Error(TString signal) {
+  if (m_nToysMu0[signal] == 0) return 1.0;
+  return statistics::pvalueError(getP0(signal), m_nToysMu0[signal]);
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Get the name of a toy state, for printing.
+   @param state - The state of the toys of a signal.
+   @return - The name of the state.
+*/
+TString DMToyController::getStateName(int state) {
+  if (state == kWaiting) return "waiting";
+  else if (state == kPrecise) return "precise";
+  else if (state == kDecided) return "decided";
+  else if (state == kAtMaximum) return "at_maximum";
+  return "needs_toys";
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Get the state of the toys of a signal from the last update().
+   @param signal - The signal.
+   @return - The state of the toys.
+*/
+int DMToyController::getToyState(TString signal) {
+  if (m_toyStates.count(signal) == 0) return kNeedsToys;
+  return m_toyStates[signal];
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Check whether p0 is known to be below the p-value of "ToyP0Sigma", so that
+   it needs no more precision. Without any passing toys, p0 is below 3/N at
+   95% CL. Otherwise its upper bound is "ToyDecisionSigma" uncertainties above
+   the estimate. Deep in the tail, the relative uncertainty stays near 1 for
+   any number of toys, so this stops the p0 target from using the maximum.
+   @param signal - The signal.
+   @return - True iff p0 is below the threshold.
+*/
+bool DMToyController::isP0Decided(TString signal) {
+  if (m_nToysMu0[signal] == 0) return false;
+  double upperP0 = (m_nPassP0[signal] == 0) ?
+    (3.0 / m_nToysMu0[signal]) :
+    (getP0(signal) + m_decisionSigma * getP0Error(signal));
+  return (upperP0 < m_thresholdP0);
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Load the observed test statistics of a signal. They are saved with the
+   modification time of the workspace, and only calculated again when the
+   workspace changes.
+   @param signal - The signal.
+*/
+void DMToyController::loadObserved(TString signal) {
+  TString wsFileName = Form("%s/%s/DMWorkspace/rootfiles/workspaceDM_%s.root",
+			    (m_config->getStr("masterOutput")).Data(),
+			    (m_config->getStr("jobName")).Data(),
+			    signal.Data());
+  FileStat_t fileStat;
+  long wsTime = 0;
+  if (gSystem->GetPathInfo(wsFileName, fileStat) == 0) {
+    wsTime = fileStat.fMtime;
+  }
+  
+  // Use the saved values if the workspace has not changed:
+  TString obsFileName = Form("%s/observed_%s.txt", m_outputDir.Data(),
+			     signal.Data());
+  std::ifstream obsFile(obsFileName);
+  long savedTime = -1; double savedQMu = 0.0; double savedQ0 = 0.0;
+  if (obsFile.is_open()) {
+    obsFile >> savedTime >> savedQMu >> savedQ0;
+    obsFile.close();
+  }
+  if (savedTime == wsTime) {
+    m_obsQMu[signal] = savedQMu;
+    m_obsQ0[signal] = savedQ0;
+    return;
+  }
+  
+  // Otherwise fit the observed data:
+  DMTestStat *dmts = new DMTestStat(m_configFile, signal, "new", NULL);
+  m_obsQMu[signal] = dmts->calculateObsTestStat("QMu");
+  m_obsQ0[signal] = dmts->calculateObsTestStat("Q0");
+  delete dmts;
+  
+  std::ofstream newObsFile(obsFileName);
+  newObsFile << wsTime << " " << m_obsQMu[signal] << " " << m_obsQ0[signal]
+	     << std::endl;
+  newObsFile.close();
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Print the toy estimates and the state of each signal in the last update(),
+   and write them to toy_summary.txt.
+*/
+void DMToyController::printSummary() {
+  std::ofstream summaryFile(Form("%s/toy_summary.txt", m_outputDir.Data()));
+  std::cout << "DMToyController: Toy estimates of CLs and p0" << std::endl;
+  for (int i_s = 0; i_s < (int)m_signals.size(); i_s++) {
+    TString currSignal = m_signals[i_s];
+    TString line = Form("%s %d %f %f %f %f %s", currSignal.Data(),
+			getNToys(currSignal), getCLs(currSignal),
+			getCLsError(currSignal), getP0(currSignal),
+			getP0Error(currSignal),
+			(getStateName(getToyState(currSignal))).Data());
+    std::cout << "\t" << line << std::endl;
+    summaryFile << line << std::endl;
+  }
+  summaryFile.close();
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Read the toy jobs of a signal, from the ledger and from the submissions of
+   the controller, and check whether any of them is pending. A job is pending
+   until both of its toy types have ended, or one of them has failed. A
+   submitted job that never started is taken as lost after "JobStallHours".
+   @param signal - The signal.
+*/
+void DMToyController::readSubmissions(TString signal) {
+  std::map<int,int> jobs = m_ledger->getJobSeeds("DMPseudoExp_mu0", signal);
+  std::map<int,long> submitTimes; submitTimes.clear();
+  std::ifstream submitFile(Form("%s/submitted_%s.txt", m_outputDir.Data(),
+				signal.Data()));
+  long submitTime; int seed, nToys;
+  while (submitFile >> submitTime >> seed >> nToys) {
+    jobs[seed] = nToys;
+    submitTimes[seed] = submitTime;
+  }
+  submitFile.close();
+  
+  m_nSubmitted[signal] = 0;
+  m_nextSeed[signal] = m_firstSeed;
+  bool isWaiting = false;
+  long currTime = (long)time(NULL);
+  for (std::map<int,int>::iterator iter = jobs.begin(); iter != jobs.end();
+       iter++) {
+    m_nSubmitted[signal] += iter->second;
+    m_nextSeed[signal] = TMath::Max(m_nextSeed[signal],
+				    iter->first + iter->second);
+    int stateMu0 = m_ledger->getJobState("DMPseudoExp_mu0", signal,
+					 iter->first);
+    int stateMu1 = m_ledger->getJobState("DMPseudoExp_mu1", signal,
+					 iter->first);
+    if (stateMu0 == DMJobLedger::kRunning ||
+	stateMu1 == DMJobLedger::kRunning) {
+      isWaiting = true;
+    }
+    else if (stateMu0 != DMJobLedger::kFailed &&
+	     stateMu1 != DMJobLedger::kFailed &&
+	     (stateMu0 == DMJobLedger::kMissing ||
+	      stateMu1 == DMJobLedger::kMissing) &&
+	     submitTimes.count(iter->first) > 0 &&
+	     currTime - submitTimes[iter->first] < m_stallTime) {
+      isWaiting = true;
+    }
+  }
+  m_toyStates[signal] = isWaiting ? kWaiting : kNeedsToys;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Count the converged toys of a signal, and the toys passing the observed
+   test statistics. The test statistics of each toy file are kept in a summary
+   by DMToyAnalysis::loadToyStats(), so only new or changed files are read.
+   @param signal - The signal.
+*/
+void DMToyController::readToys(TString signal) {
+  m_nToysMu0[signal] = 0;
+  m_nToysMu1[signal] = 0;
+  m_nPassCLsb[signal] = 0;
+  m_nPassCLb[signal] = 0;
+  m_nPassP0[signal] = 0;
+  TString summaryDir = Form("%s/%s", m_summaryDir.Data(), signal.Data());
+  system(Form("mkdir -vp %s", summaryDir.Data()));
+  
+  for (int i_m = 0; i_m < 2; i_m++) {
+    TString fileList
+      = gSystem->GetFromPipe(Form("ls %s/single_files/%s/toy_mu%d_*.root "
+				  "2>/dev/null", m_toyDir.Data(),
+				  signal.Data(), i_m));
+    TObjArray *tokens = fileList.Tokenize("\n");
+    for (int i_f = 0; i_f < tokens->GetEntries(); i_f++) {
+      TString fileName = ((TObjString*)tokens->At(i_f))->GetString();
+      std::vector<double> valuesQMu; std::vector<double> valuesQ0;
+      if (!DMToyAnalysis::loadToyStats(fileName, summaryDir, valuesQMu,
+				       valuesQ0)) {
+	std::cout << "DMToyController: Skipping " << fileName << std::endl;
+	continue;
+      }
+      for (int i_t = 0; i_t < (int)valuesQMu.size(); i_t++) {
+	if (i_m == 0) {
+	  m_nToysMu0[signal]++;
+	  if (valuesQMu[i_t] >= m_obsQMu[signal]) m_nPassCLb[signal]++;
+	  if (valuesQ0[i_t] >= m_obsQ0[signal]) m_nPassP0[signal]++;
+	}
+	else {
+	  m_nToysMu1[signal]++;
+	  if (valuesQMu[i_t] >= m_obsQMu[signal]) m_nPassCLsb[signal]++;
+	}
+      }
+    }
+    delete tokens;
+  }
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Record the submission of a toy job, so that it is known to be pending.
+   @param signal - The signal of the job.
+   @param seed - The first seed of the job.
+   @param nToys - The number of toys of the job.
+*/
+void DMToyController::recordSubmission(TString signal, int seed, int nToys) {
+  std::ofstream submitFile(Form("%s/submitted_%s.txt", m_outputDir.Data(),
+				signal.Data()), std::ios::app);
+  submitFile << (long)time(NULL) << " " << seed << " " << nToys << std::endl;
+  submitFile.close();
+  m_nSubmitted[signal] += nToys;
+  m_nextSeed[signal] = TMath::Max(m_nextSeed[signal], seed + nToys);
+  m_toyStates[signal] = kWaiting;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Read the jobs and toys of the signals, and decide which signals need more
+   toys. The toys of signals with pending jobs are not read.
+   @param signals - The signals to control.
+*/
+void DMToyController::update(std::vector<TString> signals) {
+  m_ledger->readLedger();
+  m_signals = signals;
+  for (int i_s = 0; i_s < (int)m_signals.size(); i_s++) {
+    TString currSignal = m_signals[i_s];
+    readSubmissions(currSignal);
+    if (m_toyStates[currSignal] == kWaiting) continue;
+  
+    // Signals without toys do not need the observed test statistics:
+    if (m_nSubmitted[currSignal] == 0) {
+      m_nToysMu0[currSignal] = 0;
+      m_nToysMu1[currSignal] = 0;
+      continue;
+    }
+    loadObserved(currSignal);
+    readToys(currSignal);
+    if (getNToys(currSignal) == 0 || m_nSubmitted[currSignal] < m_minToys) {
+      continue;
+    }
+  
+    // Check the precision of p0 and CLs:
+    double errorCLs = getCLsError(currSignal);
+    bool preciseP0 = (!m_targetP0 || isP0Decided(currSignal) ||
+		      getP0Error(currSignal) <=
+		      m_precision * getP0(currSignal));
+    bool preciseCLs = (!m_targetCLs || errorCLs <=
+		       m_precision * getCLs(currSignal));
+    bool decidedCLs = (!m_targetCLs ||
+		       fabs(getCLs(currSignal) - m_thresholdCLs) >=
+		       m_decisionSigma * errorCLs);
+    if (preciseP0 && preciseCLs) m_toyStates[currSignal] = kPrecise;
+    else if (preciseP0 && decidedCLs) m_toyStates[currSignal] = kDecided;
+    else if (m_nSubmitted[currSignal] >= m_maxToys) {
+      m_toyStates[currSignal] = kAtMaximum;
+    }
+  }
+}
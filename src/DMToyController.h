@@ -0,0 +1,117 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: DMToyController.h                                                   //
+//  Class: DMToyController.cxx                                                //
+//                                                                            //
+//  Author: agent                                                             //
+//  Date: 16/10/2026                                                          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef DMToyController_h
+#define DMToyController_h
+
+// C++ includes:
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <map>
+#include <time.h>
+
+// ROOT includes:
+#include "TFile.h"
+#include "TMath.h"
+#include "TObjArray.h"
+#include "TObjString.h"
+#include "TString.h"
+#include "TSystem.h"
+#include "TTree.h"
+
+// Package includes:
+#include "Config.h"
+#include "DMJobLedger.h"
+#include "DMTestStat.h"
+#include "DMToyAnalysis.h"
+#include "DMToyTree.h"
+#include "statistics.h"
+
+class DMToyController
+{
+  
+ public:
+  
+  // Status of the toys of each signal:
+  enum ToyState { kNeedsToys, kWaiting, kPrecise, kDecided, kAtMaximum };
+  
+  DMToyController(TString newConfigFile);
+  virtual ~DMToyController();
+  
+  // Accessors:
+  double getCLs(TString signal);
+  double getCLsError(TString signal);
+  std::vector<int> getNewSeeds(TString signal);
+  int getNToys(TString signal);
+  double getP0(TString signal);
+  double getP0Error(TString signal);
+  int getToyState(TString signal);
+  void printSummary();
+  
+  // Mutators:
+  void recordSubmission(TString signal, int seed, int nToys);
+  void update(std::vector<TString> signals);
+  
+ private:
+  
+  // Member methods:
+  int getNToysNeeded(TString signal);
+  TString getStateName(int state);
+  bool isP0Decided(TString signal);
+  void loadObserved(TString signal);
+  void readSubmissions(TString signal);
+  void readToys(TString signal);
+  
+  // Member objects:
+  Config *m_config;
+  TString m_configFile;
+  DMJobLedger *m_ledger;
+  TString m_outputDir;
+  TString m_toyDir;
+  TString m_summaryDir;
+  
+  // Settings of the controller:
+  double m_precision;
+  double m_decisionSigma;
+  double m_thresholdCLs;
+  double m_thresholdP0;
+  bool m_targetCLs;
+  bool m_targetP0;
+  double m_stallTime;
+  int m_firstSeed;
+  int m_nToysPerJob;
+  int m_minToys;
+  int m_maxToys;
+  
+  // The signals in the last update, and their observed test statistics:
+  std::vector<TString> m_signals;
+  std::map<TString,double> m_obsQMu;
+  std::map<TString,double> m_obsQ0;
+  
+  // Toy counts (indexed by signal):
+  std::map<TString,int> m_nToysMu0;
+  std::map<TString,int> m_nToysMu1;
+  std::map<TString,int> m_nPassCLsb;
+  std::map<TString,int> m_nPassCLb;
+  std::map<TString,int> m_nPassP0;
+  
+  // Submitted toys and the state of each signal:
+  std::map<TString,int> m_nSubmitted;
+  std::map<TString,int> m_nextSeed;
+  std::map<TString,int> m_toyStates;
+  
+};
+
+#endif
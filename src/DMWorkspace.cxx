@@ -154,8 +154,15 @@ void DMWorkspace::createNewWS() {
   //m_pes = new PESReader(m_config->getStr("fileNamePESValues"), m_nCategories);
   //m_per = new PERReader(m_config->getStr("fileNamePERValues"), m_nCategories);
   
-  // Instantiate the signal parameterization class using the observable:
-  m_spi = new SigParamInterface(m_configFile, "FromFile");
+  // Instantiate the signal parameterization class using the observable. Only
+  // the SM signals and the current DM signal are needed:
+  std::vector<TString> signalTypes; signalTypes.clear();
+  if (m_config->getBool("SplitSMProdModes")) {
+    signalTypes = m_config->getStrV("sigSMModes");
+  }
+  signalTypes.push_back(m_DMSignal);
+  signalTypes.push_back("SM");
+  m_spi = new SigParamInterface(m_configFile, "FromFile", signalTypes);
     
   //--------------------------------------//
   // Initialize classes relevant to workspace:
@@ -10,6 +10,7 @@
 //                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
 
+#include "DMJobLedger.h"
 #include "DMWorkspace.h"
 
 int main(int argc, char **argv) {
@@ -24,11 +25,18 @@ int main(int argc, char **argv) {
   TString DMSignal = argv[2];
   TString options = argv[3];
   
+  // Record the job in the ledger:
+  DMJobLedger *ledger = new DMJobLedger(configFile);
+  ledger->recordStart("DMWorkspace", DMSignal, -1, 0);
+  
   // Load the workspace tool:
   DMWorkspace *dmw = new DMWorkspace(configFile, DMSignal, options);
-  if (dmw->fitsAllConverged()) {
+  bool allConverged = dmw->fitsAllConverged();
+  if (allConverged) {
     std::cout << "DMWorkspaceWrapper: All OK!" << std::endl;
   }
   delete dmw;
+  ledger->recordEnd("DMWorkspace", DMSignal, -1, 0, 0, allConverged);
+  delete ledger;
   return 0;
 }
@@ -2,7 +2,7 @@
 //                                                                            //
 //  Name: DMxAODCutflow.cxx                                                   //
 //                                                                            //
-//  Created: Andrew Hard                                                      //
+//  Created: agent                                                            //
 //  Email: ahard@cern.ch                                                      //
 //  Date: 23/04/2015                                                          //
 //                                                                            //
@@ -29,31 +29,8 @@ DMxAODCutflow::DMxAODCutflow(TString fileName, TString configFileName) {
   Config *config = new Config(configFileName);
   m_unskimmed = !DMAnalysis::isSkimmed(config, fileName);
   
-  // NOTE: at the moment, the weighted cutflow histogram is the 
-  // weighted_nodalitz histogram. Not sure whether this is the correct choice.
-  // need to check.
-  
   // Find the cutflow histograms from the file based on limited name info:
-  m_histCuts_weighted = NULL;
-  m_histCuts_unweighted = NULL;
-  //m_histCuts_weighted_NoDalitz = NULL;
-  TIter next(m_inputFile->GetListOfKeys());
-  TObject *currObj;
-  while ((currObj = (TObject*)next())) {
-    TString currName = currObj->GetName();
-    if (currName.Contains("CutFlow") && currName.Contains("weighted")
-    	&& currName.Contains("noDalitz")) {
-      m_histCuts_weighted = (TH1F*)m_inputFile->Get(currName);
-    }
-    //else if (currName.Contains("CutFlow") && currName.Contains("weighted")
-    //	     && currName.Contains("noDalitz")) {
-    //m_histCuts_weighted_NoDalitz = (TH1F*)m_inputFile->Get(currName);
-    //}
-    else if (currName.Contains("CutFlow") && !currName.Contains("weighted")
-	     && !currName.Contains("noDalitz")) {
-      m_histCuts_unweighted = (TH1F*)m_inputFile->Get(currName);
-    }
-  }
+  findHists(m_inputFile, m_histCuts_weighted, m_histCuts_unweighted);
   if (m_histCuts_weighted && m_histCuts_unweighted) {
     std::cout << "DMxAODCutflow: Sample is weighted." << std::endl;
     m_isWeighted = true;
@@ -99,7 +76,6 @@ DMxAODCutflow::DMxAODCutflow(TString fileName, TString configFileName) {
   printxAODCutflow();
   
   std::cout << "DMxAODCutflow: Successfully initialized!" << std::endl;
-  delete currObj;
   delete config;
 }
 
@@ -221,19 +197,63 @@ double DMxAODCutflow::getAccXEffAtCut(TString cutName) {
   return result;
 }
 
+/**
+   -----------------------------------------------------------------------------
+   Find the cutflow histograms in a file based on limited name info. A pointer
+   is set to NULL if the histogram does not exist.
+   @param file - The MxAOD file.
+   @param histWeighted - Set to the weighted (noDalitz) cutflow histogram.
+   @param histUnweighted - Set to the unweighted cutflow histogram.
+*/
+void DMxAODCutflow::findHists(TFile *file, TH1F *&histWeighted,
+			      TH1F *&histUnweighted) {
+  // NOTE: at the moment, the weighted cutflow histogram is the 
+  // weighted_nodalitz histogram. Not sure whether this is the correct choice.
+  // need to check.
+  histWeighted = NULL;
+  histUnweighted = NULL;
+  TIter next(file->GetListOfKeys());
+  TObject *currObj;
+  while ((currObj = (TObject*)next())) {
+    TString currName = currObj->GetName();
+    if (currName.Contains("CutFlow") && currName.Contains("weighted")
+    	&& currName.Contains("noDalitz")) {
+      histWeighted = (TH1F*)file->Get(currName);
+    }
+    else if (currName.Contains("CutFlow") && !currName.Contains("weighted")
+	     && !currName.Contains("noDalitz")) {
+      histUnweighted = (TH1F*)file->Get(currName);
+    }
+  }
+}
+
 /**
    -----------------------------------------------------------------------------
    Get the total number of events in the file, for normalization of MC.
 */
 double DMxAODCutflow::nTotalEventsInFile() {
+  return nTotalEvents(m_isWeighted ? m_histCuts_weighted : NULL,
+		      m_histCuts_unweighted, m_unskimmed);
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Get the total number of events in a file from its cutflow histograms.
+   @param histWeighted - The weighted cutflow histogram (NULL if unweighted).
+   @param histUnweighted - The unweighted cutflow histogram.
+   @param unskimmed - True iff the file is unskimmed.
+   @return - The total number of events, for normalization of MC.
+*/
+double DMxAODCutflow::nTotalEvents(TH1F *histWeighted, TH1F *histUnweighted,
+				   bool unskimmed) {
   double nTotalEvents = 0.0;
-  if (!m_isWeighted) nTotalEvents = m_histCuts_unweighted->GetBinContent(1);//?
+  if (!histWeighted) nTotalEvents = histUnweighted->GetBinContent(1);//?
   else {
-    if (m_unskimmed) nTotalEvents = m_histCuts_weighted->GetBinContent(3);
+    if (unskimmed) nTotalEvents = histWeighted->GetBinContent(3);
     else {
-      nTotalEvents = (m_histCuts_weighted->GetBinContent(3) * 
-		      m_histCuts_unweighted->GetBinContent(2) /
-		      m_histCuts_unweighted->GetBinContent(1));
+      nTotalEvents = (histWeighted->GetBinContent(3) * 
+		      histUnweighted->GetBinContent(2) /
+		      histUnweighted->GetBinContent(1));
     }
   }
   return nTotalEvents;
@@ -50,6 +50,12 @@ class DMxAODCutflow
   void printxAODCutflow();
   double nTotalEventsInFile();
   
+  // Static methods shared with DMxAODIndex:
+  static void findHists(TFile *file, TH1F *&histWeighted,
+			TH1F *&histUnweighted);
+  static double nTotalEvents(TH1F *histWeighted, TH1F *histUnweighted,
+			     bool unskimmed);
+  
  private:
   
   // Member methods:
@@ -0,0 +1,362 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: DMxAODIndex.cxx                                                     //
+//                                                                            //
+//  Created: agent                                                            //
+//  Date: 16/10/2026                                                          //
+//                                                                            //
+//  This class reads the metadata of a list of MxAOD files once: the cutflow  //
+//  histograms, the total number of events, the skim status and the cross-    //
+//  section times BR times filter efficiency of each file. The event loop     //
+//  can then switch between files without opening them again.                 //
+//                                                                            //
+//  A file is only read when its metadata is first requested, from its local  //
+//  copy if one was set with setLocalName(). The remote files are then never  //
+//  opened one after the other before the copies start. The index can be      //
+//  used by several threads.                                                  //
+//                                                                            //
+//  The UUIDs and sizes of the files can be kept in a cache file (see         //
+//  setUUIDCache()), keyed by the path, modification time and size of each    //
+//  file. A file that has not changed is then not opened to identify it.      //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include "DMxAODIndex.h"
+
+/**
+   -----------------------------------------------------------------------------
+   Create the index for a list of files. The metadata of each file is read
+   when it is first requested.
+   @param fileNames - The names of the MxAOD files.
+   @param config - The config of the analysis (for the skim tags).
+*/
+DMxAODIndex::DMxAODIndex(std::vector<TString> fileNames, Config *config) {
+  std::cout << "DMxAODIndex: Index of " << fileNames.size() << " files."
+	    << std::endl;
+  m_config = config;
+  m_mutex = new TMutex();
+  m_fileNames = fileNames;
+  m_localNames = fileNames;
+  int nFiles = (int)fileNames.size();
+  m_indexed.assign(nFiles, false);
+  m_uuids.assign(nFiles, "");
+  m_fileSizes.assign(nFiles, 0);
+  m_histsWeighted.assign(nFiles, NULL);
+  m_histsUnweighted.assign(nFiles, NULL);
+  m_skimmed.assign(nFiles, false);
+  m_nTotalEvents.assign(nFiles, 0.0);
+  m_crossSectionBRfilterEff.assign(nFiles, 0.0);
+  m_uuidCacheName = "";
+  m_uuidCacheChanged = false;
+  m_cachedUUIDs.clear();
+  m_cachedSizes.clear();
+  std::cout << "DMxAODIndex: Successfully initialized!" << std::endl;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Delete the stored cutflow histograms.
+*/
+DMxAODIndex::~DMxAODIndex() {
+  for (int i_f = 0; i_f < nFiles(); i_f++) {
+    if (m_histsWeighted[i_f]) delete m_histsWeighted[i_f];
+    if (m_histsUnweighted[i_f]) delete m_histsUnweighted[i_f];
+  }
+  delete m_mutex;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Check that a file index is valid, and exit otherwise. The metadata of the
+   file is read if this has not been done yet.
+   @param fileIndex - The index of the file in the list.
+*/
+void DMxAODIndex::checkIndex(int fileIndex) {
+  if (fileIndex < 0 || fileIndex >= nFiles()) {
+    std::cout << "DMxAODIndex: Error! No file with index " << fileIndex
+	      << std::endl;
+    exit(0);
+  }
+  m_mutex->Lock();
+  if (!m_indexed[fileIndex]) indexFile(fileIndex);
+  m_mutex->UnLock();
+}
+
+/**
+   -----------------------------------------------------------------------------
+   @param fileIndex - The index of the file in the list.
+   @return - The cross-section times BR times filter efficiency of the file.
+*/
+double DMxAODIndex::crossSectionBRfilterEff(int fileIndex) {
+  checkIndex(fileIndex);
+  return m_crossSectionBRfilterEff[fileIndex];
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Look up the UUID and size of a file in the cache, if it has not been read
+   yet. Called with the mutex locked.
+   @param fileIndex - The index of the file in the list.
+   @return - True iff the UUID and size of the file are known.
+*/
+bool DMxAODIndex::findCachedUUID(int fileIndex) {
+  if (m_indexed[fileIndex] || m_uuids[fileIndex] != "") return true;
+  if (m_cachedUUIDs.empty()) return false;
+  TString statKey = getStatKey(fileIndex);
+  if (statKey == "" || m_cachedUUIDs.count(statKey) == 0) return false;
+  m_uuids[fileIndex] = m_cachedUUIDs[statKey];
+  m_fileSizes[fileIndex] = m_cachedSizes[statKey];
+  return true;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   The size of a file is taken from the cache if possible (see getUUID()).
+   @param fileIndex - The index of the file in the list.
+   @return - The size of the file in bytes.
+*/
+Long64_t DMxAODIndex::getFileSize(int fileIndex) {
+  if (fileIndex < 0 || fileIndex >= nFiles()) checkIndex(fileIndex);
+  m_mutex->Lock();
+  bool isKnown = findCachedUUID(fileIndex);
+  m_mutex->UnLock();
+  if (!isKnown) checkIndex(fileIndex);
+  return m_fileSizes[fileIndex];
+}
+
+/**
+   -----------------------------------------------------------------------------
+   @param fileIndex - The index of the file in the list.
+   @return - The name of the file (not that of its local copy).
+*/
+TString DMxAODIndex::getFileName(int fileIndex) {
+  if (fileIndex < 0 || fileIndex >= nFiles()) checkIndex(fileIndex);
+  return m_fileNames[fileIndex];
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Get the cutflow histogram of a file, in the same way as DMxAODCutflow: the
+   weighted histogram for weighted samples, the unweighted one otherwise.
+   @param fileIndex - The index of the file in the list.
+   @return - The cutflow histogram (owned by the index).
+*/
+TH1F* DMxAODIndex::getHist(int fileIndex) {
+  return getHist(fileIndex, isWeighted(fileIndex));
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Get one of the cutflow histograms of a file.
+   @param fileIndex - The index of the file in the list.
+   @param weighted - True for the weighted histogram.
+   @return - The cutflow histogram (owned by the index), or NULL.
+*/
+TH1F* DMxAODIndex::getHist(int fileIndex, bool weighted) {
+  checkIndex(fileIndex);
+  return weighted ? m_histsWeighted[fileIndex] : m_histsUnweighted[fileIndex];
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Get the key of a file in the UUID cache, from a stat of the file (which
+   does not open it).
+   @param fileIndex - The index of the file in the list.
+   @return - The path, modification time and size of the file, or "".
+*/
+TString DMxAODIndex::getStatKey(int fileIndex) {
+  FileStat_t fileStat;
+  if (gSystem->GetPathInfo(m_fileNames[fileIndex], fileStat) != 0) return "";
+  return Form("%s %ld %lld", m_fileNames[fileIndex].Data(), fileStat.fMtime,
+	      fileStat.fSize);
+}
+
+/**
+   -----------------------------------------------------------------------------
+   The UUID is taken from the cache if the file has not changed since it was
+   stored there, so that the file is not opened.
+   @param fileIndex - The index of the file in the list.
+   @return - The UUID of the file, which changes whenever it is rewritten.
+*/
+TString DMxAODIndex::getUUID(int fileIndex) {
+  if (fileIndex < 0 || fileIndex >= nFiles()) checkIndex(fileIndex);
+  m_mutex->Lock();
+  bool isKnown = findCachedUUID(fileIndex);
+  m_mutex->UnLock();
+  if (!isKnown) checkIndex(fileIndex);
+  return m_uuids[fileIndex];
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Read the metadata of one file into the index, from its local copy if it
+   has one. The file is closed afterwards, and the histograms are detached
+   from it. Called with the mutex locked.
+   @param fileIndex - The index of the file in the list.
+*/
+void DMxAODIndex::indexFile(int fileIndex) {
+  TString fileName = m_localNames[fileIndex];
+  TFile *inputFile = TFile::Open(fileName, "READ");
+  if (!inputFile || inputFile->IsZombie()) {
+    std::cout << "DMxAODIndex: Error loading file: " << fileName << std::endl;
+    exit(0);
+  }
+  
+  TH1F *histWeighted = NULL;
+  TH1F *histUnweighted = NULL;
+  DMxAODCutflow::findHists(inputFile, histWeighted, histUnweighted);
+  if (!histUnweighted) {
+    std::cout << "DMxAODIndex: Error! No cutflow in file: " << fileName
+	      << std::endl;
+    exit(0);
+  }
+  histUnweighted = (TH1F*)histUnweighted->Clone();
+  histUnweighted->SetDirectory(0);
+  if (histWeighted) {
+    histWeighted = (TH1F*)histWeighted->Clone();
+    histWeighted->SetDirectory(0);
+  }
+  bool skimmed = DMAnalysis::isSkimmed(m_config, m_fileNames[fileIndex]);
+  
+  // The cross-section is stored with every event, so read the first one. A
+  // skim without events keeps the cross-section of its input instead:
+  Float_t xSectionBRfilterEff = 0.0;
+  TNamed *skimXSection = (TNamed*)inputFile->Get("skimCrossSectionBRfilterEff");
+  if (skimXSection) xSectionBRfilterEff = atof(skimXSection->GetTitle());
+  TTree *tree = (TTree*)inputFile->Get("CollectionTree");
+  if (tree && tree->GetEntries() > 0 &&
+      tree->GetBranch("HGamEventInfoAuxDyn.crossSectionBRfilterEff")) {
+    tree->SetBranchStatus("*", 0);
+    tree->SetBranchStatus("HGamEventInfoAuxDyn.crossSectionBRfilterEff", 1);
+    tree->SetBranchAddress("HGamEventInfoAuxDyn.crossSectionBRfilterEff",
+			   &xSectionBRfilterEff);
+    tree->GetEntry(0);
+    tree->ResetBranchAddresses();
+  }
+  
+  m_uuids[fileIndex] = inputFile->GetUUID().AsString();
+  m_fileSizes[fileIndex] = inputFile->GetSize();
+  m_histsWeighted[fileIndex] = histWeighted;
+  m_histsUnweighted[fileIndex] = histUnweighted;
+  m_skimmed[fileIndex] = skimmed;
+  m_nTotalEvents[fileIndex] = DMxAODCutflow::nTotalEvents(histWeighted,
+							  histUnweighted,
+							  !skimmed);
+  m_crossSectionBRfilterEff[fileIndex] = xSectionBRfilterEff;
+  m_indexed[fileIndex] = true;
+  
+  // Remember the identity of the file for later jobs:
+  if (m_uuidCacheName != "") {
+    TString statKey = getStatKey(fileIndex);
+    if (statKey != "" && m_cachedUUIDs[statKey] != m_uuids[fileIndex]) {
+      m_cachedUUIDs[statKey] = m_uuids[fileIndex];
+      m_cachedSizes[statKey] = m_fileSizes[fileIndex];
+      m_uuidCacheChanged = true;
+    }
+  }
+  
+  inputFile->Close();
+  delete inputFile;
+}
+
+/**
+   -----------------------------------------------------------------------------
+   @param fileIndex - The index of the file in the list.
+   @return - True iff the file is skimmed.
+*/
+bool DMxAODIndex::isSkimmed(int fileIndex) {
+  checkIndex(fileIndex);
+  return m_skimmed[fileIndex];
+}
+
+/**
+   -----------------------------------------------------------------------------
+   @param fileIndex - The index of the file in the list.
+   @return - True iff the file has a weighted cutflow histogram.
+*/
+bool DMxAODIndex::isWeighted(int fileIndex) {
+  checkIndex(fileIndex);
+  return (m_histsWeighted[fileIndex] != NULL);
+}
+
+/**
+   -----------------------------------------------------------------------------
+   @return - The number of files in the index.
+*/
+int DMxAODIndex::nFiles() {
+  return (int)m_fileNames.size();
+}
+
+/**
+   -----------------------------------------------------------------------------
+   @param fileIndex - The index of the file in the list.
+   @return - The total number of events in the file, for normalization of MC.
+*/
+double DMxAODIndex::nTotalEventsInFile(int fileIndex) {
+  checkIndex(fileIndex);
+  return m_nTotalEvents[fileIndex];
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Save the UUID cache, if files were added to it. The cache is written to a
+   temporary file first, so that a failed job does not leave a partial cache.
+*/
+void DMxAODIndex::saveUUIDCache() {
+  if (m_uuidCacheName == "" || !m_uuidCacheChanged) return;
+  m_mutex->Lock();
+  TString tempName = Form("%s.part", m_uuidCacheName.Data());
+  std::ofstream cacheFile(tempName);
+  std::map<TString,TString>::iterator iterUUID;
+  for (iterUUID = m_cachedUUIDs.begin(); iterUUID != m_cachedUUIDs.end();
+       iterUUID++) {
+    cacheFile << iterUUID->first << " " << iterUUID->second << " "
+	      << m_cachedSizes[iterUUID->first] << std::endl;
+  }
+  cacheFile.close();
+  gSystem->Rename(tempName, m_uuidCacheName);
+  m_uuidCacheChanged = false;
+  m_mutex->UnLock();
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Read the metadata of a file from a local copy, once it is requested. The
+   copy must be available when the metadata is first requested.
+   @param fileIndex - The index of the file in the list.
+   @param localName - The name of the local copy of the file.
+*/
+void DMxAODIndex::setLocalName(int fileIndex, TString localName) {
+  if (fileIndex < 0 || fileIndex >= nFiles()) checkIndex(fileIndex);
+  m_mutex->Lock();
+  m_localNames[fileIndex] = localName;
+  m_mutex->UnLock();
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Set the file that caches the UUIDs and sizes of files, and load it if it
+   exists. Each line holds the path, modification time and size of a file
+   (from a stat), followed by its UUID and its size from ROOT.
+   @param cacheName - The name of the cache file.
+*/
+void DMxAODIndex::setUUIDCache(TString cacheName) {
+  m_mutex->Lock();
+  m_uuidCacheName = cacheName;
+  m_uuidCacheChanged = false;
+  m_cachedUUIDs.clear();
+  m_cachedSizes.clear();
+  std::ifstream cacheFile(cacheName);
+  std::string path, uuid;
+  long mtime;
+  Long64_t statSize, fileSize;
+  while (cacheFile >> path >> mtime >> statSize >> uuid >> fileSize) {
+    TString statKey = Form("%s %ld %lld", path.c_str(), mtime, statSize);
+    m_cachedUUIDs[statKey] = uuid.c_str();
+    m_cachedSizes[statKey] = fileSize;
+  }
+  cacheFile.close();
+  std::cout << "DMxAODIndex: Loaded " << m_cachedUUIDs.size()
+	    << " file UUIDs from " << cacheName << std::endl;
+  m_mutex->UnLock();
+}
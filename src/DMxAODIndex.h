@@ -0,0 +1,93 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: DMxAODIndex.h                                                       //
+//  Class: DMxAODIndex.cxx                                                    //
+//                                                                            //
+//  Author: agent                                                             //
+//  Date: 16/10/2026                                                          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef DMxAODIndex_h
+#define DMxAODIndex_h
+
+// C++ includes:
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <map>
+
+// ROOT includes:
+#include "TString.h"
+#include "TFile.h"
+#include "TTree.h"
+#include "TH1F.h"
+#include "TNamed.h"
+#include "TSystem.h"
+#include "TMutex.h"
+
+// Package includes:
+#include "Config.h"
+#include "DMAnalysis.h"
+#include "DMxAODCutflow.h"
+
+class DMxAODIndex 
+{
+  
+ public:
+  
+  DMxAODIndex(std::vector<TString> fileNames, Config *config);
+  virtual ~DMxAODIndex();
+  
+  // Accessors:
+  double crossSectionBRfilterEff(int fileIndex);
+  Long64_t getFileSize(int fileIndex);
+  TString getFileName(int fileIndex);
+  TH1F* getHist(int fileIndex);
+  TH1F* getHist(int fileIndex, bool weighted);
+  TString getUUID(int fileIndex);
+  bool isSkimmed(int fileIndex);
+  bool isWeighted(int fileIndex);
+  int nFiles();
+  double nTotalEventsInFile(int fileIndex);
+  
+  // Mutators:
+  void saveUUIDCache();
+  void setLocalName(int fileIndex, TString localName);
+  void setUUIDCache(TString cacheName);
+  
+ private:
+  
+  // Member methods:
+  void checkIndex(int fileIndex);
+  bool findCachedUUID(int fileIndex);
+  TString getStatKey(int fileIndex);
+  void indexFile(int fileIndex);
+  
+  Config *m_config;
+  TMutex *m_mutex;
+  
+  // Member objects (indexed by file):
+  std::vector<TString> m_fileNames;
+  std::vector<TString> m_localNames;
+  std::vector<bool> m_indexed;
+  std::vector<TString> m_uuids;
+  std::vector<Long64_t> m_fileSizes;
+  std::vector<TH1F*> m_histsWeighted;
+  std::vector<TH1F*> m_histsUnweighted;
+  std::vector<bool> m_skimmed;
+  std::vector<double> m_nTotalEvents;
+  std::vector<double> m_crossSectionBRfilterEff;
+  
+  // The UUIDs and sizes of files by path, mtime and size (see setUUIDCache()):
+  TString m_uuidCacheName;
+  bool m_uuidCacheChanged;
+  std::map<TString,TString> m_cachedUUIDs;
+  std::map<TString,Long64_t> m_cachedSizes;
+  
+};
+
+#endif
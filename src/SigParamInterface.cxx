@@ -2,13 +2,14 @@
 //                                                                            //
 //  Name: SigParamInterface.cxx                                               //
 //                                                                            //
-//  Created: Andrew Hard                                                      //
+//  Created: agent                                                            //
 //  Email: ahard@cern.ch                                                      //
 //  Date: 29/06/2015                                                          //
 //                                                                            //
 //  This is an interface class for the SigParam class. It allows one to load  //
 //  preexisting workspaces or create new ones if they cannot be loaded.       //
-//                                                                            //
+//  A list of signals can be given, so that jobs which need only some of the  //
+//  signals do not load (or create) the others.                               //
 //                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -21,13 +22,46 @@
    @param newOptions - The job options ("New", "FromFile")
 */
 SigParamInterface::SigParamInterface(TString newConfigFile, TString newOptions){
+  m_configFile = newConfigFile;
+  m_config = new Config(m_configFile);
+  
+  // The SM production modes (if split), the DM signals, then the total SM:
+  std::vector<TString> signalTypes; signalTypes.clear();
+  if (m_config->getBool("SplitSMProdModes")) {
+    signalTypes = m_config->getStrV("sigSMModes");
+  }
+  std::vector<TString> sigDMModes = m_config->getStrV("sigDMModes");
+  signalTypes.insert(signalTypes.end(), sigDMModes.begin(), sigDMModes.end());
+  signalTypes.push_back("SM");
+  prepareSignals(newOptions, signalTypes);
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Initialize the SigParamInterface class for a subset of the signals.
+   @param newConfigFile - The name of the analysis config file.
+   @param newOptions - The job options ("New", "FromFile")
+   @param signalTypes - The signals to load or create ("SM" for the total SM).
+*/
+SigParamInterface::SigParamInterface(TString newConfigFile, TString newOptions,
+				     std::vector<TString> signalTypes) {
+  m_configFile = newConfigFile;
+  m_config = new Config(m_configFile);
+  prepareSignals(newOptions, signalTypes);
+}
+
+/**
+   -----------------------------------------------------------------------------
+   Load the signal parameterizations from file or create them from scratch.
+   @param newOptions - The job options ("New", "FromFile")
+   @param signalTypes - The signals to load or create.
+*/
+void SigParamInterface::prepareSignals(TString newOptions,
+				       std::vector<TString> signalTypes) {
   std::cout << "\nSigParamInterface::Initializing..."
-	    << "\n\tconfigFile = " << newConfigFile
+	    << "\n\tconfigFile = " << m_configFile
 	    << "\n\toptions = " << newOptions << std::endl;
   
-  // Assign member variables:
-  m_configFile = newConfigFile;
-    
   m_signalsOK = true;
   m_failedSigParam = "";
   m_sigMap.clear();
@@ -35,45 +69,22 @@ SigParamInterface::SigParamInterface(TString newConfigFile, TString newOptions){
   // Set the ATLAS Style for plots:
   CommonFunc::SetAtlasStyle();
   
-  // Load the configuration for the analysis:
-  m_config = new Config(m_configFile);
-  
   // Assign output directory, and make sure it exists:
   m_outputDir = Form("%s/%s/DMSigParam", 
 		     (m_config->getStr("masterOutput")).Data(),
 		     (m_config->getStr("jobName")).Data());
   system(Form("mkdir -vp %s", m_outputDir.Data()));
   
-  // Load the SM signal parameterization from file or start from scratch:
-  if (m_config->getBool("SplitSMProdModes")) {
-    std::vector<TString> sigSMModes = m_config->getStrV("sigSMModes");
-    for (int i_SM = 0; i_SM < (int)sigSMModes.size(); i_SM++) {
-      if ((newOptions.Contains("FromFile") && loadFile(sigSMModes[i_SM]))
-	  || createNew(sigSMModes[i_SM])) {
-	std::cout << "SigParamInterface: " << sigSMModes[i_SM] << " ready!"
-		  << std::endl;
-      }
-      else m_signalsOK = false;
-    }
-  }
-  
-  // Load the DM signal parameterization from file or start from scratch:
-  std::vector<TString> sigDMModes = m_config->getStrV("sigDMModes");
-  for (int i_DM = 0; i_DM < (int)sigDMModes.size(); i_DM++) {
-    if ((newOptions.Contains("FromFile") && loadFile(sigDMModes[i_DM]))
-	|| createNew(sigDMModes[i_DM])) {
-      std::cout << "SigParamInterface: " << sigDMModes[i_DM] << " ready!"
+  // Load each signal parameterization from file or start from scratch:
+  for (int i_s = 0; i_s < (int)signalTypes.size(); i_s++) {
+    if ((newOptions.Contains("FromFile") && loadFile(signalTypes[i_s]))
+	|| createNew(signalTypes[i_s])) {
+      std::cout << "SigParamInterface: " << signalTypes[i_s] << " ready!"
 		<< std::endl;
     }
     else m_signalsOK = false;
   }
   
-  // Also load or create the total SM parameterization:
-  if ((newOptions.Contains("FromFile") && loadFile("SM")) || createNew("SM")) {
-    std::cout << "SigParamInterface: Total SM signal ready!" << std::endl;
-  }
-  else m_signalsOK = false;
-  
   if (m_signalsOK) {
     std::cout << "SigParamInterface: Successfully initialized!" << std::endl;
   }
@@ -36,6 +36,8 @@ class SigParamInterface
   
   // Constructor / destructor:
   SigParamInterface(TString newConfigFile, TString newOptions);
+  SigParamInterface(TString newConfigFile, TString newOptions,
+		    std::vector<TString> signalTypes);
   virtual ~SigParamInterface() {};
   
   // Accessors:
@@ -47,6 +49,9 @@ class SigParamInterface
 
  private:
   
+  // Member methods:
+  void prepareSignals(TString newOptions, std::vector<TString> signalTypes);
+  
   // Member variables:
   TString m_configFile;
   TString m_outputDir;
@@ -2,7 +2,7 @@
 //                                                                            //
 //  Name: SystematicsTool.cxx                                                 //
 //                                                                            //
-//  Created: Andrew Hard                                                      //
+//  Created: agent                                                            //
 //  Email: ahard@cern.ch                                                      //
 //  Date: 13/12/2015                                                          //
 //                                                                            //